@@ -32,6 +32,7 @@ SPVTOOLS_SRC_FILES := \
 		source/val/construct.cpp \
 		source/val/function.cpp \
 		source/val/instruction.cpp \
+		source/val/validation_cache.cpp \
 		source/val/validation_state.cpp \
 		source/validate.cpp \
 		source/validate_adjacency.cpp \
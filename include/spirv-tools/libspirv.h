@@ -472,6 +472,30 @@ SPIRV_TOOLS_EXPORT void spvValidatorOptionsSetRelaxStoreStruct(
 SPIRV_TOOLS_EXPORT void spvValidatorOptionsSetRelaxLogicalPointer(
     spv_validator_options options, bool val);
 
+// Records the number of errors after which the validator stops. The default
+// is 1. With a larger number the validator reports up to that many errors,
+// going on with the checks which do not depend on the failed ones, and leaving
+// out errors likely caused by an earlier one. When a diagnostic object is
+// requested, it holds the messages of all the errors, one per line, at the
+// position of the first one. A value of 0 is treated as 1.
+SPIRV_TOOLS_EXPORT void spvValidatorOptionsSetMaxErrors(
+    spv_validator_options options, uint32_t max_errors);
+
+// Records the number of threads the validator may use for the checks which
+// are independent across functions. The default is 1. A value of 0 means one
+// thread per hardware thread. The result and the diagnostics of validation do
+// not depend on the number of threads.
+SPIRV_TOOLS_EXPORT void spvValidatorOptionsSetNumThreads(
+    spv_validator_options options, uint32_t num_threads);
+
+// Records the directory in which the validator caches its results, keyed by
+// a hash of the module, the target environment, the other options and the
+// library version. Validating a module found in the cache reports the cached
+// result and diagnostics without parsing it. The directory must exist. A null
+// or empty path disables the cache, which is the default.
+SPIRV_TOOLS_EXPORT void spvValidatorOptionsSetCacheDirectory(
+    spv_validator_options options, const char* path);
+
 // Encodes the given SPIR-V assembly text to its binary representation. The
 // length parameter specifies the number of bytes for text. Encoded binary will
 // be stored into *binary. Any error will be written into *diagnostic if
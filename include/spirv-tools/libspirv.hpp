@@ -91,6 +91,23 @@ class ValidatorOptions {
     spvValidatorOptionsSetRelaxLogicalPointer(options_, val);
   }
 
+  // Records the number of errors after which the validator stops.
+  void SetMaxErrors(uint32_t max_errors) {
+    spvValidatorOptionsSetMaxErrors(options_, max_errors);
+  }
+
+  // Records the number of threads the validator may use, 0 meaning one per
+  // hardware thread.
+  void SetNumThreads(uint32_t num_threads) {
+    spvValidatorOptionsSetNumThreads(options_, num_threads);
+  }
+
+  // Records the directory in which the validator caches its results. An empty
+  // path disables the cache.
+  void SetCacheDirectory(const std::string& path) {
+    spvValidatorOptionsSetCacheDirectory(options_, path.c_str());
+  }
+
  private:
   spv_validator_options options_;
 };
@@ -29,7 +29,8 @@ class LinkerOptions {
   LinkerOptions()
       : create_library_(false),
         verify_ids_(false),
-        allow_partial_linkage_(false) {}
+        allow_partial_linkage_(false),
+        num_threads_(1u) {}
 
   // Returns whether a library or an executable should be produced by the
   // linking phase.
@@ -63,10 +64,20 @@ class LinkerOptions {
     allow_partial_linkage_ = allow_partial_linkage;
   }
 
+  // Returns the number of threads used to load and renumber the input
+  // modules. A value of 0 means one thread per hardware thread.
+  uint32_t GetNumThreads() const { return num_threads_; }
+
+  // Sets the number of threads used to load and renumber the input modules.
+  // A value of 0 means one thread per hardware thread. The linked module does
+  // not depend on this setting.
+  void SetNumThreads(uint32_t num_threads) { num_threads_ = num_threads; }
+
  private:
   bool create_library_;
   bool verify_ids_;
   bool allow_partial_linkage_;
+  uint32_t num_threads_;
 };
 
 // Links one or more SPIR-V modules into a new SPIR-V module. That is, combine
@@ -92,6 +103,36 @@ spv_result_t Link(const Context& context, const uint32_t* const* binaries,
                   std::vector<uint32_t>* linked_binary,
                   const LinkerOptions& options = LinkerOptions());
 
+// Creates an index of the SPIR-V module |library| and writes it to |index|.
+//
+// The index records, for each function of the library, its word range in the
+// binary, the functions it references, and the debug and annotation
+// instructions that target it. It also maps each exported function name to
+// its function. The index only stays valid for the exact binary it was
+// created from, and can be stored next to the library so that the cost of
+// parsing the library is paid once rather than at every link.
+//
+// The function can fail if |library| is not parseable.
+spv_result_t CreateLibraryIndex(const Context& context,
+                                const uint32_t* library, size_t library_size,
+                                std::vector<uint32_t>* index);
+
+// Links the modules in |binaries| against the library |library|, indexed by
+// |index| (as produced by CreateLibraryIndex()). Instead of linking the whole
+// library, only the functions which are transitively referenced from the
+// symbols imported by |binaries| are kept, along with the library's entry
+// points and its global declarations. The library's function bodies are
+// copied as word ranges, without being parsed.
+//
+// |library| and |index| may point into memory-mapped files. In addition to
+// the failure cases of Link(), the function can fail if |index| is malformed
+// or does not match |library|.
+spv_result_t LinkWithLibrary(
+    const Context& context, const std::vector<std::vector<uint32_t>>& binaries,
+    const uint32_t* library, size_t library_size, const uint32_t* index,
+    size_t index_size, std::vector<uint32_t>* linked_binary,
+    const LinkerOptions& options = LinkerOptions());
+
 }  // namespace spvtools
 
 #endif  // SPIRV_TOOLS_LINKER_HPP_
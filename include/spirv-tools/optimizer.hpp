@@ -78,6 +78,19 @@ class Optimizer {
   // method.
   Optimizer& RegisterPass(PassToken&& pass);
 
+  // Starts a group of passes that is run repeatedly until none of the passes
+  // in it changes the module, or until |max_iterations| rounds have been run.
+  // All passes registered until the matching EndFixedPointGroup() call belong
+  // to the group. Within the group, a pass is not rerun if the module has not
+  // changed since it last ran without making changes. Groups cannot be nested.
+  Optimizer& BeginFixedPointGroup(uint32_t max_iterations);
+  // Same as above, with the default limit of the pass manager.
+  Optimizer& BeginFixedPointGroup();
+
+  // Closes the group started by the last call to BeginFixedPointGroup().
+  // Reports an error and does nothing if no group is open.
+  Optimizer& EndFixedPointGroup();
+
   // Registers passes that attempt to improve performance of generated code.
   // This sequence of passes is subject to constant review and will change
   // from time to time.
@@ -124,6 +137,13 @@ class Optimizer {
   // |out| output stream.
   Optimizer& SetTimeReport(std::ostream* out);
 
+  // Sets the option to print, for each pass, the number of times it was run,
+  // how many of those runs changed the module, and how many runs were skipped
+  // because the module was unchanged since the pass last ran. If |out| is
+  // null, then no output is generated. Otherwise, output is sent to the |out|
+  // output stream.
+  Optimizer& SetChangeReport(std::ostream* out);
+
  private:
   struct Impl;                  // Opaque struct for holding internal data.
   std::unique_ptr<Impl> impl_;  // Unique pointer to internal data.
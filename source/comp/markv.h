@@ -21,6 +21,9 @@
 #ifndef SPIRV_TOOLS_MARKV_HPP_
 #define SPIRV_TOOLS_MARKV_HPP_
 
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <string>
 #include <vector>
 
@@ -51,6 +54,31 @@ using MarkvDebugConsumer =
 // contain a paragraph of text with newlines, or can be just one character.
 using MarkvLogConsumer = std::function<void(const std::string& snippet)>;
 
+// Input callback of the streaming decoder. Copies at most |max_size| bytes of
+// the MARK-V binary to |data| and returns the number of bytes copied. Returns 0
+// once the whole binary has been supplied. The callback may return fewer bytes
+// than requested; the decoder only needs a few kilobytes at a time.
+using MarkvByteSource = std::function<size_t(uint8_t* data, size_t max_size)>;
+
+// Output callback of the streaming decoder. Called first with the 5 words of
+// the SPIR-V header, then once with the words of each decoded instruction.
+// |words| is only valid during the call. Returning false stops decoding with
+// SPV_REQUESTED_TERMINATION.
+using SpirvWordConsumer =
+    std::function<bool(const uint32_t* words, size_t num_words)>;
+
+// Options of the container format, which splits the functions of a module
+// into blocks that are encoded and decoded independently of each other.
+struct MarkvContainerOptions {
+  // Functions are grouped into blocks of at least this many SPIR-V words.
+  // Smaller blocks allow more parallelism, but every block repeats the work of
+  // coding the global section of the module.
+  size_t min_block_num_words = 4096;
+  // Number of threads used to code the blocks. 0 means one thread per
+  // hardware thread.
+  uint32_t num_threads = 0;
+};
+
 // Encodes the given SPIR-V binary to MARK-V binary.
 // |log_consumer| is optional (pass MarkvLogConsumer() to disable).
 // |debug_consumer| is optional (pass MarkvDebugConsumer() to disable).
@@ -69,6 +97,87 @@ spv_result_t MarkvToSpirv(
     MessageConsumer message_consumer, MarkvLogConsumer log_consumer,
     MarkvDebugConsumer debug_consumer, std::vector<uint32_t>* spirv);
 
+// Decodes a SPIR-V binary from a MARK-V binary read from |markv_source| in
+// chunks. The SPIR-V words are passed to |spirv_consumer| as soon as each
+// instruction is decoded, so they can be fed to a parser or an upload buffer
+// directly. The decoder still keeps the decoded instructions it needs to
+// track ids, so its memory use grows with the size of the module. If decoding
+// fails, |spirv_consumer| may have received part of the module.
+// |log_consumer| is optional (pass MarkvLogConsumer() to disable).
+// |debug_consumer| is optional (pass MarkvDebugConsumer() to disable).
+spv_result_t MarkvStreamToSpirv(
+    spv_const_context context, MarkvByteSource markv_source,
+    const MarkvCodecOptions& options, const MarkvModel& markv_model,
+    MessageConsumer message_consumer, MarkvLogConsumer log_consumer,
+    MarkvDebugConsumer debug_consumer, SpirvWordConsumer spirv_consumer);
+
+// Encodes the given SPIR-V binary to a MARK-V container. The global section
+// of the module is encoded once, and the functions are encoded in blocks on
+// |container_options.num_threads| threads. The container is only readable by
+// MarkvContainerToSpirv. The binary must be in host endianness.
+spv_result_t SpirvToMarkvContainer(
+    spv_const_context context, const std::vector<uint32_t>& spirv,
+    const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint8_t>* markv);
+
+// Decodes a SPIR-V binary from the given MARK-V container, decoding its blocks
+// on |container_options.num_threads| threads. Only the |num_threads| member of
+// |container_options| is used.
+spv_result_t MarkvContainerToSpirv(
+    spv_const_context context, const std::vector<uint8_t>& markv,
+    const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint32_t>* spirv);
+
+// Encodes the given SPIR-V binaries to a MARK-V pack, on
+// |container_options.num_threads| threads. Every function is encoded in a
+// block of its own, after only the global instructions it uses, so a helper
+// function is encoded to the same bits in every module which has it and the
+// types and constants it uses. Only the bits of the function are stored: the
+// decoder finds the bits of these global instructions by encoding them again
+// from the decoded global section. The entry points, debug instructions and
+// decorations are encoded after the rest of the global section and stored
+// apart from it, so modules which only differ in them share their global
+// section, and the global section is stored in fixed-size parts, so modules
+// whose global sections start alike share the parts of their common start.
+// Every part and block is stored once however many modules contain it, and
+// each module keeps a small record of the segments it uses. Only the
+// |num_threads| member of |container_options| is used. The pack is only
+// readable by MarkvPackToSpirv. The binaries must be in host endianness.
+spv_result_t SpirvToMarkvPack(
+    spv_const_context context,
+    const std::vector<std::vector<uint32_t>>& modules,
+    const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint8_t>* pack);
+
+// Gets the number of modules in the MARK-V pack of |pack_size| bytes at
+// |pack|.
+spv_result_t GetMarkvPackNumModules(spv_const_context context,
+                                    const uint8_t* pack, size_t pack_size,
+                                    const MarkvModel& markv_model,
+                                    MessageConsumer message_consumer,
+                                    uint32_t* num_modules);
+
+// Decodes module |module_index| of the MARK-V pack of |pack_size| bytes at
+// |pack|, decoding its blocks on |container_options.num_threads| threads. Only
+// the header of the pack, the record of the module and the segments it uses
+// are read, so |pack| may be a memory-mapped file. The decoded module has the
+// instructions of the encoded one in the same order, with other ids. Only the
+// |num_threads| member of |container_options| is used. Packs are validated a
+// module at a time rather than an instruction at a time if
+// |options.validate_spirv_binary| is set.
+spv_result_t MarkvPackToSpirv(
+    spv_const_context context, const uint8_t* pack, size_t pack_size,
+    uint32_t module_index, const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint32_t>* spirv);
+
 }  // namespace spvtools
 
 #endif  // SPIRV_TOOLS_MARKV_HPP_
@@ -26,8 +26,10 @@
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <numeric>
 #include <string>
 #include <unordered_map>
@@ -55,6 +57,7 @@
 #include "util/bit_stream.h"
 #include "util/huffman_codec.h"
 #include "util/move_to_front.h"
+#include "util/parallel.h"
 #include "util/parse_number.h"
 #include "val/instruction.h"
 #include "val/validation_state.h"
@@ -64,7 +67,7 @@ using libspirv::DiagnosticStream;
 using libspirv::IdDescriptorCollection;
 using libspirv::Instruction;
 using libspirv::ValidationState_t;
-using spvutils::BitReaderWord64;
+using spvutils::BitReaderChunked;
 using spvutils::BitWriterWord64;
 using spvutils::HuffmanCodec;
 using MoveToFront = spvutils::MoveToFront<uint32_t>;
@@ -76,6 +79,8 @@ namespace {
 
 const uint32_t kSpirvMagicNumber = SpvMagicNumber;
 const uint32_t kMarkvMagicNumber = 0x07230303;
+const uint32_t kMarkvContainerMagicNumber = 0x07230304;
+const uint32_t kMarkvPackMagicNumber = 0x07230306;
 
 // Handles for move-to-front sequences. Enums which end with "Begin" define
 // handle spaces which start at that value and span 16 or 32 bit wide.
@@ -154,16 +159,9 @@ const size_t kByteBreakAfterInstIfLessThanUntilNextByte = 8;
 
 const uint32_t kShortDescriptorNumBits = 8;
 
-// Custom hash function used to produce short descriptors.
-uint32_t ShortHashU32Array(const std::vector<uint32_t>& words) {
-  // The hash function is a sum of hashes of each word seeded by word index.
-  // Knuth's multiplicative hash is used to hash the words.
-  const uint32_t kKnuthMulHash = 2654435761;
-  uint32_t val = 0;
-  for (uint32_t i = 0; i < words.size(); ++i) {
-    val += (words[i] + i + 123) * kKnuthMulHash;
-  }
-  return 1 + val % ((1 << kShortDescriptorNumBits) - 1);
+// Maps descriptor hashes to short descriptors.
+uint32_t GetShortDescriptor(uint32_t hash) {
+  return 1 + hash % ((1 << kShortDescriptorNumBits) - 1);
 }
 
 // Returns a set of mtf rank codecs based on a plausible hand-coded
@@ -277,7 +275,7 @@ size_t GetNumBitsToNextByte(size_t bit_pos) { return (8 - (bit_pos % 8)) % 8; }
 // Defines and returns current MARK-V version.
 uint32_t GetMarkvVersion() {
   const uint32_t kVersionMajor = 1;
-  const uint32_t kVersionMinor = 4;
+  const uint32_t kVersionMinor = 5;
   return kVersionMinor | (kVersionMajor << 16);
 }
 
@@ -348,6 +346,40 @@ class MarkvLogger {
   bool use_delimiter_ = false;
 };
 
+// Index entry of a block of a MARK-V container. A block holds one or more
+// consecutive functions, and can be decoded independently of the other blocks
+// after the global section of the module.
+struct MarkvContainerBlock {
+  // Position of the encoded functions in the container in bytes, and their
+  // length in bits.
+  uint32_t offset = 0;
+  uint32_t length_in_bits = 0;
+  // The decoder issues the ids [id_base, id_base + num_new_ids) in the block.
+  uint32_t id_base = 0;
+  uint32_t num_new_ids = 0;
+  // Ids of the functions of other blocks, as pairs of the index of the first
+  // reference in the block and the decoded id of the function.
+  std::vector<std::pair<uint32_t, uint32_t>> external_ids;
+};
+
+// Result of encoding a block of a MARK-V container.
+struct MarkvContainerBlockData {
+  MarkvContainerBlock info;
+  // The encoded global section, which is the same for every block, and the
+  // decoded id bound after it.
+  std::vector<uint8_t> globals;
+  uint32_t globals_length_in_bits = 0;
+  uint32_t globals_id_bound = 0;
+  // The encoded instructions of the block.
+  std::vector<uint8_t> bits;
+  // References to the functions of other blocks, as pairs of the index of the
+  // first reference in the block and the id of the function in the module.
+  std::vector<std::pair<uint32_t, uint32_t>> external_references;
+  // Maps ids of the module to decoded ids. Decoded ids from globals_id_bound
+  // on are relative to the block.
+  std::unordered_map<uint32_t, uint32_t> decoded_ids;
+};
+
 // Base class for MARK-V encoder and decoder. Contains common functionality
 // such as:
 // - Validator connection and validation state.
@@ -367,6 +399,7 @@ class MarkvCodecBase {
       markv_length_in_bits = 0;
       spirv_version = 0;
       spirv_generator = 0;
+      spirv_id_bound = 0;
     }
 
     uint32_t magic_number;
@@ -376,6 +409,9 @@ class MarkvCodecBase {
     uint32_t markv_length_in_bits;
     uint32_t spirv_version;
     uint32_t spirv_generator;
+    // Id bound of the decoded module. Stored in the header so that the decoder
+    // can output the SPIR-V header before the instructions.
+    uint32_t spirv_id_bound;
   };
 
   // |model| is owned by the caller, must be not null and valid during the
@@ -386,7 +422,7 @@ class MarkvCodecBase {
       : validator_options_(validator_options),
         grammar_(context),
         model_(model),
-        short_id_descriptors_(ShortHashU32Array),
+        short_id_descriptors_(GetShortDescriptor),
         mtf_huffman_codecs_(GetMtfHuffmanCodecs()),
         context_(context),
         vstate_(validator_options
@@ -561,6 +597,9 @@ class MarkvCodecBase {
   // List of ids local to the current function.
   std::vector<uint32_t> ids_local_to_cur_function_;
 
+  // Stores the words and operands of |instructions_|.
+  libspirv::InstructionArena instruction_arena_;
+
   // List of instructions in the order they are given in the module.
   std::vector<std::unique_ptr<const Instruction>> instructions_;
 
@@ -574,7 +613,7 @@ class MarkvCodecBase {
   // descriptors, since one could actually map/truncate long descriptors.
   // But as short descriptors have collisions, the efficiency of
   // compression depends on the collision pattern, and short descriptors
-  // produced by function ShortHashU32Array have been empirically proven to
+  // produced by function GetShortDescriptor have been empirically proven to
   // produce better results.
   IdDescriptorCollection short_id_descriptors_;
 
@@ -641,6 +680,42 @@ class MarkvEncoder : public MarkvCodecBase {
   // the encoder stubmles on something unexpected.
   spv_result_t EncodeInstruction(const spv_parsed_instruction_t& inst);
 
+  // Makes the encoder encode a block of a MARK-V container. The module given
+  // to the encoder consists of the global section of the original module and
+  // the instructions of the block, which start at the first function, or
+  // after |num_global_instructions| instructions if that comes first.
+  // |external_ids| are the ids of the original module which are defined in
+  // other blocks, such as the functions of other blocks.
+  void SetContainerBlock(std::unordered_set<uint32_t>&& external_ids,
+                         size_t num_global_instructions =
+                             std::numeric_limits<size_t>::max()) {
+    is_container_block_ = true;
+    external_ids_ = std::move(external_ids);
+    num_global_instructions_ = num_global_instructions;
+  }
+
+  // Must be called after the last instruction of a container block has been
+  // encoded. Fills |block| with everything the container needs to know about
+  // the block, besides the ids of other blocks.
+  void FinishContainerBlock(MarkvContainerBlockData* block) {
+    assert(is_container_block_);
+    if (!in_block_) BeginContainerBlock();
+
+    const uint8_t* data = writer_.GetData();
+    const size_t globals_num_bytes =
+        spvutils::NumBitsToNumWords<8>(globals_num_bits_);
+    block->globals_length_in_bits = static_cast<uint32_t>(globals_num_bits_);
+    block->globals_id_bound = globals_id_bound_;
+    block->globals.assign(data, data + globals_num_bytes);
+    block->info.length_in_bits = static_cast<uint32_t>(
+        writer_.GetNumBits() - globals_num_bytes * 8);
+    block->info.num_new_ids = decoded_id_bound_ - globals_id_bound_;
+    block->bits.assign(data + globals_num_bytes,
+                       data + writer_.GetDataSizeBytes());
+    block->external_references = std::move(external_references_);
+    block->decoded_ids = std::move(decoded_ids_);
+  }
+
   // Concatenates MARK-V header and the bit stream with encoded instructions
   // into a single buffer and returns it as spv_markv_binary. The returned
   // value is owned by the caller and needs to be destroyed with
@@ -650,6 +725,7 @@ class MarkvEncoder : public MarkvCodecBase {
         static_cast<uint32_t>(sizeof(header_) * 8 + writer_.GetNumBits());
     header_.markv_model =
         (model_->model_type() << 16) | model_->model_version();
+    header_.spirv_id_bound = decoded_id_bound_;
 
     const size_t num_bytes = sizeof(header_) + writer_.GetDataSizeBytes();
     std::vector<uint8_t> markv(num_bytes);
@@ -723,6 +799,35 @@ class MarkvEncoder : public MarkvCodecBase {
   // Encodes a literal number operand and writes it to the bit stream.
   spv_result_t EncodeLiteralNumber(const spv_parsed_operand_t& operand);
 
+  // Records that the decoder issues a new id for |id|.
+  void IssueNewId(uint32_t id) {
+    if (is_container_block_) decoded_ids_[id] = decoded_id_bound_;
+    ++decoded_id_bound_;
+  }
+
+  // Records the first reference to the forward declared |id|. In a container
+  // block, the ids defined in other blocks get the id issued by their own
+  // block instead of a new one.
+  void AddFirstReference(uint32_t id) {
+    if (in_block_) {
+      const uint32_t reference_index = num_block_first_references_++;
+      if (external_ids_.count(id)) {
+        external_references_.emplace_back(reference_index, id);
+        return;
+      }
+    }
+    IssueNewId(id);
+  }
+
+  // Ends the global section of a container block, and starts the
+  // instructions of the block on the next byte.
+  void BeginContainerBlock() {
+    globals_num_bits_ = writer_.GetNumBits();
+    writer_.WriteBits(0, GetNumBitsToNextByte(globals_num_bits_));
+    globals_id_bound_ = decoded_id_bound_;
+    in_block_ = true;
+  }
+
   MarkvCodecOptions options_;
 
   // Bit stream where encoded instructions are written.
@@ -731,6 +836,36 @@ class MarkvEncoder : public MarkvCodecBase {
   // If not nullptr, disassembled instruction lines will be written to comments.
   // Format: \n separated instruction lines, no header.
   std::unique_ptr<std::stringstream> disassembly_;
+
+  // Id bound of the module the decoder will produce. The decoder issues new
+  // ids in order of first appearance, and this counts them the same way.
+  uint32_t decoded_id_bound_ = 1;
+
+  // True if the encoder encodes a block of a MARK-V container, and true once
+  // it has reached the instructions of the block.
+  bool is_container_block_ = false;
+  bool in_block_ = false;
+
+  // Ids defined in other blocks of the container.
+  std::unordered_set<uint32_t> external_ids_;
+
+  // Number of instructions of the global section of a container block, if
+  // the block does not start at its first function.
+  size_t num_global_instructions_ = std::numeric_limits<size_t>::max();
+
+  // Length of the global section in bits, and the decoded id bound after it.
+  size_t globals_num_bits_ = 0;
+  uint32_t globals_id_bound_ = 0;
+
+  // Number of forward declared ids first referenced in the block so far.
+  uint32_t num_block_first_references_ = 0;
+
+  // References to functions of other blocks, as pairs of the index of the
+  // first reference in the block and the id of the function.
+  std::vector<std::pair<uint32_t, uint32_t>> external_references_;
+
+  // Maps the ids of a container block to the ids issued by the decoder.
+  std::unordered_map<uint32_t, uint32_t> decoded_ids_;
 };
 
 // Decodes MARK-V buffers written by MarkvEncoder.
@@ -738,11 +873,15 @@ class MarkvDecoder : public MarkvCodecBase {
  public:
   // |model| is owned by the caller, must be not null and valid during the
   // lifetime of MarkvEncoder.
-  MarkvDecoder(spv_const_context context, const std::vector<uint8_t>& markv,
+  // The MARK-V binary is read from |markv_source|, and the decoded SPIR-V words
+  // are passed to |spirv_consumer| as soon as they are available.
+  MarkvDecoder(spv_const_context context, MarkvByteSource markv_source,
+               SpirvWordConsumer spirv_consumer,
                const MarkvCodecOptions& options, const MarkvModel* model)
       : MarkvCodecBase(context, GetValidatorOptions(options), model),
         options_(options),
-        reader_(markv) {
+        spirv_consumer_(std::move(spirv_consumer)),
+        reader_(std::move(markv_source)) {
     (void)options_;
     SetIdBound(1);
     parsed_operands_.reserve(25);
@@ -755,10 +894,28 @@ class MarkvDecoder : public MarkvCodecBase {
     logger_.reset(new MarkvLogger(log_consumer, debug_consumer));
   }
 
-  // Decodes SPIR-V from MARK-V and stores the words in |spirv_binary|.
+  // Decodes SPIR-V from MARK-V and passes the words to the SPIR-V consumer:
+  // first the header, then one instruction at a time.
   // Can be called only once. Fails if data of wrong format or ends prematurely,
   // of if validation fails.
-  spv_result_t DecodeModule(std::vector<uint32_t>* spirv_binary);
+  spv_result_t DecodeModule();
+
+  // Decodes a block of a MARK-V container from a bit stream which holds the
+  // global section, |globals_length_in_bits| long and padded to a whole byte,
+  // followed by the functions of |block|. The global section is only passed to
+  // the SPIR-V consumer if |output_globals| is true.
+  spv_result_t DecodeContainerBlock(uint32_t globals_length_in_bits,
+                                    uint32_t globals_id_bound,
+                                    const MarkvContainerBlock& block,
+                                    bool output_globals);
+
+  // Makes the decoder pass |ids|[id - 1] to the SPIR-V consumer in place of
+  // every decoded id from 1 to |ids|.size(). Used for the blocks of MARK-V
+  // packs, whose global sections only hold the global instructions used by
+  // the block, so the decoder issues them other ids than the module has.
+  void SetOutputIds(std::vector<uint32_t>&& ids) {
+    output_ids_ = std::move(ids);
+  }
 
  private:
   // Describes the format of a typed literal number.
@@ -834,6 +991,28 @@ class MarkvDecoder : public MarkvCodecBase {
   // Decoded instruction is valid until the next call of DecodeInstruction().
   spv_result_t DecodeInstruction();
 
+  // Decodes and validates instructions until |num_bits| bits of the bit
+  // stream have been read.
+  spv_result_t DecodeInstructionsUntil(size_t num_bits);
+
+  // Issues and returns a new id.
+  uint32_t IssueNewId() {
+    const uint32_t id = next_new_id_++;
+    SetIdBound(std::max(GetIdBound(), next_new_id_));
+    return id;
+  }
+
+  // Returns the id of a forward declared id at its first reference. In a
+  // container block, the functions of other blocks get the id issued by their
+  // own block instead of a new one.
+  uint32_t GetIdOfFirstReference() {
+    if (in_block_) {
+      const auto it = external_ids_.find(num_block_first_references_++);
+      if (it != external_ids_.end()) return it->second;
+    }
+    return IssueNewId();
+  }
+
   // Read operand from the stream decodes and validates it.
   spv_result_t DecodeOperand(size_t operand_offset,
                              const spv_operand_type_t type,
@@ -854,12 +1033,11 @@ class MarkvDecoder : public MarkvCodecBase {
 
   MarkvCodecOptions options_;
 
-  // Temporary sink where decoded SPIR-V words are written. Once it contains the
-  // entire module, the container is moved and returned.
-  std::vector<uint32_t> spirv_;
+  // Receives the decoded SPIR-V words.
+  SpirvWordConsumer spirv_consumer_;
 
   // Bit stream containing encoded data.
-  BitReaderWord64 reader_;
+  BitReaderChunked reader_;
 
   // Temporary storage for operands of the currently parsed instruction.
   // Valid until next DecodeInstruction call.
@@ -869,15 +1047,38 @@ class MarkvDecoder : public MarkvCodecBase {
   // Valid until next DecodeInstruction call.
   std::vector<uint32_t> inst_words_;
 
+  // Ids passed to the SPIR-V consumer in place of the decoded ids from 1 on,
+  // and the words of the current instruction with these ids.
+  std::vector<uint32_t> output_ids_;
+  std::vector<uint32_t> output_words_;
+
   // Maps a type ID to its number type description.
   std::unordered_map<uint32_t, NumberType> type_id_to_number_type_info_;
 
   // Maps an ExtInstImport id to the extended instruction type.
   std::unordered_map<uint32_t, spv_ext_inst_type_t> import_id_to_ext_inst_type_;
+
+  // The next id issued to a result id which was not forward declared, or to
+  // the first reference of a forward declared id.
+  uint32_t next_new_id_ = 1;
+
+  // False while decoded instructions are not passed to spirv_consumer_.
+  bool output_instructions_ = true;
+
+  // True once a container block decoder has reached the functions of the
+  // block.
+  bool in_block_ = false;
+
+  // Number of forward declared ids first referenced in the block so far.
+  uint32_t num_block_first_references_ = 0;
+
+  // Maps the index of a first reference in a container block to the id of a
+  // function of another block.
+  std::unordered_map<uint32_t, uint32_t> external_ids_;
 };
 
 void MarkvCodecBase::ProcessCurInstruction() {
-  instructions_.emplace_back(new Instruction(&inst_));
+  instructions_.emplace_back(new Instruction(&inst_, &instruction_arena_));
 
   const SpvOp opcode = SpvOp(inst_.opcode);
 
@@ -913,7 +1114,7 @@ void MarkvCodecBase::ProcessCurInstruction() {
   // Remove local ids from MTFs if function end.
   if (opcode == SpvOpFunctionEnd) {
     cur_function_id_ = 0;
-    for (uint32_t id : ids_local_to_cur_function_) multi_mtf_.RemoveFromAll(id);
+    multi_mtf_.RemoveAllFromAll(ids_local_to_cur_function_);
     ids_local_to_cur_function_.clear();
     assert(remaining_function_parameter_types_.empty());
   }
@@ -1837,6 +2038,7 @@ spv_result_t MarkvEncoder::EncodeRefId(uint32_t id) {
 
     if (!multi_mtf_.RankFromValue(mtf, id, &rank)) {
       // This is the first occurrence of a forward declared id.
+      AddFirstReference(id);
       multi_mtf_.Insert(kMtfAll, id);
       multi_mtf_.Insert(kMtfForwardDeclared, id);
       if (mtf != kMtfAll) multi_mtf_.Insert(mtf, id);
@@ -1849,6 +2051,7 @@ spv_result_t MarkvEncoder::EncodeRefId(uint32_t id) {
 
     if (!multi_mtf_.RankFromValue(kMtfForwardDeclared, id, &rank)) {
       // This is the first occurrence of a forward declared id.
+      AddFirstReference(id);
       multi_mtf_.Insert(kMtfForwardDeclared, id);
       rank = 0;
     }
@@ -1884,8 +2087,7 @@ spv_result_t MarkvDecoder::DecodeRefId(uint32_t* id) {
 
     if (rank == 0) {
       // This is the first occurrence of a forward declared id.
-      *id = GetIdBound();
-      SetIdBound(*id + 1);
+      *id = GetIdOfFirstReference();
       multi_mtf_.Insert(kMtfAll, *id);
       multi_mtf_.Insert(kMtfForwardDeclared, *id);
       if (mtf != kMtfAll) multi_mtf_.Insert(mtf, *id);
@@ -1902,8 +2104,7 @@ spv_result_t MarkvDecoder::DecodeRefId(uint32_t* id) {
 
     if (rank == 0) {
       // This is the first occurrence of a forward declared id.
-      *id = GetIdBound();
-      SetIdBound(*id + 1);
+      *id = GetIdOfFirstReference();
       multi_mtf_.Insert(kMtfForwardDeclared, *id);
     } else {
       if (!multi_mtf_.ValueFromRank(kMtfForwardDeclared, rank, id))
@@ -1997,6 +2198,9 @@ spv_result_t MarkvEncoder::EncodeResultId() {
     }
   }
 
+  // The decoder issues a new id unless the id was forward declared.
+  if (!rank) IssueNewId(inst_.result_id);
+
   if (model_->id_fallback_strategy() ==
       MarkvModel::IdFallbackStrategy::kRuleBased) {
     if (!rank) {
@@ -2042,8 +2246,7 @@ spv_result_t MarkvDecoder::DecodeResultId() {
 
   if (inst_.result_id == 0) {
     // The id was not forward declared, issue a new id.
-    inst_.result_id = GetIdBound();
-    SetIdBound(inst_.result_id + 1);
+    inst_.result_id = IssueNewId();
   }
 
   if (model_->id_fallback_strategy() ==
@@ -2148,6 +2351,11 @@ spv_result_t MarkvEncoder::EncodeInstruction(
   SpvOp opcode = SpvOp(inst.opcode);
   inst_ = inst;
 
+  if (is_container_block_ && !in_block_ &&
+      (opcode == SpvOpFunction ||
+       instructions_.size() == num_global_instructions_))
+    BeginContainerBlock();
+
   const spv_result_t validation_result = UpdateValidationState(inst);
   if (validation_result != SPV_SUCCESS) return validation_result;
 
@@ -2273,14 +2481,15 @@ spv_result_t MarkvEncoder::EncodeInstruction(
   return SPV_SUCCESS;
 }
 
-spv_result_t MarkvDecoder::DecodeModule(std::vector<uint32_t>* spirv_binary) {
+spv_result_t MarkvDecoder::DecodeModule() {
   const bool header_read_success =
       reader_.ReadUnencoded(&header_.magic_number) &&
       reader_.ReadUnencoded(&header_.markv_version) &&
       reader_.ReadUnencoded(&header_.markv_model) &&
       reader_.ReadUnencoded(&header_.markv_length_in_bits) &&
       reader_.ReadUnencoded(&header_.spirv_version) &&
-      reader_.ReadUnencoded(&header_.spirv_generator);
+      reader_.ReadUnencoded(&header_.spirv_generator) &&
+      reader_.ReadUnencoded(&header_.spirv_id_bound);
 
   if (!header_read_success)
     return Diag(SPV_ERROR_INVALID_BINARY) << "Unable to read MARK-V header";
@@ -2309,25 +2518,23 @@ spv_result_t MarkvDecoder::DecodeModule(std::vector<uint32_t>* spirv_binary) {
            << "MARK-V binary and the codec use different versions if the same "
            << "MARK-V model";
 
-  spirv_.reserve(header_.markv_length_in_bits / 2);  // Heuristic.
-  spirv_.resize(5, 0);
-  spirv_[0] = kSpirvMagicNumber;
-  spirv_[1] = header_.spirv_version;
-  spirv_[2] = header_.spirv_generator;
+  if (header_.spirv_id_bound == 0)
+    return Diag(SPV_ERROR_INVALID_BINARY)
+           << "Header spirv_id_bound field is zero";
+
+  const uint32_t spirv_header[5] = {kSpirvMagicNumber, header_.spirv_version,
+                                    header_.spirv_generator,
+                                    header_.spirv_id_bound, 0};
+  if (!spirv_consumer_(spirv_header, 5)) return SPV_REQUESTED_TERMINATION;
 
   if (logger_) {
     reader_.SetCallback(
         [this](const std::string& str) { logger_->AppendBitSequence(str); });
   }
 
-  while (reader_.GetNumReadBits() < header_.markv_length_in_bits) {
-    inst_ = {};
-    const spv_result_t decode_result = DecodeInstruction();
-    if (decode_result != SPV_SUCCESS) return decode_result;
-
-    const spv_result_t validation_result = UpdateValidationState(inst_);
-    if (validation_result != SPV_SUCCESS) return validation_result;
-  }
+  const spv_result_t result =
+      DecodeInstructionsUntil(header_.markv_length_in_bits);
+  if (result != SPV_SUCCESS) return result;
 
   if (reader_.GetNumReadBits() != header_.markv_length_in_bits ||
       !reader_.OnlyZeroesLeft()) {
@@ -2336,11 +2543,58 @@ spv_result_t MarkvDecoder::DecodeModule(std::vector<uint32_t>* spirv_binary) {
            << reader_.GetNumReadBits() << " " << header_.markv_length_in_bits;
   }
 
-  // Decoding of the module is finished, validation state should have correct
-  // id bound.
-  spirv_[3] = GetIdBound();
+  // Decoding of the module is finished, the id bound which was output with
+  // the header must be the one of the decoded module.
+  if (GetIdBound() != header_.spirv_id_bound) {
+    return Diag(SPV_ERROR_INVALID_BINARY)
+           << "MARK-V binary has wrong stated id bound "
+           << header_.spirv_id_bound << " " << GetIdBound();
+  }
 
-  *spirv_binary = std::move(spirv_);
+  return SPV_SUCCESS;
+}
+
+spv_result_t MarkvDecoder::DecodeContainerBlock(
+    uint32_t globals_length_in_bits, uint32_t globals_id_bound,
+    const MarkvContainerBlock& block, bool output_globals) {
+  output_instructions_ = output_globals;
+  spv_result_t result = DecodeInstructionsUntil(globals_length_in_bits);
+  if (result != SPV_SUCCESS) return result;
+
+  if (reader_.GetNumReadBits() != globals_length_in_bits ||
+      !ReadToByteBreak(8) || next_new_id_ != globals_id_bound ||
+      block.id_base < globals_id_bound) {
+    return Diag(SPV_ERROR_INVALID_BINARY)
+           << "MARK-V container has an invalid global section";
+  }
+
+  output_instructions_ = true;
+  in_block_ = true;
+  next_new_id_ = block.id_base;
+  SetIdBound(std::max(GetIdBound(), next_new_id_));
+  external_ids_.insert(block.external_ids.begin(), block.external_ids.end());
+
+  const size_t end = reader_.GetNumReadBits() + block.length_in_bits;
+  result = DecodeInstructionsUntil(end);
+  if (result != SPV_SUCCESS) return result;
+
+  if (reader_.GetNumReadBits() != end || !reader_.OnlyZeroesLeft() ||
+      next_new_id_ != block.id_base + block.num_new_ids) {
+    return Diag(SPV_ERROR_INVALID_BINARY)
+           << "MARK-V container block has wrong stated length or ids";
+  }
+  return SPV_SUCCESS;
+}
+
+spv_result_t MarkvDecoder::DecodeInstructionsUntil(size_t num_bits) {
+  while (reader_.GetNumReadBits() < num_bits) {
+    inst_ = {};
+    const spv_result_t decode_result = DecodeInstruction();
+    if (decode_result != SPV_SUCCESS) return decode_result;
+
+    const spv_result_t validation_result = UpdateValidationState(inst_);
+    if (validation_result != SPV_SUCCESS) return validation_result;
+  }
   return SPV_SUCCESS;
 }
 
@@ -2750,7 +3004,20 @@ spv_result_t MarkvDecoder::DecodeInstruction() {
   inst_.num_words = static_cast<uint16_t>(inst_words_.size());
   inst_words_[0] = spvOpcodeMake(inst_.num_words, SpvOp(inst_.opcode));
 
-  std::copy(inst_words_.begin(), inst_words_.end(), std::back_inserter(spirv_));
+  if (output_instructions_) {
+    const uint32_t* words = inst_words_.data();
+    if (!output_ids_.empty()) {
+      output_words_.assign(inst_words_.begin(), inst_words_.end());
+      for (const spv_parsed_operand_t& operand : parsed_operands_) {
+        if (!spvIsIdType(operand.type)) continue;
+        uint32_t& id = output_words_[operand.offset];
+        if (id != 0 && id <= output_ids_.size()) id = output_ids_[id - 1];
+      }
+      words = output_words_.data();
+    }
+    if (!spirv_consumer_(words, inst_words_.size()))
+      return SPV_REQUESTED_TERMINATION;
+  }
 
   assert(inst_.num_words ==
              std::accumulate(
@@ -2837,6 +3104,840 @@ spv_result_t EncodeInstruction(void* user_data,
   return encoder->EncodeInstruction(*inst);
 }
 
+// Returns a message consumer which forwards to |consumer|, one message at a
+// time, so that it can be shared by the threads of a container codec.
+MessageConsumer MakeThreadSafe(MessageConsumer consumer) {
+  if (!consumer) return consumer;
+  std::shared_ptr<std::mutex> mutex(new std::mutex);
+  return [consumer, mutex](spv_message_level_t level, const char* source,
+                           const spv_position_t& position,
+                           const char* message) {
+    std::lock_guard<std::mutex> lock(*mutex);
+    consumer(level, source, position, message);
+  };
+}
+
+// Appends |value| to |out|.
+void AppendWord(uint32_t value, std::vector<uint8_t>* out) {
+  const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&value);
+  out->insert(out->end(), bytes, bytes + sizeof(value));
+}
+
+// Reads a word from the |size| bytes at |data| at |*offset|, and advances
+// |*offset|. Returns false if there are too few bytes.
+bool ReadWord(const uint8_t* data, size_t size, size_t* offset,
+              uint32_t* value) {
+  if (size < sizeof(*value) || *offset > size - sizeof(*value)) return false;
+  std::memcpy(value, data + *offset, sizeof(*value));
+  *offset += sizeof(*value);
+  return true;
+}
+
+// Appends |value| to |out| in as few bytes as it takes: seven bits per byte,
+// lowest first, with the high bit set in every byte but the last.
+void AppendVarint(uint32_t value, std::vector<uint8_t>* out) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<uint8_t>(value));
+}
+
+// Reads a value written by AppendVarint from the |size| bytes at |data| at
+// |*offset|, and advances |*offset|. Returns false if the value is truncated
+// or does not fit in a word.
+bool ReadVarint(const uint8_t* data, size_t size, size_t* offset,
+                uint32_t* value) {
+  uint64_t result = 0;
+  for (uint32_t shift = 0; shift < 35; shift += 7) {
+    if (*offset >= size) return false;
+    const uint8_t byte = data[(*offset)++];
+    result |= uint64_t(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      if (result > std::numeric_limits<uint32_t>::max()) return false;
+      *value = static_cast<uint32_t>(result);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Returns the word which identifies |markv_model| in containers and packs.
+uint32_t GetModelWord(const MarkvModel& markv_model) {
+  return (markv_model.model_type() << 16) | markv_model.model_version();
+}
+
+// A MARK-V container which has been encoded but not written out yet, or whose
+// index has been read. The offsets of the global section and of the blocks
+// are relative to the bytes the container is decoded from.
+struct MarkvContainerLayout {
+  uint32_t spirv_version = 0;
+  uint32_t spirv_generator = 0;
+  uint32_t spirv_id_bound = 0;
+  uint32_t globals_id_bound = 0;
+  uint32_t globals_length_in_bits = 0;
+  size_t globals_offset = 0;
+  std::vector<MarkvContainerBlock> blocks;
+};
+
+// Appends the index entry of |block| to |out|.
+void AppendContainerBlock(const MarkvContainerBlock& block,
+                          std::vector<uint8_t>* out) {
+  AppendWord(block.offset, out);
+  AppendWord(block.length_in_bits, out);
+  AppendWord(block.id_base, out);
+  AppendWord(block.num_new_ids, out);
+  AppendWord(static_cast<uint32_t>(block.external_ids.size()), out);
+  for (const auto& external_id : block.external_ids) {
+    AppendWord(external_id.first, out);
+    AppendWord(external_id.second, out);
+  }
+}
+
+// Reads an index entry written by AppendContainerBlock from the |size| bytes
+// at |data| at |*offset|. Returns false if the entry is truncated.
+bool ReadContainerBlock(const uint8_t* data, size_t size, size_t* offset,
+                        MarkvContainerBlock* block) {
+  uint32_t num_external_ids = 0;
+  if (!ReadWord(data, size, offset, &block->offset) ||
+      !ReadWord(data, size, offset, &block->length_in_bits) ||
+      !ReadWord(data, size, offset, &block->id_base) ||
+      !ReadWord(data, size, offset, &block->num_new_ids) ||
+      !ReadWord(data, size, offset, &num_external_ids) ||
+      num_external_ids > (size - *offset) / (2 * sizeof(uint32_t))) {
+    return false;
+  }
+  block->external_ids.resize(num_external_ids);
+  for (auto& external_id : block->external_ids) {
+    ReadWord(data, size, offset, &external_id.first);
+    ReadWord(data, size, offset, &external_id.second);
+  }
+  return true;
+}
+
+// Encodes |spirv| to the global section and blocks of a MARK-V container.
+// Fills |layout| except for the offsets, |globals| with the encoded global
+// section, and |block_bits| with the encoded functions of each block.
+spv_result_t EncodeContainer(spv_const_context context,
+                             const std::vector<uint32_t>& spirv,
+                             const MarkvCodecOptions& options,
+                             const MarkvContainerOptions& container_options,
+                             const MarkvModel& markv_model,
+                             MarkvContainerLayout* layout,
+                             std::vector<uint8_t>* globals,
+                             std::vector<std::vector<uint8_t>>* block_bits) {
+  spv_context_t hijack_context = *context;
+  spv_position_t position = {};
+
+  if (spirv.size() < 5 || spirv[0] != kSpirvMagicNumber) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "Invalid SPIR-V magic number.";
+  }
+
+  // Find the global section and the functions of the module.
+  struct FunctionRange {
+    size_t begin;
+    size_t end;
+    uint32_t id;
+  };
+  std::vector<FunctionRange> functions;
+  for (size_t i = 5; i < spirv.size();) {
+    const uint16_t num_words = static_cast<uint16_t>(spirv[i] >> 16);
+    const SpvOp opcode = static_cast<SpvOp>(spirv[i] & 0xFFFF);
+    if (num_words == 0 || num_words > spirv.size() - i ||
+        (opcode == SpvOpFunction && num_words < 3)) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "Invalid instruction at word " << i << ".";
+    }
+    if (opcode == SpvOpFunction) {
+      functions.push_back({i, spirv.size(), spirv[i + 2]});
+    } else if (opcode == SpvOpFunctionEnd && !functions.empty()) {
+      functions.back().end = i + num_words;
+    }
+    i += num_words;
+  }
+  const size_t globals_end =
+      functions.empty() ? spirv.size() : functions.front().begin;
+
+  // Group consecutive functions into blocks.
+  std::vector<std::pair<size_t, size_t>> block_functions;
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (block_functions.empty() ||
+        functions[block_functions.back().second - 1].end -
+                functions[block_functions.back().first].begin >=
+            container_options.min_block_num_words) {
+      block_functions.emplace_back(i, i);
+    }
+    block_functions.back().second = i + 1;
+  }
+
+  // Encode the global section followed by the functions of each block. A
+  // module without functions is encoded as a single block without functions,
+  // which is not stored in the container.
+  const size_t num_encoded_blocks = std::max<size_t>(block_functions.size(), 1);
+  std::vector<MarkvContainerBlockData> blocks(num_encoded_blocks);
+  std::vector<spv_result_t> results(num_encoded_blocks, SPV_SUCCESS);
+  spvutils::ParallelFor(
+      num_encoded_blocks, container_options.num_threads, [&](size_t index) {
+        std::vector<uint32_t> block_spirv(spirv.begin(),
+                                          spirv.begin() + globals_end);
+        std::unordered_set<uint32_t> external_function_ids;
+        for (size_t i = 0; i < functions.size(); ++i) {
+          const FunctionRange& function = functions[i];
+          if (!block_functions.empty() && i >= block_functions[index].first &&
+              i < block_functions[index].second) {
+            block_spirv.insert(block_spirv.end(),
+                               spirv.begin() + function.begin,
+                               spirv.begin() + function.end);
+          } else {
+            external_function_ids.insert(function.id);
+          }
+        }
+
+        MarkvEncoder encoder(&hijack_context, options, &markv_model);
+        encoder.SetContainerBlock(std::move(external_function_ids));
+        results[index] = spvBinaryParse(
+            &hijack_context, &encoder, block_spirv.data(), block_spirv.size(),
+            EncodeHeader, EncodeInstruction, nullptr);
+        if (results[index] == SPV_SUCCESS)
+          encoder.FinishContainerBlock(&blocks[index]);
+      });
+
+  for (spv_result_t result : results) {
+    if (result != SPV_SUCCESS) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "Unable to encode to MARK-V.";
+    }
+  }
+
+  // Assign id ranges to the blocks, and resolve references to the functions
+  // of other blocks.
+  MarkvContainerBlockData& first_block = blocks.front();
+  std::unordered_map<uint32_t, uint32_t> function_decoded_ids;
+  uint32_t id_base = first_block.globals_id_bound;
+  for (size_t index = 0; index < block_functions.size(); ++index) {
+    MarkvContainerBlockData& block = blocks[index];
+    assert(block.globals == first_block.globals);
+    assert(block.globals_id_bound == first_block.globals_id_bound);
+    block.info.id_base = id_base;
+    id_base += block.info.num_new_ids;
+    for (size_t i = block_functions[index].first;
+         i < block_functions[index].second; ++i) {
+      uint32_t decoded_id = block.decoded_ids[functions[i].id];
+      if (decoded_id >= block.globals_id_bound)
+        decoded_id += block.info.id_base - block.globals_id_bound;
+      function_decoded_ids[functions[i].id] = decoded_id;
+    }
+  }
+  for (size_t index = 0; index < block_functions.size(); ++index) {
+    MarkvContainerBlockData& block = blocks[index];
+    for (const auto& reference : block.external_references) {
+      block.info.external_ids.emplace_back(
+          reference.first, function_decoded_ids[reference.second]);
+    }
+  }
+
+  layout->spirv_version = spirv[1];
+  layout->spirv_generator = spirv[2];
+  layout->spirv_id_bound = id_base;
+  layout->globals_id_bound = first_block.globals_id_bound;
+  layout->globals_length_in_bits = first_block.globals_length_in_bits;
+  layout->globals_offset = 0;
+  layout->blocks.clear();
+  block_bits->clear();
+  for (size_t index = 0; index < block_functions.size(); ++index) {
+    layout->blocks.push_back(std::move(blocks[index].info));
+    block_bits->push_back(std::move(blocks[index].bits));
+  }
+  globals->swap(first_block.globals);
+  return SPV_SUCCESS;
+}
+
+// Returns a MARK-V byte source which reads the |parts|, given as pairs of
+// data and size, one after the other.
+MarkvByteSource ConcatenateParts(
+    std::vector<std::pair<const uint8_t*, size_t>> parts) {
+  size_t part = 0;
+  size_t part_offset = 0;
+  return [parts, part, part_offset](uint8_t* out, size_t max_size) mutable {
+    while (part < parts.size() && part_offset == parts[part].second) {
+      ++part;
+      part_offset = 0;
+    }
+    if (part == parts.size()) return size_t(0);
+    const size_t size = std::min(max_size, parts[part].second - part_offset);
+    std::memcpy(out, parts[part].first + part_offset, size);
+    part_offset += size;
+    return size;
+  };
+}
+
+// Decodes the container described by |layout| from |data|, decoding its
+// blocks on |num_threads| threads. The caller has checked that the global
+// section and the blocks lie within |data|.
+spv_result_t DecodeContainer(spv_const_context context, const uint8_t* data,
+                             const MarkvContainerLayout& layout,
+                             const MarkvCodecOptions& options,
+                             uint32_t num_threads,
+                             const MarkvModel& markv_model,
+                             std::vector<uint32_t>* spirv) {
+  spv_context_t hijack_context = *context;
+  spv_position_t position = {};
+
+  bool ids_are_consistent = true;
+  uint32_t expected_id_base = layout.globals_id_bound;
+  for (const MarkvContainerBlock& block : layout.blocks) {
+    ids_are_consistent &= block.id_base == expected_id_base;
+    expected_id_base += block.num_new_ids;
+  }
+  if (!ids_are_consistent || expected_id_base != layout.spirv_id_bound) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V container has inconsistent block ids";
+  }
+
+  // A module without functions is decoded as a single empty block.
+  std::vector<MarkvContainerBlock> empty_blocks;
+  if (layout.blocks.empty()) {
+    empty_blocks.resize(1);
+    empty_blocks[0].id_base = layout.globals_id_bound;
+  }
+  const std::vector<MarkvContainerBlock>& blocks =
+      layout.blocks.empty() ? empty_blocks : layout.blocks;
+
+  // Decode every block after its own copy of the global section.
+  const size_t globals_num_bytes =
+      spvutils::NumBitsToNumWords<8>(layout.globals_length_in_bits);
+  std::vector<std::vector<uint32_t>> block_words(blocks.size());
+  std::vector<spv_result_t> results(blocks.size(), SPV_SUCCESS);
+  spvutils::ParallelFor(blocks.size(), num_threads, [&](size_t index) {
+    const MarkvContainerBlock& block = blocks[index];
+    const MarkvByteSource markv_source = ConcatenateParts(
+        {{data + layout.globals_offset, globals_num_bytes},
+         {data + block.offset,
+          spvutils::NumBitsToNumWords<8>(block.length_in_bits)}});
+
+    std::vector<uint32_t>& words = block_words[index];
+    const auto spirv_consumer = [&words](const uint32_t* decoded,
+                                         size_t size) {
+      words.insert(words.end(), decoded, decoded + size);
+      return true;
+    };
+
+    MarkvDecoder decoder(&hijack_context, markv_source, spirv_consumer,
+                         options, &markv_model);
+    results[index] = decoder.DecodeContainerBlock(
+        layout.globals_length_in_bits, layout.globals_id_bound, block,
+        index == 0);
+  });
+
+  for (spv_result_t result : results) {
+    if (result != SPV_SUCCESS) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "Unable to decode MARK-V.";
+    }
+  }
+
+  std::vector<uint32_t> words = {kSpirvMagicNumber, layout.spirv_version,
+                                 layout.spirv_generator, layout.spirv_id_bound,
+                                 0};
+  for (const auto& block : block_words) {
+    words.insert(words.end(), block.begin(), block.end());
+  }
+  spirv->swap(words);
+  return SPV_SUCCESS;
+}
+
+// Returns a hash of |bytes|.
+uint64_t HashBytes(const std::vector<uint8_t>& bytes) {
+  // 64-bit FNV-1a.
+  uint64_t hash = 14695981039346656037ull;
+  for (uint8_t byte : bytes) {
+    hash ^= byte;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+// The segments of a MARK-V pack: distinct parts of encoded modules, each
+// stored once however many modules share it.
+class MarkvPackSegments {
+ public:
+  // Returns the index of the segment equal to |bytes|, adding it if there is
+  // none yet.
+  uint32_t Add(std::vector<uint8_t>&& bytes) {
+    const uint64_t hash = HashBytes(bytes);
+    const auto range = indices_.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+      if (segments_[it->second] == bytes) return it->second;
+    }
+    const uint32_t index = static_cast<uint32_t>(segments_.size());
+    indices_.emplace(hash, index);
+    segments_.push_back(std::move(bytes));
+    return index;
+  }
+
+  const std::vector<std::vector<uint8_t>>& segments() const {
+    return segments_;
+  }
+
+ private:
+  std::vector<std::vector<uint8_t>> segments_;
+  // Maps hashes of segments to their indices.
+  std::unordered_multimap<uint64_t, uint32_t> indices_;
+};
+
+// Size of the header of a MARK-V pack in bytes.
+const size_t kMarkvPackHeaderSize = 5 * sizeof(uint32_t);
+
+// Reads the header of the MARK-V pack of |pack_size| bytes at |pack|, and
+// checks that it was written with |markv_model| and that its index fits.
+spv_result_t ReadMarkvPackHeader(spv_const_context context,
+                                 const uint8_t* pack, size_t pack_size,
+                                 const MarkvModel& markv_model,
+                                 uint32_t* num_modules,
+                                 uint32_t* num_segments) {
+  spv_position_t position = {};
+  size_t offset = 0;
+  uint32_t magic_number = 0;
+  uint32_t markv_version = 0;
+  uint32_t model = 0;
+  if (!ReadWord(pack, pack_size, &offset, &magic_number) ||
+      !ReadWord(pack, pack_size, &offset, &markv_version) ||
+      !ReadWord(pack, pack_size, &offset, &model) ||
+      !ReadWord(pack, pack_size, &offset, num_modules) ||
+      !ReadWord(pack, pack_size, &offset, num_segments)) {
+    return DiagnosticStream(position, context->consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "Unable to read MARK-V pack header";
+  }
+
+  if (magic_number != kMarkvPackMagicNumber ||
+      markv_version != GetMarkvVersion() ||
+      model != GetModelWord(markv_model)) {
+    return DiagnosticStream(position, context->consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V pack has an incorrect magic number, or was written by "
+           << "a different version or model of the codec";
+  }
+
+  // A word per module, and a word per segment plus one for the end of the
+  // last segment.
+  const uint64_t index_size =
+      (uint64_t(*num_modules) + uint64_t(*num_segments) + 1) *
+      sizeof(uint32_t);
+  if (index_size > pack_size - kMarkvPackHeaderSize) {
+    return DiagnosticStream(position, context->consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V pack has a truncated index";
+  }
+  return SPV_SUCCESS;
+}
+
+// The encoded global section of a module in a MARK-V pack is stored in
+// segments of this many bytes, so that modules whose global sections start
+// with the same instructions share the segments of their common start.
+const size_t kMarkvPackGlobalsSegmentSize = 256;
+
+// Returns true if instructions with |opcode| in the global section of a
+// module are encoded after the rest of the global section in a MARK-V pack.
+// These select the entry points, and name and decorate ids, so modules which
+// only differ in them share the segments of their global sections.
+bool IsMarkvPackResidualOpcode(SpvOp opcode) {
+  switch (opcode) {
+    case SpvOpEntryPoint:
+    case SpvOpExecutionMode:
+    case SpvOpExecutionModeId:
+    case SpvOpSourceContinued:
+    case SpvOpSource:
+    case SpvOpSourceExtension:
+    case SpvOpName:
+    case SpvOpMemberName:
+    case SpvOpModuleProcessed:
+    case SpvOpDecorationGroup:
+      return true;
+    default:
+      return spvOpcodeIsDecoration(opcode);
+  }
+}
+
+// An instruction of a module which is encoded to a MARK-V pack.
+struct MarkvPackInstruction {
+  std::vector<uint32_t> words;
+  SpvOp opcode = SpvOpNop;
+  uint32_t result_id = 0;
+  // Offsets of the id operands in |words|.
+  std::vector<uint16_t> id_offsets;
+};
+
+// Parser callback which appends the instruction to the vector of
+// MarkvPackInstruction at |user_data|.
+spv_result_t AddMarkvPackInstruction(void* user_data,
+                                     const spv_parsed_instruction_t* inst) {
+  auto* instructions =
+      reinterpret_cast<std::vector<MarkvPackInstruction>*>(user_data);
+  MarkvPackInstruction instruction;
+  instruction.words.assign(inst->words, inst->words + inst->num_words);
+  instruction.opcode = static_cast<SpvOp>(inst->opcode);
+  instruction.result_id = inst->result_id;
+  for (uint16_t i = 0; i < inst->num_operands; ++i) {
+    if (spvIsIdType(inst->operands[i].type))
+      instruction.id_offsets.push_back(inst->operands[i].offset);
+  }
+  instructions->push_back(std::move(instruction));
+  return SPV_SUCCESS;
+}
+
+// A module of a MARK-V pack which has been encoded but not written out yet.
+struct MarkvPackModule {
+  uint32_t spirv_version = 0;
+  uint32_t spirv_generator = 0;
+  // The encoded global section without the residual instructions, whose ids
+  // are the ids of the decoded module, followed by the residual instructions
+  // encoded as a block.
+  MarkvContainerBlockData globals;
+  // The positions of the residual instructions in the global section, as
+  // runs of the number of global instructions before them and their number.
+  std::vector<std::pair<uint32_t, uint32_t>> residual_runs;
+  // A block per function, encoded after the global instructions used by the
+  // function. The encoded global instructions are not stored: the decoder
+  // encodes them again from the decoded global section.
+  std::vector<MarkvContainerBlockData> blocks;
+  // The global instructions each block is encoded after, as pairs of the
+  // number of global instructions to skip and the number to use.
+  std::vector<std::vector<std::pair<uint32_t, uint32_t>>> block_prefixes;
+};
+
+// Encodes |spirv| to |module|. Every function is encoded after only the
+// global instructions it uses, so that it is encoded to the same bits in
+// every module which has it and these instructions in the same order,
+// whatever else the module holds.
+spv_result_t EncodeMarkvPackModule(spv_const_context context,
+                                   const std::vector<uint32_t>& spirv,
+                                   const MarkvCodecOptions& options,
+                                   const MarkvModel& markv_model,
+                                   MarkvPackModule* module) {
+  spv_context_t hijack_context = *context;
+  spv_position_t position = {};
+
+  if (spirv.size() < 5 || spirv[0] != kSpirvMagicNumber) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "Invalid SPIR-V magic number.";
+  }
+
+  // The encoded global section and blocks are not valid modules, so the
+  // module is validated as a whole instead of by the encoders.
+  if (options.validate_spirv_binary) {
+    const spv_result_t result = spvValidateBinary(
+        &hijack_context, spirv.data(), spirv.size(), nullptr);
+    if (result != SPV_SUCCESS) return result;
+  }
+  MarkvCodecOptions block_options = options;
+  block_options.validate_spirv_binary = false;
+
+  std::vector<MarkvPackInstruction> instructions;
+  if (spvBinaryParse(&hijack_context, &instructions, spirv.data(),
+                     spirv.size(), nullptr, AddMarkvPackInstruction,
+                     nullptr) != SPV_SUCCESS) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "Unable to encode to MARK-V.";
+  }
+
+  // Split the module into the global section, the residual instructions with
+  // their positions in the global section, and the functions.
+  std::vector<const MarkvPackInstruction*> globals;
+  std::vector<std::pair<size_t, const MarkvPackInstruction*>> residual;
+  std::vector<std::vector<const MarkvPackInstruction*>> functions;
+  for (const MarkvPackInstruction& inst : instructions) {
+    if (inst.opcode == SpvOpFunction) functions.emplace_back();
+    if (!functions.empty()) {
+      functions.back().push_back(&inst);
+    } else if (IsMarkvPackResidualOpcode(inst.opcode)) {
+      residual.emplace_back(globals.size(), &inst);
+    } else {
+      globals.push_back(&inst);
+    }
+  }
+
+  // Maps ids to the global instructions which define them, or which forward
+  // declare them.
+  std::unordered_multimap<uint32_t, size_t> global_definitions;
+  for (size_t i = 0; i < globals.size(); ++i) {
+    const MarkvPackInstruction& inst = *globals[i];
+    if (inst.result_id) {
+      global_definitions.emplace(inst.result_id, i);
+    } else if (inst.opcode == SpvOpTypeForwardPointer &&
+               !inst.id_offsets.empty()) {
+      global_definitions.emplace(inst.words[inst.id_offsets[0]], i);
+    }
+  }
+
+  // The functions, and every id the functions define, which the residual
+  // instructions get from the blocks.
+  std::unordered_set<uint32_t> function_ids;
+  std::unordered_set<uint32_t> function_defined_ids;
+  for (const auto& function : functions) {
+    function_ids.insert(function.front()->result_id);
+    for (const MarkvPackInstruction* inst : function) {
+      if (inst->result_id) function_defined_ids.insert(inst->result_id);
+    }
+  }
+
+  const auto encode = [&](const std::vector<uint32_t>& words,
+                          std::unordered_set<uint32_t>&& external_ids,
+                          size_t num_global_instructions,
+                          MarkvContainerBlockData* block) -> spv_result_t {
+    MarkvEncoder encoder(&hijack_context, block_options, &markv_model);
+    encoder.SetContainerBlock(std::move(external_ids),
+                              num_global_instructions);
+    const spv_result_t result =
+        spvBinaryParse(&hijack_context, &encoder, words.data(), words.size(),
+                       EncodeHeader, EncodeInstruction, nullptr);
+    if (result == SPV_SUCCESS) encoder.FinishContainerBlock(block);
+    return result;
+  };
+
+  // The residual instructions are encoded after the whole global section, so
+  // that their ids cost no more than in a module encoded on its own.
+  std::vector<uint32_t> words(spirv.begin(), spirv.begin() + 5);
+  for (const MarkvPackInstruction* inst : globals) {
+    words.insert(words.end(), inst->words.begin(), inst->words.end());
+  }
+  for (const auto& inst : residual) {
+    words.insert(words.end(), inst.second->words.begin(),
+                 inst.second->words.end());
+  }
+  bool success = encode(words, std::move(function_defined_ids),
+                        globals.size(), &module->globals) == SPV_SUCCESS;
+
+  module->residual_runs.clear();
+  for (const auto& inst : residual) {
+    const uint32_t run_position = static_cast<uint32_t>(inst.first);
+    if (module->residual_runs.empty() ||
+        module->residual_runs.back().first != run_position) {
+      module->residual_runs.emplace_back(run_position, 0);
+    }
+    ++module->residual_runs.back().second;
+  }
+
+  module->blocks.resize(functions.size());
+  module->block_prefixes.assign(functions.size(), {});
+  for (size_t index = 0; success && index < functions.size(); ++index) {
+    const std::vector<const MarkvPackInstruction*>& function =
+        functions[index];
+
+    // Find the global instructions the function uses, directly or through
+    // other global instructions.
+    std::vector<bool> used(globals.size(), false);
+    std::vector<uint32_t> ids;
+    for (const MarkvPackInstruction* inst : function) {
+      for (uint16_t offset : inst->id_offsets) {
+        ids.push_back(inst->words[offset]);
+      }
+    }
+    while (!ids.empty()) {
+      const auto range = global_definitions.equal_range(ids.back());
+      ids.pop_back();
+      for (auto it = range.first; it != range.second; ++it) {
+        if (used[it->second]) continue;
+        used[it->second] = true;
+        const MarkvPackInstruction& definition = *globals[it->second];
+        for (uint16_t offset : definition.id_offsets) {
+          ids.push_back(definition.words[offset]);
+        }
+      }
+    }
+
+    words.resize(5);
+    auto& prefix = module->block_prefixes[index];
+    for (size_t i = 0; i < globals.size();) {
+      const size_t skipped_begin = i;
+      while (i < globals.size() && !used[i]) ++i;
+      const size_t used_begin = i;
+      for (; i < globals.size() && used[i]; ++i) {
+        words.insert(words.end(), globals[i]->words.begin(),
+                     globals[i]->words.end());
+      }
+      if (i == used_begin) break;
+      prefix.emplace_back(static_cast<uint32_t>(used_begin - skipped_begin),
+                          static_cast<uint32_t>(i - used_begin));
+    }
+    for (const MarkvPackInstruction* inst : function) {
+      words.insert(words.end(), inst->words.begin(), inst->words.end());
+    }
+    std::unordered_set<uint32_t> external_function_ids = function_ids;
+    external_function_ids.erase(function.front()->result_id);
+    success = encode(words, std::move(external_function_ids),
+                     std::numeric_limits<size_t>::max(),
+                     &module->blocks[index]) == SPV_SUCCESS;
+  }
+
+  if (!success) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "Unable to encode to MARK-V.";
+  }
+
+  // Number the ids of the decoded module: the ids issued by the global
+  // section, then the new ids of each block, then the new ids of the
+  // residual instructions.
+  std::unordered_map<uint32_t, uint32_t> block_ids;
+  uint32_t id_bound = module->globals.globals_id_bound;
+  for (MarkvContainerBlockData& block : module->blocks) {
+    block.info.id_base = id_bound;
+    id_bound += block.info.num_new_ids;
+    for (const auto& decoded_id : block.decoded_ids) {
+      if (decoded_id.second >= block.globals_id_bound) {
+        block_ids[decoded_id.first] =
+            decoded_id.second - block.globals_id_bound + block.info.id_base;
+      }
+    }
+  }
+  module->globals.info.id_base = id_bound;
+
+  const auto resolve_external_references =
+      [&](MarkvContainerBlockData* block) {
+        for (const auto& reference : block->external_references) {
+          const auto it = block_ids.find(reference.second);
+          if (it == block_ids.end()) return false;
+          block->info.external_ids.emplace_back(reference.first, it->second);
+        }
+        return true;
+      };
+  success = resolve_external_references(&module->globals);
+  for (MarkvContainerBlockData& block : module->blocks) {
+    success = success && resolve_external_references(&block);
+  }
+  if (!success) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INTERNAL)
+           << "An id defined by a function is not issued by its block";
+  }
+
+  module->spirv_version = spirv[1];
+  module->spirv_generator = spirv[2];
+  return SPV_SUCCESS;
+}
+
+// Appends the entry of a block of a MARK-V pack module to |out|: the index
+// entry of |block| without the offset of its bits, and without the id base,
+// which follows from the blocks before it.
+void AppendMarkvPackBlock(const MarkvContainerBlock& block,
+                          std::vector<uint8_t>* out) {
+  AppendVarint(block.length_in_bits, out);
+  AppendVarint(block.num_new_ids, out);
+  AppendVarint(static_cast<uint32_t>(block.external_ids.size()), out);
+  uint32_t reference_index = 0;
+  for (const auto& external_id : block.external_ids) {
+    assert(external_id.first >= reference_index);
+    AppendVarint(external_id.first - reference_index, out);
+    AppendVarint(external_id.second, out);
+    reference_index = external_id.first;
+  }
+}
+
+// Reads an entry written by AppendMarkvPackBlock from the |size| bytes at
+// |data| at |*offset|, for a block whose ids start at |id_base|. Returns
+// false if the entry is truncated or malformed.
+bool ReadMarkvPackBlock(const uint8_t* data, size_t size, size_t* offset,
+                        uint32_t id_base, MarkvContainerBlock* block) {
+  uint32_t num_external_ids = 0;
+  if (!ReadVarint(data, size, offset, &block->length_in_bits) ||
+      !ReadVarint(data, size, offset, &block->num_new_ids) ||
+      !ReadVarint(data, size, offset, &num_external_ids) ||
+      block->num_new_ids > std::numeric_limits<uint32_t>::max() - id_base ||
+      num_external_ids > (size - *offset) / 2) {
+    return false;
+  }
+  block->id_base = id_base;
+  block->external_ids.resize(num_external_ids);
+  uint64_t reference_index = 0;
+  for (auto& external_id : block->external_ids) {
+    uint32_t delta = 0;
+    if (!ReadVarint(data, size, offset, &delta) ||
+        !ReadVarint(data, size, offset, &external_id.second) ||
+        external_id.second == 0) {
+      return false;
+    }
+    reference_index += delta;
+    if (reference_index > std::numeric_limits<uint32_t>::max()) return false;
+    external_id.first = static_cast<uint32_t>(reference_index);
+  }
+  return true;
+}
+
+// Appends to |out| the number of |runs| and the runs.
+void AppendMarkvPackRuns(const std::vector<std::pair<uint32_t, uint32_t>>& runs,
+                         std::vector<uint8_t>* out) {
+  AppendVarint(static_cast<uint32_t>(runs.size()), out);
+  for (const auto& run : runs) {
+    AppendVarint(run.first, out);
+    AppendVarint(run.second, out);
+  }
+}
+
+// Reads runs written by AppendMarkvPackRuns from the |size| bytes at |data|
+// at |*offset|. Returns false if they are truncated.
+bool ReadMarkvPackRuns(const uint8_t* data, size_t size, size_t* offset,
+                       std::vector<std::pair<uint32_t, uint32_t>>* runs) {
+  uint32_t num_runs = 0;
+  if (!ReadVarint(data, size, offset, &num_runs) ||
+      num_runs > (size - *offset) / 2) {
+    return false;
+  }
+  runs->resize(num_runs);
+  for (auto& run : *runs) {
+    if (!ReadVarint(data, size, offset, &run.first) ||
+        !ReadVarint(data, size, offset, &run.second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Appends the instructions of the decoded global section of a MARK-V pack
+// module to |words|, with its residual instructions put back in the places
+// given by |residual_runs|. |decoded| holds the global section followed by
+// the residual instructions, and |instruction_offsets| the offsets of its
+// instructions and its size. Returns false if |residual_runs| does not fit.
+bool MergeMarkvPackResidual(
+    const std::vector<uint32_t>& decoded,
+    const std::vector<size_t>& instruction_offsets,
+    const std::vector<std::pair<uint32_t, uint32_t>>& residual_runs,
+    std::vector<uint32_t>* words) {
+  const size_t num_instructions = instruction_offsets.size() - 1;
+  uint64_t num_residual_instructions = 0;
+  for (const auto& run : residual_runs) {
+    num_residual_instructions += run.second;
+  }
+  if (num_residual_instructions > num_instructions) return false;
+  const size_t num_global_instructions =
+      num_instructions - static_cast<size_t>(num_residual_instructions);
+
+  const auto append = [&](size_t begin, size_t end) {
+    words->insert(words->end(), decoded.begin() + instruction_offsets[begin],
+                  decoded.begin() + instruction_offsets[end]);
+  };
+  size_t global_index = 0;
+  size_t residual_index = num_global_instructions;
+  for (const auto& run : residual_runs) {
+    if (run.first < global_index || run.first > num_global_instructions)
+      return false;
+    append(global_index, run.first);
+    global_index = run.first;
+    append(residual_index, residual_index + run.second);
+    residual_index += run.second;
+  }
+  append(global_index, num_global_instructions);
+  return true;
+}
+
 }  // namespace
 
 spv_result_t SpirvToMarkv(
@@ -2893,27 +3994,583 @@ spv_result_t SpirvToMarkv(
   return SPV_SUCCESS;
 }
 
+spv_result_t SpirvToMarkvContainer(
+    spv_const_context context, const std::vector<uint32_t>& spirv,
+    const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint8_t>* markv) {
+  spv_context_t hijack_context = *context;
+  libspirv::SetContextMessageConsumer(&hijack_context,
+                                      MakeThreadSafe(message_consumer));
+
+  MarkvContainerLayout layout;
+  std::vector<uint8_t> globals;
+  std::vector<std::vector<uint8_t>> block_bits;
+  const spv_result_t result =
+      EncodeContainer(&hijack_context, spirv, options, container_options,
+                      markv_model, &layout, &globals, &block_bits);
+  if (result != SPV_SUCCESS) return result;
+
+  // Write the container: the header, the block index, the global section and
+  // the blocks.
+  std::vector<uint8_t> out;
+  AppendWord(kMarkvContainerMagicNumber, &out);
+  AppendWord(GetMarkvVersion(), &out);
+  AppendWord(GetModelWord(markv_model), &out);
+  AppendWord(layout.spirv_version, &out);
+  AppendWord(layout.spirv_generator, &out);
+  AppendWord(layout.spirv_id_bound, &out);
+  AppendWord(layout.globals_id_bound, &out);
+  AppendWord(layout.globals_length_in_bits, &out);
+  AppendWord(static_cast<uint32_t>(layout.blocks.size()), &out);
+
+  size_t index_size = 0;
+  for (const MarkvContainerBlock& block : layout.blocks) {
+    index_size += 5 + 2 * block.external_ids.size();
+  }
+  size_t offset = out.size() + index_size * sizeof(uint32_t) + globals.size();
+  for (size_t index = 0; index < layout.blocks.size(); ++index) {
+    MarkvContainerBlock& block = layout.blocks[index];
+    block.offset = static_cast<uint32_t>(offset);
+    offset += block_bits[index].size();
+    AppendContainerBlock(block, &out);
+  }
+
+  out.insert(out.end(), globals.begin(), globals.end());
+  for (const auto& bits : block_bits) {
+    out.insert(out.end(), bits.begin(), bits.end());
+  }
+  assert(out.size() == offset);
+
+  markv->swap(out);
+  return SPV_SUCCESS;
+}
+
+spv_result_t MarkvContainerToSpirv(
+    spv_const_context context, const std::vector<uint8_t>& markv,
+    const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint32_t>* spirv) {
+  spv_context_t hijack_context = *context;
+  libspirv::SetContextMessageConsumer(&hijack_context,
+                                      MakeThreadSafe(message_consumer));
+  spv_position_t position = {};
+
+  const uint8_t* data = markv.data();
+  const size_t size = markv.size();
+  size_t offset = 0;
+  uint32_t magic_number = 0;
+  uint32_t markv_version = 0;
+  uint32_t model = 0;
+  uint32_t num_blocks = 0;
+  MarkvContainerLayout layout;
+  if (!ReadWord(data, size, &offset, &magic_number) ||
+      !ReadWord(data, size, &offset, &markv_version) ||
+      !ReadWord(data, size, &offset, &model) ||
+      !ReadWord(data, size, &offset, &layout.spirv_version) ||
+      !ReadWord(data, size, &offset, &layout.spirv_generator) ||
+      !ReadWord(data, size, &offset, &layout.spirv_id_bound) ||
+      !ReadWord(data, size, &offset, &layout.globals_id_bound) ||
+      !ReadWord(data, size, &offset, &layout.globals_length_in_bits) ||
+      !ReadWord(data, size, &offset, &num_blocks)) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "Unable to read MARK-V container header";
+  }
+
+  if (magic_number != kMarkvContainerMagicNumber ||
+      markv_version != GetMarkvVersion() ||
+      model != GetModelWord(markv_model)) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V container has an incorrect magic number, or was "
+           << "written by a different version or model of the codec";
+  }
+
+  for (uint32_t index = 0; index < num_blocks; ++index) {
+    MarkvContainerBlock block;
+    if (!ReadContainerBlock(data, size, &offset, &block) ||
+        block.offset > size ||
+        spvutils::NumBitsToNumWords<8>(block.length_in_bits) >
+            size - block.offset) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "MARK-V container has an invalid block index";
+    }
+    layout.blocks.push_back(std::move(block));
+  }
+
+  layout.globals_offset = offset;
+  if (spvutils::NumBitsToNumWords<8>(layout.globals_length_in_bits) >
+      size - layout.globals_offset) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V container has an invalid global section";
+  }
+
+  return DecodeContainer(&hijack_context, data, layout, options,
+                         container_options.num_threads, markv_model, spirv);
+}
+
+spv_result_t SpirvToMarkvPack(
+    spv_const_context context,
+    const std::vector<std::vector<uint32_t>>& modules,
+    const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint8_t>* pack) {
+  spv_context_t hijack_context = *context;
+  libspirv::SetContextMessageConsumer(&hijack_context,
+                                      MakeThreadSafe(message_consumer));
+  spv_position_t position = {};
+
+  std::vector<MarkvPackModule> encoded_modules(modules.size());
+  std::vector<spv_result_t> results(modules.size(), SPV_SUCCESS);
+  spvutils::ParallelFor(
+      modules.size(), container_options.num_threads, [&](size_t index) {
+        results[index] =
+            EncodeMarkvPackModule(&hijack_context, modules[index], options,
+                                  markv_model, &encoded_modules[index]);
+      });
+
+  for (size_t index = 0; index < modules.size(); ++index) {
+    if (results[index] != SPV_SUCCESS) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "Unable to encode module " << index << " of the MARK-V pack.";
+    }
+  }
+
+  // Returns the bytes of the bits of |block|.
+  const auto take_block_bits = [](MarkvContainerBlockData* block) {
+    std::vector<uint8_t> bytes = std::move(block->bits);
+    bytes.resize(std::min(
+        bytes.size(),
+        spvutils::NumBitsToNumWords<8>(block->info.length_in_bits)));
+    return bytes;
+  };
+
+  // Store every distinct part of the global sections, residual instructions
+  // and blocks once. The records of the modules refer to them by segment
+  // index.
+  MarkvPackSegments segments;
+  std::vector<uint8_t> records;
+  std::vector<size_t> record_offsets;
+  for (MarkvPackModule& module : encoded_modules) {
+    record_offsets.push_back(records.size());
+    AppendVarint(module.spirv_version, &records);
+    AppendVarint(module.spirv_generator, &records);
+    AppendVarint(module.globals.globals_id_bound, &records);
+    AppendVarint(module.globals.globals_length_in_bits, &records);
+
+    const std::vector<uint8_t>& globals = module.globals.globals;
+    const size_t num_globals_segments =
+        (globals.size() + kMarkvPackGlobalsSegmentSize - 1) /
+        kMarkvPackGlobalsSegmentSize;
+    AppendVarint(static_cast<uint32_t>(num_globals_segments), &records);
+    for (size_t begin = 0; begin < globals.size();
+         begin += kMarkvPackGlobalsSegmentSize) {
+      const size_t end =
+          std::min(globals.size(), begin + kMarkvPackGlobalsSegmentSize);
+      AppendVarint(segments.Add(std::vector<uint8_t>(globals.begin() + begin,
+                                                     globals.begin() + end)),
+                   &records);
+    }
+
+    // The table of the blocks, with the segment index of the bits of each
+    // block, is a segment of its own, which modules with the same functions
+    // and global instructions share.
+    std::vector<uint8_t> block_table;
+    AppendVarint(static_cast<uint32_t>(module.blocks.size()), &block_table);
+    for (size_t i = 0; i < module.blocks.size(); ++i) {
+      MarkvContainerBlockData& block = module.blocks[i];
+      AppendVarint(segments.Add(take_block_bits(&block)), &block_table);
+      AppendMarkvPackBlock(block.info, &block_table);
+      AppendMarkvPackRuns(module.block_prefixes[i], &block_table);
+    }
+    AppendVarint(segments.Add(std::move(block_table)), &records);
+
+    // The residual instructions are stored as their entry and positions
+    // followed by their bits.
+    std::vector<uint8_t> residual;
+    AppendMarkvPackBlock(module.globals.info, &residual);
+    AppendMarkvPackRuns(module.residual_runs, &residual);
+    const std::vector<uint8_t> residual_bits =
+        take_block_bits(&module.globals);
+    residual.insert(residual.end(), residual_bits.begin(),
+                    residual_bits.end());
+    AppendVarint(segments.Add(std::move(residual)), &records);
+  }
+
+  // Write the pack: the header, the module index, the segment index, the
+  // module records and the segments.
+  const size_t num_segments = segments.segments().size();
+  const size_t records_offset =
+      kMarkvPackHeaderSize +
+      (modules.size() + num_segments + 1) * sizeof(uint32_t);
+  size_t size = records_offset + records.size();
+  for (const auto& segment : segments.segments()) size += segment.size();
+  if (size > std::numeric_limits<uint32_t>::max()) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V pack would be larger than 4 GiB.";
+  }
+
+  std::vector<uint8_t> out;
+  out.reserve(size);
+  AppendWord(kMarkvPackMagicNumber, &out);
+  AppendWord(GetMarkvVersion(), &out);
+  AppendWord(GetModelWord(markv_model), &out);
+  AppendWord(static_cast<uint32_t>(modules.size()), &out);
+  AppendWord(static_cast<uint32_t>(num_segments), &out);
+  for (size_t record_offset : record_offsets) {
+    AppendWord(static_cast<uint32_t>(records_offset + record_offset), &out);
+  }
+  size_t segment_offset = records_offset + records.size();
+  for (const auto& segment : segments.segments()) {
+    AppendWord(static_cast<uint32_t>(segment_offset), &out);
+    segment_offset += segment.size();
+  }
+  AppendWord(static_cast<uint32_t>(segment_offset), &out);
+  out.insert(out.end(), records.begin(), records.end());
+  for (const auto& segment : segments.segments()) {
+    out.insert(out.end(), segment.begin(), segment.end());
+  }
+  assert(out.size() == size);
+
+  pack->swap(out);
+  return SPV_SUCCESS;
+}
+
+spv_result_t GetMarkvPackNumModules(spv_const_context context,
+                                    const uint8_t* pack, size_t pack_size,
+                                    const MarkvModel& markv_model,
+                                    MessageConsumer message_consumer,
+                                    uint32_t* num_modules) {
+  spv_context_t hijack_context = *context;
+  libspirv::SetContextMessageConsumer(&hijack_context, message_consumer);
+  uint32_t num_segments = 0;
+  return ReadMarkvPackHeader(&hijack_context, pack, pack_size, markv_model,
+                             num_modules, &num_segments);
+}
+
+spv_result_t MarkvPackToSpirv(
+    spv_const_context context, const uint8_t* pack, size_t pack_size,
+    uint32_t module_index, const MarkvCodecOptions& options,
+    const MarkvContainerOptions& container_options,
+    const MarkvModel& markv_model, MessageConsumer message_consumer,
+    std::vector<uint32_t>* spirv) {
+  spv_context_t hijack_context = *context;
+  libspirv::SetContextMessageConsumer(&hijack_context,
+                                      MakeThreadSafe(message_consumer));
+  spv_position_t position = {};
+
+  uint32_t num_modules = 0;
+  uint32_t num_segments = 0;
+  const spv_result_t result =
+      ReadMarkvPackHeader(&hijack_context, pack, pack_size, markv_model,
+                          &num_modules, &num_segments);
+  if (result != SPV_SUCCESS) return result;
+
+  if (module_index >= num_modules) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V pack has " << num_modules << " modules, and no module "
+           << module_index;
+  }
+
+  // Finds segment |index|, which must hold at least |num_bytes|. Only the
+  // index entries of the segments used by the module are read.
+  const size_t segment_index_offset =
+      kMarkvPackHeaderSize + size_t(num_modules) * sizeof(uint32_t);
+  const auto find_segment = [&](uint32_t index, size_t num_bytes,
+                                const uint8_t** segment_data,
+                                uint32_t* segment_size) {
+    if (index >= num_segments) return false;
+    size_t offset = segment_index_offset + size_t(index) * sizeof(uint32_t);
+    uint32_t segment_begin = 0;
+    uint32_t segment_end = 0;
+    ReadWord(pack, pack_size, &offset, &segment_begin);
+    ReadWord(pack, pack_size, &offset, &segment_end);
+    *segment_data = pack + segment_begin;
+    *segment_size = segment_end - segment_begin;
+    return segment_begin <= segment_end && segment_end <= pack_size &&
+           num_bytes <= *segment_size;
+  };
+
+  size_t offset =
+      kMarkvPackHeaderSize + size_t(module_index) * sizeof(uint32_t);
+  uint32_t record_offset = 0;
+  ReadWord(pack, pack_size, &offset, &record_offset);
+  offset = record_offset;
+
+  uint32_t spirv_version = 0;
+  uint32_t spirv_generator = 0;
+  uint32_t globals_id_bound = 0;
+  uint32_t globals_length_in_bits = 0;
+  uint32_t num_globals_segments = 0;
+  bool success =
+      ReadVarint(pack, pack_size, &offset, &spirv_version) &&
+      ReadVarint(pack, pack_size, &offset, &spirv_generator) &&
+      ReadVarint(pack, pack_size, &offset, &globals_id_bound) &&
+      ReadVarint(pack, pack_size, &offset, &globals_length_in_bits) &&
+      ReadVarint(pack, pack_size, &offset, &num_globals_segments) &&
+      globals_id_bound != 0;
+
+  std::vector<std::pair<const uint8_t*, size_t>> globals_parts;
+  size_t globals_size = 0;
+  for (uint32_t index = 0; success && index < num_globals_segments; ++index) {
+    uint32_t segment = 0;
+    const uint8_t* segment_data = nullptr;
+    uint32_t segment_size = 0;
+    success = ReadVarint(pack, pack_size, &offset, &segment) &&
+              find_segment(segment, 0, &segment_data, &segment_size);
+    globals_parts.emplace_back(segment_data, segment_size);
+    globals_size += segment_size;
+  }
+  // The residual instructions start on the byte after the global section.
+  success = success && globals_size == spvutils::NumBitsToNumWords<8>(
+                                           globals_length_in_bits);
+
+  // A function block, encoded after the global instructions it uses.
+  struct PackBlock {
+    MarkvContainerBlock block;
+    const uint8_t* data = nullptr;
+    std::vector<std::pair<uint32_t, uint32_t>> prefix;
+  };
+  std::vector<PackBlock> blocks;
+  uint32_t block_table_segment = 0;
+  const uint8_t* block_table = nullptr;
+  uint32_t block_table_size = 0;
+  size_t block_table_offset = 0;
+  uint32_t num_blocks = 0;
+  success = success &&
+            ReadVarint(pack, pack_size, &offset, &block_table_segment) &&
+            find_segment(block_table_segment, 0, &block_table,
+                         &block_table_size) &&
+            ReadVarint(block_table, block_table_size, &block_table_offset,
+                       &num_blocks) &&
+            num_blocks <= block_table_size - block_table_offset;
+  uint32_t id_base = globals_id_bound;
+  for (uint32_t index = 0; success && index < num_blocks; ++index) {
+    PackBlock block;
+    uint32_t segment_size = 0;
+    success =
+        ReadVarint(block_table, block_table_size, &block_table_offset,
+                   &block.block.offset) &&
+        ReadMarkvPackBlock(block_table, block_table_size, &block_table_offset,
+                           id_base, &block.block) &&
+        ReadMarkvPackRuns(block_table, block_table_size, &block_table_offset,
+                          &block.prefix) &&
+        find_segment(block.block.offset,
+                     spvutils::NumBitsToNumWords<8>(block.block.length_in_bits),
+                     &block.data, &segment_size);
+    id_base += block.block.num_new_ids;
+    blocks.push_back(std::move(block));
+  }
+
+  MarkvContainerBlock residual_block;
+  std::vector<std::pair<uint32_t, uint32_t>> residual_runs;
+  uint32_t residual_segment = 0;
+  const uint8_t* residual_data = nullptr;
+  uint32_t residual_size = 0;
+  size_t residual_offset = 0;
+  success =
+      success && ReadVarint(pack, pack_size, &offset, &residual_segment) &&
+      find_segment(residual_segment, 0, &residual_data, &residual_size) &&
+      ReadMarkvPackBlock(residual_data, residual_size, &residual_offset,
+                         id_base, &residual_block) &&
+      ReadMarkvPackRuns(residual_data, residual_size, &residual_offset,
+                        &residual_runs) &&
+      spvutils::NumBitsToNumWords<8>(residual_block.length_in_bits) <=
+          residual_size - residual_offset;
+
+  if (!success) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V pack has an invalid record for module " << module_index;
+  }
+  const uint32_t spirv_id_bound =
+      residual_block.id_base + residual_block.num_new_ids;
+
+  // Decode the global section followed by the residual instructions, then
+  // the blocks in parallel. The decoders only see parts of the module, which
+  // is validated as a whole once decoded.
+  MarkvCodecOptions block_options = options;
+  block_options.validate_spirv_binary = false;
+  std::vector<uint32_t> globals;
+  {
+    globals_parts.emplace_back(
+        residual_data + residual_offset,
+        spvutils::NumBitsToNumWords<8>(residual_block.length_in_bits));
+    const auto spirv_consumer = [&globals](const uint32_t* data,
+                                           size_t size) {
+      globals.insert(globals.end(), data, data + size);
+      return true;
+    };
+    MarkvDecoder decoder(&hijack_context, ConcatenateParts(globals_parts),
+                         spirv_consumer, block_options, &markv_model);
+    if (decoder.DecodeContainerBlock(globals_length_in_bits, globals_id_bound,
+                                     residual_block, true) != SPV_SUCCESS) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "Unable to decode MARK-V.";
+    }
+  }
+  // The decoder writes whole instructions, so their word counts are sound.
+  std::vector<size_t> instruction_offsets;
+  for (size_t i = 0; i < globals.size(); i += globals[i] >> 16) {
+    assert(globals[i] >> 16);
+    instruction_offsets.push_back(i);
+  }
+  instruction_offsets.push_back(globals.size());
+
+  std::vector<uint32_t> words = {kSpirvMagicNumber, spirv_version,
+                                 spirv_generator, spirv_id_bound, 0};
+  if (!MergeMarkvPackResidual(globals, instruction_offsets, residual_runs,
+                              &words)) {
+    return DiagnosticStream(position, hijack_context.consumer,
+                            SPV_ERROR_INVALID_BINARY)
+           << "MARK-V pack has invalid residual instructions for module "
+           << module_index;
+  }
+
+  // Every block is decoded after the bits of the global instructions it
+  // uses, which are found by encoding these instructions again.
+  const size_t num_global_instructions = instruction_offsets.size() - 1;
+  std::vector<std::vector<uint32_t>> decoded(blocks.size());
+  std::vector<spv_result_t> results(blocks.size(), SPV_SUCCESS);
+  spvutils::ParallelFor(
+      blocks.size(), container_options.num_threads, [&](size_t index) {
+        PackBlock& block = blocks[index];
+        std::vector<uint32_t> prefix_words(words.begin(), words.begin() + 5);
+        size_t end = 0;
+        for (const auto& run : block.prefix) {
+          if (run.first > num_global_instructions - end ||
+              run.second > num_global_instructions - end - run.first) {
+            results[index] = SPV_ERROR_INVALID_BINARY;
+            return;
+          }
+          const size_t begin = end + run.first;
+          end = begin + run.second;
+          prefix_words.insert(prefix_words.end(),
+                              globals.begin() + instruction_offsets[begin],
+                              globals.begin() + instruction_offsets[end]);
+        }
+
+        MarkvEncoder encoder(&hijack_context, block_options, &markv_model);
+        encoder.SetContainerBlock({});
+        results[index] = spvBinaryParse(
+            &hijack_context, &encoder, prefix_words.data(),
+            prefix_words.size(), EncodeHeader, EncodeInstruction, nullptr);
+        if (results[index] != SPV_SUCCESS) return;
+        MarkvContainerBlockData prefix;
+        encoder.FinishContainerBlock(&prefix);
+
+        // The decoder issues the ids of the global instructions in the order
+        // the encoder did.
+        std::vector<uint32_t> globals_ids(prefix.globals_id_bound - 1, 0);
+        for (const auto& decoded_id : prefix.decoded_ids) {
+          globals_ids[decoded_id.second - 1] = decoded_id.first;
+        }
+
+        std::vector<uint32_t>& block_words = decoded[index];
+        const auto spirv_consumer = [&block_words](const uint32_t* data,
+                                                   size_t size) {
+          block_words.insert(block_words.end(), data, data + size);
+          return true;
+        };
+        MarkvDecoder decoder(
+            &hijack_context,
+            ConcatenateParts(
+                {{prefix.globals.data(), prefix.globals.size()},
+                 {block.data, spvutils::NumBitsToNumWords<8>(
+                                  block.block.length_in_bits)}}),
+            spirv_consumer, block_options, &markv_model);
+        decoder.SetOutputIds(std::move(globals_ids));
+        results[index] = decoder.DecodeContainerBlock(
+            prefix.globals_length_in_bits, prefix.globals_id_bound,
+            block.block, false);
+      });
+
+  for (spv_result_t result : results) {
+    if (result != SPV_SUCCESS) {
+      return DiagnosticStream(position, hijack_context.consumer,
+                              SPV_ERROR_INVALID_BINARY)
+             << "Unable to decode MARK-V.";
+    }
+  }
+
+  for (const auto& block_words : decoded) {
+    words.insert(words.end(), block_words.begin(), block_words.end());
+  }
+
+  if (options.validate_spirv_binary) {
+    const spv_result_t result =
+        spvValidateBinary(&hijack_context, words.data(), words.size(), nullptr);
+    if (result != SPV_SUCCESS) return result;
+  }
+
+  spirv->swap(words);
+  return SPV_SUCCESS;
+}
+
 spv_result_t MarkvToSpirv(
     spv_const_context context, const std::vector<uint8_t>& markv,
     const MarkvCodecOptions& options, const MarkvModel& markv_model,
     MessageConsumer message_consumer, MarkvLogConsumer log_consumer,
     MarkvDebugConsumer debug_consumer, std::vector<uint32_t>* spirv) {
+  size_t num_read_bytes = 0;
+  const auto markv_source = [&markv, &num_read_bytes](uint8_t* data,
+                                                      size_t max_size) {
+    const size_t size = std::min(max_size, markv.size() - num_read_bytes);
+    std::memcpy(data, markv.data() + num_read_bytes, size);
+    num_read_bytes += size;
+    return size;
+  };
+
+  std::vector<uint32_t> words;
+  words.reserve(markv.size() * 4);  // Heuristic.
+  const auto spirv_consumer = [&words](const uint32_t* data, size_t size) {
+    words.insert(words.end(), data, data + size);
+    return true;
+  };
+
+  const spv_result_t result = MarkvStreamToSpirv(
+      context, markv_source, options, markv_model, message_consumer,
+      log_consumer, debug_consumer, spirv_consumer);
+  if (result != SPV_SUCCESS) return result;
+
+  assert(!words.empty());
+  spirv->swap(words);
+  return SPV_SUCCESS;
+}
+
+spv_result_t MarkvStreamToSpirv(
+    spv_const_context context, MarkvByteSource markv_source,
+    const MarkvCodecOptions& options, const MarkvModel& markv_model,
+    MessageConsumer message_consumer, MarkvLogConsumer log_consumer,
+    MarkvDebugConsumer debug_consumer, SpirvWordConsumer spirv_consumer) {
   spv_position_t position = {};
   spv_context_t hijack_context = *context;
   libspirv::SetContextMessageConsumer(&hijack_context, message_consumer);
 
-  MarkvDecoder decoder(&hijack_context, markv, options, &markv_model);
+  MarkvDecoder decoder(&hijack_context, std::move(markv_source),
+                       std::move(spirv_consumer), options, &markv_model);
 
   if (log_consumer || debug_consumer)
     decoder.CreateLogger(log_consumer, debug_consumer);
 
-  if (decoder.DecodeModule(spirv) != SPV_SUCCESS) {
+  const spv_result_t result = decoder.DecodeModule();
+  if (result == SPV_REQUESTED_TERMINATION) return result;
+  if (result != SPV_SUCCESS) {
     return DiagnosticStream(position, hijack_context.consumer,
                             SPV_ERROR_INVALID_BINARY)
            << "Unable to decode MARK-V.";
   }
 
-  assert(!spirv->empty());
   return SPV_SUCCESS;
 }
 
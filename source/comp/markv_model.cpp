@@ -0,0 +1,461 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Binary format of MARK-V models, all values are 32-bit words:
+//
+//   magic number, format version, model type, model version,
+//   opcode, num_operands, mtf_rank, u64 and s64 chunk lengths,
+//   s64 block exponent, id fallback strategy,
+//   number of operand types, chunk length of every operand type,
+//   number of descriptors with coding scheme, the descriptors,
+//   0 or 1, the codec for opcode_and_num_operands if 1,
+//   number of Markov codecs, <previous opcode, codec> for each,
+//   number of non-id word codecs, <opcode, operand index, codec> for each,
+//   number of id descriptor codecs, <opcode, operand index, codec> for each,
+//   number of literal string codecs, <opcode, codec> for each.
+//
+// A codec starts with its kind. A tree codec is the handle of its root and
+// the number of its nodes, followed by the nodes, NIL included. A uint64_t
+// node is <value low word, value high word, left, right>. A string node is
+// <left, right, number of bytes> followed by the bytes padded with zeroes to a
+// whole number of words. A canonical codec is the length of its longest code,
+// the number of codes of every length from 0 up to it, and the values in
+// canonical order: by code length, then by value. A uint64_t value is <low
+// word, high word>, a string value is its number of bytes followed by the
+// padded bytes.
+//
+// Move-to-front policies are not part of the format: the rules choosing the
+// move-to-front sequence of an id stay hard-coded in the codec, and a model
+// file only carries the chunk lengths and Huffman codecs listed above.
+
+#include "markv_model.h"
+
+#include <algorithm>
+#include <cstring>
+#include <initializer_list>
+#include <utility>
+
+using spvutils::HuffmanCodec;
+
+namespace spvtools {
+
+namespace {
+
+// Identifies a MARK-V model file.
+const uint32_t kMarkvModelMagicNumber = 0x07230305;
+
+// Changes whenever the layout of the model file does.
+const uint32_t kMarkvModelFormatVersion = 2;
+
+// Kinds of codecs in a model file.
+enum CodecKind : uint32_t {
+  kCodecTree = 0,
+  kCodecCanonical = 1,
+};
+
+// Codes are encoded in 64-bit words.
+const uint32_t kMaxCodeLength = 64;
+
+// Writes the header of a canonical codec and returns its values in order.
+template <class Val>
+std::vector<Val> WriteCanonicalCodecHeader(const HuffmanCodec<Val>& codec,
+                                           std::vector<uint32_t>* words) {
+  const std::vector<std::pair<Val, uint32_t>> code_lengths =
+      codec.GetCodeLengths();
+  const uint32_t max_length = code_lengths.back().second;
+  words->push_back(kCodecCanonical);
+  words->push_back(max_length);
+  const size_t first_count = words->size();
+  words->resize(first_count + max_length + 1, 0);
+  std::vector<Val> values;
+  values.reserve(code_lengths.size());
+  for (const auto& pair : code_lengths) {
+    ++(*words)[first_count + pair.second];
+    values.push_back(pair.first);
+  }
+  return values;
+}
+
+void WriteString(const std::string& value, std::vector<uint32_t>* words) {
+  words->push_back(static_cast<uint32_t>(value.size()));
+  const size_t first_word = words->size();
+  words->resize(first_word + (value.size() + 3) / 4, 0);
+  if (!value.empty()) memcpy(&(*words)[first_word], value.data(), value.size());
+}
+
+// Chunk lengths are used for values of up to 16 bits (the number of
+// operands), operand chunk lengths for values of up to 32 bits.
+const uint32_t kMaxChunkLength = 15;
+const uint32_t kMaxOperandChunkLength = 31;
+
+void WriteCodec(const HuffmanCodec<uint64_t>& codec,
+                std::vector<uint32_t>* words) {
+  if (codec.is_canonical()) {
+    for (uint64_t value : WriteCanonicalCodecHeader(codec, words)) {
+      words->push_back(static_cast<uint32_t>(value));
+      words->push_back(static_cast<uint32_t>(value >> 32));
+    }
+    return;
+  }
+
+  words->push_back(kCodecTree);
+  words->push_back(codec.root_handle());
+  words->push_back(static_cast<uint32_t>(codec.nodes().size()));
+  for (const auto& node : codec.nodes()) {
+    words->push_back(static_cast<uint32_t>(node.value));
+    words->push_back(static_cast<uint32_t>(node.value >> 32));
+    words->push_back(node.left);
+    words->push_back(node.right);
+  }
+}
+
+void WriteCodec(const HuffmanCodec<std::string>& codec,
+                std::vector<uint32_t>* words) {
+  if (codec.is_canonical()) {
+    for (const std::string& value : WriteCanonicalCodecHeader(codec, words)) {
+      WriteString(value, words);
+    }
+    return;
+  }
+
+  words->push_back(kCodecTree);
+  words->push_back(codec.root_handle());
+  words->push_back(static_cast<uint32_t>(codec.nodes().size()));
+  for (const auto& node : codec.nodes()) {
+    words->push_back(node.left);
+    words->push_back(node.right);
+    WriteString(node.value, words);
+  }
+}
+
+// Reads words of a model, and checks that they don't run out.
+class ModelReader {
+ public:
+  ModelReader(const uint32_t* words, size_t num_words)
+      : words_(words), end_(words + num_words) {}
+
+  bool AtEnd() const { return words_ == end_; }
+
+  bool Read(uint32_t* word) {
+    if (words_ == end_) return false;
+    *word = *words_++;
+    return true;
+  }
+
+  bool ReadCodec(std::unique_ptr<HuffmanCodec<uint64_t>>* codec) {
+    uint32_t kind = 0;
+    if (!Read(&kind)) return false;
+    if (kind == kCodecCanonical) {
+      return ReadCanonicalCodec(codec, [this](uint64_t* value) {
+        uint32_t low = 0;
+        uint32_t high = 0;
+        if (!Read(&low) || !Read(&high)) return false;
+        *value = low | (uint64_t(high) << 32);
+        return true;
+      });
+    }
+    if (kind != kCodecTree) return false;
+
+    uint32_t root = 0;
+    uint32_t num_nodes = 0;
+    if (!Read(&root) || !Read(&num_nodes)) return false;
+    if (static_cast<size_t>(end_ - words_) / 4 < num_nodes) return false;
+
+    std::vector<HuffmanCodec<uint64_t>::Node> nodes;
+    nodes.reserve(num_nodes);
+    for (uint32_t i = 0; i < num_nodes; ++i) {
+      const uint64_t value = words_[0] | (uint64_t(words_[1]) << 32);
+      nodes.emplace_back(value, words_[2], words_[3]);
+      words_ += 4;
+    }
+    if (!IsValidTree(root, nodes)) return false;
+    codec->reset(new HuffmanCodec<uint64_t>(root, std::move(nodes)));
+    return true;
+  }
+
+  bool ReadCodec(std::unique_ptr<HuffmanCodec<std::string>>* codec) {
+    uint32_t kind = 0;
+    if (!Read(&kind)) return false;
+    if (kind == kCodecCanonical) {
+      return ReadCanonicalCodec(
+          codec, [this](std::string* value) { return ReadString(value); });
+    }
+    if (kind != kCodecTree) return false;
+
+    uint32_t root = 0;
+    uint32_t num_nodes = 0;
+    if (!Read(&root) || !Read(&num_nodes)) return false;
+    if (static_cast<size_t>(end_ - words_) / 3 < num_nodes) return false;
+
+    std::vector<HuffmanCodec<std::string>::Node> nodes;
+    nodes.reserve(num_nodes);
+    for (uint32_t i = 0; i < num_nodes; ++i) {
+      uint32_t left = 0;
+      uint32_t right = 0;
+      std::string value;
+      if (!Read(&left) || !Read(&right) || !ReadString(&value)) return false;
+      nodes.emplace_back(std::move(value), left, right);
+    }
+    if (!IsValidTree(root, nodes)) return false;
+    codec->reset(new HuffmanCodec<std::string>(root, std::move(nodes)));
+    return true;
+  }
+
+ private:
+  bool ReadString(std::string* value) {
+    uint32_t num_bytes = 0;
+    if (!Read(&num_bytes)) return false;
+    const size_t num_words = (size_t(num_bytes) + 3) / 4;
+    if (static_cast<size_t>(end_ - words_) < num_words) return false;
+    value->assign(reinterpret_cast<const char*>(words_), num_bytes);
+    words_ += num_words;
+    return true;
+  }
+
+  // Reads a canonical codec after its kind, reading every value with
+  // |read_value|.
+  template <class Val, class ReadValueFn>
+  bool ReadCanonicalCodec(std::unique_ptr<HuffmanCodec<Val>>* codec,
+                          ReadValueFn read_value) {
+    uint32_t max_length = 0;
+    if (!Read(&max_length) || max_length > kMaxCodeLength) return false;
+
+    std::vector<uint32_t> num_codes_of_length(max_length + 1, 0);
+    uint64_t num_codes = 0;
+    for (uint32_t& num_codes_with_length : num_codes_of_length) {
+      if (!Read(&num_codes_with_length)) return false;
+      num_codes += num_codes_with_length;
+    }
+    // Every value takes at least one word.
+    if (num_codes > static_cast<uint64_t>(end_ - words_)) return false;
+
+    std::vector<std::pair<Val, uint32_t>> code_lengths;
+    code_lengths.reserve(static_cast<size_t>(num_codes));
+    for (uint32_t length = 0; length <= max_length; ++length) {
+      for (uint32_t i = 0; i < num_codes_of_length[length]; ++i) {
+        Val value;
+        if (!read_value(&value)) return false;
+        code_lengths.emplace_back(std::move(value), length);
+      }
+    }
+    if (!HuffmanCodec<Val>::AreValidCodeLengths(code_lengths)) return false;
+    codec->reset(new HuffmanCodec<Val>(code_lengths));
+    return true;
+  }
+
+  // Returns true if |nodes| form a tree with the root at |root| and NIL at 0.
+  // Codecs only ever create parents after their children, which is required
+  // here as well, as it rules out cycles without traversing the tree.
+  template <class Node>
+  static bool IsValidTree(uint32_t root, const std::vector<Node>& nodes) {
+    if (root == 0 || root >= nodes.size()) return false;
+    if (nodes[0].left || nodes[0].right) return false;
+    std::vector<bool> has_parent(nodes.size(), false);
+    for (uint32_t handle = 1; handle < nodes.size(); ++handle) {
+      const Node& node = nodes[handle];
+      // Either a leaf, or a node with two children.
+      if (!node.left != !node.right) return false;
+      if (!node.left) continue;
+      if (node.left >= handle || node.right >= handle) return false;
+      if (node.left == node.right) return false;
+      if (has_parent[node.left] || has_parent[node.right]) return false;
+      has_parent[node.left] = true;
+      has_parent[node.right] = true;
+    }
+    if (has_parent[root]) return false;
+
+    // The leaves reached from the root need distinct values.
+    std::vector<decltype(nodes[0].value)> values;
+    std::vector<uint32_t> stack = {root};
+    while (!stack.empty()) {
+      const Node& node = nodes[stack.back()];
+      stack.pop_back();
+      if (node.left) {
+        stack.push_back(node.left);
+        stack.push_back(node.right);
+      } else {
+        values.push_back(node.value);
+      }
+    }
+    std::sort(values.begin(), values.end());
+    return std::adjacent_find(values.begin(), values.end()) == values.end();
+  }
+
+  const uint32_t* words_;
+  const uint32_t* const end_;
+};
+
+}  // namespace
+
+void MarkvModel::Serialize(std::vector<uint32_t>* words) const {
+  words->push_back(kMarkvModelMagicNumber);
+  words->push_back(kMarkvModelFormatVersion);
+  words->push_back(model_type_);
+  words->push_back(model_version_);
+  words->push_back(opcode_chunk_length_);
+  words->push_back(num_operands_chunk_length_);
+  words->push_back(mtf_rank_chunk_length_);
+  words->push_back(u64_chunk_length_);
+  words->push_back(s64_chunk_length_);
+  words->push_back(s64_block_exponent_);
+  words->push_back(static_cast<uint32_t>(id_fallback_strategy_));
+
+  words->push_back(static_cast<uint32_t>(operand_chunk_lengths_.size()));
+  words->insert(words->end(), operand_chunk_lengths_.begin(),
+                operand_chunk_lengths_.end());
+
+  // Sorted, so that equal models are always serialized to the same words.
+  std::vector<uint32_t> descriptors(descriptors_with_coding_scheme_.begin(),
+                                    descriptors_with_coding_scheme_.end());
+  std::sort(descriptors.begin(), descriptors.end());
+  words->push_back(static_cast<uint32_t>(descriptors.size()));
+  words->insert(words->end(), descriptors.begin(), descriptors.end());
+
+  words->push_back(opcode_and_num_operands_huffman_codec_ ? 1 : 0);
+  if (opcode_and_num_operands_huffman_codec_) {
+    WriteCodec(*opcode_and_num_operands_huffman_codec_, words);
+  }
+
+  words->push_back(static_cast<uint32_t>(
+      opcode_and_num_operands_markov_huffman_codecs_.size()));
+  for (const auto& kv : opcode_and_num_operands_markov_huffman_codecs_) {
+    words->push_back(kv.first);
+    WriteCodec(*kv.second, words);
+  }
+
+  for (const auto* codecs :
+       {&non_id_word_huffman_codecs_, &id_descriptor_huffman_codecs_}) {
+    words->push_back(static_cast<uint32_t>(codecs->size()));
+    for (const auto& kv : *codecs) {
+      words->push_back(kv.first.first);
+      words->push_back(kv.first.second);
+      WriteCodec(*kv.second, words);
+    }
+  }
+
+  words->push_back(
+      static_cast<uint32_t>(literal_string_huffman_codecs_.size()));
+  for (const auto& kv : literal_string_huffman_codecs_) {
+    words->push_back(kv.first);
+    WriteCodec(*kv.second, words);
+  }
+}
+
+std::unique_ptr<MarkvModel> MarkvModel::Deserialize(const uint32_t* words,
+                                                    size_t num_words) {
+  ModelReader reader(words, num_words);
+  std::unique_ptr<MarkvModel> model(new MarkvModel());
+
+  uint32_t magic = 0;
+  uint32_t format_version = 0;
+  uint32_t id_fallback_strategy = 0;
+  if (!reader.Read(&magic) || magic != kMarkvModelMagicNumber ||
+      !reader.Read(&format_version) ||
+      format_version != kMarkvModelFormatVersion ||
+      !reader.Read(&model->model_type_) ||
+      !reader.Read(&model->model_version_) ||
+      !reader.Read(&model->opcode_chunk_length_) ||
+      !reader.Read(&model->num_operands_chunk_length_) ||
+      !reader.Read(&model->mtf_rank_chunk_length_) ||
+      !reader.Read(&model->u64_chunk_length_) ||
+      !reader.Read(&model->s64_chunk_length_) ||
+      !reader.Read(&model->s64_block_exponent_) ||
+      !reader.Read(&id_fallback_strategy)) {
+    return nullptr;
+  }
+
+  // Model type and version share a word in the MARK-V header.
+  if (model->model_type_ > 0xFFFF || model->model_version_ > 0xFFFF)
+    return nullptr;
+
+  for (uint32_t chunk_length :
+       {model->opcode_chunk_length_, model->num_operands_chunk_length_,
+        model->mtf_rank_chunk_length_, model->u64_chunk_length_,
+        model->s64_chunk_length_}) {
+    if (chunk_length == 0 || chunk_length > kMaxChunkLength) return nullptr;
+  }
+  if (model->s64_block_exponent_ >= 64) return nullptr;
+
+  if (id_fallback_strategy ==
+      static_cast<uint32_t>(IdFallbackStrategy::kRuleBased)) {
+    model->id_fallback_strategy_ = IdFallbackStrategy::kRuleBased;
+  } else if (id_fallback_strategy ==
+             static_cast<uint32_t>(IdFallbackStrategy::kShortDescriptor)) {
+    model->id_fallback_strategy_ = IdFallbackStrategy::kShortDescriptor;
+  } else {
+    return nullptr;
+  }
+
+  // Operand types are numbered differently by different versions of the
+  // grammar, and a model is only valid with the numbering it was made for.
+  uint32_t num_operand_types = 0;
+  if (!reader.Read(&num_operand_types) ||
+      num_operand_types != model->operand_chunk_lengths_.size()) {
+    return nullptr;
+  }
+  for (uint32_t& chunk_length : model->operand_chunk_lengths_) {
+    if (!reader.Read(&chunk_length) || chunk_length > kMaxOperandChunkLength)
+      return nullptr;
+  }
+
+  uint32_t num_descriptors = 0;
+  if (!reader.Read(&num_descriptors)) return nullptr;
+  for (uint32_t i = 0; i < num_descriptors; ++i) {
+    uint32_t descriptor = 0;
+    if (!reader.Read(&descriptor)) return nullptr;
+    model->descriptors_with_coding_scheme_.insert(descriptor);
+  }
+
+  uint32_t has_codec = 0;
+  if (!reader.Read(&has_codec) || has_codec > 1) return nullptr;
+  if (has_codec &&
+      !reader.ReadCodec(&model->opcode_and_num_operands_huffman_codec_)) {
+    return nullptr;
+  }
+
+  uint32_t num_codecs = 0;
+  if (!reader.Read(&num_codecs)) return nullptr;
+  for (uint32_t i = 0; i < num_codecs; ++i) {
+    uint32_t prev_opcode = 0;
+    if (!reader.Read(&prev_opcode) ||
+        !reader.ReadCodec(
+            &model->opcode_and_num_operands_markov_huffman_codecs_[prev_opcode]))
+      return nullptr;
+  }
+
+  for (auto* codecs : {&model->non_id_word_huffman_codecs_,
+                       &model->id_descriptor_huffman_codecs_}) {
+    if (!reader.Read(&num_codecs)) return nullptr;
+    for (uint32_t i = 0; i < num_codecs; ++i) {
+      std::pair<uint32_t, uint32_t> opcode_and_index;
+      if (!reader.Read(&opcode_and_index.first) ||
+          !reader.Read(&opcode_and_index.second) ||
+          !reader.ReadCodec(&(*codecs)[opcode_and_index]))
+        return nullptr;
+    }
+  }
+
+  if (!reader.Read(&num_codecs)) return nullptr;
+  for (uint32_t i = 0; i < num_codecs; ++i) {
+    uint32_t opcode = 0;
+    if (!reader.Read(&opcode) ||
+        !reader.ReadCodec(&model->literal_string_huffman_codecs_[opcode]))
+      return nullptr;
+  }
+
+  if (!reader.AtEnd()) return nullptr;
+  return model;
+}
+
+}  // namespace spvtools
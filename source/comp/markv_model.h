@@ -15,7 +15,10 @@
 #ifndef LIBSPIRV_COMP_MARKV_MODEL_H_
 #define LIBSPIRV_COMP_MARKV_MODEL_H_
 
+#include <cstddef>
 #include <map>
+#include <memory>
+#include <string>
 #include <unordered_set>
 #include <vector>
 
@@ -166,6 +169,19 @@ class MarkvModel {
     model_version_ = in_model_version;
   }
 
+  // Appends the model to |words| in the binary model format. The format is a
+  // flat sequence of words holding the constants, the chunk lengths and the
+  // trees of all Huffman codecs, so that it can be loaded with a single pass
+  // and no parsing, for example straight from a memory-mapped file.
+  void Serialize(std::vector<uint32_t>* words) const;
+
+  // Creates a model from the |num_words| words at |words| in the binary model
+  // format written by Serialize(). Returns nullptr if the words are not a
+  // valid model for this build, for example if they were written for a
+  // different version of the format.
+  static std::unique_ptr<MarkvModel> Deserialize(const uint32_t* words,
+                                                 size_t num_words);
+
   // Returns value used by Huffman codecs as a signal that a value is not in the
   // coding table.
   static uint64_t GetMarkvNoneOfTheAbove() {
@@ -15,7 +15,6 @@
 #include "id_descriptor.h"
 
 #include <cassert>
-#include <iostream>
 
 #include "opcode.h"
 #include "operand.h"
@@ -24,16 +23,29 @@ namespace libspirv {
 
 namespace {
 
-// Hashes an array of words. Order of words is important.
-uint32_t HashU32Array(const std::vector<uint32_t>& words) {
-  // The hash function is a sum of hashes of each word seeded by word index.
-  // Knuth's multiplicative hash is used to hash the words.
-  const uint32_t kKnuthMulHash = 2654435761;
-  uint32_t val = 0;
-  for (uint32_t i = 0; i < words.size(); ++i) {
-    val += (words[i] + i + 123) * kKnuthMulHash;
-  }
-  return val;
+// The hash of an array of words is a sum of hashes of each word seeded by
+// word index, where Knuth's multiplicative hash is used to hash the words:
+// the sum of (words[i] + i + 123) * kKnuthMulHash. As all arithmetic is
+// modulo 2^32, it equals kKnuthMulHash times the sum of the words plus the
+// sum of (i + 123), which only needs the sum and the number of the words.
+const uint32_t kKnuthMulHash = 2654435761;
+
+uint32_t HashU32Array(uint32_t sum_of_words, uint32_t num_words) {
+  const uint64_t n = num_words;
+  const uint32_t sum_of_seeds =
+      static_cast<uint32_t>(n * (n - 1) / 2 + 123 * n);
+  return (sum_of_words + sum_of_seeds) * kKnuthMulHash;
+}
+
+// Mixes |word| into |hash|, a 64-bit hash of an array of words which, unlike
+// the descriptor hash, depends on the order of the words. Used to tell apart
+// different arrays with the same descriptor.
+inline uint64_t MixWord(uint64_t hash, uint32_t word) {
+  const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+  const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+  hash += word * kPrime2;
+  hash = (hash << 31) | (hash >> 33);
+  return hash * kPrime1;
 }
 
 }  // namespace
@@ -42,38 +54,64 @@ uint32_t IdDescriptorCollection::ProcessInstruction(
     const spv_parsed_instruction_t& inst) {
   if (!inst.result_id) return 0;
 
-  assert(words_.empty());
-  words_.push_back(inst.words[0]);
+  // The sum and the number of the hashed words, and their 64-bit hash if
+  // collisions are counted.
+  uint32_t sum_of_words = inst.words[0];
+  uint32_t num_words = 1;
+  uint64_t words_hash = count_collisions_ ? MixWord(0, inst.words[0]) : 0;
 
   for (size_t operand_index = 0; operand_index < inst.num_operands;
        ++operand_index) {
     const auto& operand = inst.operands[operand_index];
     if (spvIsIdType(operand.type)) {
-      const uint32_t id = inst.words[operand.offset];
-      const auto it = id_to_descriptor_.find(id);
+      const uint32_t descriptor = GetDescriptor(inst.words[operand.offset]);
       // Forward declared ids are not hashed.
-      if (it != id_to_descriptor_.end()) {
-        words_.push_back(it->second);
+      if (descriptor) {
+        sum_of_words += descriptor;
+        ++num_words;
+        if (count_collisions_) words_hash = MixWord(words_hash, descriptor);
       }
     } else {
-      for (size_t operand_word_index = 0;
-           operand_word_index < operand.num_words; ++operand_word_index) {
-        words_.push_back(inst.words[operand.offset + operand_word_index]);
+      const uint32_t* words = inst.words + operand.offset;
+      for (size_t i = 0; i < operand.num_words; ++i) {
+        sum_of_words += words[i];
+      }
+      num_words += operand.num_words;
+      if (count_collisions_) {
+        for (size_t i = 0; i < operand.num_words; ++i) {
+          words_hash = MixWord(words_hash, words[i]);
+        }
       }
     }
   }
 
+  const uint32_t hash = HashU32Array(sum_of_words, num_words);
   uint32_t descriptor =
-      custom_hash_func_ ? custom_hash_func_(words_) : HashU32Array(words_);
+      custom_descriptor_func_ ? custom_descriptor_func_(hash) : hash;
   if (descriptor == 0) descriptor = 1;
   assert(descriptor);
 
-  words_.clear();
+  if (count_collisions_) {
+    const auto result =
+        descriptor_to_words_hash_.emplace(descriptor, words_hash);
+    if (!result.second && result.first->second != words_hash)
+      ++num_collisions_;
+  }
 
-  const auto result = id_to_descriptor_.emplace(inst.result_id, descriptor);
-  assert(result.second);
-  (void)result;
+  SetDescriptor(inst.result_id, descriptor);
   return descriptor;
 }
 
+void IdDescriptorCollection::SetDescriptor(uint32_t id, uint32_t descriptor) {
+  if (id < kMaxDenseId) {
+    if (id >= dense_descriptors_.size()) dense_descriptors_.resize(id + 1, 0);
+    assert(!dense_descriptors_[id]);
+    dense_descriptors_[id] = descriptor;
+  } else {
+    const auto result = sparse_descriptors_.emplace(id, descriptor);
+    assert(result.second);
+    (void)result;
+  }
+}
+
 }  // namespace libspirv
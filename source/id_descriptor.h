@@ -15,6 +15,7 @@
 #ifndef LIBSPIRV_ID_DESCRIPTOR_H_
 #define LIBSPIRV_ID_DESCRIPTOR_H_
 
+#include <cstdint>
 #include <unordered_map>
 #include <vector>
 
@@ -22,40 +23,69 @@
 
 namespace libspirv {
 
-using CustomHashFunc = std::function<uint32_t(const std::vector<uint32_t>&)>;
+// Maps the hash of the words of an instruction to a descriptor.
+using CustomDescriptorFunc = uint32_t (*)(uint32_t hash);
 
 // Computes and stores id descriptors.
 //
 // Descriptors are computed as hash of all words in the instruction where ids
-// were substituted with previously computed descriptors.
+// were substituted with previously computed descriptors. The hash is a sum of
+// per-word terms, which is computed in a single pass over the instruction
+// without copying its words. Descriptor values are stored in compression
+// models, so the hash must not change.
 class IdDescriptorCollection {
  public:
+  // If |custom_descriptor_func| is given, it maps hashes to descriptors
+  // instead of the default mapping, which only replaces 0 by 1. If
+  // |count_collisions| is true, the collection also computes a 64-bit hash
+  // of every instruction, to count descriptors shared by different words.
   explicit IdDescriptorCollection(
-      CustomHashFunc custom_hash_func = CustomHashFunc())
-      : custom_hash_func_(custom_hash_func) {
-    words_.reserve(16);
-  }
+      CustomDescriptorFunc custom_descriptor_func = nullptr,
+      bool count_collisions = false)
+      : custom_descriptor_func_(custom_descriptor_func),
+        count_collisions_(count_collisions) {}
 
   // Computes descriptor for the result id of the given instruction and
-  // registers it in id_to_descriptor_. Returns the computed descriptor.
+  // registers it. Returns the computed descriptor.
   // This function needs to be sequentially called for every instruction in the
   // module.
   uint32_t ProcessInstruction(const spv_parsed_instruction_t& inst);
 
   // Returns a previously computed descriptor id.
   uint32_t GetDescriptor(uint32_t id) const {
-    const auto it = id_to_descriptor_.find(id);
-    if (it == id_to_descriptor_.end()) return 0;
+    if (id < kMaxDenseId) {
+      return id < dense_descriptors_.size() ? dense_descriptors_[id] : 0;
+    }
+    const auto it = sparse_descriptors_.find(id);
+    if (it == sparse_descriptors_.end()) return 0;
     return it->second;
   }
 
+  // Returns the number of instructions which got the descriptor of an earlier
+  // instruction with different words. Always 0 unless the collection was
+  // created to count collisions.
+  uint32_t num_collisions() const { return num_collisions_; }
+
  private:
-  std::unordered_map<uint32_t, uint32_t> id_to_descriptor_;
+  // Ids are dense in valid modules, and are looked up in a vector indexed by
+  // id. Ids which are this large, which only happens in invalid modules, are
+  // looked up in a map instead, to bound the size of the vector.
+  static const uint32_t kMaxDenseId = 1 << 22;
+
+  // Registers |descriptor| as the descriptor of |id|.
+  void SetDescriptor(uint32_t id, uint32_t descriptor);
+
+  // Descriptors of ids below kMaxDenseId, indexed by id. 0 means none, which
+  // is never a valid descriptor.
+  std::vector<uint32_t> dense_descriptors_;
+  std::unordered_map<uint32_t, uint32_t> sparse_descriptors_;
 
-  std::function<uint32_t(const std::vector<uint32_t>&)> custom_hash_func_;
+  CustomDescriptorFunc custom_descriptor_func_;
 
-  // Scratch buffer used for hashing. Class member to optimize on allocation.
-  std::vector<uint32_t> words_;
+  const bool count_collisions_;
+  uint32_t num_collisions_ = 0;
+  // The 64-bit hash of the first instruction which got each descriptor.
+  std::unordered_map<uint32_t, uint64_t> descriptor_to_words_hash_;
 };
 
 }  // namespace libspirv
@@ -0,0 +1,494 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "spirv-tools/linker.hpp"
+
+#include <cstring>
+
+#include <algorithm>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "diagnostic.h"
+#include "latest_version_spirv_header.h"
+#include "operand.h"
+#include "spirv-tools/libspirv.hpp"
+#include "spirv_constant.h"
+
+// The layout of a library index, all fields being 32-bit words:
+//
+//   magic number, version, word count of the library,
+//   offset of the first OpFunction of the library, number of functions,
+//   for each function:
+//     first word offset, end word offset (exclusive), flags,
+//     number of referenced functions, indices of the referenced functions,
+//     number of global instructions targeting it, their word offsets,
+//   number of exported functions,
+//   for each exported function:
+//     function index, number of words of the name, nul-terminated name.
+//
+// Offsets are relative to the start of the library binary, including its
+// header.
+
+namespace spvtools {
+
+namespace {
+
+const uint32_t kLibraryIndexMagicNumber = 0x5850494c;  // "LIPX"
+const uint32_t kLibraryIndexVersion = 1u;
+// The function is a root of the library: it is always kept.
+const uint32_t kFunctionFlagKeep = 0x1u;
+
+// Everything the index records about a function of the library.
+struct LibraryFunction {
+  uint32_t begin = 0u;
+  uint32_t end = 0u;
+  uint32_t flags = 0u;
+  std::vector<uint32_t> callees;
+  std::vector<uint32_t> global_refs;
+};
+
+// A parsed library index.
+struct LibraryIndex {
+  uint32_t function_section_begin = 0u;
+  std::vector<LibraryFunction> functions;
+  std::unordered_map<std::string, uint32_t> exports;
+};
+
+// The state of CreateLibraryIndex() while parsing the library.
+struct IndexBuilder {
+  // An instruction of the global section which refers to ids.
+  struct GlobalInst {
+    uint32_t offset;
+    // True if this is a debug or annotation instruction that can be dropped
+    // along with the function defining its target.
+    bool droppable;
+    std::vector<uint32_t> ids;
+  };
+
+  // Word offset of the next instruction.
+  uint32_t offset = SPV_INDEX_INSTRUCTION;
+  uint32_t function_section_begin = 0u;
+  bool in_function = false;
+  bool misplaced_global = false;
+  std::vector<LibraryFunction> functions;
+  // The ids referenced from within each function.
+  std::vector<std::vector<uint32_t>> referenced_ids;
+  // Maps the result id of each function to its index.
+  std::unordered_map<uint32_t, uint32_t> function_index;
+  // Maps every id defined inside a function to the index of that function.
+  std::unordered_map<uint32_t, uint32_t> defining_function;
+  std::vector<GlobalInst> global_insts;
+  std::vector<std::pair<std::string, uint32_t>> exports;
+};
+
+// Returns true if |inst| is an OpDecorate of the LinkageAttributes decoration
+// with the given |linkage_type|.
+bool IsLinkageDecoration(const spv_parsed_instruction_t* inst,
+                         SpvLinkageType linkage_type) {
+  return inst->opcode == SpvOpDecorate && inst->num_operands == 4u &&
+         inst->words[inst->operands[1].offset] ==
+             SpvDecorationLinkageAttributes &&
+         inst->words[inst->operands[3].offset] ==
+             static_cast<uint32_t>(linkage_type);
+}
+
+// Returns the symbol name of the linkage decoration |inst|.
+std::string GetLinkageName(const spv_parsed_instruction_t* inst) {
+  return reinterpret_cast<const char*>(inst->words + inst->operands[2].offset);
+}
+
+spv_result_t AddIndexInstruction(void* user_data,
+                                 const spv_parsed_instruction_t* inst) {
+  IndexBuilder* builder = reinterpret_cast<IndexBuilder*>(user_data);
+  const uint32_t offset = builder->offset;
+  builder->offset += inst->num_words;
+
+  if (inst->opcode == SpvOpFunction) {
+    if (builder->function_section_begin == 0u)
+      builder->function_section_begin = offset;
+    builder->function_index[inst->result_id] =
+        static_cast<uint32_t>(builder->functions.size());
+    builder->functions.emplace_back();
+    builder->functions.back().begin = offset;
+    builder->referenced_ids.emplace_back();
+    builder->in_function = true;
+  }
+
+  if (builder->in_function) {
+    const uint32_t function =
+        static_cast<uint32_t>(builder->functions.size()) - 1u;
+    if (inst->result_id != 0u)
+      builder->defining_function[inst->result_id] = function;
+    for (uint16_t i = 0u; i < inst->num_operands; ++i) {
+      const spv_parsed_operand_t& operand = inst->operands[i];
+      if (spvIsIdType(operand.type) &&
+          operand.type != SPV_OPERAND_TYPE_RESULT_ID)
+        builder->referenced_ids[function].push_back(
+            inst->words[operand.offset]);
+    }
+    if (inst->opcode == SpvOpFunctionEnd) {
+      builder->functions[function].end = offset + inst->num_words;
+      builder->in_function = false;
+    }
+    return SPV_SUCCESS;
+  }
+
+  if (builder->function_section_begin != 0u) {
+    builder->misplaced_global = true;
+    return SPV_SUCCESS;
+  }
+
+  IndexBuilder::GlobalInst global_inst = {offset, false, {}};
+  switch (inst->opcode) {
+    case SpvOpName:
+    case SpvOpMemberName:
+    case SpvOpDecorate:
+    case SpvOpMemberDecorate:
+    case SpvOpDecorateId:
+    case SpvOpDecorateStringGOOGLE:
+    case SpvOpMemberDecorateStringGOOGLE:
+      // Only the target matters: other id operands refer to global values.
+      global_inst.droppable = true;
+      global_inst.ids.push_back(inst->words[inst->operands[0].offset]);
+      if (IsLinkageDecoration(inst, SpvLinkageTypeExport))
+        builder->exports.emplace_back(GetLinkageName(inst),
+                                      global_inst.ids.back());
+      break;
+    default:
+      for (uint16_t i = 0u; i < inst->num_operands; ++i) {
+        const spv_parsed_operand_t& operand = inst->operands[i];
+        if (spvIsIdType(operand.type) &&
+            operand.type != SPV_OPERAND_TYPE_RESULT_ID)
+          global_inst.ids.push_back(inst->words[operand.offset]);
+      }
+      break;
+  }
+  if (!global_inst.ids.empty())
+    builder->global_insts.push_back(std::move(global_inst));
+  return SPV_SUCCESS;
+}
+
+// Collects the names imported through LinkageAttributes decorations into the
+// std::unordered_set<std::string> |user_data|.
+spv_result_t CollectImportedName(void* user_data,
+                                 const spv_parsed_instruction_t* inst) {
+  if (IsLinkageDecoration(inst, SpvLinkageTypeImport))
+    reinterpret_cast<std::unordered_set<std::string>*>(user_data)->insert(
+        GetLinkageName(inst));
+  return SPV_SUCCESS;
+}
+
+// Reads words from an index, keeping track of out-of-bounds reads.
+class IndexReader {
+ public:
+  IndexReader(const uint32_t* words, size_t num_words)
+      : words_(words), num_words_(num_words), pos_(0u), ok_(true) {}
+
+  uint32_t Read() {
+    if (pos_ >= num_words_) {
+      ok_ = false;
+      return 0u;
+    }
+    return words_[pos_++];
+  }
+
+  // Reads |num_words| words and returns a pointer to them, or nullptr if the
+  // index is too short.
+  const uint32_t* ReadSpan(uint32_t num_words) {
+    if (num_words > num_words_ - pos_) {
+      ok_ = false;
+      return nullptr;
+    }
+    const uint32_t* span = words_ + pos_;
+    pos_ += num_words;
+    return span;
+  }
+
+  bool ok() const { return ok_; }
+  bool done() const { return pos_ == num_words_; }
+
+ private:
+  const uint32_t* words_;
+  size_t num_words_;
+  size_t pos_;
+  bool ok_;
+};
+
+// Parses |index| into |parsed|. Returns false if the index is malformed or
+// does not match a library of |library_size| words.
+bool ParseLibraryIndex(const uint32_t* index, size_t index_size,
+                       size_t library_size, LibraryIndex* parsed) {
+  IndexReader reader(index, index_size);
+  if (reader.Read() != kLibraryIndexMagicNumber) return false;
+  if (reader.Read() != kLibraryIndexVersion) return false;
+  if (reader.Read() != library_size) return false;
+  parsed->function_section_begin = reader.Read();
+  if (parsed->function_section_begin < SPV_INDEX_INSTRUCTION ||
+      parsed->function_section_begin > library_size)
+    return false;
+
+  const uint32_t num_functions = reader.Read();
+  // Each function takes at least 5 words in the index.
+  if (!reader.ok() || num_functions > index_size / 5u) return false;
+  parsed->functions.resize(num_functions);
+  uint32_t previous_end = parsed->function_section_begin;
+  for (auto& function : parsed->functions) {
+    function.begin = reader.Read();
+    function.end = reader.Read();
+    function.flags = reader.Read();
+    if (function.begin != previous_end || function.end <= function.begin ||
+        function.end > library_size)
+      return false;
+    previous_end = function.end;
+
+    const uint32_t num_callees = reader.Read();
+    const uint32_t* callees = reader.ReadSpan(num_callees);
+    if (!callees) return false;
+    function.callees.assign(callees, callees + num_callees);
+    for (uint32_t callee : function.callees)
+      if (callee >= num_functions) return false;
+
+    const uint32_t num_global_refs = reader.Read();
+    const uint32_t* global_refs = reader.ReadSpan(num_global_refs);
+    if (!global_refs) return false;
+    function.global_refs.assign(global_refs, global_refs + num_global_refs);
+    for (uint32_t global_ref : function.global_refs)
+      if (global_ref >= parsed->function_section_begin) return false;
+  }
+  if (num_functions != 0u && previous_end != library_size) return false;
+
+  const uint32_t num_exports = reader.Read();
+  for (uint32_t i = 0u; reader.ok() && i < num_exports; ++i) {
+    const uint32_t function = reader.Read();
+    const uint32_t num_name_words = reader.Read();
+    const uint32_t* name_words = reader.ReadSpan(num_name_words);
+    if (!name_words || num_name_words == 0u || function >= num_functions)
+      return false;
+    const char* name = reinterpret_cast<const char*>(name_words);
+    const size_t max_length = num_name_words * sizeof(uint32_t);
+    const size_t length = std::find(name, name + max_length, '\0') - name;
+    if (length == max_length) return false;
+    parsed->exports.emplace(std::string(name, length), function);
+  }
+
+  return reader.ok() && reader.done();
+}
+
+}  // namespace
+
+spv_result_t CreateLibraryIndex(const Context& context,
+                                const uint32_t* library, size_t library_size,
+                                std::vector<uint32_t>* index) {
+  spv_position_t position = {};
+  const spv_context& c_context = context.CContext();
+  const MessageConsumer& consumer = c_context->consumer;
+
+  IndexBuilder builder;
+  spv_diagnostic diagnostic = nullptr;
+  const spv_result_t result =
+      spvBinaryParse(c_context, &builder, library, library_size, nullptr,
+                     AddIndexInstruction, &diagnostic);
+  if (result != SPV_SUCCESS) {
+    if (diagnostic) {
+      libspirv::DiagnosticStream(diagnostic->position, consumer, result)
+          << diagnostic->error;
+      spvDiagnosticDestroy(diagnostic);
+    }
+    return result;
+  }
+  if (builder.misplaced_global || builder.in_function)
+    return libspirv::DiagnosticStream(position, consumer,
+                                      SPV_ERROR_INVALID_LAYOUT)
+           << "Functions of the library must come after all global "
+              "instructions.";
+  if (builder.function_section_begin == 0u)
+    builder.function_section_begin = static_cast<uint32_t>(library_size);
+
+  // Attach the global instructions to the functions they target. Functions
+  // that are referenced from anywhere else in the global section (entry
+  // points, group decorations, ...) are always kept.
+  for (const auto& global_inst : builder.global_insts) {
+    for (uint32_t id : global_inst.ids) {
+      const auto defining = builder.defining_function.find(id);
+      if (defining == builder.defining_function.end()) continue;
+      LibraryFunction& function = builder.functions[defining->second];
+      if (global_inst.droppable)
+        function.global_refs.push_back(global_inst.offset);
+      else
+        function.flags |= kFunctionFlagKeep;
+    }
+  }
+
+  for (size_t i = 0u; i < builder.functions.size(); ++i) {
+    auto& callees = builder.functions[i].callees;
+    for (uint32_t id : builder.referenced_ids[i]) {
+      const auto callee = builder.function_index.find(id);
+      if (callee != builder.function_index.end())
+        callees.push_back(callee->second);
+    }
+    std::sort(callees.begin(), callees.end());
+    callees.erase(std::unique(callees.begin(), callees.end()), callees.end());
+  }
+
+  index->clear();
+  index->push_back(kLibraryIndexMagicNumber);
+  index->push_back(kLibraryIndexVersion);
+  index->push_back(static_cast<uint32_t>(library_size));
+  index->push_back(builder.function_section_begin);
+  index->push_back(static_cast<uint32_t>(builder.functions.size()));
+  for (const auto& function : builder.functions) {
+    index->push_back(function.begin);
+    index->push_back(function.end);
+    index->push_back(function.flags);
+    index->push_back(static_cast<uint32_t>(function.callees.size()));
+    index->insert(index->end(), function.callees.begin(),
+                  function.callees.end());
+    index->push_back(static_cast<uint32_t>(function.global_refs.size()));
+    index->insert(index->end(), function.global_refs.begin(),
+                  function.global_refs.end());
+  }
+
+  const size_t num_exports_pos = index->size();
+  index->push_back(0u);
+  for (const auto& name_and_id : builder.exports) {
+    const auto function = builder.function_index.find(name_and_id.second);
+    // Exported variables live in the global section, which is always kept.
+    if (function == builder.function_index.end()) continue;
+    const std::string& name = name_and_id.first;
+    const size_t num_name_words = name.size() / 4u + 1u;
+    std::vector<uint32_t> name_words(num_name_words, 0u);
+    std::memcpy(name_words.data(), name.data(), name.size());
+    index->push_back(function->second);
+    index->push_back(static_cast<uint32_t>(num_name_words));
+    index->insert(index->end(), name_words.begin(), name_words.end());
+    ++(*index)[num_exports_pos];
+  }
+
+  return SPV_SUCCESS;
+}
+
+spv_result_t LinkWithLibrary(
+    const Context& context, const std::vector<std::vector<uint32_t>>& binaries,
+    const uint32_t* library, size_t library_size, const uint32_t* index,
+    size_t index_size, std::vector<uint32_t>* linked_binary,
+    const LinkerOptions& options) {
+  spv_position_t position = {};
+  const spv_context& c_context = context.CContext();
+  const MessageConsumer& consumer = c_context->consumer;
+
+  LibraryIndex parsed_index;
+  if (library_size < SPV_INDEX_INSTRUCTION ||
+      !ParseLibraryIndex(index, index_size, library_size, &parsed_index))
+    return libspirv::DiagnosticStream(position, consumer,
+                                      SPV_ERROR_INVALID_BINARY)
+           << "The library index is malformed or does not match the library.";
+
+  // Find the names imported by the modules being linked.
+  std::unordered_set<std::string> imported_names;
+  for (const auto& binary : binaries) {
+    spv_diagnostic diagnostic = nullptr;
+    const spv_result_t result =
+        spvBinaryParse(c_context, &imported_names, binary.data(),
+                       binary.size(), nullptr, CollectImportedName,
+                       &diagnostic);
+    if (result != SPV_SUCCESS) {
+      if (diagnostic) {
+        libspirv::DiagnosticStream(diagnostic->position, consumer, result)
+            << diagnostic->error;
+        spvDiagnosticDestroy(diagnostic);
+      }
+      return result;
+    }
+  }
+
+  // Mark the functions reachable from the imported symbols and from the
+  // library's own roots.
+  const auto& functions = parsed_index.functions;
+  std::vector<bool> kept(functions.size(), false);
+  std::queue<uint32_t> worklist;
+  for (uint32_t i = 0u; i < functions.size(); ++i) {
+    if (functions[i].flags & kFunctionFlagKeep) {
+      kept[i] = true;
+      worklist.push(i);
+    }
+  }
+  for (const auto& name : imported_names) {
+    const auto exported = parsed_index.exports.find(name);
+    if (exported != parsed_index.exports.end() && !kept[exported->second]) {
+      kept[exported->second] = true;
+      worklist.push(exported->second);
+    }
+  }
+  while (!worklist.empty()) {
+    const uint32_t function = worklist.front();
+    worklist.pop();
+    for (uint32_t callee : functions[function].callees) {
+      if (!kept[callee]) {
+        kept[callee] = true;
+        worklist.push(callee);
+      }
+    }
+  }
+
+  // Copy the global section, minus the debug and annotation instructions
+  // targeting dropped functions, followed by the kept functions.
+  std::unordered_set<uint32_t> dropped_global_insts;
+  for (uint32_t i = 0u; i < functions.size(); ++i) {
+    if (!kept[i])
+      dropped_global_insts.insert(functions[i].global_refs.begin(),
+                                  functions[i].global_refs.end());
+  }
+  std::vector<uint32_t> trimmed_library(library,
+                                        library + SPV_INDEX_INSTRUCTION);
+  for (uint32_t offset = SPV_INDEX_INSTRUCTION;
+       offset < parsed_index.function_section_begin;) {
+    const uint32_t num_words = library[offset] >> 16u;
+    if (num_words == 0u ||
+        num_words > parsed_index.function_section_begin - offset)
+      return libspirv::DiagnosticStream(position, consumer,
+                                        SPV_ERROR_INVALID_BINARY)
+             << "Invalid instruction word count in the library at word "
+             << offset << ".";
+    if (!dropped_global_insts.count(offset))
+      trimmed_library.insert(trimmed_library.end(), library + offset,
+                             library + offset + num_words);
+    offset += num_words;
+  }
+  for (uint32_t i = 0u; i < functions.size(); ++i) {
+    if (kept[i])
+      trimmed_library.insert(trimmed_library.end(),
+                             library + functions[i].begin,
+                             library + functions[i].end);
+  }
+
+  std::vector<const uint32_t*> binary_ptrs;
+  std::vector<size_t> binary_sizes;
+  binary_ptrs.reserve(binaries.size() + 1u);
+  binary_sizes.reserve(binaries.size() + 1u);
+  for (const auto& binary : binaries) {
+    binary_ptrs.push_back(binary.data());
+    binary_sizes.push_back(binary.size());
+  }
+  binary_ptrs.push_back(trimmed_library.data());
+  binary_sizes.push_back(trimmed_library.size());
+
+  return Link(context, binary_ptrs.data(), binary_sizes.data(),
+              binary_ptrs.size(), linked_binary, options);
+}
+
+}  // namespace spvtools
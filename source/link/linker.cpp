@@ -34,6 +34,7 @@
 #include "opt/remove_duplicates_pass.h"
 #include "spirv-tools/libspirv.hpp"
 #include "spirv_target_env.h"
+#include "util/parallel.h"
 
 namespace spvtools {
 
@@ -65,14 +66,25 @@ struct LinkageEntry {
 };
 using LinkageTable = std::vector<LinkageEntry>;
 
+// A message emitted while loading one of the input modules, kept until it can
+// be handed to the consumer from the linking thread.
+struct BufferedMessage {
+  spv_message_level_t level;
+  std::string source;
+  spv_position_t position;
+  std::string message;
+};
+
 // Shifts the IDs used in each binary of |modules| so that they occupy a
 // disjoint range from the other binaries, and compute the new ID bound which
-// is returned in |max_id_bound|.
+// is returned in |max_id_bound|. The modules are rewritten using up to
+// |num_threads| threads.
 //
 // Both |modules| and |max_id_bound| should not be null, and |modules| should
 // not be empty either. Furthermore |modules| should not contain any null
 // pointers.
 static spv_result_t ShiftIdsInModules(const MessageConsumer& consumer,
+                                      uint32_t num_threads,
                                       std::vector<ir::Module*>* modules,
                                       uint32_t* max_id_bound);
 
@@ -90,7 +102,9 @@ static spv_result_t GenerateHeader(const MessageConsumer& consumer,
                                    ir::ModuleHeader* header);
 
 // Merge all the modules from |in_modules| into a single module owned by
-// |linked_context|.
+// |linked_context|. The instructions and functions of |in_modules| are moved
+// rather than copied, so the input modules are left empty or partially empty
+// and should not be used afterwards.
 //
 // |linked_context| should not be null.
 static spv_result_t MergeModules(const MessageConsumer& consumer,
@@ -176,7 +190,29 @@ spv_result_t Link(const Context& context, const uint32_t* const* binaries,
                                       SPV_ERROR_INVALID_BINARY)
            << "No modules were given.";
 
-  std::vector<std::unique_ptr<IRContext>> ir_contexts;
+  // Parse the input binaries. Modules are independent of each other, so they
+  // are loaded in parallel. The messages of each module are buffered and
+  // reported afterwards, in module order, so that the consumer is only ever
+  // called from this thread and the output does not depend on scheduling.
+  std::vector<std::unique_ptr<IRContext>> ir_contexts(num_binaries);
+  std::vector<std::vector<BufferedMessage>> messages(num_binaries);
+  spvutils::ParallelFor(
+      num_binaries, options.GetNumThreads(),
+      [&ir_contexts, &messages, binaries, binary_sizes,
+       &c_context](size_t i) {
+        if (binaries[i][4u] != 0u) return;
+        std::vector<BufferedMessage>* module_messages = &messages[i];
+        ir_contexts[i] = BuildModule(
+            c_context->target_env,
+            [module_messages](spv_message_level_t level, const char* source,
+                              const spv_position_t& position,
+                              const char* message) {
+              module_messages->push_back(
+                  {level, source ? source : "", position, message});
+            },
+            binaries[i], binary_sizes[i]);
+      });
+
   std::vector<Module*> modules;
   modules.reserve(num_binaries);
   for (size_t i = 0u; i < num_binaries; ++i) {
@@ -188,20 +224,23 @@ spv_result_t Link(const Context& context, const uint32_t* const* binaries,
              << "Schema is non-zero for module " << i << ".";
     }
 
-    std::unique_ptr<IRContext> ir_context = BuildModule(
-        c_context->target_env, consumer, binaries[i], binary_sizes[i]);
-    if (ir_context == nullptr)
+    if (consumer) {
+      for (const auto& m : messages[i])
+        consumer(m.level, m.source.c_str(), m.position, m.message.c_str());
+    }
+    if (ir_contexts[i] == nullptr)
       return libspirv::DiagnosticStream(position, consumer,
                                         SPV_ERROR_INVALID_BINARY)
-             << "Failed to build a module out of " << ir_contexts.size() << ".";
-    modules.push_back(ir_context->module());
-    ir_contexts.push_back(std::move(ir_context));
+             << "Failed to build a module out of " << i << ".";
+    ir_contexts[i]->SetMessageConsumer(consumer);
+    modules.push_back(ir_contexts[i]->module());
   }
 
   // Phase 1: Shift the IDs used in each binary so that they occupy a disjoint
   //          range from the other binaries, and compute the new ID bound.
   uint32_t max_id_bound = 0u;
-  spv_result_t res = ShiftIdsInModules(consumer, &modules, &max_id_bound);
+  spv_result_t res = ShiftIdsInModules(consumer, options.GetNumThreads(),
+                                       &modules, &max_id_bound);
   if (res != SPV_SUCCESS) return res;
 
   // Phase 2: Generate the header
@@ -265,6 +304,7 @@ spv_result_t Link(const Context& context, const uint32_t* const* binaries,
 }
 
 static spv_result_t ShiftIdsInModules(const MessageConsumer& consumer,
+                                      uint32_t num_threads,
                                       std::vector<ir::Module*>* modules,
                                       uint32_t* max_id_bound) {
   spv_position_t position = {};
@@ -282,22 +322,18 @@ static spv_result_t ShiftIdsInModules(const MessageConsumer& consumer,
                                       SPV_ERROR_INVALID_DATA)
            << "|max_id_bound| of ShiftIdsInModules should not be null.";
 
+  // Compute the offset of each module first; the rewriting of the modules can
+  // then proceed independently.
+  std::vector<uint32_t> offsets(modules->size(), 0u);
   uint32_t id_bound = modules->front()->IdBound() - 1u;
-  for (auto module_iter = modules->begin() + 1; module_iter != modules->end();
-       ++module_iter) {
-    Module* module = *module_iter;
-    module->ForEachInst([&id_bound](Instruction* insn) {
-      insn->ForEachId([&id_bound](uint32_t* id) { *id += id_bound; });
-    });
-    id_bound += module->IdBound() - 1u;
+  for (size_t i = 1u; i < modules->size(); ++i) {
+    offsets[i] = id_bound;
+    id_bound += (*modules)[i]->IdBound() - 1u;
     if (id_bound > 0x3FFFFF)
       return libspirv::DiagnosticStream(position, consumer,
                                         SPV_ERROR_INVALID_ID)
              << "The limit of IDs, 4194303, was exceeded:"
              << " " << id_bound << " is the current ID bound.";
-
-    // Invalidate the DefUseManager
-    module->context()->InvalidateAnalyses(ir::IRContext::kAnalysisDefUse);
   }
   ++id_bound;
   if (id_bound > 0x3FFFFF)
@@ -305,6 +341,18 @@ static spv_result_t ShiftIdsInModules(const MessageConsumer& consumer,
            << "The limit of IDs, 4194303, was exceeded:"
            << " " << id_bound << " is the current ID bound.";
 
+  spvutils::ParallelFor(
+      modules->size() - 1u, num_threads, [modules, &offsets](size_t i) {
+        Module* module = (*modules)[i + 1u];
+        const uint32_t offset = offsets[i + 1u];
+        module->ForEachInst([offset](Instruction* insn) {
+          insn->ForEachId([offset](uint32_t* id) { *id += offset; });
+        });
+
+        // Invalidate the DefUseManager
+        module->context()->InvalidateAnalyses(ir::IRContext::kAnalysisDefUse);
+      });
+
   *max_id_bound = id_bound;
 
   return SPV_SUCCESS;
@@ -338,6 +386,22 @@ static spv_result_t GenerateHeader(const MessageConsumer& consumer,
   return SPV_SUCCESS;
 }
 
+// Moves the instructions of |range| out of their module and appends them, in
+// order, to |linked_module| using |add|, making |linked_context| their
+// context.
+template <typename Range>
+static void MoveInstructions(
+    Range range, IRContext* linked_context, Module* linked_module,
+    void (Module::*add)(std::unique_ptr<Instruction>)) {
+  for (auto iter = range.begin(); iter != range.end();) {
+    Instruction* inst = &*iter;
+    ++iter;
+    inst->RemoveFromList();
+    inst->SetContext(linked_context);
+    (linked_module->*add)(std::unique_ptr<Instruction>(inst));
+  }
+}
+
 static spv_result_t MergeModules(const MessageConsumer& consumer,
                                  const std::vector<Module*>& input_modules,
                                  const libspirv::AssemblyGrammar& grammar,
@@ -352,20 +416,23 @@ static spv_result_t MergeModules(const MessageConsumer& consumer,
 
   if (input_modules.empty()) return SPV_SUCCESS;
 
+  // The instructions are about to be moved out of the input modules, so none
+  // of their analyses may keep referring to them.
   for (const auto& module : input_modules)
-    for (const auto& inst : module->capabilities())
-      linked_module->AddCapability(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    module->context()->InvalidateAnalysesExceptFor(
+        ir::IRContext::kAnalysisNone);
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->extensions())
-      linked_module->AddExtension(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->capabilities(), linked_context, linked_module,
+                     &Module::AddCapability);
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->ext_inst_imports())
-      linked_module->AddExtInstImport(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->extensions(), linked_context, linked_module,
+                     &Module::AddExtension);
+
+  for (const auto& module : input_modules)
+    MoveInstructions(module->ext_inst_imports(), linked_context, linked_module,
+                     &Module::AddExtInstImport);
 
   do {
     const Instruction* memory_model_inst = input_modules[0]->GetMemoryModel();
@@ -408,18 +475,14 @@ static spv_result_t MergeModules(const MessageConsumer& consumer,
           memory_model_inst->Clone(linked_context)));
   } while (false);
 
-  std::vector<std::pair<uint32_t, const char*>> entry_points;
+  // Names of the entry points seen so far, for each execution model.
+  std::unordered_map<uint32_t, std::unordered_set<std::string>> entry_points;
   for (const auto& module : input_modules)
     for (const auto& inst : module->entry_points()) {
       const uint32_t model = inst.GetSingleWordInOperand(0);
       const char* const name =
           reinterpret_cast<const char*>(inst.GetInOperand(2).words.data());
-      const auto i = std::find_if(
-          entry_points.begin(), entry_points.end(),
-          [model, name](const std::pair<uint32_t, const char*>& v) {
-            return v.first == model && strcmp(name, v.second) == 0;
-          });
-      if (i != entry_points.end()) {
+      if (!entry_points[model].insert(name).second) {
         spv_operand_desc desc = nullptr;
         grammar.lookupOperand(SPV_OPERAND_TYPE_EXECUTION_MODEL, model, &desc);
         return libspirv::DiagnosticStream(position, consumer,
@@ -427,30 +490,27 @@ static spv_result_t MergeModules(const MessageConsumer& consumer,
                << "The entry point \"" << name << "\", with execution model "
                << desc->name << ", was already defined.";
       }
-      linked_module->AddEntryPoint(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
-      entry_points.emplace_back(model, name);
     }
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->execution_modes())
-      linked_module->AddExecutionMode(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->entry_points(), linked_context, linked_module,
+                     &Module::AddEntryPoint);
+
+  for (const auto& module : input_modules)
+    MoveInstructions(module->execution_modes(), linked_context, linked_module,
+                     &Module::AddExecutionMode);
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->debugs1())
-      linked_module->AddDebug1Inst(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->debugs1(), linked_context, linked_module,
+                     &Module::AddDebug1Inst);
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->debugs2())
-      linked_module->AddDebug2Inst(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->debugs2(), linked_context, linked_module,
+                     &Module::AddDebug2Inst);
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->debugs3())
-      linked_module->AddDebug3Inst(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->debugs3(), linked_context, linked_module,
+                     &Module::AddDebug3Inst);
 
   // If the generated module uses SPIR-V 1.1 or higher, add an
   // OpModuleProcessed instruction about the linking step.
@@ -466,20 +526,18 @@ static spv_result_t MergeModules(const MessageConsumer& consumer,
   }
 
   for (const auto& module : input_modules)
-    for (const auto& inst : module->annotations())
-      linked_module->AddAnnotationInst(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    MoveInstructions(module->annotations(), linked_context, linked_module,
+                     &Module::AddAnnotationInst);
 
   // TODO(pierremoreau): Since the modules have not been validate, should we
   //                     expect SpvStorageClassFunction variables outside
   //                     functions?
   uint32_t num_global_values = 0u;
   for (const auto& module : input_modules) {
-    for (const auto& inst : module->types_values()) {
-      linked_module->AddType(
-          std::unique_ptr<Instruction>(inst.Clone(linked_context)));
+    for (const auto& inst : module->types_values())
       num_global_values += inst.opcode() == SpvOpVariable;
-    }
+    MoveInstructions(module->types_values(), linked_context, linked_module,
+                     &Module::AddType);
   }
   if (num_global_values > 0xFFFF)
     return libspirv::DiagnosticStream(position, consumer, SPV_ERROR_INTERNAL)
@@ -488,10 +546,12 @@ static spv_result_t MergeModules(const MessageConsumer& consumer,
 
   // Process functions and their basic blocks
   for (const auto& module : input_modules) {
-    for (const auto& func : *module) {
-      std::unique_ptr<ir::Function> cloned_func(func.Clone(linked_context));
-      cloned_func->SetParent(linked_module);
-      linked_module->AddFunction(std::move(cloned_func));
+    for (auto& func : module->ReleaseFunctions()) {
+      func->ForEachInst([linked_context](Instruction* inst) {
+        inst->SetContext(linked_context);
+      });
+      func->SetParent(linked_module);
+      linked_module->AddFunction(std::move(func));
     }
   }
 
@@ -513,6 +573,15 @@ static spv_result_t GetImportExportPairs(
   std::vector<LinkageSymbolInfo> imports;
   std::unordered_map<std::string, std::vector<LinkageSymbolInfo>> exports;
 
+  // Map from the result id of each function to the function, used to look up
+  // the parameters of function symbols.
+  std::unordered_map<SpvId, const ir::Function*> functions;
+  // range-based for loop calls begin()/end(), but never cbegin()/cend(),
+  // which will not work here.
+  for (auto func_iter = linked_context.module()->cbegin();
+       func_iter != linked_context.module()->cend(); ++func_iter)
+    functions.emplace(func_iter->result_id(), &*func_iter);
+
   // Figure out the imports and exports
   for (const auto& decoration : linked_context.annotations()) {
     if (decoration.opcode() != SpvOpDecorate ||
@@ -555,14 +624,12 @@ static spv_result_t GetImportExportPairs(
     } else if (def_inst->opcode() == SpvOpFunction) {
       symbol_info.type_id = def_inst->GetSingleWordInOperand(1u);
 
-      // range-based for loop calls begin()/end(), but never cbegin()/cend(),
-      // which will not work here.
-      for (auto func_iter = linked_context.module()->cbegin();
-           func_iter != linked_context.module()->cend(); ++func_iter) {
-        if (func_iter->result_id() != id) continue;
-        func_iter->ForEachParam([&symbol_info](const Instruction* inst) {
-          symbol_info.parameter_ids.push_back(inst->result_id());
-        });
+      const auto func_iter = functions.find(id);
+      if (func_iter != functions.end()) {
+        func_iter->second->ForEachParam(
+            [&symbol_info](const Instruction* inst) {
+              symbol_info.parameter_ids.push_back(inst->result_id());
+            });
       }
     } else {
       return libspirv::DiagnosticStream(position, consumer,
@@ -688,24 +755,27 @@ static spv_result_t RemoveLinkageSpecificInstructions(
     }
   }
 
+  std::unordered_set<SpvId> imported_ids;
+  imported_ids.reserve(linkings_to_do.size());
+  for (const auto& linking_entry : linkings_to_do)
+    imported_ids.insert(linking_entry.imported_symbol.id);
+
   // Remove prototypes of imported functions
-  for (const auto& linking_entry : linkings_to_do) {
-    for (auto func_iter = linked_context->module()->begin();
-         func_iter != linked_context->module()->end();) {
-      if (func_iter->result_id() == linking_entry.imported_symbol.id)
-        func_iter = func_iter.Erase();
-      else
-        ++func_iter;
-    }
+  for (auto func_iter = linked_context->module()->begin();
+       func_iter != linked_context->module()->end();) {
+    if (imported_ids.count(func_iter->result_id()))
+      func_iter = func_iter.Erase();
+    else
+      ++func_iter;
   }
 
   // Remove declarations of imported variables
-  for (const auto& linking_entry : linkings_to_do) {
+  {
     auto next = linked_context->types_values_begin();
     for (auto inst = next; inst != linked_context->types_values_end();
          inst = next) {
       ++next;
-      if (inst->result_id() == linking_entry.imported_symbol.id) {
+      if (imported_ids.count(inst->result_id())) {
         linked_context->KillInst(&*inst);
       }
     }
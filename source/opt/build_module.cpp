@@ -47,12 +47,14 @@ spv_result_t SetSpvInst(void* builder, const spv_parsed_instruction_t* inst) {
 std::unique_ptr<ir::IRContext> BuildModule(spv_target_env env,
                                            MessageConsumer consumer,
                                            const uint32_t* binary,
-                                           const size_t size) {
+                                           const size_t size,
+                                           bool lazy_function_bodies) {
   auto context = spvContextCreate(env);
   libspirv::SetContextMessageConsumer(context, consumer);
 
   auto irContext = MakeUnique<ir::IRContext>(env, consumer);
   ir::IrLoader loader(consumer, irContext->module());
+  loader.SetLazyFunctionBodies(lazy_function_bodies);
 
   spv_result_t status = spvBinaryParse(context, &loader, binary, size,
                                        SetSpvHeader, SetSpvInst, nullptr);
@@ -27,10 +27,14 @@ namespace spvtools {
 // Builds an ir::Module returns the owning ir::IRContext from the given SPIR-V
 // |binary|. |size| specifies number of words in |binary|. The |binary| will be
 // decoded according to the given target |env|. Returns nullptr if errors occur
-// and sends the errors to |consumer|.
+// and sends the errors to |consumer|. If |lazy_function_bodies| is true, the
+// function bodies are only loaded when first accessed (see
+// ir::Function::HasUnloadedBody()); errors in them are then reported at that
+// point rather than by this function.
 std::unique_ptr<ir::IRContext> BuildModule(spv_target_env env,
                                            MessageConsumer consumer,
-                                           const uint32_t* binary, size_t size);
+                                           const uint32_t* binary, size_t size,
+                                           bool lazy_function_bodies = false);
 
 // Builds an ir::Module and returns the owning ir::IRContext from the given
 // SPIR-V assembly |text|.  The |text| will be encoded according to the given
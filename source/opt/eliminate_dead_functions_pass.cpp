@@ -49,6 +49,15 @@ Pass::Status EliminateDeadFunctionsPass::Process(ir::IRContext* c) {
 }
 
 void EliminateDeadFunctionsPass::EliminateFunction(ir::Function* func) {
+  if (func->HasUnloadedBody()) {
+    // No analysis knows about the instructions of an unloaded body, so only
+    // the names and decorations of the ids it defines need to be removed.
+    func->ForEachUnloadedResultId(
+        [this](uint32_t id) { context()->KillNamesAndDecorates(id); });
+    context()->KillInst(&func->DefInst());
+    return;
+  }
+
   // Remove all of the instruction in the function body
   func->ForEachInst(
       [this](ir::Instruction* inst) { context()->KillInst(inst); }, true);
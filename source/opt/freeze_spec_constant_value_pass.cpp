@@ -20,7 +20,8 @@ namespace opt {
 
 Pass::Status FreezeSpecConstantValuePass::Process(ir::IRContext* irContext) {
   bool modified = false;
-  irContext->module()->ForEachInst(
+  // Spec constants and their decorations can only be global.
+  irContext->module()->ForEachGlobalInst(
       [&modified, irContext](ir::Instruction* inst) {
         switch (inst->opcode()) {
           case SpvOp::SpvOpSpecConstant:
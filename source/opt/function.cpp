@@ -14,15 +14,27 @@
 
 #include "function.h"
 
+#include <algorithm>
+#include <cassert>
 #include <ostream>
 #include <sstream>
 
+#include "ir_context.h"
+#include "ir_loader.h"
+#include "operand.h"
+
 namespace spvtools {
 namespace ir {
 
 Function* Function::Clone(IRContext* ctx) const {
   Function* clone =
       new Function(std::unique_ptr<Instruction>(DefInst().Clone(ctx)));
+  if (unloaded_body_) {
+    // The parsed instructions do not depend on the context.
+    clone->unloaded_body_.reset(new UnloadedBody(*unloaded_body_));
+    return clone;
+  }
+
   clone->params_.reserve(params_.size());
   ForEachParam(
       [clone, ctx](const Instruction* inst) {
@@ -43,6 +55,7 @@ Function* Function::Clone(IRContext* ctx) const {
 
 void Function::ForEachInst(const std::function<void(Instruction*)>& f,
                            bool run_on_debug_line_insts) {
+  EnsureBodyLoaded();
   if (def_inst_) def_inst_->ForEachInst(f, run_on_debug_line_insts);
   for (auto& param : params_) param->ForEachInst(f, run_on_debug_line_insts);
   for (auto& bb : blocks_) bb->ForEachInst(f, run_on_debug_line_insts);
@@ -51,6 +64,7 @@ void Function::ForEachInst(const std::function<void(Instruction*)>& f,
 
 void Function::ForEachInst(const std::function<void(const Instruction*)>& f,
                            bool run_on_debug_line_insts) const {
+  EnsureBodyLoaded();
   if (def_inst_)
     static_cast<const Instruction*>(def_inst_.get())
         ->ForEachInst(f, run_on_debug_line_insts);
@@ -70,11 +84,115 @@ void Function::ForEachInst(const std::function<void(const Instruction*)>& f,
 
 void Function::ForEachParam(const std::function<void(const Instruction*)>& f,
                             bool run_on_debug_line_insts) const {
+  EnsureBodyLoaded();
   for (const auto& param : params_)
     static_cast<const Instruction*>(param.get())
         ->ForEachInst(f, run_on_debug_line_insts);
 }
 
+void Function::AddUnloadedInst(const spv_parsed_instruction_t& inst) {
+  if (!unloaded_body_) unloaded_body_.reset(new UnloadedBody());
+  UnloadedBody& body = *unloaded_body_;
+  // The OpFunction instruction is loaded, and might change.
+  if (!body.insts.empty()) {
+    for (uint16_t i = 0; i < inst.num_operands; ++i) {
+      const spv_parsed_operand_t& operand = inst.operands[i];
+      if (spvIsIdType(operand.type)) {
+        body.max_id = std::max(body.max_id, inst.words[operand.offset]);
+      }
+    }
+  }
+  body.words.insert(body.words.end(), inst.words, inst.words + inst.num_words);
+  body.operands.insert(body.operands.end(), inst.operands,
+                       inst.operands + inst.num_operands);
+  body.insts.push_back(inst);
+  body.insts.back().words = nullptr;
+  body.insts.back().operands = nullptr;
+}
+
+bool Function::UnloadedBodyContains(SpvOp opcode) const {
+  if (!unloaded_body_) return false;
+  for (const auto& inst : unloaded_body_->insts)
+    if (inst.opcode == opcode) return true;
+  return false;
+}
+
+void Function::ForEachUnloadedResultId(
+    const std::function<void(uint32_t)>& f) const {
+  if (!unloaded_body_) return;
+  // Skip the OpFunction instruction, which is loaded.
+  for (size_t i = 1; i < unloaded_body_->insts.size(); ++i) {
+    const uint32_t id = unloaded_body_->insts[i].result_id;
+    if (id != 0) f(id);
+  }
+}
+
+uint32_t Function::GetMaxId() const {
+  uint32_t highest = 0;
+  const auto update_highest = [&highest](const Instruction* inst) {
+    for (const auto& operand : *inst) {
+      if (spvIsIdType(operand.type)) {
+        highest = std::max(highest, operand.words[0]);
+      }
+    }
+  };
+  if (unloaded_body_) {
+    static_cast<const Instruction*>(def_inst_.get())
+        ->ForEachInst(update_highest, true);
+    return std::max(highest, unloaded_body_->max_id);
+  }
+  ForEachInst(update_highest, true);
+  return highest;
+}
+
+void Function::LoadBody() {
+  std::unique_ptr<UnloadedBody> body = std::move(unloaded_body_);
+
+  // Replay the parsed instructions into a scratch module, then take over the
+  // body of the function it ends up with. The OpFunction instruction of this
+  // function is kept as is, since it might have been changed.
+  Module scratch;
+  scratch.SetContext(context());
+  IrLoader loader(context()->consumer(), &scratch);
+  const uint32_t* words = body->words.data();
+  const spv_parsed_operand_t* operands = body->operands.data();
+  for (auto inst : body->insts) {
+    inst.words = words;
+    inst.operands = operands;
+    words += inst.num_words;
+    operands += inst.num_operands;
+    // The IrLoader which read the body checked its structure.
+    const bool added = loader.AddInstruction(&inst);
+    assert(added && "Unloaded function body is malformed");
+    (void)added;
+  }
+  loader.EndModule();
+
+  std::vector<std::unique_ptr<Function>> loaded = scratch.ReleaseFunctions();
+  assert(loaded.size() == 1 && "Unloaded function body is malformed");
+  Function& function = *loaded.front();
+  params_ = std::move(function.params_);
+  blocks_ = std::move(function.blocks_);
+  end_inst_ = std::move(function.end_inst_);
+  for (auto& bb : blocks_) bb->SetParent(this);
+}
+
+void Function::ToBinary(std::vector<uint32_t>* binary, bool skip_nop) const {
+  auto write_inst = [binary, skip_nop](const Instruction* i) {
+    if (!(skip_nop && i->IsNop())) i->ToBinaryWithoutAttachedDebugInsts(binary);
+  };
+  if (unloaded_body_ && !(skip_nop && UnloadedBodyContains(SpvOpNop))) {
+    static_cast<const Instruction*>(def_inst_.get())
+        ->ForEachInst(write_inst, true);
+    const auto& words = unloaded_body_->words;
+    binary->insert(binary->end(),
+                   words.begin() + unloaded_body_->insts.front().num_words,
+                   words.end());
+    return;
+  }
+  ForEachInst(write_inst, true);
+}
+
 BasicBlock* Function::InsertBasicBlockAfter(
     std::unique_ptr<BasicBlock>&& new_block, BasicBlock* position) {
   for (auto bb_iter = begin(); bb_iter != end(); ++bb_iter) {
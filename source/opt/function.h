@@ -57,6 +57,31 @@ class Function {
   void SetParent(Module* module) { module_ = module; }
   // Gets the enclosing module for this function
   Module* GetParent() const { return module_; }
+  // Returns true if the body of this function (everything following the
+  // OpFunction instruction) is still held as the parsed instructions it was
+  // read from. Such a body is loaded into basic blocks the first time it is
+  // accessed; until then it is written back verbatim by ToBinary(). The
+  // structure of the body is checked by the IrLoader which read it, so loading
+  // it cannot fail.
+  bool HasUnloadedBody() const { return unloaded_body_ != nullptr; }
+
+  // Appends |inst| to the unloaded body of this function, starting one if
+  // needed. The data of |inst| is copied. The first appended instruction must
+  // be the OpFunction instruction this function was created from.
+  void AddUnloadedInst(const spv_parsed_instruction_t& inst);
+
+  // Returns true if this function has an unloaded body containing an
+  // instruction with |opcode|.
+  bool UnloadedBodyContains(SpvOp opcode) const;
+
+  // Runs the given function |f| on each id defined in the unloaded body of
+  // this function, if any.
+  void ForEachUnloadedResultId(const std::function<void(uint32_t)>& f) const;
+
+  // Returns the largest id mentioned in this function, or 0 if there is none.
+  // The body is not loaded.
+  uint32_t GetMaxId() const;
+
   // Appends a parameter to this function.
   inline void AddParameter(std::unique_ptr<Instruction> p);
   // Appends a basic block to this function.
@@ -70,8 +95,14 @@ class Function {
   inline void SetFunctionEnd(std::unique_ptr<Instruction> end_inst);
 
   // Returns the given function end instruction.
-  inline Instruction* EndInst() { return end_inst_.get(); }
-  inline const Instruction* EndInst() const { return end_inst_.get(); }
+  inline Instruction* EndInst() {
+    EnsureBodyLoaded();
+    return end_inst_.get();
+  }
+  inline const Instruction* EndInst() const {
+    EnsureBodyLoaded();
+    return end_inst_.get();
+  }
 
   // Returns function's id
   inline uint32_t result_id() const { return def_inst_->result_id(); }
@@ -80,16 +111,27 @@ class Function {
   inline uint32_t type_id() const { return def_inst_->type_id(); }
 
   // Returns the entry basic block for this function.
-  const std::unique_ptr<BasicBlock>& entry() const { return blocks_.front(); }
+  const std::unique_ptr<BasicBlock>& entry() const {
+    EnsureBodyLoaded();
+    return blocks_.front();
+  }
 
-  iterator begin() { return iterator(&blocks_, blocks_.begin()); }
-  iterator end() { return iterator(&blocks_, blocks_.end()); }
+  iterator begin() {
+    EnsureBodyLoaded();
+    return iterator(&blocks_, blocks_.begin());
+  }
+  iterator end() {
+    EnsureBodyLoaded();
+    return iterator(&blocks_, blocks_.end());
+  }
   const_iterator begin() const { return cbegin(); }
   const_iterator end() const { return cend(); }
   const_iterator cbegin() const {
+    EnsureBodyLoaded();
     return const_iterator(&blocks_, blocks_.cbegin());
   }
   const_iterator cend() const {
+    EnsureBodyLoaded();
     return const_iterator(&blocks_, blocks_.cend());
   }
 
@@ -112,6 +154,11 @@ class Function {
   void ForEachParam(const std::function<void(const Instruction*)>& f,
                     bool run_on_debug_line_insts = false) const;
 
+  // Pushes the binary segments for the instructions of this function into the
+  // back of *|binary|. If |skip_nop| is true, OpNop instructions are skipped.
+  // An unloaded body is copied without being loaded.
+  void ToBinary(std::vector<uint32_t>* binary, bool skip_nop) const;
+
   // Returns the context of the current function.
   IRContext* context() const { return def_inst_->context(); }
 
@@ -125,6 +172,26 @@ class Function {
   std::string PrettyPrint(uint32_t options = 0u) const;
 
  private:
+  // The parsed instructions of a function which have not been loaded yet.
+  struct UnloadedBody {
+    // The instructions, starting with OpFunction. Their |words| and
+    // |operands| pointers are left null: they are laid out one instruction
+    // after the other in |words| and |operands| below.
+    std::vector<spv_parsed_instruction_t> insts;
+    std::vector<uint32_t> words;
+    std::vector<spv_parsed_operand_t> operands;
+    // The largest id mentioned after the OpFunction instruction.
+    uint32_t max_id = 0;
+  };
+
+  // Loads the unloaded body of this function, if any.
+  void EnsureBodyLoaded() const {
+    if (unloaded_body_) const_cast<Function*>(this)->LoadBody();
+  }
+  // Creates the parameters, basic blocks and OpFunctionEnd of this function
+  // from its unloaded body.
+  void LoadBody();
+
   // The enclosing module.
   Module* module_;
   // The OpFunction instruction that begins the definition of this function.
@@ -135,15 +202,20 @@ class Function {
   std::vector<std::unique_ptr<BasicBlock>> blocks_;
   // The OpFunctionEnd instruction.
   std::unique_ptr<Instruction> end_inst_;
+  // The body of the function, if it has not been loaded yet.
+  std::unique_ptr<UnloadedBody> unloaded_body_;
 };
 
 // Pretty-prints |func| to |str|. Returns |str|.
 std::ostream& operator<<(std::ostream& str, const Function& func);
 
 inline Function::Function(std::unique_ptr<Instruction> def_inst)
-    : module_(nullptr), def_inst_(std::move(def_inst)), end_inst_() {}
+    : module_(nullptr),
+      def_inst_(std::move(def_inst)),
+      end_inst_() {}
 
 inline void Function::AddParameter(std::unique_ptr<Instruction> p) {
+  EnsureBodyLoaded();
   params_.emplace_back(std::move(p));
 }
 
@@ -153,16 +225,19 @@ inline void Function::AddBasicBlock(std::unique_ptr<BasicBlock> b) {
 
 inline void Function::AddBasicBlock(std::unique_ptr<BasicBlock> b,
                                     iterator ip) {
+  EnsureBodyLoaded();
   ip.InsertBefore(std::move(b));
 }
 
 template <typename T>
 inline void Function::AddBasicBlocks(T src_begin, T src_end, iterator ip) {
+  EnsureBodyLoaded();
   blocks_.insert(ip.Get(), std::make_move_iterator(src_begin),
                  std::make_move_iterator(src_end));
 }
 
 inline void Function::SetFunctionEnd(std::unique_ptr<Instruction> end_inst) {
+  EnsureBodyLoaded();
   end_inst_ = std::move(end_inst);
 }
 
@@ -58,12 +58,12 @@ Instruction::Instruction(IRContext* c, const spv_parsed_instruction_t& inst,
       dbg_line_insts_(std::move(dbg_line)) {
   assert((!IsDebugLineInst(opcode_) || dbg_line.empty()) &&
          "Op(No)Line attaching to Op(No)Line found");
+  operands_.reserve(inst.num_operands);
   for (uint32_t i = 0; i < inst.num_operands; ++i) {
     const auto& current_payload = inst.operands[i];
-    std::vector<uint32_t> words(
-        inst.words + current_payload.offset,
+    operands_.emplace_back(
+        current_payload.type, inst.words + current_payload.offset,
         inst.words + current_payload.offset + current_payload.num_words);
-    operands_.emplace_back(current_payload.type, std::move(words));
   }
 }
 
@@ -118,6 +118,12 @@ Instruction* Instruction::Clone(IRContext* c) const {
   return clone;
 }
 
+void Instruction::SetContext(IRContext* c) {
+  context_ = c;
+  unique_id_ = c->TakeNextUniqueId();
+  for (auto& dbg_line_inst : dbg_line_insts_) dbg_line_inst.SetContext(c);
+}
+
 uint32_t Instruction::GetSingleWordOperand(uint32_t index) const {
   const auto& words = GetOperand(index).words;
   assert(words.size() == 1 && "expected the operand only taking one word");
@@ -17,12 +17,14 @@
 
 #include <cassert>
 #include <functional>
+#include <iterator>
 #include <utility>
 #include <vector>
 
 #include "opcode.h"
 #include "operand.h"
 #include "util/ilist_node.h"
+#include "util/small_vector.h"
 
 #include "latest_version_spirv_header.h"
 #include "reflect.h"
@@ -64,17 +66,26 @@ class InstructionList;
 // "%inop1" and "%inop2" are in operands, while "%rtype" and "%rid" are out
 // operands.
 
+// The words of a logical operand. Nearly all operands are one or two words
+// long, and are then stored without any heap allocation.
+using OperandData = utils::SmallVector<uint32_t, 2>;
+
 // A *logical* operand to a SPIR-V instruction. It can be the type id, result
 // id, or other additional operands carried in an instruction.
 struct Operand {
-  Operand(spv_operand_type_t t, std::vector<uint32_t>&& w)
+  Operand(spv_operand_type_t t, OperandData&& w)
       : type(t), words(std::move(w)) {}
 
-  Operand(spv_operand_type_t t, const std::vector<uint32_t>& w)
-      : type(t), words(w) {}
+  Operand(spv_operand_type_t t, const OperandData& w) : type(t), words(w) {}
+
+  template <class ForwardIt>
+  Operand(spv_operand_type_t t, ForwardIt first_word, ForwardIt last_word)
+      : type(t) {
+    words.assign(first_word, last_word);
+  }
 
-  spv_operand_type_t type;      // Type of this logical operand.
-  std::vector<uint32_t> words;  // Binary segments of this logical operand.
+  spv_operand_type_t type;  // Type of this logical operand.
+  OperandData words;        // Binary segments of this logical operand.
 
   friend bool operator==(const Operand& o1, const Operand& o2) {
     return o1.type == o2.type && o1.words == o2.words;
@@ -144,6 +155,13 @@ class Instruction : public utils::IntrusiveNodeBase<Instruction> {
 
   IRContext* context() const { return context_; }
 
+  // Makes |c| the context of this instruction and of the line-related debug
+  // instructions attached to it, giving each of them a new unique id from |c|.
+  // This allows instructions to be moved from one context to another without
+  // cloning them. It is the caller's responsibility to unlink |this| from any
+  // list owned by the old context.
+  void SetContext(IRContext* c);
+
   SpvOp opcode() const { return opcode_; }
   // Sets the opcode of this instruction to a specific opcode. Note this may
   // invalidate the instruction.
@@ -197,11 +215,11 @@ class Instruction : public utils::IntrusiveNodeBase<Instruction> {
   // words.
   uint32_t GetSingleWordOperand(uint32_t index) const;
   // Sets the |index|-th in-operand's data to the given |data|.
-  inline void SetInOperand(uint32_t index, std::vector<uint32_t>&& data);
+  inline void SetInOperand(uint32_t index, OperandData&& data);
   // Sets the |index|-th operand's data to the given |data|.
   // This is for in-operands modification only, but with |index| expressed in
   // terms of operand index rather than in-operand index.
-  inline void SetOperand(uint32_t index, std::vector<uint32_t>&& data);
+  inline void SetOperand(uint32_t index, OperandData&& data);
   // Replace all of the in operands with those in |new_operands|.
   inline void SetInOperands(std::vector<Operand>&& new_operands);
   // Sets the result type id.
@@ -476,13 +494,11 @@ inline void Instruction::AddOperand(Operand&& operand) {
   operands_.push_back(std::move(operand));
 }
 
-inline void Instruction::SetInOperand(uint32_t index,
-                                      std::vector<uint32_t>&& data) {
+inline void Instruction::SetInOperand(uint32_t index, OperandData&& data) {
   SetOperand(index + TypeResultIdCount(), std::move(data));
 }
 
-inline void Instruction::SetOperand(uint32_t index,
-                                    std::vector<uint32_t>&& data) {
+inline void Instruction::SetOperand(uint32_t index, OperandData&& data) {
   assert(index < operands_.size() && "operand index out of bound");
   assert(index >= TypeResultIdCount() && "operand is not a in-operand");
   operands_[index].words = std::move(data);
@@ -492,7 +508,9 @@ inline void Instruction::SetInOperands(std::vector<Operand>&& new_operands) {
   // Remove the old in operands.
   operands_.erase(operands_.begin() + TypeResultIdCount(), operands_.end());
   // Add the new in operands.
-  operands_.insert(operands_.end(), new_operands.begin(), new_operands.end());
+  operands_.insert(operands_.end(),
+                   std::make_move_iterator(new_operands.begin()),
+                   std::make_move_iterator(new_operands.end()));
 }
 
 inline void Instruction::SetResultId(uint32_t res_id) {
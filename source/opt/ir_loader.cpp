@@ -24,16 +24,73 @@ IrLoader::IrLoader(const MessageConsumer& consumer, Module* m)
     : consumer_(consumer),
       module_(m),
       source_("<instruction>"),
-      inst_index_(0) {}
+      inst_index_(0),
+      lazy_function_bodies_(false),
+      in_unloaded_block_(false) {}
+
+bool IrLoader::CheckFunctionInst(SpvOp opcode, bool in_block) {
+  const char* src = source_.c_str();
+  spv_position_t loc = {inst_index_, 0, 0};
+  if (opcode == SpvOpFunction) {
+    Error(consumer_, src, loc, "function inside function");
+    return false;
+  }
+  if (opcode == SpvOpFunctionEnd) {
+    if (in_block) {
+      Error(consumer_, src, loc, "OpFunctionEnd inside basic block");
+      return false;
+    }
+  } else if (opcode == SpvOpLabel) {
+    if (in_block) {
+      Error(consumer_, src, loc, "OpLabel inside basic block");
+      return false;
+    }
+  } else if (IsTerminatorInst(opcode)) {
+    if (!in_block) {
+      Error(consumer_, src, loc, "terminator instruction outside basic block");
+      return false;
+    }
+  } else if (!in_block && opcode != SpvOpFunctionParameter) {
+    Errorf(consumer_, src, loc,
+           "Non-OpFunctionParameter (opcode: %d) found inside "
+           "function but outside basic block",
+           opcode);
+    return false;
+  }
+  return true;
+}
 
 bool IrLoader::AddInstruction(const spv_parsed_instruction_t* inst) {
   ++inst_index_;
   const auto opcode = static_cast<SpvOp>(inst->opcode);
+  if (function_ != nullptr && function_->HasUnloadedBody()) {
+    // The body is loaded later, but its structure is checked now, so that
+    // malformed bodies fail the build of the module and loading cannot fail.
+    if (!IsDebugLineInst(opcode)) {
+      if (!CheckFunctionInst(opcode, in_unloaded_block_)) return false;
+      if (opcode == SpvOpLabel) {
+        in_unloaded_block_ = true;
+      } else if (IsTerminatorInst(opcode)) {
+        in_unloaded_block_ = false;
+      }
+    }
+    function_->AddUnloadedInst(*inst);
+    if (opcode == SpvOpFunctionEnd) {
+      module_->AddFunction(std::move(function_));
+      function_ = nullptr;
+    }
+    return true;
+  }
+
   if (IsDebugLineInst(opcode)) {
     dbg_line_info_.push_back(Instruction(module()->context(), *inst));
     return true;
   }
 
+  if (function_ != nullptr && !CheckFunctionInst(opcode, block_ != nullptr)) {
+    return false;
+  }
+
   std::unique_ptr<Instruction> spv_inst(
       new Instruction(module()->context(), *inst, std::move(dbg_line_info_)));
   dbg_line_info_.clear();
@@ -44,21 +101,14 @@ bool IrLoader::AddInstruction(const spv_parsed_instruction_t* inst) {
   // Handle function and basic block boundaries first, then normal
   // instructions.
   if (opcode == SpvOpFunction) {
-    if (function_ != nullptr) {
-      Error(consumer_, src, loc, "function inside function");
-      return false;
-    }
     function_.reset(new Function(std::move(spv_inst)));
+    if (lazy_function_bodies_) function_->AddUnloadedInst(*inst);
   } else if (opcode == SpvOpFunctionEnd) {
     if (function_ == nullptr) {
       Error(consumer_, src, loc,
             "OpFunctionEnd without corresponding OpFunction");
       return false;
     }
-    if (block_ != nullptr) {
-      Error(consumer_, src, loc, "OpFunctionEnd inside basic block");
-      return false;
-    }
     function_->SetFunctionEnd(std::move(spv_inst));
     module_->AddFunction(std::move(function_));
     function_ = nullptr;
@@ -67,20 +117,12 @@ bool IrLoader::AddInstruction(const spv_parsed_instruction_t* inst) {
       Error(consumer_, src, loc, "OpLabel outside function");
       return false;
     }
-    if (block_ != nullptr) {
-      Error(consumer_, src, loc, "OpLabel inside basic block");
-      return false;
-    }
     block_.reset(new BasicBlock(std::move(spv_inst)));
   } else if (IsTerminatorInst(opcode)) {
     if (function_ == nullptr) {
       Error(consumer_, src, loc, "terminator instruction outside function");
       return false;
     }
-    if (block_ == nullptr) {
-      Error(consumer_, src, loc, "terminator instruction outside basic block");
-      return false;
-    }
     block_->AddInstruction(std::move(spv_inst));
     function_->AddBasicBlock(std::move(block_));
     block_ = nullptr;
@@ -118,13 +160,6 @@ bool IrLoader::AddInstruction(const spv_parsed_instruction_t* inst) {
       }
     } else {
       if (block_ == nullptr) {  // Inside function but outside blocks
-        if (opcode != SpvOpFunctionParameter) {
-          Errorf(consumer_, src, loc,
-                 "Non-OpFunctionParameter (opcode: %d) found inside "
-                 "function but outside basic block",
-                 opcode);
-          return false;
-        }
         function_->AddParameter(std::move(spv_inst));
       } else {
         block_->AddInstruction(std::move(spv_inst));
@@ -152,7 +187,9 @@ void IrLoader::EndModule() {
     function_ = nullptr;
   }
   for (auto& function : *module_) {
-    for (auto& bb : function) bb.SetParent(&function);
+    // Unloaded bodies set the parent of their blocks once loaded.
+    if (!function.HasUnloadedBody())
+      for (auto& bb : function) bb.SetParent(&function);
     function.SetParent(module_);
   }
 }
@@ -44,6 +44,12 @@ class IrLoader {
   // Sets the source name of the module.
   void SetSource(const std::string& src) { source_ = src; }
 
+  // Sets whether the bodies of functions are left unloaded. In that case only
+  // the OpFunction instructions are created up front, and the rest of each
+  // function is loaded the first time it is accessed. See
+  // Function::HasUnloadedBody().
+  void SetLazyFunctionBodies(bool lazy) { lazy_function_bodies_ = lazy; }
+
   Module* module() const { return module_; }
 
   // Sets the fields in the module's header to the given parameters.
@@ -62,6 +68,11 @@ class IrLoader {
   void EndModule();
 
  private:
+  // Returns true if an instruction with |opcode| can come next in function_,
+  // which is inside a basic block if |in_block| is true. Reports an error
+  // otherwise. Debug line instructions are not checked.
+  bool CheckFunctionInst(SpvOp opcode, bool in_block);
+
   // Consumer for communicating messages to outside.
   const MessageConsumer& consumer_;
   // The module to be built.
@@ -70,6 +81,10 @@ class IrLoader {
   std::string source_;
   // The last used instruction index.
   uint32_t inst_index_;
+  // Whether the bodies of functions are left unloaded.
+  bool lazy_function_bodies_;
+  // Whether the unloaded body of function_ is inside a basic block.
+  bool in_unloaded_block_;
   // The current Function under construction.
   std::unique_ptr<Function> function_;
   // The current BasicBlock under construction.
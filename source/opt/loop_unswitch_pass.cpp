@@ -286,9 +286,10 @@ class LoopUnswitch {
       // specific value.
       original_loop_constant_value = nullptr;
       for (uint32_t i = 2; i < iv_condition->NumInOperands(); i += 2) {
+        const ir::OperandData& words = iv_condition->GetInOperand(i).words;
         constant_branch.emplace_back(
             cst_mgr->GetDefiningInstruction(cst_mgr->GetConstant(
-                cond_type, iv_condition->GetInOperand(i).words)),
+                cond_type, std::vector<uint32_t>(words.begin(), words.end()))),
             nullptr);
       }
     }
@@ -427,7 +428,9 @@ class LoopUnswitch {
     } else {
       std::vector<std::pair<std::vector<uint32_t>, uint32_t>> targets;
       for (auto& t : constant_branch) {
-        targets.emplace_back(t.first->GetInOperand(0).words, t.second->id());
+        const ir::OperandData& words = t.first->GetInOperand(0).words;
+        targets.emplace_back(std::vector<uint32_t>(words.begin(), words.end()),
+                             t.second->id());
       }
 
       builder.AddSwitch(condition->result_id(), original_loop_target->id(),
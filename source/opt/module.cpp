@@ -70,8 +70,8 @@ void Module::AddGlobalValue(SpvOp opcode, uint32_t result_id,
   AddGlobalValue(std::move(newGlobal));
 }
 
-void Module::ForEachInst(const std::function<void(Instruction*)>& f,
-                         bool run_on_debug_line_insts) {
+void Module::ForEachGlobalInst(const std::function<void(Instruction*)>& f,
+                               bool run_on_debug_line_insts) {
 #define DELEGATE(list) list.ForEachInst(f, run_on_debug_line_insts)
   DELEGATE(capabilities_);
   DELEGATE(extensions_);
@@ -84,12 +84,12 @@ void Module::ForEachInst(const std::function<void(Instruction*)>& f,
   DELEGATE(debugs3_);
   DELEGATE(annotations_);
   DELEGATE(types_values_);
-  for (auto& i : functions_) i->ForEachInst(f, run_on_debug_line_insts);
 #undef DELEGATE
 }
 
-void Module::ForEachInst(const std::function<void(const Instruction*)>& f,
-                         bool run_on_debug_line_insts) const {
+void Module::ForEachGlobalInst(
+    const std::function<void(const Instruction*)>& f,
+    bool run_on_debug_line_insts) const {
 #define DELEGATE(i) i.ForEachInst(f, run_on_debug_line_insts)
   for (auto& i : capabilities_) DELEGATE(i);
   for (auto& i : extensions_) DELEGATE(i);
@@ -104,11 +104,22 @@ void Module::ForEachInst(const std::function<void(const Instruction*)>& f,
   for (auto& i : debugs3_) DELEGATE(i);
   for (auto& i : annotations_) DELEGATE(i);
   for (auto& i : types_values_) DELEGATE(i);
+#undef DELEGATE
+}
+
+void Module::ForEachInst(const std::function<void(Instruction*)>& f,
+                         bool run_on_debug_line_insts) {
+  ForEachGlobalInst(f, run_on_debug_line_insts);
+  for (auto& i : functions_) i->ForEachInst(f, run_on_debug_line_insts);
+}
+
+void Module::ForEachInst(const std::function<void(const Instruction*)>& f,
+                         bool run_on_debug_line_insts) const {
+  ForEachGlobalInst(f, run_on_debug_line_insts);
   for (auto& i : functions_) {
     static_cast<const Function*>(i.get())->ForEachInst(f,
                                                        run_on_debug_line_insts);
   }
-#undef DELEGATE
 }
 
 void Module::ToBinary(std::vector<uint32_t>* binary, bool skip_nop) const {
@@ -122,13 +133,14 @@ void Module::ToBinary(std::vector<uint32_t>* binary, bool skip_nop) const {
   auto write_inst = [binary, skip_nop](const Instruction* i) {
     if (!(skip_nop && i->IsNop())) i->ToBinaryWithoutAttachedDebugInsts(binary);
   };
-  ForEachInst(write_inst, true);
+  ForEachGlobalInst(write_inst, true);
+  for (auto& i : functions_) i->ToBinary(binary, skip_nop);
 }
 
 uint32_t Module::ComputeIdBound() const {
   uint32_t highest = 0;
 
-  ForEachInst(
+  ForEachGlobalInst(
       [&highest](const Instruction* inst) {
         for (const auto& operand : *inst) {
           if (spvIsIdType(operand.type)) {
@@ -137,6 +149,10 @@ uint32_t Module::ComputeIdBound() const {
         }
       },
       true /* scan debug line insts as well */);
+  // Unloaded function bodies are not loaded for this.
+  for (const auto& function : functions_) {
+    highest = std::max(highest, function->GetMaxId());
+  }
 
   return highest + 1;
 }
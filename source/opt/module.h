@@ -106,6 +106,9 @@ class Module {
   // Appends a function to this module.
   inline void AddFunction(std::unique_ptr<Function> f);
 
+  // Removes all functions from this module and returns them, in order.
+  inline std::vector<std::unique_ptr<Function>> ReleaseFunctions();
+
   // Returns a vector of pointers to type-declaration instructions in this
   // module.
   std::vector<Instruction*> GetTypes();
@@ -231,11 +234,21 @@ class Module {
   void ForEachInst(const std::function<void(const Instruction*)>& f,
                    bool run_on_debug_line_insts = false) const;
 
+  // Invokes function |f| on all instructions in this module outside of
+  // function definitions, and optionally on the debug line instructions that
+  // precede them. Function bodies are not loaded.
+  void ForEachGlobalInst(const std::function<void(Instruction*)>& f,
+                         bool run_on_debug_line_insts = false);
+  void ForEachGlobalInst(const std::function<void(const Instruction*)>& f,
+                         bool run_on_debug_line_insts = false) const;
+
   // Pushes the binary segments for this instruction into the back of *|binary|.
-  // If |skip_nop| is true and this is a OpNop, do nothing.
+  // If |skip_nop| is true and this is a OpNop, do nothing. Unloaded function
+  // bodies are copied verbatim.
   void ToBinary(std::vector<uint32_t>* binary, bool skip_nop) const;
 
-  // Returns 1 more than the maximum Id value mentioned in the module.
+  // Returns 1 more than the maximum Id value mentioned in the module. Function
+  // bodies are not loaded.
   uint32_t ComputeIdBound() const;
 
   // Returns true if module has capability |cap|
@@ -328,6 +341,12 @@ inline void Module::AddFunction(std::unique_ptr<Function> f) {
   functions_.emplace_back(std::move(f));
 }
 
+inline std::vector<std::unique_ptr<Function>> Module::ReleaseFunctions() {
+  std::vector<std::unique_ptr<Function>> functions;
+  functions.swap(functions_);
+  return functions;
+}
+
 inline Module::inst_iterator Module::capability_begin() {
   return capabilities_.begin();
 }
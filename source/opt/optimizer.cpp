@@ -67,6 +67,21 @@ Optimizer& Optimizer::RegisterPass(PassToken&& p) {
   return *this;
 }
 
+Optimizer& Optimizer::BeginFixedPointGroup(uint32_t max_iterations) {
+  impl_->pass_manager.BeginFixedPointGroup(max_iterations);
+  return *this;
+}
+
+Optimizer& Optimizer::BeginFixedPointGroup() {
+  impl_->pass_manager.BeginFixedPointGroup();
+  return *this;
+}
+
+Optimizer& Optimizer::EndFixedPointGroup() {
+  impl_->pass_manager.EndFixedPointGroup();
+  return *this;
+}
+
 // The legalization passes take a spir-v shader generated by an HLSL front-end
 // and turn it into a valid vulkan spir-v shader.  There are two ways in which
 // the code will be invalid at the start:
@@ -154,12 +169,14 @@ Optimizer& Optimizer::RegisterPerformancePasses() {
       .RegisterPass(CreateSimplificationPass())
       .RegisterPass(CreateIfConversionPass())
       .RegisterPass(CreateCopyPropagateArraysPass())
+      // Clean up until none of these passes finds anything left to do.
+      .BeginFixedPointGroup()
       .RegisterPass(CreateAggressiveDCEPass())
       .RegisterPass(CreateBlockMergePass())
       .RegisterPass(CreateRedundancyEliminationPass())
       .RegisterPass(CreateDeadBranchElimPass())
-      .RegisterPass(CreateBlockMergePass())
-      .RegisterPass(CreateInsertExtractElimPass());
+      .RegisterPass(CreateInsertExtractElimPass())
+      .EndFixedPointGroup();
   // Currently exposing driver bugs resulting in crashes (#946)
   // .RegisterPass(CreateCommonUniformElimPass())
 }
@@ -182,15 +199,17 @@ Optimizer& Optimizer::RegisterSizePasses() {
       .RegisterPass(CreateAggressiveDCEPass())
       .RegisterPass(CreateDeadBranchElimPass())
       .RegisterPass(CreateIfConversionPass())
+      // Clean up until none of these passes finds anything left to do.
+      .BeginFixedPointGroup()
       .RegisterPass(CreateAggressiveDCEPass())
       .RegisterPass(CreateBlockMergePass())
       .RegisterPass(CreateInsertExtractElimPass())
       .RegisterPass(CreateDeadInsertElimPass())
       .RegisterPass(CreateRedundancyEliminationPass())
       .RegisterPass(CreateCFGCleanupPass())
-      // Currently exposing driver bugs resulting in crashes (#946)
-      // .RegisterPass(CreateCommonUniformElimPass())
-      .RegisterPass(CreateAggressiveDCEPass());
+      .EndFixedPointGroup();
+  // Currently exposing driver bugs resulting in crashes (#946)
+  // .RegisterPass(CreateCommonUniformElimPass())
 }
 
 bool Optimizer::Run(const uint32_t* original_binary,
@@ -198,7 +217,8 @@ bool Optimizer::Run(const uint32_t* original_binary,
                     std::vector<uint32_t>* optimized_binary) const {
   std::unique_ptr<ir::IRContext> context =
       BuildModule(impl_->target_env, impl_->pass_manager.consumer(),
-                  original_binary, original_binary_size);
+                  original_binary, original_binary_size,
+                  /* lazy_function_bodies = */ true);
   if (context == nullptr) return false;
 
   auto status = impl_->pass_manager.Run(context.get());
@@ -223,6 +243,11 @@ Optimizer& Optimizer::SetTimeReport(std::ostream* out) {
   return *this;
 }
 
+Optimizer& Optimizer::SetChangeReport(std::ostream* out) {
+  impl_->pass_manager.SetChangeReport(out);
+  return *this;
+}
+
 Optimizer::PassToken CreateNullPass() {
   return MakeUnique<Optimizer::PassToken::Impl>(MakeUnique<opt::NullPass>());
 }
@@ -14,7 +14,10 @@
 
 #include "pass_manager.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <limits>
 #include <vector>
 
 #include "ir_context.h"
@@ -42,13 +45,59 @@ Pass::Status PassManager::Run(ir::IRContext* context) {
     }
   };
 
+  if (open_group_) EndFixedPointGroup();
+
+  // |version| is bumped every time a pass changes the module.
+  // |clean_version[i]| is the version on which the |i|th pass last ran
+  // without changing the module; running it again on that same version would
+  // be a no-op, so it is skipped.
+  const uint64_t kNeverClean = std::numeric_limits<uint64_t>::max();
+  uint64_t version = 0;
+  std::vector<uint64_t> clean_version(passes_.size(), kNeverClean);
+  std::vector<PassStats> pass_stats(passes_.size());
+
   SPIRV_TIMER_DESCRIPTION(time_report_stream_, /* measure_mem_usage = */ true);
-  for (const auto& pass : passes_) {
-    print_disassembly("; IR before pass ", pass.get());
+  auto run_pass = [&](uint32_t index) {
+    Pass* pass = passes_[index].get();
+    if (clean_version[index] == version) {
+      ++pass_stats[index].skips;
+      return Pass::Status::SuccessWithoutChange;
+    }
+    print_disassembly("; IR before pass ", pass);
     SPIRV_TIMER_SCOPED(time_report_stream_, (pass ? pass->name() : ""), true);
     const auto one_status = pass->Run(context);
+    ++pass_stats[index].runs;
+    if (one_status == Pass::Status::SuccessWithChange) {
+      ++pass_stats[index].changes;
+      ++version;
+      clean_version[index] = kNeverClean;
+    } else {
+      clean_version[index] = version;
+    }
+    return one_status;
+  };
+
+  size_t next_group = 0;
+  for (uint32_t i = 0; i < passes_.size();) {
+    if (next_group < groups_.size() && groups_[next_group].begin == i) {
+      const FixedPointGroup& group = groups_[next_group++];
+      for (uint32_t round = 0; round < group.max_iterations; ++round) {
+        const uint64_t round_start_version = version;
+        for (uint32_t j = group.begin; j < group.end; ++j) {
+          const auto one_status = run_pass(j);
+          if (one_status == Pass::Status::Failure) return one_status;
+          if (one_status == Pass::Status::SuccessWithChange)
+            status = one_status;
+        }
+        if (version == round_start_version) break;
+      }
+      i = group.end;
+      continue;
+    }
+    const auto one_status = run_pass(i);
     if (one_status == Pass::Status::Failure) return one_status;
     if (one_status == Pass::Status::SuccessWithChange) status = one_status;
+    ++i;
   }
   print_disassembly("; IR after last pass", nullptr);
 
@@ -59,9 +108,53 @@ Pass::Status PassManager::Run(ir::IRContext* context) {
   if (status == Pass::Status::SuccessWithChange) {
     context->module()->SetIdBound(context->module()->ComputeIdBound());
   }
+  if (change_report_stream_) {
+    // Aggregates the counters of all passes sharing a name, in the order in
+    // which the names first appear in the pipeline.
+    std::vector<std::pair<const char*, PassStats>> stats;
+    for (size_t i = 0; i < passes_.size(); ++i) {
+      const char* name = passes_[i]->name();
+      auto it = std::find_if(
+          stats.begin(), stats.end(),
+          [name](const std::pair<const char*, PassStats>& entry) {
+            return 0 == strcmp(entry.first, name);
+          });
+      if (it == stats.end()) {
+        it = stats.emplace(stats.end(), name, PassStats());
+      }
+      it->second.runs += pass_stats[i].runs;
+      it->second.changes += pass_stats[i].changes;
+      it->second.skips += pass_stats[i].skips;
+    }
+    PrintChangeReport(stats);
+  }
+
   passes_.clear();
+  groups_.clear();
   return status;
 }
 
+void PassManager::PrintChangeReport(
+    const std::vector<std::pair<const char*, PassStats>>& stats) const {
+  std::ostream& out = *change_report_stream_;
+  uint32_t total_runs = 0;
+  uint32_t total_changes = 0;
+  uint32_t total_skips = 0;
+  out << "Pass: runs, changed, skipped, change rate\n";
+  for (const auto& name_and_stats : stats) {
+    const PassStats& s = name_and_stats.second;
+    out << name_and_stats.first << ": " << s.runs << ", " << s.changes << ", "
+        << s.skips << ", "
+        << (s.runs ? 100.0 * s.changes / s.runs : 0.0) << "%\n";
+    total_runs += s.runs;
+    total_changes += s.changes;
+    total_skips += s.skips;
+  }
+  out << "Total: " << total_runs << ", " << total_changes << ", "
+      << total_skips << ", "
+      << (total_runs ? 100.0 * total_changes / total_runs : 0.0) << "%"
+      << std::endl;
+}
+
 }  // namespace opt
 }  // namespace spvtools
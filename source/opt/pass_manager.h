@@ -17,6 +17,7 @@
 
 #include <memory>
 #include <ostream>
+#include <utility>
 #include <vector>
 
 #include "log.h"
@@ -32,8 +33,17 @@ namespace opt {
 // The pass manager, responsible for tracking and running passes.
 // Clients should first call AddPass() to add passes and then call Run()
 // to run on a module. Passes are executed in the exact order of addition.
+//
+// Consecutive passes can be grouped with BeginFixedPointGroup() and
+// EndFixedPointGroup(). The passes of a group are run repeatedly, in order,
+// until none of them changes the module. The manager tracks which version of
+// the module each pass last saw, and skips any pass that already ran on the
+// current version without changing it.
 class PassManager {
  public:
+  // The default limit on the number of rounds of a fixed-point group.
+  static const uint32_t kDefaultMaxIterations = 8;
+
   // Constructs a pass manager.
   //
   // The constructed instance will have an empty message consumer, which just
@@ -42,7 +52,9 @@ class PassManager {
   PassManager()
       : consumer_(nullptr),
         print_all_stream_(nullptr),
-        time_report_stream_(nullptr) {}
+        time_report_stream_(nullptr),
+        change_report_stream_(nullptr),
+        open_group_(false) {}
 
   // Sets the message consumer to the given |consumer|.
   void SetMessageConsumer(MessageConsumer c) { consumer_ = std::move(c); }
@@ -55,6 +67,15 @@ class PassManager {
   template <typename T, typename... Args>
   void AddPass(Args&&... args);
 
+  // Starts a fixed-point group. All passes added until the matching call to
+  // EndFixedPointGroup() are run repeatedly until none of them changes the
+  // module, or until |max_iterations| rounds have been run. Groups cannot be
+  // nested.
+  void BeginFixedPointGroup(uint32_t max_iterations = kDefaultMaxIterations);
+  // Closes the group opened by the last call to BeginFixedPointGroup().
+  // Reports an error and does nothing if no group is open.
+  void EndFixedPointGroup();
+
   // Returns the number of passes added.
   uint32_t NumPasses() const;
   // Returns a pointer to the |index|th pass added.
@@ -69,7 +90,8 @@ class PassManager {
   // corresponding Status::Success if processing is succesful to indicate
   // whether changes are made to the module.
   //
-  // After running all the passes, they are removed from the list.
+  // After running all the passes, they (and any groups) are removed from the
+  // list.
   Pass::Status Run(ir::IRContext* context);
 
   // Sets the option to print the disassembly before each pass and after the
@@ -88,7 +110,35 @@ class PassManager {
     return *this;
   }
 
+  // Sets the option to print, for each pass name, how many times the pass was
+  // run, how many of those runs changed the module, and how many runs were
+  // skipped because the module had not changed since the pass last saw it.
+  // Output is written to |out| if that is not null. No output is generated if
+  // |out| is null.
+  PassManager& SetChangeReport(std::ostream* out) {
+    change_report_stream_ = out;
+    return *this;
+  }
+
  private:
+  // A range [begin, end) of passes that is run until it reaches a fixed point.
+  struct FixedPointGroup {
+    uint32_t begin;
+    uint32_t end;
+    uint32_t max_iterations;
+  };
+
+  // Per pass-name counters for the change report.
+  struct PassStats {
+    uint32_t runs = 0;
+    uint32_t changes = 0;
+    uint32_t skips = 0;
+  };
+
+  // Prints |stats| to |change_report_stream_|, if set.
+  void PrintChangeReport(
+      const std::vector<std::pair<const char*, PassStats>>& stats) const;
+
   // Consumer for messages.
   MessageConsumer consumer_;
   // A vector of passes. Order matters.
@@ -99,6 +149,13 @@ class PassManager {
   // The output stream to write the resource utilization of each pass. If this
   // is null, no output is generated.
   std::ostream* time_report_stream_;
+  // The output stream to write the per-pass change statistics to. If this is
+  // null, no output is generated.
+  std::ostream* change_report_stream_;
+  // The fixed-point groups, sorted by their first pass and non-overlapping.
+  std::vector<FixedPointGroup> groups_;
+  // True between BeginFixedPointGroup() and EndFixedPointGroup().
+  bool open_group_;
 };
 
 inline void PassManager::AddPass(std::unique_ptr<Pass> pass) {
@@ -111,6 +168,23 @@ inline void PassManager::AddPass(Args&&... args) {
   passes_.back()->SetMessageConsumer(consumer_);
 }
 
+inline void PassManager::BeginFixedPointGroup(uint32_t max_iterations) {
+  SPIRV_ASSERT(consumer_, !open_group_, "fixed-point groups cannot be nested");
+  open_group_ = true;
+  const uint32_t first = NumPasses();
+  groups_.push_back({first, first, max_iterations});
+}
+
+inline void PassManager::EndFixedPointGroup() {
+  if (!open_group_) {
+    Error(consumer_, __FILE__, {__LINE__, 0, 0},
+          "no fixed-point group to end");
+    return;
+  }
+  open_group_ = false;
+  groups_.back().end = NumPasses();
+}
+
 inline uint32_t PassManager::NumPasses() const {
   return static_cast<uint32_t>(passes_.size());
 }
@@ -24,10 +24,20 @@ Pass::Status StripDebugInfoPass::Process(ir::IRContext* irContext) {
                   !irContext->debugs3().empty();
   irContext->debug_clear();
 
-  irContext->module()->ForEachInst([&modified](ir::Instruction* inst) {
+  auto strip_line_insts = [&modified](ir::Instruction* inst) {
     modified |= !inst->dbg_line_insts().empty();
     inst->dbg_line_insts().clear();
-  });
+  };
+  irContext->module()->ForEachGlobalInst(strip_line_insts);
+  for (auto& func : *irContext->module()) {
+    // Leave unloaded bodies without line instructions alone.
+    if (func.HasUnloadedBody() && !func.UnloadedBodyContains(SpvOpLine) &&
+        !func.UnloadedBodyContains(SpvOpNoLine)) {
+      strip_line_insts(&func.DefInst());
+      continue;
+    }
+    func.ForEachInst(strip_line_insts);
+  }
 
   return modified ? Status::SuccessWithChange : Status::SuccessWithoutChange;
 }
@@ -17,8 +17,10 @@
 #include <cassert>
 
 #include <algorithm>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "binary.h"
@@ -48,7 +50,8 @@ namespace {
 // instruction.
 class StatsAggregator {
  public:
-  StatsAggregator(SpirvStats* in_out_stats, const spv_const_context context) {
+  StatsAggregator(SpirvStats* in_out_stats, const spv_const_context context)
+      : id_descriptors_(nullptr, /* count_collisions = */ true) {
     stats_ = in_out_stats;
     vstate_.reset(new ValidationState_t(context, &validator_options_));
   }
@@ -90,7 +93,9 @@ class StatsAggregator {
     const uint32_t new_descriptor =
         id_descriptors_.ProcessInstruction(inst.c_inst());
 
-    if (new_descriptor) {
+    // Only the first instruction with a descriptor labels it, so labels are
+    // only made for new descriptors.
+    if (new_descriptor && !stats_->id_descriptor_labels.count(new_descriptor)) {
       std::stringstream ss;
       ss << spvOpcodeString(inst.opcode());
       for (size_t i = 1; i < inst.words().size(); ++i) {
@@ -115,6 +120,11 @@ class StatsAggregator {
     }
   }
 
+  // Returns the number of id descriptor collisions in the module so far.
+  uint32_t num_id_descriptor_collisions() const {
+    return id_descriptors_.num_collisions();
+  }
+
   // Collects statistics of enum words for operands of specific types.
   void ProcessEnums() {
     const Instruction& inst = GetCurrentInstruction();
@@ -292,6 +302,198 @@ spv_result_t ProcessInstruction(void* user_data,
   return stats_aggregator->ProcessInstruction(inst);
 }
 
+// Identifies serialized stats, and changes whenever their layout does.
+const uint32_t kSerializedStatsMagic = 0x32545353;  // "SST2"
+
+// Adds the count |from| to |to|.
+void MergeHist(uint32_t from, uint32_t* to) { *to += from; }
+
+// Adds the counts of histogram |from| to histogram |to|. Histograms of
+// histograms are merged recursively.
+template <class Hist>
+void MergeHist(const Hist& from, Hist* to) {
+  for (const auto& pair : from) {
+    MergeHist(pair.second, &(*to)[pair.first]);
+  }
+}
+
+// Writes keys and histograms of SpirvStats as words. A histogram is the
+// number of its entries, followed by a key and a value for every entry.
+void Write(uint32_t value, std::vector<uint32_t>* words) {
+  words->push_back(value);
+}
+
+void Write(int32_t value, std::vector<uint32_t>* words) {
+  words->push_back(static_cast<uint32_t>(value));
+}
+
+void Write(uint16_t value, std::vector<uint32_t>* words) {
+  words->push_back(value);
+}
+
+void Write(int16_t value, std::vector<uint32_t>* words) {
+  words->push_back(static_cast<uint16_t>(value));
+}
+
+void Write(uint64_t value, std::vector<uint32_t>* words) {
+  words->push_back(static_cast<uint32_t>(value));
+  words->push_back(static_cast<uint32_t>(value >> 32));
+}
+
+void Write(int64_t value, std::vector<uint32_t>* words) {
+  Write(static_cast<uint64_t>(value), words);
+}
+
+void Write(float value, std::vector<uint32_t>* words) {
+  uint32_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  Write(bits, words);
+}
+
+void Write(double value, std::vector<uint32_t>* words) {
+  uint64_t bits = 0;
+  memcpy(&bits, &value, sizeof(bits));
+  Write(bits, words);
+}
+
+void Write(const std::string& value, std::vector<uint32_t>* words) {
+  words->push_back(static_cast<uint32_t>(value.size()));
+  const size_t first_word = words->size();
+  words->resize(first_word + (value.size() + 3) / 4, 0);
+  if (!value.empty()) memcpy(&(*words)[first_word], value.data(), value.size());
+}
+
+void Write(const std::pair<uint32_t, uint32_t>& value,
+           std::vector<uint32_t>* words) {
+  words->push_back(value.first);
+  words->push_back(value.second);
+}
+
+template <class Hist>
+void Write(const Hist& hist, std::vector<uint32_t>* words) {
+  words->push_back(static_cast<uint32_t>(hist.size()));
+  for (const auto& pair : hist) {
+    Write(pair.first, words);
+    Write(pair.second, words);
+  }
+}
+
+// Reads words written by Write(), and checks that they don't run out.
+class StatsReader {
+ public:
+  StatsReader(const uint32_t* words, size_t num_words)
+      : words_(words), end_(words + num_words) {}
+
+  bool Read(uint32_t* value) {
+    if (words_ == end_) return false;
+    *value = *words_++;
+    return true;
+  }
+
+  bool Read(int32_t* value) {
+    uint32_t word = 0;
+    if (!Read(&word)) return false;
+    *value = static_cast<int32_t>(word);
+    return true;
+  }
+
+  bool Read(uint16_t* value) {
+    uint32_t word = 0;
+    if (!Read(&word) || word > 0xFFFF) return false;
+    *value = static_cast<uint16_t>(word);
+    return true;
+  }
+
+  bool Read(int16_t* value) {
+    uint16_t bits = 0;
+    if (!Read(&bits)) return false;
+    *value = static_cast<int16_t>(bits);
+    return true;
+  }
+
+  bool Read(uint64_t* value) {
+    uint32_t low = 0;
+    uint32_t high = 0;
+    if (!Read(&low) || !Read(&high)) return false;
+    *value = low | (uint64_t(high) << 32);
+    return true;
+  }
+
+  bool Read(int64_t* value) {
+    uint64_t bits = 0;
+    if (!Read(&bits)) return false;
+    *value = static_cast<int64_t>(bits);
+    return true;
+  }
+
+  bool Read(float* value) {
+    uint32_t bits = 0;
+    if (!Read(&bits)) return false;
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  bool Read(double* value) {
+    uint64_t bits = 0;
+    if (!Read(&bits)) return false;
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+
+  bool Read(std::string* value) {
+    uint32_t size = 0;
+    if (!Read(&size)) return false;
+    const size_t num_words = (size_t(size) + 3) / 4;
+    if (static_cast<size_t>(end_ - words_) < num_words) return false;
+    value->assign(reinterpret_cast<const char*>(words_), size);
+    words_ += num_words;
+    return true;
+  }
+
+  bool Read(std::pair<uint32_t, uint32_t>* value) {
+    return Read(&value->first) && Read(&value->second);
+  }
+
+  // Reads a count and adds it to |count|.
+  bool ReadInto(uint32_t* count) {
+    uint32_t value = 0;
+    if (!Read(&value)) return false;
+    *count += value;
+    return true;
+  }
+
+  // Reads a histogram and adds its counts to |hist|.
+  template <class Hist>
+  bool ReadInto(Hist* hist) {
+    uint32_t num_entries = 0;
+    if (!Read(&num_entries)) return false;
+    for (uint32_t i = 0; i < num_entries; ++i) {
+      typename Hist::key_type key;
+      if (!Read(&key) || !ReadInto(&(*hist)[key])) return false;
+    }
+    return true;
+  }
+
+  // Reads labels, and adds those of descriptors without a label to |labels|.
+  bool ReadInto(std::unordered_map<uint32_t, std::string>* labels) {
+    uint32_t num_entries = 0;
+    if (!Read(&num_entries)) return false;
+    for (uint32_t i = 0; i < num_entries; ++i) {
+      uint32_t descriptor = 0;
+      std::string label;
+      if (!Read(&descriptor) || !Read(&label)) return false;
+      labels->emplace(descriptor, std::move(label));
+    }
+    return true;
+  }
+
+  bool AtEnd() const { return words_ == end_; }
+
+ private:
+  const uint32_t* words_;
+  const uint32_t* const end_;
+};
+
 }  // namespace
 
 namespace libspirv {
@@ -318,8 +520,123 @@ spv_result_t AggregateStats(const spv_context_t& context, const uint32_t* words,
 
   StatsAggregator stats_aggregator(stats, &context);
 
-  return spvBinaryParse(&context, &stats_aggregator, words, num_words,
-                        ProcessHeader, ProcessInstruction, pDiagnostic);
+  const spv_result_t result =
+      spvBinaryParse(&context, &stats_aggregator, words, num_words,
+                     ProcessHeader, ProcessInstruction, pDiagnostic);
+  stats->id_descriptor_collisions +=
+      stats_aggregator.num_id_descriptor_collisions();
+  return result;
+}
+
+void MergeStats(const SpirvStats& from, SpirvStats* to) {
+  MergeHist(from.version_hist, &to->version_hist);
+  MergeHist(from.generator_hist, &to->generator_hist);
+  MergeHist(from.capability_hist, &to->capability_hist);
+  MergeHist(from.extension_hist, &to->extension_hist);
+  MergeHist(from.opcode_hist, &to->opcode_hist);
+  MergeHist(from.opcode_and_num_operands_hist,
+            &to->opcode_and_num_operands_hist);
+  MergeHist(from.u16_constant_hist, &to->u16_constant_hist);
+  MergeHist(from.u32_constant_hist, &to->u32_constant_hist);
+  MergeHist(from.u64_constant_hist, &to->u64_constant_hist);
+  MergeHist(from.s16_constant_hist, &to->s16_constant_hist);
+  MergeHist(from.s32_constant_hist, &to->s32_constant_hist);
+  MergeHist(from.s64_constant_hist, &to->s64_constant_hist);
+  MergeHist(from.f32_constant_hist, &to->f32_constant_hist);
+  MergeHist(from.f64_constant_hist, &to->f64_constant_hist);
+  MergeHist(from.enum_hist, &to->enum_hist);
+  MergeHist(from.operand_slot_non_id_words_hist,
+            &to->operand_slot_non_id_words_hist);
+  MergeHist(from.id_descriptor_hist, &to->id_descriptor_hist);
+  to->id_descriptor_collisions += from.id_descriptor_collisions;
+  to->id_descriptor_labels.insert(from.id_descriptor_labels.begin(),
+                                  from.id_descriptor_labels.end());
+  MergeHist(from.operand_slot_id_descriptor_hist,
+            &to->operand_slot_id_descriptor_hist);
+  MergeHist(from.literal_strings_hist, &to->literal_strings_hist);
+  MergeHist(from.opcode_and_num_operands_markov_hist,
+            &to->opcode_and_num_operands_markov_hist);
+
+  if (to->opcode_markov_hist.size() < from.opcode_markov_hist.size())
+    to->opcode_markov_hist.resize(from.opcode_markov_hist.size());
+  for (size_t i = 0; i < from.opcode_markov_hist.size(); ++i) {
+    MergeHist(from.opcode_markov_hist[i], &to->opcode_markov_hist[i]);
+  }
+}
+
+void SerializeStats(const SpirvStats& stats, std::vector<uint32_t>* words) {
+  words->push_back(kSerializedStatsMagic);
+  Write(stats.version_hist, words);
+  Write(stats.generator_hist, words);
+  Write(stats.capability_hist, words);
+  Write(stats.extension_hist, words);
+  Write(stats.opcode_hist, words);
+  Write(stats.opcode_and_num_operands_hist, words);
+  Write(stats.u16_constant_hist, words);
+  Write(stats.u32_constant_hist, words);
+  Write(stats.u64_constant_hist, words);
+  Write(stats.s16_constant_hist, words);
+  Write(stats.s32_constant_hist, words);
+  Write(stats.s64_constant_hist, words);
+  Write(stats.f32_constant_hist, words);
+  Write(stats.f64_constant_hist, words);
+  Write(stats.enum_hist, words);
+  Write(stats.operand_slot_non_id_words_hist, words);
+  Write(stats.id_descriptor_hist, words);
+  Write(stats.id_descriptor_collisions, words);
+  Write(stats.id_descriptor_labels, words);
+  Write(stats.operand_slot_id_descriptor_hist, words);
+  Write(stats.literal_strings_hist, words);
+  Write(stats.opcode_and_num_operands_markov_hist, words);
+  words->push_back(static_cast<uint32_t>(stats.opcode_markov_hist.size()));
+  for (const auto& hist : stats.opcode_markov_hist) {
+    Write(hist, words);
+  }
+}
+
+bool AggregateSerializedStats(const uint32_t* words, size_t num_words,
+                              SpirvStats* stats) {
+  // Read into empty stats first, so that |stats| is left alone if |words| are
+  // invalid.
+  SpirvStats result;
+  StatsReader reader(words, num_words);
+  uint32_t magic = 0;
+  uint32_t num_markov_steps = 0;
+  if (!reader.Read(&magic) || magic != kSerializedStatsMagic ||
+      !reader.ReadInto(&result.version_hist) ||
+      !reader.ReadInto(&result.generator_hist) ||
+      !reader.ReadInto(&result.capability_hist) ||
+      !reader.ReadInto(&result.extension_hist) ||
+      !reader.ReadInto(&result.opcode_hist) ||
+      !reader.ReadInto(&result.opcode_and_num_operands_hist) ||
+      !reader.ReadInto(&result.u16_constant_hist) ||
+      !reader.ReadInto(&result.u32_constant_hist) ||
+      !reader.ReadInto(&result.u64_constant_hist) ||
+      !reader.ReadInto(&result.s16_constant_hist) ||
+      !reader.ReadInto(&result.s32_constant_hist) ||
+      !reader.ReadInto(&result.s64_constant_hist) ||
+      !reader.ReadInto(&result.f32_constant_hist) ||
+      !reader.ReadInto(&result.f64_constant_hist) ||
+      !reader.ReadInto(&result.enum_hist) ||
+      !reader.ReadInto(&result.operand_slot_non_id_words_hist) ||
+      !reader.ReadInto(&result.id_descriptor_hist) ||
+      !reader.ReadInto(&result.id_descriptor_collisions) ||
+      !reader.ReadInto(&result.id_descriptor_labels) ||
+      !reader.ReadInto(&result.operand_slot_id_descriptor_hist) ||
+      !reader.ReadInto(&result.literal_strings_hist) ||
+      !reader.ReadInto(&result.opcode_and_num_operands_markov_hist) ||
+      !reader.Read(&num_markov_steps) || num_markov_steps > num_words) {
+    return false;
+  }
+
+  result.opcode_markov_hist.resize(num_markov_steps);
+  for (uint32_t i = 0; i < num_markov_steps; ++i) {
+    if (!reader.ReadInto(&result.opcode_markov_hist[i])) return false;
+  }
+  if (!reader.AtEnd()) return false;
+
+  MergeStats(result, stats);
+  return true;
 }
 
 }  // namespace libspirv
@@ -83,6 +83,10 @@ struct SpirvStats {
   // Descriptor -> count.
   std::unordered_map<uint32_t, uint32_t> id_descriptor_hist;
 
+  // Number of ids whose descriptor was already generated for an instruction
+  // with different words in the same module.
+  uint32_t id_descriptor_collisions = 0;
+
   // Debut labels for id descriptors, descriptor -> label.
   std::unordered_map<uint32_t, std::string> id_descriptor_labels;
 
@@ -125,6 +129,21 @@ spv_result_t AggregateStats(const spv_context_t& context, const uint32_t* words,
                             const size_t num_words, spv_diagnostic* pDiagnostic,
                             SpirvStats* stats);
 
+// Adds the histograms of |from| to those of |to|, so that stats aggregated
+// from parts of a corpus, for example on different threads, can be combined
+// into the stats of the whole corpus.
+void MergeStats(const SpirvStats& from, SpirvStats* to);
+
+// Appends |stats| to |words| in a compact binary format, so that stats can be
+// stored, or aggregated on other machines and merged later.
+void SerializeStats(const SpirvStats& stats, std::vector<uint32_t>* words);
+
+// Adds the stats serialized by SerializeStats() in the |num_words| words at
+// |words| to |stats|, as MergeStats() would. Returns false, and leaves |stats|
+// unchanged, if the words are not valid serialized stats.
+bool AggregateSerializedStats(const uint32_t* words, size_t num_words,
+                              SpirvStats* stats);
+
 }  // namespace libspirv
 
 #endif  // LIBSPIRV_SPIRV_STATS_H_
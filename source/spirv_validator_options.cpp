@@ -86,3 +86,18 @@ void spvValidatorOptionsSetRelaxLogicalPointer(spv_validator_options options,
                                                bool val) {
   options->relax_logcial_pointer = val;
 }
+
+void spvValidatorOptionsSetMaxErrors(spv_validator_options options,
+                                     uint32_t max_errors) {
+  options->max_errors = max_errors > 0 ? max_errors : 1;
+}
+
+void spvValidatorOptionsSetNumThreads(spv_validator_options options,
+                                      uint32_t num_threads) {
+  options->num_threads = num_threads;
+}
+
+void spvValidatorOptionsSetCacheDirectory(spv_validator_options options,
+                                          const char* path) {
+  options->cache_directory = path ? path : "";
+}
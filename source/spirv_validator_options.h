@@ -15,6 +15,8 @@
 #ifndef LIBSPIRV_SPIRV_VALIDATOR_OPTIONS_H_
 #define LIBSPIRV_SPIRV_VALIDATOR_OPTIONS_H_
 
+#include <string>
+
 #include "spirv-tools/libspirv.h"
 
 // Return true if the command line option for the validator limit is valid (Also
@@ -40,11 +42,21 @@ struct spv_validator_options_t {
   spv_validator_options_t()
       : universal_limits_(),
         relax_struct_store(false),
-        relax_logcial_pointer(false) {}
+        relax_logcial_pointer(false),
+        max_errors(1),
+        num_threads(1) {}
 
   validator_universal_limits_t universal_limits_;
   bool relax_struct_store;
   bool relax_logcial_pointer;
+  // The number of errors after which validation stops.
+  uint32_t max_errors;
+  // The number of threads the validator may use, or 0 for one per hardware
+  // thread.
+  uint32_t num_threads;
+  // The directory of the validation result cache, or empty if results are not
+  // cached.
+  std::string cache_directory;
 };
 
 #endif  // LIBSPIRV_SPIRV_VALIDATOR_OPTIONS_H_
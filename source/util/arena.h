@@ -0,0 +1,90 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSPIRV_UTIL_ARENA_H_
+#define LIBSPIRV_UTIL_ARENA_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "util/span.h"
+
+namespace spvtools {
+namespace utils {
+
+// Stores many small arrays of trivially copyable elements, such as the words
+// of instructions, in a few large chunks instead of one heap allocation per
+// array. The arrays never move, and are all freed with the arena.
+template <class T>
+class Arena {
+ public:
+  // Creates an arena which allocates chunks of |chunk_size| elements.
+  explicit Arena(size_t chunk_size = 16 * 1024)
+      : chunk_size_(chunk_size),
+        next_(nullptr),
+        available_(0),
+        capacity_(0) {}
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  // Copies the |count| elements starting at |elements| into the arena, and
+  // returns a view of the copy.
+  Span<T> Copy(const T* elements, size_t count) {
+    T* copy = Allocate(count);
+    std::copy(elements, elements + count, copy);
+    return Span<T>(copy, count);
+  }
+
+  // Returns the number of elements in all the chunks of the arena.
+  size_t capacity() const { return capacity_; }
+
+ private:
+  // Returns space for |count| elements.
+  T* Allocate(size_t count) {
+    if (count > available_) {
+      if (count > chunk_size_ / 4) {
+        // Give large arrays a chunk of their own, and keep filling the
+        // current one.
+        chunks_.emplace_back(new T[count]);
+        capacity_ += count;
+        return chunks_.back().get();
+      }
+      chunks_.emplace_back(new T[chunk_size_]);
+      capacity_ += chunk_size_;
+      next_ = chunks_.back().get();
+      available_ = chunk_size_;
+    }
+    T* space = next_;
+    next_ += count;
+    available_ -= count;
+    return space;
+  }
+
+  const size_t chunk_size_;
+  std::vector<std::unique_ptr<T[]>> chunks_;
+  // The first free element of the current chunk, and the number of free
+  // elements left in it.
+  T* next_;
+  size_t available_;
+  // The number of elements in all the chunks.
+  size_t capacity_;
+};
+
+}  // namespace utils
+}  // namespace spvtools
+
+#endif  // LIBSPIRV_UTIL_ARENA_H_
@@ -19,10 +19,13 @@
 
 #include <algorithm>
 #include <bitset>
+#include <cassert>
 #include <cstdint>
+#include <cstring>
 #include <functional>
 #include <sstream>
 #include <string>
+#include <type_traits>
 #include <vector>
 
 namespace spvutils {
@@ -274,12 +277,14 @@ class BitWriterInterface {
 };
 
 // This class is an implementation of BitWriterInterface, using
-// std::vector<uint64_t> to store written bits.
-class BitWriterWord64 : public BitWriterInterface {
+// std::vector<uint64_t> to store written bits. WriteBits and the variable
+// width writers are inlined, and are called without virtual dispatch when the
+// writer is used through its own type.
+class BitWriterWord64 final : public BitWriterInterface {
  public:
   explicit BitWriterWord64(size_t reserve_bits = 64);
 
-  void WriteBits(uint64_t bits, size_t num_bits) override;
+  inline void WriteBits(uint64_t bits, size_t num_bits) override;
 
   size_t GetNumBits() const override { return end_; }
 
@@ -402,7 +407,7 @@ class BitReaderInterface {
 // This class is an implementation of BitReaderInterface which accepts both
 // uint8_t and uint64_t buffers as input. uint64_t buffers are consumed and
 // owned. uint8_t buffers are copied.
-class BitReaderWord64 : public BitReaderInterface {
+class BitReaderWord64 final : public BitReaderInterface {
  public:
   // Consumes and owns the buffer.
   explicit BitReaderWord64(std::vector<uint64_t>&& buffer);
@@ -413,7 +418,7 @@ class BitReaderWord64 : public BitReaderInterface {
   explicit BitReaderWord64(const std::vector<uint8_t>& buffer);
   BitReaderWord64(const void* buffer, size_t num_bytes);
 
-  size_t ReadBits(uint64_t* bits, size_t num_bits) override;
+  inline size_t ReadBits(uint64_t* bits, size_t num_bits) override;
 
   size_t GetNumReadBits() const override { return pos_; }
 
@@ -442,6 +447,444 @@ class BitReaderWord64 : public BitReaderInterface {
   std::function<void(const std::string&)> callback_;
 };
 
+// This class is an implementation of BitReaderInterface which pulls its input
+// in chunks from a callback, so that the whole stream never needs to be held
+// in memory.
+//
+// The next bits of the stream are kept in a 64-bit cache, which is refilled
+// with a single unaligned 8-byte load while at least 8 bytes of the chunk are
+// left. Besides ReadBits, the reader offers PeekBits and ConsumeBits for
+// table-driven decoders, which look at the next few bits before knowing how
+// many of them make up a code.
+class BitReaderChunked final : public BitReaderInterface {
+ public:
+  // Copies at most |max_size| bytes of the stream to |data| and returns the
+  // number of bytes copied. Returns 0 once the stream is exhausted.
+  using ByteSource = std::function<size_t(uint8_t* data, size_t max_size)>;
+
+  // The largest number of bits which can be peeked at once.
+  static const size_t kMaxPeekBits = 56;
+
+  // Reads the stream from |source|, |chunk_size| bytes at a time.
+  explicit BitReaderChunked(ByteSource source, size_t chunk_size = 4096);
+
+  inline size_t ReadBits(uint64_t* bits, size_t num_bits) override;
+
+  // Returns the next |num_bits| bits of the stream without consuming them.
+  // Bits past the end of the stream read as zero. |num_bits| must be no
+  // greater than kMaxPeekBits.
+  uint64_t PeekBits(size_t num_bits) {
+    assert(num_bits <= kMaxPeekBits);
+    if (num_cached_bits_ < num_bits) FillCache();
+    return GetLowerBits(cache_, num_bits);
+  }
+
+  // Consumes |num_bits| bits which have just been peeked. Returns false if
+  // the stream has fewer bits left, in which case nothing is consumed.
+  bool ConsumeBits(size_t num_bits) {
+    assert(num_bits <= kMaxPeekBits);
+    if (num_cached_bits_ < num_bits) {
+      FillCache();
+      if (num_cached_bits_ < num_bits) return false;
+    }
+    if (callback_) EmitSequence(GetLowerBits(cache_, num_bits), num_bits);
+    cache_ >>= num_bits;
+    num_cached_bits_ -= num_bits;
+    return true;
+  }
+
+  size_t GetNumReadBits() const override {
+    return (num_discarded_bytes_ + next_byte_) * 8 - num_cached_bits_;
+  }
+
+  bool ReachedEnd() const override;
+  bool OnlyZeroesLeft() const override;
+
+  BitReaderChunked() = delete;
+
+  // Sets callback to emit bit sequences after every read.
+  void SetCallback(std::function<void(const std::string&)> callback) {
+    callback_ = callback;
+  }
+
+ protected:
+  // Sends string generated from arguments to callback_ if defined.
+  void EmitSequence(uint64_t bits, size_t num_bits) const {
+    if (callback_) callback_(BitsToStream(bits, num_bits));
+  }
+
+ private:
+  // Loads bytes from buffer_ into cache_ until it holds more than
+  // kMaxPeekBits bits or the stream ends.
+  void FillCache() {
+    if (size_ - next_byte_ >= 8) {
+      // Load 8 bytes, of which the ones which do not fit whole are loaded
+      // again by the next call. Their bits are already in place in cache_,
+      // so or-ing them in twice does no harm.
+      uint64_t word = 0;
+      std::memcpy(&word, buffer_.data() + next_byte_, sizeof(word));
+      cache_ |= word << num_cached_bits_;
+      next_byte_ += (63 - num_cached_bits_) / 8;
+      num_cached_bits_ |= kMaxPeekBits;
+    } else {
+      FillCacheSlow();
+    }
+  }
+
+  // Same as FillCache for the end of the chunk, which pulls the next chunk
+  // from source_.
+  void FillCacheSlow();
+
+  // Discards the bytes of buffer_ which have been loaded into cache_, and
+  // fills the rest of buffer_ from source_.
+  void Refill();
+
+  ByteSource source_;
+  std::vector<uint8_t> buffer_;
+  // The number of valid bytes in buffer_.
+  size_t size_;
+  // The next byte of buffer_ to load into cache_.
+  size_t next_byte_;
+  // The number of bytes which were discarded from buffer_.
+  size_t num_discarded_bytes_;
+  // The next bits of the stream, starting from the lowest bit. Only the
+  // lowest num_cached_bits_ bits are counted; the bits above them are either
+  // zero or the actual bits which follow.
+  uint64_t cache_;
+  size_t num_cached_bits_;
+  // True once source_ has signaled the end of the stream.
+  bool exhausted_;
+
+  // If not null, the reader will use the callback to emit the read bit
+  // sequence as a string of '0' and '1'.
+  std::function<void(const std::string&)> callback_;
+};
+
+// The variable width and fixed width codes are defined here rather than in
+// bit_stream.cpp, so that they are inlined and call WriteBits and ReadBits
+// directly when the concrete writer or reader type is known.
+
+// Writes bits from |val| to |writer| in chunks of size |chunk_length|.
+// Signal bit is used to signal if the reader should expect another chunk:
+// 0 - no more chunks to follow
+// 1 - more chunks to follow
+// If number of written bits reaches |max_payload| last chunk is truncated.
+inline void WriteVariableWidthInternal(BitWriterInterface* writer,
+                                       uint64_t val, size_t chunk_length,
+                                       size_t max_payload) {
+  assert(chunk_length > 0);
+  assert(chunk_length < max_payload);
+  assert(max_payload == 64 || (val >> max_payload) == 0);
+
+  if (val == 0) {
+    // Split in two writes for more readable logging.
+    writer->WriteBits(0, chunk_length);
+    writer->WriteBits(0, 1);
+    return;
+  }
+
+  size_t payload_written = 0;
+
+  while (val) {
+    if (payload_written + chunk_length >= max_payload) {
+      // This has to be the last chunk.
+      // There is no need for the signal bit and the chunk can be truncated.
+      const size_t left_to_write = max_payload - payload_written;
+      assert((val >> left_to_write) == 0);
+      writer->WriteBits(val, left_to_write);
+      break;
+    }
+
+    writer->WriteBits(val, chunk_length);
+    payload_written += chunk_length;
+    val = val >> chunk_length;
+
+    // Write a single bit to signal if there is more to come.
+    writer->WriteBits(val ? 1 : 0, 1);
+  }
+}
+
+// Reads data written with WriteVariableWidthInternal. |chunk_length| and
+// |max_payload| should be identical to those used to write the data.
+// Returns false if the stream ends prematurely.
+inline bool ReadVariableWidthInternal(BitReaderInterface* reader,
+                                      uint64_t* val, size_t chunk_length,
+                                      size_t max_payload) {
+  assert(chunk_length > 0);
+  assert(chunk_length <= max_payload);
+  size_t payload_read = 0;
+
+  while (payload_read + chunk_length < max_payload) {
+    uint64_t bits = 0;
+    if (reader->ReadBits(&bits, chunk_length) != chunk_length) return false;
+
+    *val |= bits << payload_read;
+    payload_read += chunk_length;
+
+    uint64_t more_to_come = 0;
+    if (reader->ReadBits(&more_to_come, 1) != 1) return false;
+
+    if (!more_to_come) {
+      return true;
+    }
+  }
+
+  // Need to read the last chunk which may be truncated. No signal bit follows.
+  uint64_t bits = 0;
+  const size_t left_to_read = max_payload - payload_read;
+  if (reader->ReadBits(&bits, left_to_read) != left_to_read) return false;
+
+  *val |= bits << payload_read;
+  return true;
+}
+
+// Calls WriteVariableWidthInternal with the right max_payload argument.
+template <typename T>
+inline void WriteVariableWidthUnsigned(BitWriterInterface* writer, T val,
+                                       size_t chunk_length) {
+  static_assert(std::is_unsigned<T>::value, "Type must be unsigned");
+  static_assert(std::is_integral<T>::value, "Type must be integral");
+  WriteVariableWidthInternal(writer, val, chunk_length, sizeof(T) * 8);
+}
+
+// Calls ReadVariableWidthInternal with the right max_payload argument.
+template <typename T>
+inline bool ReadVariableWidthUnsigned(BitReaderInterface* reader, T* val,
+                                      size_t chunk_length) {
+  static_assert(std::is_unsigned<T>::value, "Type must be unsigned");
+  static_assert(std::is_integral<T>::value, "Type must be integral");
+  uint64_t val64 = 0;
+  if (!ReadVariableWidthInternal(reader, &val64, chunk_length, sizeof(T) * 8))
+    return false;
+  *val = static_cast<T>(val64);
+  assert(*val == val64);
+  return true;
+}
+
+// Encodes signed |val| to an unsigned value and calls
+// WriteVariableWidthInternal with the right max_payload argument.
+template <typename T>
+inline void WriteVariableWidthSigned(BitWriterInterface* writer, T val,
+                                     size_t chunk_length,
+                                     size_t zigzag_exponent) {
+  static_assert(std::is_signed<T>::value, "Type must be signed");
+  static_assert(std::is_integral<T>::value, "Type must be integral");
+  WriteVariableWidthInternal(writer, EncodeZigZag(val, zigzag_exponent),
+                             chunk_length, sizeof(T) * 8);
+}
+
+// Calls ReadVariableWidthInternal with the right max_payload argument
+// and decodes the value.
+template <typename T>
+inline bool ReadVariableWidthSigned(BitReaderInterface* reader, T* val,
+                                    size_t chunk_length,
+                                    size_t zigzag_exponent) {
+  static_assert(std::is_signed<T>::value, "Type must be signed");
+  static_assert(std::is_integral<T>::value, "Type must be integral");
+  uint64_t encoded = 0;
+  if (!ReadVariableWidthInternal(reader, &encoded, chunk_length, sizeof(T) * 8))
+    return false;
+
+  const int64_t decoded = DecodeZigZag(encoded, zigzag_exponent);
+
+  *val = static_cast<T>(decoded);
+  assert(*val == decoded);
+  return true;
+}
+
+inline void BitWriterInterface::WriteVariableWidthU64(uint64_t val,
+                                                      size_t chunk_length) {
+  WriteVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline void BitWriterInterface::WriteVariableWidthU32(uint32_t val,
+                                                      size_t chunk_length) {
+  WriteVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline void BitWriterInterface::WriteVariableWidthU16(uint16_t val,
+                                                      size_t chunk_length) {
+  WriteVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline void BitWriterInterface::WriteVariableWidthU8(uint8_t val,
+                                                     size_t chunk_length) {
+  WriteVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline void BitWriterInterface::WriteVariableWidthS64(int64_t val,
+                                                      size_t chunk_length,
+                                                      size_t zigzag_exponent) {
+  WriteVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline void BitWriterInterface::WriteVariableWidthS32(int32_t val,
+                                                      size_t chunk_length,
+                                                      size_t zigzag_exponent) {
+  WriteVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline void BitWriterInterface::WriteVariableWidthS16(int16_t val,
+                                                      size_t chunk_length,
+                                                      size_t zigzag_exponent) {
+  WriteVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline void BitWriterInterface::WriteVariableWidthS8(int8_t val,
+                                                     size_t chunk_length,
+                                                     size_t zigzag_exponent) {
+  WriteVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline void BitWriterInterface::WriteFixedWidth(uint64_t val,
+                                                uint64_t max_val) {
+  if (val > max_val) {
+    assert(0 && "WriteFixedWidth: value too wide");
+    return;
+  }
+
+  const size_t num_bits = 1 + Log2U64(max_val);
+  WriteBits(val, num_bits);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthU64(uint64_t* val,
+                                                     size_t chunk_length) {
+  return ReadVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthU32(uint32_t* val,
+                                                     size_t chunk_length) {
+  return ReadVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthU16(uint16_t* val,
+                                                     size_t chunk_length) {
+  return ReadVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthU8(uint8_t* val,
+                                                    size_t chunk_length) {
+  return ReadVariableWidthUnsigned(this, val, chunk_length);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthS64(int64_t* val,
+                                                     size_t chunk_length,
+                                                     size_t zigzag_exponent) {
+  return ReadVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthS32(int32_t* val,
+                                                     size_t chunk_length,
+                                                     size_t zigzag_exponent) {
+  return ReadVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthS16(int16_t* val,
+                                                     size_t chunk_length,
+                                                     size_t zigzag_exponent) {
+  return ReadVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline bool BitReaderInterface::ReadVariableWidthS8(int8_t* val,
+                                                    size_t chunk_length,
+                                                    size_t zigzag_exponent) {
+  return ReadVariableWidthSigned(this, val, chunk_length, zigzag_exponent);
+}
+
+inline bool BitReaderInterface::ReadFixedWidth(uint64_t* val,
+                                               uint64_t max_val) {
+  const size_t num_bits = 1 + Log2U64(max_val);
+  return ReadBits(val, num_bits) == num_bits;
+}
+
+void BitWriterWord64::WriteBits(uint64_t bits, size_t num_bits) {
+  // Check that |bits| and |num_bits| are valid and consistent.
+  assert(num_bits <= 64);
+  if (num_bits == 0) return;
+
+  bits = GetLowerBits(bits, num_bits);
+
+  if (callback_) EmitSequence(bits, num_bits);
+
+  // Offset from the start of the current word.
+  const size_t offset = end_ % 64;
+
+  if (offset == 0) {
+    // If no offset, simply add |bits| as a new word to the buffer_.
+    buffer_.push_back(bits);
+  } else {
+    // Shift bits and add them to the current word after offset.
+    buffer_.back() |= bits << offset;
+
+    if (offset + num_bits > 64) {
+      // We overflow to the next word. Add remaining bits as a new word to
+      // buffer_.
+      buffer_.push_back(bits >> (64 - offset));
+    }
+  }
+
+  // Move end_ into position for next write.
+  end_ += num_bits;
+  assert(buffer_.size() * 64 >= end_);
+}
+
+size_t BitReaderWord64::ReadBits(uint64_t* bits, size_t num_bits) {
+  assert(num_bits <= 64);
+  if (ReachedEnd()) return 0;
+
+  // Index of the current word.
+  const size_t index = pos_ / 64;
+
+  // Bit position in the current word where we start reading.
+  const size_t offset = pos_ % 64;
+
+  // Read all bits from the current word (it might be too much, but
+  // excessive bits will be removed later).
+  *bits = buffer_[index] >> offset;
+
+  const size_t num_read_from_first_word = std::min(64 - offset, num_bits);
+  pos_ += num_read_from_first_word;
+
+  if (pos_ >= buffer_.size() * 64) {
+    // Reached end of buffer_.
+    if (callback_) EmitSequence(*bits, num_read_from_first_word);
+    return num_read_from_first_word;
+  }
+
+  if (offset + num_bits > 64) {
+    // Requested |num_bits| overflows to next word.
+    // Write all bits from the beginning of next word to *bits after offset.
+    *bits |= buffer_[index + 1] << (64 - offset);
+    pos_ += offset + num_bits - 64;
+  }
+
+  // We likely have written more bits than requested. Clear excessive bits.
+  *bits = GetLowerBits(*bits, num_bits);
+  if (callback_) EmitSequence(*bits, num_bits);
+  return num_bits;
+}
+
+size_t BitReaderChunked::ReadBits(uint64_t* bits, size_t num_bits) {
+  assert(num_bits <= 64);
+  if (num_bits > kMaxPeekBits) {
+    // Too many bits for the cache, read them in two parts.
+    uint64_t high_bits = 0;
+    const size_t num_read = ReadBits(bits, 32);
+    if (num_read < 32) return num_read;
+    const size_t num_high_read = ReadBits(&high_bits, num_bits - 32);
+    *bits |= high_bits << 32;
+    return 32 + num_high_read;
+  }
+
+  if (num_cached_bits_ < num_bits) FillCache();
+  const size_t num_read = std::min(num_bits, num_cached_bits_);
+  *bits = GetLowerBits(cache_, num_read);
+  if (callback_) EmitSequence(*bits, num_read);
+  cache_ >>= num_read;
+  num_cached_bits_ -= num_read;
+  return num_read;
+}
+
 }  // namespace spvutils
 
 #endif  // LIBSPIRV_UTIL_BIT_STREAM_H_
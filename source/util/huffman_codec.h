@@ -21,18 +21,97 @@
 #include <cassert>
 #include <functional>
 #include <iomanip>
+#include <limits>
 #include <map>
 #include <memory>
+#include <numeric>
 #include <ostream>
 #include <queue>
 #include <sstream>
 #include <stack>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 namespace spvutils {
 
+// Returns the code lengths of an optimal prefix code for symbols with the
+// given |weights|, in which no code is longer than |max_length| bits. Uses the
+// package-merge algorithm. A single symbol gets a code of 0 bits. If
+// |max_length| is too small for the number of symbols, the smallest length
+// which fits them is used instead.
+inline std::vector<uint32_t> GetLengthLimitedCodeLengths(
+    const std::vector<uint32_t>& weights, uint32_t max_length) {
+  const size_t num_symbols = weights.size();
+  std::vector<uint32_t> lengths(num_symbols, 0);
+  if (num_symbols < 2) return lengths;
+
+  uint32_t min_length = 0;
+  while ((size_t(1) << min_length) < num_symbols) ++min_length;
+  // No code of an unlimited Huffman code is longer than num_symbols - 1.
+  const size_t num_levels =
+      std::min(std::max(max_length, min_length), uint32_t(num_symbols - 1));
+
+  // Symbols by ascending weight.
+  std::vector<uint32_t> order(num_symbols);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&weights](uint32_t a,
+                                                          uint32_t b) {
+    return weights[a] < weights[b];
+  });
+
+  // The items of every level, by ascending weight: symbols, and at the levels
+  // after the first, packages of two consecutive items of the previous level.
+  // Only whether an item is a symbol needs to be kept.
+  std::vector<std::vector<bool>> is_symbol(num_levels);
+  std::vector<uint64_t> items(num_symbols);
+  for (size_t i = 0; i < num_symbols; ++i) items[i] = weights[order[i]];
+  is_symbol[0].assign(num_symbols, true);
+  std::vector<uint64_t> next_items;
+  for (size_t level = 1; level < num_levels; ++level) {
+    const size_t num_packages = items.size() / 2;
+    next_items.clear();
+    size_t symbol = 0;
+    size_t package = 0;
+    while (symbol < num_symbols || package < num_packages) {
+      const uint64_t package_weight =
+          package < num_packages ? items[2 * package] + items[2 * package + 1]
+                                 : 0;
+      if (package == num_packages ||
+          (symbol < num_symbols && weights[order[symbol]] <= package_weight)) {
+        next_items.push_back(weights[order[symbol++]]);
+        is_symbol[level].push_back(true);
+      } else {
+        next_items.push_back(package_weight);
+        ++package;
+        is_symbol[level].push_back(false);
+      }
+    }
+    items.swap(next_items);
+  }
+
+  // The 2 * num_symbols - 2 lightest items of the last level make the code.
+  // A symbol gets a bit for every level at which it is selected, on its own
+  // or inside a selected package.
+  size_t num_selected = 2 * num_symbols - 2;
+  for (size_t level = num_levels; level-- > 0;) {
+    assert(num_selected <= is_symbol[level].size());
+    size_t num_selected_symbols = 0;
+    size_t num_selected_packages = 0;
+    for (size_t i = 0; i < num_selected; ++i) {
+      if (is_symbol[level][i])
+        ++lengths[order[num_selected_symbols++]];
+      else
+        ++num_selected_packages;
+    }
+    num_selected = 2 * num_selected_packages;
+  }
+  assert(num_selected == 0);
+  return lengths;
+}
+
 // Used to generate and apply a Huffman coding scheme.
 // |Val| is the type of variable being encoded (for example a string or a
 // literal).
@@ -63,63 +142,131 @@ class HuffmanCodec {
   explicit HuffmanCodec(const std::map<Val, uint32_t>& hist) {
     if (hist.empty()) return;
 
-    // Heuristic estimate.
-    nodes_.reserve(3 * hist.size());
+    nodes_.reserve(2 * hist.size());
 
     // Create NIL.
     CreateNode();
 
-    // The queue is sorted in ascending order by weight (or by node id if
-    // weights are equal).
-    std::vector<uint32_t> queue_vector;
-    queue_vector.reserve(hist.size());
-    std::priority_queue<uint32_t, std::vector<uint32_t>,
-                        std::function<bool(uint32_t, uint32_t)>>
-        queue(std::bind(&HuffmanCodec::LeftIsBigger, this,
-                        std::placeholders::_1, std::placeholders::_2),
-              std::move(queue_vector));
-
-    // Put all leaves in the queue.
+    // Subtrees are combined in ascending order by weight (or by node id if
+    // weights are equal). Combined nodes are created in that order, so the
+    // sorted leaves and a queue of combined nodes do the job of a priority
+    // queue.
+    std::vector<uint32_t> leaves;
+    leaves.reserve(hist.size());
     for (const auto& pair : hist) {
       const uint32_t node = CreateNode();
       MutableValueOf(node) = pair.first;
       MutableWeightOf(node) = pair.second;
       assert(WeightOf(node));
-      queue.push(node);
+      leaves.push_back(node);
     }
+    std::sort(leaves.begin(), leaves.end(),
+              [this](uint32_t left, uint32_t right) {
+                return LeftIsBigger(right, left);
+              });
+
+    std::vector<uint32_t> parents;
+    parents.reserve(hist.size());
+    size_t next_leaf = 0;
+    size_t next_parent = 0;
+    const auto take_smallest = [&]() -> uint32_t {
+      if (next_parent == parents.size() ||
+          (next_leaf < leaves.size() &&
+           LeftIsBigger(parents[next_parent], leaves[next_leaf]))) {
+        return leaves[next_leaf++];
+      }
+      return parents[next_parent++];
+    };
 
-    // Form the tree by combining two subtrees with the least weight,
-    // and pushing the root of the new tree in the queue.
+    // Form the tree by combining two subtrees with the least weight.
     while (true) {
-      // We push a node at the end of each iteration, so the queue is never
-      // supposed to be empty at this point, unless there are no leaves, but
-      // that case was already handled.
-      assert(!queue.empty());
-      const uint32_t right = queue.top();
-      queue.pop();
+      const uint32_t right = take_smallest();
 
-      // If the queue is empty at this point, then the last node is
-      // the root of the complete Huffman tree.
-      if (queue.empty()) {
+      // If nothing is left at this point, then the last node is the root of
+      // the complete Huffman tree.
+      if (next_leaf == leaves.size() && next_parent == parents.size()) {
         root_ = right;
         break;
       }
 
-      const uint32_t left = queue.top();
-      queue.pop();
+      const uint32_t left = take_smallest();
 
-      // Combine left and right into a new tree and push it into the queue.
+      // Combine left and right into a new tree.
       const uint32_t parent = CreateNode();
       MutableWeightOf(parent) = WeightOf(right) + WeightOf(left);
       MutableLeftOf(parent) = left;
       MutableRightOf(parent) = right;
-      queue.push(parent);
+      parents.push_back(parent);
     }
 
     // Traverse the tree and form encoding table.
     CreateEncodingTable();
   }
 
+  // Creates a canonical Huffman codec from a histogramm, with codes of at
+  // most |max_code_length| bits (see GetLengthLimitedCodeLengths).
+  // Histogramm counts must not be zero.
+  HuffmanCodec(const std::map<Val, uint32_t>& hist, uint32_t max_code_length) {
+    assert(max_code_length <= 64);
+    if (hist.empty()) return;
+
+    std::vector<uint32_t> weights;
+    weights.reserve(hist.size());
+    for (const auto& pair : hist) {
+      assert(pair.second);
+      weights.push_back(pair.second);
+    }
+    const std::vector<uint32_t> lengths = GetLengthLimitedCodeLengths(
+        weights, std::min<uint32_t>(max_code_length, 64));
+
+    std::vector<std::pair<Val, uint32_t>> code_lengths;
+    code_lengths.reserve(hist.size());
+    for (const auto& pair : hist) {
+      code_lengths.emplace_back(pair.first, lengths[code_lengths.size()]);
+    }
+    CreateCanonicalTree(code_lengths, weights);
+  }
+
+  // Creates a canonical Huffman codec in which every value has a code of the
+  // given length, as returned by GetCodeLengths(). Codes of the same length
+  // are assigned in the order of the values. |code_lengths| must pass
+  // AreValidCodeLengths().
+  explicit HuffmanCodec(
+      const std::vector<std::pair<Val, uint32_t>>& code_lengths) {
+    assert(AreValidCodeLengths(code_lengths));
+    CreateCanonicalTree(code_lengths, std::vector<uint32_t>());
+  }
+
+  // Returns true if |code_lengths| has distinct values and the lengths of a
+  // complete prefix code, none longer than 64 bits. A single value must have
+  // length 0.
+  static bool AreValidCodeLengths(
+      const std::vector<std::pair<Val, uint32_t>>& code_lengths) {
+    if (code_lengths.empty()) return false;
+
+    std::vector<Val> values;
+    values.reserve(code_lengths.size());
+    std::vector<size_t> num_codes_of_length(65, 0);
+    for (const auto& pair : code_lengths) {
+      if (pair.second > 64) return false;
+      values.push_back(pair.first);
+      ++num_codes_of_length[pair.second];
+    }
+    std::sort(values.begin(), values.end());
+    if (std::adjacent_find(values.begin(), values.end()) != values.end())
+      return false;
+
+    // Counts the nodes at every depth of the tree from the bottom up. Every
+    // node below the root needs a sibling.
+    size_t num_nodes = 0;
+    for (size_t length = 64; length > 0; --length) {
+      num_nodes += num_codes_of_length[length];
+      if (num_nodes % 2) return false;
+      num_nodes /= 2;
+    }
+    return num_nodes + num_codes_of_length[0] == 1;
+  }
+
   // Creates Huffman codec from saved tree structure.
   // |nodes| is the list of nodes of the tree, nodes[0] being NIL.
   // |root_handle| is the index of the root node.
@@ -135,6 +282,36 @@ class HuffmanCodec {
     CreateEncodingTable();
   }
 
+  // Returns the handle of the root node.
+  uint32_t root_handle() const { return root_; }
+
+  // Returns true if the codes were assigned canonically, so that the codec is
+  // fully described by GetCodeLengths().
+  bool is_canonical() const { return is_canonical_; }
+
+  // Returns every value with the length of its code, ordered by length and
+  // then by value.
+  std::vector<std::pair<Val, uint32_t>> GetCodeLengths() const {
+    std::vector<std::pair<Val, uint32_t>> code_lengths;
+    code_lengths.reserve(encoding_table_.size());
+    for (const auto& kv : encoding_table_) {
+      code_lengths.emplace_back(kv.first,
+                                static_cast<uint32_t>(kv.second.second));
+    }
+    std::sort(code_lengths.begin(), code_lengths.end(),
+              [](const std::pair<Val, uint32_t>& left,
+                 const std::pair<Val, uint32_t>& right) {
+                if (left.second != right.second)
+                  return left.second < right.second;
+                return left.first < right.first;
+              });
+    return code_lengths;
+  }
+
+  // Returns the nodes of the tree, nodes[0] being NIL. Together with
+  // root_handle() this is what the constructor from a saved tree takes.
+  const std::vector<Node>& nodes() const { return nodes_; }
+
   // Serializes the codec in the following text format:
   // (<root_handle>, {
   //   {0, 0, 0},
@@ -204,6 +381,15 @@ class HuffmanCodec {
   // Encodes |val| and stores its Huffman code in the lower |num_bits| of
   // |bits|. Returns false of |val| is not in the Huffman table.
   bool Encode(const Val& val, uint64_t* bits, size_t* num_bits) const {
+    size_t index = 0;
+    if (DenseIndexOf(val, &index)) {
+      const std::pair<uint64_t, size_t>& code = dense_encoding_table_[index];
+      if (code.second == kNoCode) return false;
+      *bits = code.first;
+      *num_bits = code.second;
+      return true;
+    }
+
     auto it = encoding_table_.find(val);
     if (it == encoding_table_.end()) return false;
     *bits = it->second.first;
@@ -355,6 +541,100 @@ class HuffmanCodec {
           queue.emplace(RightOf(node), bits | (1ULL << depth), depth + 1);
       }
     }
+
+    CreateDenseEncodingTable();
+  }
+
+  // Fills dense_encoding_table_ if the values are small unsigned integers.
+  template <class T = Val>
+  typename std::enable_if<std::is_unsigned<T>::value>::type
+  CreateDenseEncodingTable() {
+    uint64_t max_value = 0;
+    for (const auto& kv : encoding_table_) {
+      max_value = std::max<uint64_t>(max_value, kv.first);
+    }
+    // Keeps the table at most a few times larger than the codec.
+    if (max_value >= std::max<uint64_t>(256, 4 * encoding_table_.size()))
+      return;
+    dense_encoding_table_.assign(
+        static_cast<size_t>(max_value) + 1,
+        std::pair<uint64_t, size_t>(0, kNoCode));
+    for (const auto& kv : encoding_table_) {
+      dense_encoding_table_[static_cast<size_t>(kv.first)] = kv.second;
+    }
+  }
+
+  template <class T = Val>
+  typename std::enable_if<!std::is_unsigned<T>::value>::type
+  CreateDenseEncodingTable() {}
+
+  // Sets |index| to the index of |val| in dense_encoding_table_. Returns false
+  // if |val| has no entry there.
+  template <class T = Val>
+  typename std::enable_if<std::is_unsigned<T>::value, bool>::type DenseIndexOf(
+      const T& val, size_t* index) const {
+    if (val >= dense_encoding_table_.size()) return false;
+    *index = static_cast<size_t>(val);
+    return true;
+  }
+
+  template <class T = Val>
+  typename std::enable_if<!std::is_unsigned<T>::value, bool>::type
+  DenseIndexOf(const T&, size_t*) const {
+    return false;
+  }
+
+  // Builds the tree of a canonical codec from the code length of every value,
+  // and the weight of every value if |weights| is not empty. The tree is
+  // built from the bottom up, so that children are created before their
+  // parents. At every depth, the leaves take the lowest codes in the order of
+  // their values, and the nodes with longer codes below them the highest.
+  void CreateCanonicalTree(
+      const std::vector<std::pair<Val, uint32_t>>& code_lengths,
+      const std::vector<uint32_t>& weights) {
+    assert(weights.empty() || weights.size() == code_lengths.size());
+    nodes_.reserve(2 * code_lengths.size());
+
+    // Create NIL.
+    CreateNode();
+
+    std::vector<uint32_t> order(code_lengths.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(),
+              [&code_lengths](uint32_t left, uint32_t right) {
+                if (code_lengths[left].second != code_lengths[right].second)
+                  return code_lengths[left].second > code_lengths[right].second;
+                return code_lengths[left].first < code_lengths[right].first;
+              });
+
+    // Nodes at the depth below the current one, in ascending order of codes.
+    std::vector<uint32_t> below;
+    std::vector<uint32_t> level;
+    size_t next = 0;
+    for (uint32_t depth = code_lengths[order[0]].second + 1; depth-- > 0;) {
+      level.clear();
+      for (; next < order.size() && code_lengths[order[next]].second == depth;
+           ++next) {
+        const uint32_t node = CreateNode();
+        MutableValueOf(node) = code_lengths[order[next]].first;
+        if (!weights.empty()) MutableWeightOf(node) = weights[order[next]];
+        level.push_back(node);
+      }
+      assert(below.size() % 2 == 0);
+      for (size_t i = 0; i + 1 < below.size(); i += 2) {
+        const uint32_t parent = CreateNode();
+        MutableWeightOf(parent) = WeightOf(below[i]) + WeightOf(below[i + 1]);
+        MutableLeftOf(parent) = below[i];
+        MutableRightOf(parent) = below[i + 1];
+        level.push_back(parent);
+      }
+      below.swap(level);
+    }
+    assert(below.size() == 1);
+    root_ = below[0];
+    is_canonical_ = true;
+
+    CreateEncodingTable();
   }
 
   // Creates new Huffman tree node and stores it in the deleter array.
@@ -376,10 +656,21 @@ class HuffmanCodec {
   // impossible if frequencies are stored as uint32_t).
   std::unordered_map<Val, std::pair<uint64_t, size_t>> encoding_table_;
 
+  // The encoding table as an array indexed by value, for codecs of small
+  // unsigned integers. Values without a code have kNoCode bits.
+  static constexpr size_t kNoCode = std::numeric_limits<size_t>::max();
+  std::vector<std::pair<uint64_t, size_t>> dense_encoding_table_;
+
+  // True if the codes were assigned canonically.
+  bool is_canonical_ = false;
+
   // Next node id issued by CreateNode();
   uint32_t next_node_id_ = 1;
 };
 
+template <class Val>
+constexpr size_t HuffmanCodec<Val>::kNoCode;
+
 }  // namespace spvutils
 
 #endif  // LIBSPIRV_UTIL_HUFFMAN_CODEC_H_
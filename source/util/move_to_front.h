@@ -20,14 +20,14 @@
 #include <cstdint>
 #include <iomanip>
 #include <iostream>
-#include <map>
 #include <ostream>
-#include <set>
 #include <sstream>
 #include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
+#include "util/small_vector.h"
+
 namespace spvutils {
 
 // Log(n) move-to-front implementation. Implements the following functions:
@@ -310,14 +310,28 @@ class MoveToFront {
   bool last_accessed_value_valid_ = false;
 };
 
+// A set of move-to-front sequences identified by 64-bit handles, where a value
+// can be in several sequences at once. Implements the same operations as
+// MoveToFront, plus operations on all the sequences which have a value.
+//
+// The sequences are optimized for the access pattern of the MARK-V codec,
+// where most operations are promotions of a value in all its sequences. A
+// sequence is an array of slots ordered by the time the value in it was last
+// inserted or accessed, with a Fenwick tree counting the occupied slots.
+// Moving a value to the front frees its slot and takes the next one at the
+// end of the array, which costs two O(log n) updates of the Fenwick tree and
+// no rebalancing. When the array is full, the occupied slots are compacted to
+// its start. Handles are mapped to dense indices once, and the sequences
+// which have a value are kept in a small inline array of such indices.
 template <typename Val>
 class MultiMoveToFront {
  public:
   // Inserts |value| to sequence with handle |mtf|.
   // Returns false if |mtf| already has |value|.
   bool Insert(uint64_t mtf, const Val& value) {
-    if (GetMtf(mtf).Insert(value)) {
-      val_to_mtfs_[value].insert(mtf);
+    const uint32_t index = GetMtfIndex(mtf);
+    if (sequences_[index].Insert(value)) {
+      val_to_mtfs_[value].push_back(index);
       return true;
     }
     return false;
@@ -326,12 +340,19 @@ class MultiMoveToFront {
   // Removes |value| from sequence with handle |mtf|.
   // Returns false if |mtf| doesn't have |value|.
   bool Remove(uint64_t mtf, const Val& value) {
-    if (GetMtf(mtf).Remove(value)) {
-      val_to_mtfs_[value].erase(mtf);
-      return true;
-    }
-    assert(val_to_mtfs_[value].count(mtf) == 0);
-    return false;
+    const uint32_t index = GetMtfIndex(mtf);
+    if (!sequences_[index].Remove(value)) return false;
+
+    auto it = val_to_mtfs_.find(value);
+    assert(it != val_to_mtfs_.end());
+    auto& mtfs_containing_value = it->second;
+    auto pos = std::find(mtfs_containing_value.begin(),
+                         mtfs_containing_value.end(), index);
+    assert(pos != mtfs_containing_value.end());
+    *pos = mtfs_containing_value.back();
+    mtfs_containing_value.pop_back();
+    if (mtfs_containing_value.empty()) val_to_mtfs_.erase(it);
+    return true;
   }
 
   // Removes |value| from all sequences which have it.
@@ -339,74 +360,271 @@ class MultiMoveToFront {
     auto it = val_to_mtfs_.find(value);
     if (it == val_to_mtfs_.end()) return;
 
-    auto& mtfs_containing_value = it->second;
-    for (uint64_t mtf : mtfs_containing_value) {
-      GetMtf(mtf).Remove(value);
-    }
+    for (uint32_t index : it->second) sequences_[index].Remove(value);
+    val_to_mtfs_.erase(it);
+  }
 
-    val_to_mtfs_.erase(value);
+  // Removes all of |values| from all sequences which have them. Does the same
+  // as calling RemoveFromAll for each value, but updates the order of every
+  // sequence only once, which is cheaper when many values leave at once (for
+  // example the ids local to a function at its end).
+  template <class Container>
+  void RemoveAllFromAll(const Container& values) {
+    std::vector<uint32_t> touched;
+    for (const Val& value : values) {
+      auto it = val_to_mtfs_.find(value);
+      if (it == val_to_mtfs_.end()) continue;
+
+      for (uint32_t index : it->second) {
+        Sequence& sequence = sequences_[index];
+        if (!sequence.HasPendingRemovals()) touched.push_back(index);
+        sequence.RemoveLater(value);
+      }
+      val_to_mtfs_.erase(it);
+    }
+    for (uint32_t index : touched) sequences_[index].FinishRemovals();
   }
 
   // Computes rank of |value| in sequence |mtf|.
   // Returns false if |mtf| doesn't have |value|.
   bool RankFromValue(uint64_t mtf, const Val& value, uint32_t* rank) {
-    return GetMtf(mtf).RankFromValue(value, rank);
+    return sequences_[GetMtfIndex(mtf)].RankFromValue(value, rank);
   }
 
   // Finds |value| with |rank| in sequence |mtf|.
   // Returns false if |rank| is out of bounds.
   bool ValueFromRank(uint64_t mtf, uint32_t rank, Val* value) {
-    return GetMtf(mtf).ValueFromRank(rank, value);
+    return sequences_[GetMtfIndex(mtf)].ValueFromRank(rank, value);
   }
 
   // Returns size of |mtf| sequence.
-  uint32_t GetSize(uint64_t mtf) { return GetMtf(mtf).GetSize(); }
+  uint32_t GetSize(uint64_t mtf) { return sequences_[GetMtfIndex(mtf)].size(); }
 
   // Promotes |value| in all sequences which have it.
   void Promote(const Val& value) {
     const auto it = val_to_mtfs_.find(value);
     if (it == val_to_mtfs_.end()) return;
 
-    const auto& mtfs_containing_value = it->second;
-    for (uint64_t mtf : mtfs_containing_value) {
-      GetMtf(mtf).Promote(value);
-    }
+    for (uint32_t index : it->second) sequences_[index].Promote(value);
   }
 
   // Inserts |value| in sequence |mtf| or promotes if it's already there.
   void InsertOrPromote(uint64_t mtf, const Val& value) {
-    if (!Insert(mtf, value)) {
-      GetMtf(mtf).Promote(value);
-    }
+    const uint32_t index = GetMtfIndex(mtf);
+    if (!Insert(mtf, value)) sequences_[index].Promote(value);
   }
 
   // Returns if |mtf| sequence has |value|.
   bool HasValue(uint64_t mtf, const Val& value) {
-    return GetMtf(mtf).HasValue(value);
+    return sequences_[GetMtfIndex(mtf)].HasValue(value);
   }
 
  private:
-  // Returns actual MoveToFront object corresponding to |handle|.
-  // As multiple operations are often performed consecutively for the same
-  // sequence, the last returned value is cached.
-  MoveToFront<Val>& GetMtf(uint64_t handle) {
-    if (!cached_mtf_ || cached_handle_ != handle) {
-      cached_handle_ = handle;
-      cached_mtf_ = &mtfs_[handle];
+  // A single move-to-front sequence. Slot i of the array holds the i-th
+  // value in the order of last access, or nothing if that value has since been
+  // accessed again or removed. The rank of a value is the number of occupied
+  // slots from its own to the end of the array.
+  class Sequence {
+   public:
+    uint32_t size() const { return size_; }
+
+    bool HasValue(const Val& value) const {
+      return value_to_slot_.count(value) != 0;
+    }
+
+    bool Insert(const Val& value) {
+      if (HasValue(value)) return false;
+      const uint32_t slot = TakeNextSlot(value);
+      value_to_slot_.emplace(value, slot);
+      return true;
+    }
+
+    bool Remove(const Val& value) {
+      const auto it = value_to_slot_.find(value);
+      if (it == value_to_slot_.end()) return false;
+      FreeSlot(it->second);
+      value_to_slot_.erase(it);
+      return true;
+    }
+
+    bool RankFromValue(const Val& value, uint32_t* rank) {
+      const auto it = value_to_slot_.find(value);
+      if (it == value_to_slot_.end()) return false;
+      *rank = size_ - CountUpTo(it->second) + 1;
+      if (*rank != 1) MoveToFront(&it->second);
+      return true;
+    }
+
+    bool ValueFromRank(uint32_t rank, Val* value) {
+      if (rank == 0 || rank > size_) return false;
+      const uint32_t slot = FindNth(size_ - rank + 1);
+      *value = slots_[slot].value;
+      if (rank != 1) MoveToFront(&value_to_slot_[*value]);
+      return true;
+    }
+
+    bool Promote(const Val& value) {
+      const auto it = value_to_slot_.find(value);
+      if (it == value_to_slot_.end()) return false;
+      if (it->second + 1 != next_slot_) MoveToFront(&it->second);
+      return true;
+    }
+
+    // Frees the slot of |value|, but leaves the Fenwick tree out of date
+    // until FinishRemovals is called. Only RemoveLater and FinishRemovals may
+    // be called in between.
+    void RemoveLater(const Val& value) {
+      const auto it = value_to_slot_.find(value);
+      assert(it != value_to_slot_.end());
+      assert(slots_[it->second].occupied);
+      slots_[it->second].occupied = false;
+      --size_;
+      pending_removals_.push_back(it->second);
+      value_to_slot_.erase(it);
+    }
+
+    bool HasPendingRemovals() const { return !pending_removals_.empty(); }
+
+    // Brings the Fenwick tree up to date after calls to RemoveLater. Compacts
+    // the array instead if that is cheaper.
+    void FinishRemovals() {
+      if (pending_removals_.size() * 8 >= slots_.size()) {
+        Compact();
+      } else {
+        for (uint32_t slot : pending_removals_) Update(slot, false);
+      }
+      pending_removals_.clear();
+    }
+
+   private:
+    struct Slot {
+      Val value = Val();
+      bool occupied = false;
+    };
+
+    // Moves the value in |*slot| to the front, and updates |*slot|.
+    void MoveToFront(uint32_t* slot) {
+      const Val value = slots_[*slot].value;
+      FreeSlot(*slot);
+      *slot = TakeNextSlot(value);
+    }
+
+    // Puts |value| in the next free slot at the end of the array, and
+    // returns the slot.
+    uint32_t TakeNextSlot(const Val& value) {
+      assert(pending_removals_.empty());
+      if (next_slot_ == slots_.size()) Compact();
+      const uint32_t slot = next_slot_++;
+      slots_[slot].value = value;
+      slots_[slot].occupied = true;
+      Update(slot, true);
+      ++size_;
+      return slot;
+    }
+
+    void FreeSlot(uint32_t slot) {
+      assert(pending_removals_.empty());
+      assert(slots_[slot].occupied);
+      slots_[slot].occupied = false;
+      Update(slot, false);
+      --size_;
+    }
+
+    // Moves the occupied slots to the start of an array with room for at
+    // least as many more, and rebuilds the Fenwick tree in linear time.
+    void Compact() {
+      const size_t capacity = std::max<size_t>(16, 2 * size_);
+      std::vector<Slot> slots(capacity);
+      uint32_t num_slots = 0;
+      for (const Slot& slot : slots_) {
+        if (!slot.occupied) continue;
+        value_to_slot_[slot.value] = num_slots;
+        slots[num_slots++] = slot;
+      }
+      assert(num_slots == size_);
+      slots_.swap(slots);
+      next_slot_ = num_slots;
+
+      counts_.assign(capacity + 1, 0);
+      for (size_t i = 1; i <= capacity; ++i) {
+        counts_[i] += slots_[i - 1].occupied;
+        const size_t parent = i + (i & (0 - i));
+        if (parent <= capacity) counts_[parent] += counts_[i];
+      }
+    }
+
+    // Marks |slot| as occupied or free in the Fenwick tree.
+    void Update(uint32_t slot, bool occupied) {
+      const uint32_t delta = occupied ? 1 : uint32_t(-1);
+      for (size_t i = slot + 1; i < counts_.size(); i += i & (0 - i)) {
+        counts_[i] += delta;
+      }
+    }
+
+    // Returns the number of occupied slots up to and including |slot|.
+    uint32_t CountUpTo(uint32_t slot) const {
+      uint32_t count = 0;
+      for (size_t i = slot + 1; i; i -= i & (0 - i)) count += counts_[i];
+      return count;
     }
 
-    return *cached_mtf_;
+    // Returns the |n|-th occupied slot, counting from 1.
+    uint32_t FindNth(uint32_t n) const {
+      assert(n >= 1 && n <= size_);
+      const size_t capacity = counts_.size() - 1;
+      size_t step = 1;
+      while (step * 2 <= capacity) step *= 2;
+      size_t pos = 0;
+      for (; step; step /= 2) {
+        if (pos + step <= capacity && counts_[pos + step] < n) {
+          pos += step;
+          n -= counts_[pos];
+        }
+      }
+      assert(slots_[pos].occupied);
+      return static_cast<uint32_t>(pos);
+    }
+
+    // The array of slots, and the Fenwick tree over it (1-indexed).
+    std::vector<Slot> slots_;
+    std::vector<uint32_t> counts_ = std::vector<uint32_t>(1, 0);
+    // The slot the next accessed value goes to.
+    uint32_t next_slot_ = 0;
+    // The number of occupied slots.
+    uint32_t size_ = 0;
+    std::unordered_map<Val, uint32_t> value_to_slot_;
+    // Slots freed by RemoveLater.
+    std::vector<uint32_t> pending_removals_;
+  };
+
+  // Returns the dense index of the sequence with |handle|, creating the
+  // sequence if needed. As multiple operations are often performed
+  // consecutively for the same sequence, the last returned value is cached.
+  uint32_t GetMtfIndex(uint64_t handle) {
+    if (cached_index_ != kNoIndex && cached_handle_ == handle)
+      return cached_index_;
+
+    const auto result = handle_to_index_.emplace(
+        handle, static_cast<uint32_t>(sequences_.size()));
+    if (result.second) sequences_.emplace_back();
+    cached_handle_ = handle;
+    cached_index_ = result.first->second;
+    return cached_index_;
   }
 
-  // Container holding MoveToFront objects. Map key is sequence handle.
-  std::map<uint64_t, MoveToFront<Val>> mtfs_;
+  static const uint32_t kNoIndex = 0xFFFFFFFF;
+
+  // The sequences, indexed by the dense indices of their handles.
+  std::vector<Sequence> sequences_;
+  std::unordered_map<uint64_t, uint32_t> handle_to_index_;
 
-  // Container mapping value to sequences which contain that value.
-  std::unordered_map<Val, std::set<uint64_t>> val_to_mtfs_;
+  // Maps values to the dense indices of the sequences which contain them.
+  std::unordered_map<Val, spvtools::utils::SmallVector<uint32_t, 4>>
+      val_to_mtfs_;
 
   // Cache for the last accessed sequence.
   uint64_t cached_handle_ = 0;
-  MoveToFront<Val>* cached_mtf_ = nullptr;
+  uint32_t cached_index_ = kNoIndex;
 };
 
 template <typename Val>
@@ -0,0 +1,67 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Contains a minimal helper for running independent work items on several
+// threads.
+
+#ifndef LIBSPIRV_UTIL_PARALLEL_H_
+#define LIBSPIRV_UTIL_PARALLEL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <thread>
+#include <vector>
+
+namespace spvutils {
+
+// Returns the number of threads to use when |requested| threads are asked
+// for. A request of 0 means one thread per hardware thread.
+inline uint32_t ResolveNumThreads(uint32_t requested) {
+  if (requested != 0) return requested;
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// Calls |fn| once for every index in [0, |count|), using up to |num_threads|
+// threads (0 meaning one per hardware thread). The calling thread takes part
+// in the work, and the function returns once all calls have completed.
+// Indices are handed out dynamically, so |fn| must not depend on the order in
+// which they are processed. When a single thread is used, |fn| is called in
+// increasing index order on the calling thread.
+inline void ParallelFor(size_t count, uint32_t num_threads,
+                        const std::function<void(size_t)>& fn) {
+  const size_t num_workers =
+      std::min<size_t>(ResolveNumThreads(num_threads), count);
+  if (num_workers <= 1) {
+    for (size_t i = 0; i < count; ++i) fn(i);
+    return;
+  }
+
+  std::atomic<size_t> next_index(0);
+  auto worker = [&next_index, count, &fn]() {
+    for (size_t i = next_index++; i < count; i = next_index++) fn(i);
+  };
+
+  std::vector<std::thread> threads;
+  threads.reserve(num_workers - 1);
+  for (size_t i = 1; i < num_workers; ++i) threads.emplace_back(worker);
+  worker();
+  for (auto& thread : threads) thread.join();
+}
+
+}  // namespace spvutils
+
+#endif  // LIBSPIRV_UTIL_PARALLEL_H_
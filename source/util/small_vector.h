@@ -0,0 +1,236 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSPIRV_UTIL_SMALL_VECTOR_H_
+#define LIBSPIRV_UTIL_SMALL_VECTOR_H_
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace spvtools {
+namespace utils {
+
+// The |SmallVector| class is a container with a vector-like interface that
+// stores up to |small_size| elements inline, without any heap allocation.
+// Once it grows beyond that, its elements are moved to a std::vector.
+//
+// It is meant for the many short sequences of trivially copyable values
+// found in the IR, such as the words of an operand: most of them are one or
+// two words long. Iterators are plain pointers, and are invalidated by any
+// change to the size of the container.
+template <class T, size_t small_size>
+class SmallVector {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using reference = T&;
+  using const_reference = const T&;
+  using iterator = T*;
+  using const_iterator = const T*;
+
+  SmallVector() : size_(0) {}
+
+  SmallVector(const SmallVector& that) : SmallVector() { *this = that; }
+
+  // Moves are noexcept so that containers of SmallVectors, such as the
+  // operands of an instruction, move them rather than copy them when they
+  // grow.
+  SmallVector(SmallVector&& that) noexcept : SmallVector() {
+    *this = std::move(that);
+  }
+
+  SmallVector(const std::vector<T>& vec) : SmallVector() {
+    assign(vec.begin(), vec.end());
+  }
+
+  SmallVector(std::vector<T>&& vec) : SmallVector() {
+    if (vec.size() > small_size) {
+      large_data_.reset(new std::vector<T>(std::move(vec)));
+    } else {
+      assign(vec.begin(), vec.end());
+    }
+  }
+
+  SmallVector(std::initializer_list<T> init_list) : SmallVector() {
+    assign(init_list.begin(), init_list.end());
+  }
+
+  SmallVector(size_t count, const T& value) : SmallVector() {
+    resize(count, value);
+  }
+
+  SmallVector& operator=(const SmallVector& that) {
+    if (this != &that) assign(that.begin(), that.end());
+    return *this;
+  }
+
+  SmallVector& operator=(SmallVector&& that) noexcept {
+    if (this == &that) return *this;
+    if (that.large_data_) {
+      large_data_ = std::move(that.large_data_);
+      size_ = 0;
+    } else {
+      assign(that.begin(), that.end());
+    }
+    that.clear();
+    return *this;
+  }
+
+  size_t size() const { return large_data_ ? large_data_->size() : size_; }
+  bool empty() const { return size() == 0; }
+
+  T* data() { return large_data_ ? large_data_->data() : small_data_; }
+  const T* data() const {
+    return large_data_ ? large_data_->data() : small_data_;
+  }
+
+  iterator begin() { return data(); }
+  iterator end() { return data() + size(); }
+  const_iterator begin() const { return data(); }
+  const_iterator end() const { return data() + size(); }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  T& operator[](size_t i) {
+    assert(i < size());
+    return data()[i];
+  }
+  const T& operator[](size_t i) const {
+    assert(i < size());
+    return data()[i];
+  }
+
+  T& front() { return (*this)[0]; }
+  const T& front() const { return (*this)[0]; }
+  T& back() { return (*this)[size() - 1]; }
+  const T& back() const { return (*this)[size() - 1]; }
+
+  void clear() {
+    large_data_.reset();
+    size_ = 0;
+  }
+
+  void push_back(const T& value) {
+    if (!large_data_ && size_ == small_size) MoveToLargeData();
+    if (large_data_) {
+      large_data_->push_back(value);
+    } else {
+      small_data_[size_++] = value;
+    }
+  }
+
+  template <class... Args>
+  void emplace_back(Args&&... args) {
+    push_back(T(std::forward<Args>(args)...));
+  }
+
+  void pop_back() {
+    assert(!empty());
+    if (large_data_) {
+      large_data_->pop_back();
+    } else {
+      --size_;
+    }
+  }
+
+  void resize(size_t new_size, const T& value = T()) {
+    if (!large_data_ && new_size > small_size) MoveToLargeData();
+    if (large_data_) {
+      large_data_->resize(new_size, value);
+    } else {
+      for (size_t i = size_; i < new_size; ++i) small_data_[i] = value;
+      size_ = new_size;
+    }
+  }
+
+  // Replaces the contents with the elements of the range [|first|, |last|),
+  // which is walked over twice.
+  template <class ForwardIt>
+  void assign(ForwardIt first, ForwardIt last) {
+    const size_t count = std::distance(first, last);
+    if (count > small_size) {
+      large_data_.reset(new std::vector<T>(first, last));
+    } else {
+      large_data_.reset();
+      std::copy(first, last, small_data_);
+      size_ = count;
+    }
+  }
+
+  // Inserts the elements of the range [|first|, |last|) before |pos|, and
+  // returns an iterator to the first inserted element.
+  template <class ForwardIt>
+  iterator insert(const_iterator pos, ForwardIt first, ForwardIt last) {
+    const size_t index = pos - begin();
+    const size_t count = std::distance(first, last);
+    if (!large_data_ && size_ + count > small_size) MoveToLargeData();
+    if (large_data_) {
+      large_data_->insert(large_data_->begin() + index, first, last);
+    } else {
+      std::copy_backward(small_data_ + index, small_data_ + size_,
+                         small_data_ + size_ + count);
+      std::copy(first, last, small_data_ + index);
+      size_ += count;
+    }
+    return begin() + index;
+  }
+
+  iterator insert(const_iterator pos, const T& value) {
+    // |value| might be one of the elements being moved.
+    const T copy = value;
+    return insert(pos, &copy, &copy + 1);
+  }
+
+  bool operator==(const SmallVector& that) const {
+    return size() == that.size() && std::equal(begin(), end(), that.begin());
+  }
+  bool operator==(const std::vector<T>& that) const {
+    return size() == that.size() && std::equal(begin(), end(), that.begin());
+  }
+  bool operator!=(const SmallVector& that) const { return !(*this == that); }
+  bool operator!=(const std::vector<T>& that) const { return !(*this == that); }
+
+  friend bool operator==(const std::vector<T>& lhs, const SmallVector& rhs) {
+    return rhs == lhs;
+  }
+  friend bool operator!=(const std::vector<T>& lhs, const SmallVector& rhs) {
+    return rhs != lhs;
+  }
+
+ private:
+  // Moves the inline elements to |large_data_|.
+  void MoveToLargeData() {
+    assert(!large_data_);
+    large_data_.reset(new std::vector<T>(small_data_, small_data_ + size_));
+    size_ = 0;
+  }
+
+  // The number of inline elements. Unused once |large_data_| is set.
+  size_t size_;
+  // The inline elements.
+  T small_data_[small_size];
+  // The elements, once there are too many of them to be stored inline.
+  std::unique_ptr<std::vector<T>> large_data_;
+};
+
+}  // namespace utils
+}  // namespace spvtools
+
+#endif  // LIBSPIRV_UTIL_SMALL_VECTOR_H_
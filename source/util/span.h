@@ -0,0 +1,67 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSPIRV_UTIL_SPAN_H_
+#define LIBSPIRV_UTIL_SPAN_H_
+
+#include <cassert>
+#include <cstddef>
+#include <vector>
+
+namespace spvtools {
+namespace utils {
+
+// A read-only view of a contiguous array of elements owned by someone else,
+// such as an |Arena|. It is cheap to copy, and has the read-only interface of
+// a std::vector.
+template <class T>
+class Span {
+ public:
+  using value_type = T;
+  using size_type = size_t;
+  using const_reference = const T&;
+  using const_iterator = const T*;
+  using iterator = const_iterator;
+
+  Span() : data_(nullptr), size_(0) {}
+  Span(const T* data, size_t size) : data_(data), size_(size) {}
+
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+  const T* data() const { return data_; }
+
+  const_iterator begin() const { return data_; }
+  const_iterator end() const { return data_ + size_; }
+  const_iterator cbegin() const { return begin(); }
+  const_iterator cend() const { return end(); }
+
+  const T& operator[](size_t i) const {
+    assert(i < size_);
+    return data_[i];
+  }
+  const T& front() const { return (*this)[0]; }
+  const T& back() const { return (*this)[size_ - 1]; }
+
+  // Returns a copy of the elements.
+  std::vector<T> ToVector() const { return std::vector<T>(begin(), end()); }
+
+ private:
+  const T* data_;
+  size_t size_;
+};
+
+}  // namespace utils
+}  // namespace spvtools
+
+#endif  // LIBSPIRV_UTIL_SPAN_H_
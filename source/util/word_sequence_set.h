@@ -0,0 +1,125 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSPIRV_UTIL_WORD_SEQUENCE_SET_H_
+#define LIBSPIRV_UTIL_WORD_SEQUENCE_SET_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace spvtools {
+namespace utils {
+
+// A set of sequences of 32-bit words, such as the words of instructions.
+//
+// The words of all the sequences are stored back to back in a single arena,
+// and the set itself is an open addressing hash table with linear probing
+// whose slots hold the hash of a sequence and its position in the arena. The
+// hashes are kept so that growing the table and most failed comparisons
+// never touch the words.
+class WordSequenceSet {
+ public:
+  WordSequenceSet() : size_(0) {}
+
+  // Inserts the sequence of |num_words| words starting at |words|. Returns
+  // true if it was not in the set already.
+  bool Insert(const uint32_t* words, size_t num_words) {
+    // Keep the load factor at or below one half.
+    if (2 * (size_ + 1) > slots_.size()) Grow();
+
+    const uint32_t hash = Hash(words, num_words);
+    size_t index = SlotIndex(hash);
+    for (;; index = (index + 1) & (slots_.size() - 1)) {
+      Slot& slot = slots_[index];
+      if (slot.size == kEmptySlot) break;
+      if (slot.hash == hash && slot.size == num_words &&
+          std::equal(words, words + num_words, arena_.begin() + slot.offset)) {
+        return false;
+      }
+    }
+
+    Slot& slot = slots_[index];
+    slot.hash = hash;
+    slot.offset = static_cast<uint32_t>(arena_.size());
+    slot.size = static_cast<uint32_t>(num_words);
+    arena_.insert(arena_.end(), words, words + num_words);
+    ++size_;
+    return true;
+  }
+
+  bool Insert(const std::vector<uint32_t>& words) {
+    return Insert(words.data(), words.size());
+  }
+
+  // Returns the number of sequences in the set.
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+ private:
+  static const uint32_t kEmptySlot = UINT32_MAX;
+
+  struct Slot {
+    uint32_t hash;
+    // The position of the first word of the sequence in |arena_|.
+    uint32_t offset;
+    // The number of words in the sequence, or kEmptySlot.
+    uint32_t size;
+  };
+
+  // Returns the FNV-1a hash of the words, with a final mixing step so that
+  // the low bits used to pick a slot depend on every word.
+  static uint32_t Hash(const uint32_t* words, size_t num_words) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < num_words; ++i) {
+      hash ^= words[i];
+      hash *= 16777619u;
+    }
+    hash ^= hash >> 16;
+    hash *= 0x85ebca6bu;
+    hash ^= hash >> 13;
+    return hash;
+  }
+
+  size_t SlotIndex(uint32_t hash) const { return hash & (slots_.size() - 1); }
+
+  // Doubles the number of slots, and reinserts the sequences using their
+  // stored hashes.
+  void Grow() {
+    std::vector<Slot> old_slots(std::max<size_t>(16, 2 * slots_.size()),
+                                Slot{0, 0, kEmptySlot});
+    old_slots.swap(slots_);
+    for (const Slot& old_slot : old_slots) {
+      if (old_slot.size == kEmptySlot) continue;
+      size_t index = SlotIndex(old_slot.hash);
+      while (slots_[index].size != kEmptySlot) {
+        index = (index + 1) & (slots_.size() - 1);
+      }
+      slots_[index] = old_slot;
+    }
+  }
+
+  // The number of sequences in the set.
+  size_t size_;
+  // The hash table. Its size is zero or a power of two.
+  std::vector<Slot> slots_;
+  // The words of all the sequences in the set.
+  std::vector<uint32_t> arena_;
+};
+
+}  // namespace utils
+}  // namespace spvtools
+
+#endif  // LIBSPIRV_UTIL_WORD_SEQUENCE_SET_H_
@@ -22,10 +22,23 @@ using std::vector;
 
 namespace libspirv {
 
+namespace {
+
+// Marks a block which has no position in the (post)dominator tree.
+const uint32_t kUnnumbered = UINT32_MAX;
+
+}  // namespace
+
 BasicBlock::BasicBlock(uint32_t label_id)
     : id_(label_id),
       immediate_dominator_(nullptr),
       immediate_post_dominator_(nullptr),
+      dom_root_(nullptr),
+      dom_preorder_(kUnnumbered),
+      dom_postorder_(kUnnumbered),
+      pdom_root_(nullptr),
+      pdom_preorder_(kUnnumbered),
+      pdom_postorder_(kUnnumbered),
       predecessors_(),
       successors_(),
       type_(0),
@@ -33,10 +46,28 @@ BasicBlock::BasicBlock(uint32_t label_id)
 
 void BasicBlock::SetImmediateDominator(BasicBlock* dom_block) {
   immediate_dominator_ = dom_block;
+  dom_preorder_ = dom_postorder_ = kUnnumbered;
 }
 
 void BasicBlock::SetImmediatePostDominator(BasicBlock* pdom_block) {
   immediate_post_dominator_ = pdom_block;
+  pdom_preorder_ = pdom_postorder_ = kUnnumbered;
+}
+
+void BasicBlock::SetDominatorTreeNumbers(const BasicBlock* root,
+                                         uint32_t preorder,
+                                         uint32_t postorder) {
+  dom_root_ = root;
+  dom_preorder_ = preorder;
+  dom_postorder_ = postorder;
+}
+
+void BasicBlock::SetPostDominatorTreeNumbers(const BasicBlock* root,
+                                             uint32_t preorder,
+                                             uint32_t postorder) {
+  pdom_root_ = root;
+  pdom_preorder_ = preorder;
+  pdom_postorder_ = postorder;
 }
 
 const BasicBlock* BasicBlock::immediate_dominator() const {
@@ -66,12 +97,25 @@ void BasicBlock::RegisterBranchInstruction(SpvOp branch_instruction) {
 }
 
 bool BasicBlock::dominates(const BasicBlock& other) const {
+  if (dom_preorder_ != kUnnumbered && other.dom_preorder_ != kUnnumbered) {
+    // A block dominates the blocks of its subtree, which are visited after it
+    // and finished before it. Blocks of other trees, such as the blocks of
+    // other functions, are never dominated.
+    return dom_root_ == other.dom_root_ &&
+           dom_preorder_ <= other.dom_preorder_ &&
+           other.dom_postorder_ <= dom_postorder_;
+  }
   return (this == &other) ||
          !(other.dom_end() ==
            std::find(other.dom_begin(), other.dom_end(), this));
 }
 
 bool BasicBlock::postdominates(const BasicBlock& other) const {
+  if (pdom_preorder_ != kUnnumbered && other.pdom_preorder_ != kUnnumbered) {
+    return pdom_root_ == other.pdom_root_ &&
+           pdom_preorder_ <= other.pdom_preorder_ &&
+           other.pdom_postorder_ <= pdom_postorder_;
+  }
   return (this == &other) ||
          !(other.pdom_end() ==
            std::find(other.pdom_begin(), other.pdom_end(), this));
@@ -92,6 +92,26 @@ class BasicBlock {
   /// @param[in] pdom_block The post dominator block
   void SetImmediatePostDominator(BasicBlock* pdom_block);
 
+  /// Records the position of this block in a depth first traversal of the
+  /// dominator tree, which makes dominates() a constant time query. Numbers
+  /// are only comparable between blocks of the tree rooted at @p root.
+  ///
+  /// @param[in] root      The root of the tree which holds this block
+  /// @param[in] preorder  The preorder number of this block
+  /// @param[in] postorder The postorder number of this block
+  void SetDominatorTreeNumbers(const BasicBlock* root, uint32_t preorder,
+                               uint32_t postorder);
+
+  /// Records the position of this block in a depth first traversal of the
+  /// post dominator tree, which makes postdominates() a constant time query.
+  /// Numbers are only comparable between blocks of the tree rooted at @p root.
+  ///
+  /// @param[in] root      The root of the tree which holds this block
+  /// @param[in] preorder  The preorder number of this block
+  /// @param[in] postorder The postorder number of this block
+  void SetPostDominatorTreeNumbers(const BasicBlock* root, uint32_t preorder,
+                                   uint32_t postorder);
+
   /// Returns the immedate dominator of this basic block
   BasicBlock* immediate_dominator();
 
@@ -198,6 +218,24 @@ class BasicBlock {
   /// Pointer to the immediate dominator of the BasicBlock
   BasicBlock* immediate_post_dominator_;
 
+  /// Root of the dominator tree which numbers the BasicBlock. Every function
+  /// numbers its trees from 0, so blocks of different trees are never
+  /// compared.
+  const BasicBlock* dom_root_;
+
+  /// Preorder and postorder numbers of the BasicBlock in the dominator tree,
+  /// or kUnnumbered
+  uint32_t dom_preorder_;
+  uint32_t dom_postorder_;
+
+  /// Root of the post dominator tree which numbers the BasicBlock
+  const BasicBlock* pdom_root_;
+
+  /// Preorder and postorder numbers of the BasicBlock in the post dominator
+  /// tree, or kUnnumbered
+  uint32_t pdom_preorder_;
+  uint32_t pdom_postorder_;
+
   /// The set of predecessors of the BasicBlock
   std::vector<BasicBlock*> predecessors_;
 
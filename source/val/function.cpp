@@ -49,6 +49,7 @@ Function::Function(uint32_t function_id, uint32_t result_type_id,
       declaration_type_(FunctionDecl::kFunctionDeclUnknown),
       end_has_been_registered_(false),
       blocks_(),
+      block_numbers_(),
       current_block_(nullptr),
       pseudo_entry_block_(0),
       pseudo_exit_block_(kInvalidId),
@@ -76,8 +77,8 @@ spv_result_t Function::RegisterLoopMerge(uint32_t merge_id,
                                          uint32_t continue_id) {
   RegisterBlock(merge_id, false);
   RegisterBlock(continue_id, false);
-  BasicBlock& merge_block = blocks_.at(merge_id);
-  BasicBlock& continue_target_block = blocks_.at(continue_id);
+  BasicBlock& merge_block = *FindOrAddBlock(merge_id).first;
+  BasicBlock& continue_target_block = *FindOrAddBlock(continue_id).first;
   assert(current_block_ &&
          "RegisterLoopMerge must be called when called within a block");
 
@@ -98,7 +99,7 @@ spv_result_t Function::RegisterLoopMerge(uint32_t merge_id,
 
 spv_result_t Function::RegisterSelectionMerge(uint32_t merge_id) {
   RegisterBlock(merge_id, false);
-  BasicBlock& merge_block = blocks_.at(merge_id);
+  BasicBlock& merge_block = *FindOrAddBlock(merge_id).first;
   current_block_->set_type(kBlockTypeHeader);
   merge_block.set_type(kBlockTypeMerge);
   merge_block_header_[&merge_block] = current_block_;
@@ -119,17 +120,16 @@ spv_result_t Function::RegisterBlock(uint32_t block_id, bool is_definition) {
       declaration_type_ == FunctionDecl::kFunctionDeclDefinition &&
       "RegisterBlocks can only be called after declaration_type_ is defined");
 
-  std::unordered_map<uint32_t, BasicBlock>::iterator inserted_block;
+  BasicBlock* inserted_block;
   bool success = false;
-  tie(inserted_block, success) =
-      blocks_.insert({block_id, BasicBlock(block_id)});
+  tie(inserted_block, success) = FindOrAddBlock(block_id);
   if (is_definition) {  // new block definition
     assert(current_block_ == nullptr &&
            "Register Block can only be called when parsing a binary outside of "
            "a BasicBlock");
 
     undefined_blocks_.erase(block_id);
-    current_block_ = &inserted_block->second;
+    current_block_ = inserted_block;
     ordered_blocks_.push_back(current_block_);
     if (IsFirstBlock(block_id)) current_block_->set_reachable(true);
   } else if (success) {  // Block doesn't exsist but this is not a definition
@@ -147,15 +147,14 @@ void Function::RegisterBlockEnd(vector<uint32_t> next_list,
   vector<BasicBlock*> next_blocks;
   next_blocks.reserve(next_list.size());
 
-  std::unordered_map<uint32_t, BasicBlock>::iterator inserted_block;
+  BasicBlock* inserted_block;
   bool success;
   for (uint32_t successor_id : next_list) {
-    tie(inserted_block, success) =
-        blocks_.insert({successor_id, BasicBlock(successor_id)});
+    tie(inserted_block, success) = FindOrAddBlock(successor_id);
     if (success) {
       undefined_blocks_.insert(successor_id);
     }
-    next_blocks.push_back(&inserted_block->second);
+    next_blocks.push_back(inserted_block);
   }
 
   if (current_block_->is_type(kBlockTypeLoop)) {
@@ -182,11 +181,7 @@ void Function::RegisterBlockEnd(vector<uint32_t> next_list,
 }
 
 void Function::RegisterFunctionEnd() {
-  if (!end_has_been_registered_) {
-    end_has_been_registered_ = true;
-
-    ComputeAugmentedCFG();
-  }
+  end_has_been_registered_ = true;
 }
 
 size_t Function::block_count() const { return blocks_.size(); }
@@ -226,9 +221,9 @@ bool Function::IsBlockType(uint32_t merge_block_id, BlockType type) const {
 }
 
 pair<const BasicBlock*, bool> Function::GetBlock(uint32_t block_id) const {
-  const auto b = blocks_.find(block_id);
-  if (b != end(blocks_)) {
-    const BasicBlock* block = &(b->second);
+  const auto b = block_numbers_.find(block_id);
+  if (b != end(block_numbers_)) {
+    const BasicBlock* block = &blocks_[b->second];
     bool defined =
         undefined_blocks_.find(block->id()) == end(undefined_blocks_);
     return make_pair(block, defined);
@@ -244,6 +239,13 @@ pair<BasicBlock*, bool> Function::GetBlock(uint32_t block_id) {
   return make_pair(const_cast<BasicBlock*>(out), defined);
 }
 
+pair<BasicBlock*, bool> Function::FindOrAddBlock(uint32_t block_id) {
+  const auto inserted = block_numbers_.insert(
+      make_pair(block_id, static_cast<uint32_t>(blocks_.size())));
+  if (inserted.second) blocks_.emplace_back(block_id);
+  return make_pair(&blocks_[inserted.first->second], inserted.second);
+}
+
 Function::GetBlocksFunction Function::AugmentedCFGSuccessorsFunction() const {
   return [this](const BasicBlock* block) {
     auto where = augmented_successors_map_.find(block);
@@ -271,6 +273,7 @@ Function::GetBlocksFunction Function::AugmentedCFGPredecessorsFunction() const {
 }
 
 void Function::ComputeAugmentedCFG() {
+  assert(end_has_been_registered_);
   // Compute the successors of the pseudo-entry block, and
   // the predecessors of the pseudo exit block.
   auto succ_func = [](const BasicBlock* b) { return b->successors(); };
@@ -15,6 +15,7 @@
 #ifndef LIBSPIRV_VAL_FUNCTION_H_
 #define LIBSPIRV_VAL_FUNCTION_H_
 
+#include <deque>
 #include <functional>
 #include <list>
 #include <map>
@@ -225,15 +226,19 @@ class Function {
   }
 
   // Returns a set with ids of all functions called from this function.
-  const std::set<uint32_t> function_call_targets() const {
+  const std::set<uint32_t>& function_call_targets() const {
     return function_call_targets_;
   }
 
- private:
   // Computes the representation of the augmented CFG.
   // Populates augmented_successors_map_ and augmented_predecessors_map_.
+  // Must be called once, after the end of the function has been registered,
+  // and before the augmented CFG is used. It only touches this function, so
+  // it may run for several functions in parallel.
   void ComputeAugmentedCFG();
 
+ private:
+
   // Adds a copy of the given Construct, and tracks it by its entry block.
   // Returns a reference to the stored construct.
   Construct& AddConstruct(const Construct& new_construct);
@@ -243,6 +248,10 @@ class Function {
   Construct& FindConstructForEntryBlock(const BasicBlock* entry_block,
                                         ConstructType t);
 
+  // Returns the block with the given ID, adding it if it does not exist yet.
+  // The second element of the pair is true if the block was added.
+  std::pair<BasicBlock*, bool> FindOrAddBlock(uint32_t block_id);
+
   /// The result id of the OpLabel that defined this block
   uint32_t id_;
 
@@ -261,8 +270,12 @@ class Function {
   // Have we finished parsing this function?
   bool end_has_been_registered_;
 
-  /// The blocks in the function mapped by block ID
-  std::unordered_map<uint32_t, BasicBlock> blocks_;
+  /// The blocks in the function, indexed by block number. Blocks are
+  /// numbered in the order they are first referenced.
+  std::deque<BasicBlock> blocks_;
+
+  /// Maps the ID of each block to its block number
+  std::unordered_map<uint32_t, uint32_t> block_numbers_;
 
   /// A list of blocks in the order they appeared in the binary
   std::vector<BasicBlock*> ordered_blocks_;
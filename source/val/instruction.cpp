@@ -32,12 +32,12 @@ OPERATOR(==)
 #undef OPERATOR
 
 Instruction::Instruction(const spv_parsed_instruction_t* inst,
-                         Function* defining_function,
+                         InstructionArena* arena, Function* defining_function,
                          BasicBlock* defining_block)
-    : words_(inst->words, inst->words + inst->num_words),
-      operands_(inst->operands, inst->operands + inst->num_operands),
-      inst_({words_.data(), inst->num_words, inst->opcode, inst->ext_inst_type,
-             inst->type_id, inst->result_id, operands_.data(),
+    : inst_({arena->words.Copy(inst->words, inst->num_words).data(),
+             inst->num_words, inst->opcode, inst->ext_inst_type, inst->type_id,
+             inst->result_id,
+             arena->operands.Copy(inst->operands, inst->num_operands).data(),
              inst->num_operands}),
       function_(defining_function),
       block_(defining_block),
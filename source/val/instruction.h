@@ -23,19 +23,30 @@
 
 #include "spirv-tools/libspirv.h"
 #include "table.h"
+#include "util/arena.h"
+#include "util/span.h"
 
 namespace libspirv {
 
 class BasicBlock;
 class Function;
 
+/// Storage for the words and operands of Instructions, which is usually
+/// shared by all the instructions of a module.
+struct InstructionArena {
+  spvtools::utils::Arena<uint32_t> words;
+  spvtools::utils::Arena<spv_parsed_operand_t> operands;
+};
+
 /// Wraps the spv_parsed_instruction struct along with use and definition of the
 /// instruction's result id
 class Instruction {
  public:
-  explicit Instruction(const spv_parsed_instruction_t* inst,
-                       Function* defining_function = nullptr,
-                       BasicBlock* defining_block = nullptr);
+  /// Creates an Instruction whose words and operands are copied into
+  /// \p arena, which must outlive it.
+  Instruction(const spv_parsed_instruction_t* inst, InstructionArena* arena,
+              Function* defining_function = nullptr,
+              BasicBlock* defining_block = nullptr);
 
   /// Registers the use of the Instruction in instruction \p inst at \p index
   void RegisterUse(const Instruction* inst, uint32_t index);
@@ -61,14 +72,20 @@ class Instruction {
   }
 
   /// The word used to define the Instruction
-  uint32_t word(size_t index) const { return words_[index]; }
+  uint32_t word(size_t index) const {
+    assert(index < inst_.num_words);
+    return inst_.words[index];
+  }
 
   /// The words used to define the Instruction
-  const std::vector<uint32_t>& words() const { return words_; }
+  spvtools::utils::Span<uint32_t> words() const {
+    return spvtools::utils::Span<uint32_t>(inst_.words, inst_.num_words);
+  }
 
   /// The operands of the Instruction
-  const std::vector<spv_parsed_operand_t>& operands() const {
-    return operands_;
+  spvtools::utils::Span<spv_parsed_operand_t> operands() const {
+    return spvtools::utils::Span<spv_parsed_operand_t>(inst_.operands,
+                                                       inst_.num_operands);
   }
 
   /// Provides direct access to the stored C instruction object.
@@ -77,15 +94,16 @@ class Instruction {
   // Casts the words belonging to the operand under |index| to |T| and returns.
   template <typename T>
   T GetOperandAs(size_t index) const {
-    const spv_parsed_operand_t& operand = operands_.at(index);
+    assert(index < inst_.num_operands);
+    const spv_parsed_operand_t& operand = inst_.operands[index];
     assert(operand.num_words * 4 >= sizeof(T));
     assert(operand.offset + operand.num_words <= inst_.num_words);
-    return *reinterpret_cast<const T*>(&words_[operand.offset]);
+    return *reinterpret_cast<const T*>(&inst_.words[operand.offset]);
   }
 
  private:
-  const std::vector<uint32_t> words_;
-  const std::vector<spv_parsed_operand_t> operands_;
+  /// The instruction, whose words and operands are stored in an
+  /// InstructionArena
   spv_parsed_instruction_t inst_;
 
   /// The function in which this instruction was declared
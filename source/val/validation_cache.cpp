@@ -0,0 +1,271 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "val/validation_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+
+namespace libspirv {
+
+namespace {
+
+// Identifies a cache file, and changes whenever its layout does.
+const uint32_t kEntryMagic = 0x32435653;  // "SVC2"
+
+// The number of words compared at a time with the words of a cache entry.
+const size_t kCompareChunkSize = 1024;
+
+// The size of a stored message without its text: the level, the position and
+// the size of the text.
+const uint64_t kMessageHeaderSize = 4 + 3 * 8 + 4;
+
+const uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+const uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+
+uint64_t Rotl(uint64_t value, int bits) {
+  return (value << bits) | (value >> (64 - bits));
+}
+
+uint64_t Round(uint64_t lane, uint64_t word) {
+  return Rotl(lane + word * kPrime2, 31) * kPrime1;
+}
+
+uint64_t Avalanche(uint64_t value) {
+  value ^= value >> 33;
+  value *= 0xFF51AFD7ED558CCDull;
+  value ^= value >> 33;
+  value *= 0xC4CEB9FE1A85EC53ull;
+  value ^= value >> 33;
+  return value;
+}
+
+// Hashes the |num_words| words starting at |words| into |hash|, starting
+// from |seed|. The words are spread over four independent lanes, so that the
+// multiplications of consecutive words do not wait on each other and the
+// loop can be vectorized.
+void HashWords(const uint32_t* words, size_t num_words, const uint64_t seed[2],
+               uint64_t hash[2]) {
+  uint64_t lanes[4] = {seed[0] + kPrime1, seed[1] + kPrime2, seed[0] ^ kPrime2,
+                       seed[1] - kPrime1};
+  size_t i = 0;
+  for (; i + 4 <= num_words; i += 4) {
+    for (int lane = 0; lane < 4; ++lane) {
+      lanes[lane] = Round(lanes[lane], words[i + lane]);
+    }
+  }
+  for (int lane = 0; i < num_words; ++i, ++lane) {
+    lanes[lane] = Round(lanes[lane], words[i]);
+  }
+
+  const uint64_t length = static_cast<uint64_t>(num_words);
+  hash[0] = Avalanche(Rotl(lanes[0], 1) + Rotl(lanes[1], 7) +
+                      Rotl(lanes[2], 12) + Rotl(lanes[3], 18) + length);
+  hash[1] = Avalanche(Rotl(lanes[3], 1) ^ Rotl(lanes[2], 7) ^
+                      Rotl(lanes[1], 12) ^ Rotl(lanes[0], 18) ^ ~length);
+}
+
+// Writes the |size| bytes at |data| to |file|. Returns false on failure.
+bool Write(FILE* file, const void* data, size_t size) {
+  return size == 0 || fwrite(data, size, 1, file) == 1;
+}
+
+// Reads |size| bytes from |file| into |data|. Returns false on failure.
+bool Read(FILE* file, void* data, size_t size) {
+  return size == 0 || fread(data, size, 1, file) == 1;
+}
+
+// Reads |num_words| words from |file| and returns true if they are the words
+// at |words|. Reads in chunks, so that a large module is not held twice.
+bool ReadSameWords(FILE* file, const uint32_t* words, size_t num_words) {
+  uint32_t chunk[kCompareChunkSize];
+  while (num_words > 0) {
+    const size_t size = std::min(num_words, kCompareChunkSize);
+    if (!Read(file, chunk, size * sizeof(uint32_t)) ||
+        !std::equal(chunk, chunk + size, words)) {
+      return false;
+    }
+    words += size;
+    num_words -= size;
+  }
+  return true;
+}
+
+// Writes the size of the |num_words| words at |words|, then the words, to
+// |file|. Returns false on failure.
+bool WriteWords(FILE* file, const uint32_t* words, size_t num_words) {
+  const uint64_t size = num_words;
+  return Write(file, &size, sizeof(size)) &&
+         Write(file, words, num_words * sizeof(uint32_t));
+}
+
+// Reads a size from |file| and returns true if it is |num_words| and it is
+// followed by the words at |words|.
+bool ReadSameSizeAndWords(FILE* file, const uint32_t* words,
+                          size_t num_words) {
+  uint64_t size = 0;
+  return Read(file, &size, sizeof(size)) && size == num_words &&
+         ReadSameWords(file, words, num_words);
+}
+
+// Returns the number of bytes of |file| after the current position, or 0 if it
+// cannot be determined.
+uint64_t RemainingBytes(FILE* file) {
+  const long position = ftell(file);
+  if (position < 0 || fseek(file, 0, SEEK_END) != 0) return 0;
+  const long end = ftell(file);
+  if (fseek(file, position, SEEK_SET) != 0 || end < position) return 0;
+  return static_cast<uint64_t>(end - position);
+}
+
+struct FileCloser {
+  void operator()(FILE* file) const { fclose(file); }
+};
+using FilePtr = std::unique_ptr<FILE, FileCloser>;
+
+}  // namespace
+
+ValidationCache::ValidationCache(spv_target_env target_env,
+                                 const spv_validator_options_t& options)
+    : directory_(options.cache_directory) {
+  // Everything besides the module which decides the result of validation.
+  const validator_universal_limits_t& limits = options.universal_limits_;
+  config_ = {
+      static_cast<uint32_t>(target_env),
+      limits.max_struct_members,
+      limits.max_struct_depth,
+      limits.max_local_variables,
+      limits.max_global_variables,
+      limits.max_switch_branches,
+      limits.max_function_args,
+      limits.max_control_flow_nesting_depth,
+      limits.max_access_chain_indexes,
+      options.relax_struct_store,
+      options.relax_logcial_pointer,
+      options.max_errors};
+  for (const char* c = spvSoftwareVersionDetailsString(); *c; ++c) {
+    config_.push_back(static_cast<unsigned char>(*c));
+  }
+  const uint64_t zero_seed[2] = {0, 0};
+  HashWords(config_.data(), config_.size(), zero_seed, seed_);
+}
+
+std::string ValidationCache::Key(const uint32_t* words,
+                                 size_t num_words) const {
+  uint64_t hash[2];
+  HashWords(words, num_words, seed_, hash);
+  char key[33];
+  snprintf(key, sizeof(key), "%016llx%016llx",
+           static_cast<unsigned long long>(hash[0]),
+           static_cast<unsigned long long>(hash[1]));
+  return key;
+}
+
+std::string ValidationCache::EntryPath(const uint32_t* words,
+                                       size_t num_words) const {
+  return directory_ + "/" + Key(words, num_words) + ".spvval";
+}
+
+bool ValidationCache::Lookup(const uint32_t* words, size_t num_words,
+                             spv_result_t* result,
+                             std::vector<Message>* messages) const {
+  FilePtr file(fopen(EntryPath(words, num_words).c_str(), "rb"));
+  if (!file) return false;
+
+  // The key is only a hash: the entry is a hit only if it was stored for the
+  // same configuration and the same module.
+  uint32_t magic = 0;
+  int32_t stored_result = 0;
+  uint32_t num_messages = 0;
+  if (!Read(file.get(), &magic, sizeof(magic)) || magic != kEntryMagic ||
+      !ReadSameSizeAndWords(file.get(), config_.data(), config_.size()) ||
+      !ReadSameSizeAndWords(file.get(), words, num_words) ||
+      !Read(file.get(), &stored_result, sizeof(stored_result)) ||
+      !Read(file.get(), &num_messages, sizeof(num_messages))) {
+    return false;
+  }
+  // The counts and sizes below come from the file. A corrupt entry must not
+  // make us allocate more than the file could hold.
+  if (num_messages > RemainingBytes(file.get()) / kMessageHeaderSize) {
+    return false;
+  }
+
+  std::vector<Message> stored_messages(num_messages);
+  for (Message& message : stored_messages) {
+    int32_t level = 0;
+    uint64_t position[3] = {0, 0, 0};
+    uint32_t text_size = 0;
+    if (!Read(file.get(), &level, sizeof(level)) ||
+        !Read(file.get(), position, sizeof(position)) ||
+        !Read(file.get(), &text_size, sizeof(text_size)) ||
+        text_size > RemainingBytes(file.get())) {
+      return false;
+    }
+    message.level = static_cast<spv_message_level_t>(level);
+    message.position.line = static_cast<size_t>(position[0]);
+    message.position.column = static_cast<size_t>(position[1]);
+    message.position.index = static_cast<size_t>(position[2]);
+    message.text.resize(text_size);
+    if (!Read(file.get(), &message.text[0], text_size)) return false;
+  }
+
+  *result = static_cast<spv_result_t>(stored_result);
+  messages->swap(stored_messages);
+  return true;
+}
+
+void ValidationCache::Store(const uint32_t* words, size_t num_words,
+                            spv_result_t result,
+                            const std::vector<Message>& messages) const {
+  // Write to a temporary file first, so that concurrent lookups never see a
+  // partially written entry.
+  const std::string path = EntryPath(words, num_words);
+  const std::string temp_path =
+      path + "." +
+      std::to_string(
+          std::chrono::steady_clock::now().time_since_epoch().count()) +
+      ".tmp";
+  FilePtr file(fopen(temp_path.c_str(), "wb"));
+  if (!file) return;
+
+  const int32_t stored_result = result;
+  const uint32_t num_messages = static_cast<uint32_t>(messages.size());
+  bool ok = Write(file.get(), &kEntryMagic, sizeof(kEntryMagic)) &&
+            WriteWords(file.get(), config_.data(), config_.size()) &&
+            WriteWords(file.get(), words, num_words) &&
+            Write(file.get(), &stored_result, sizeof(stored_result)) &&
+            Write(file.get(), &num_messages, sizeof(num_messages));
+  for (const Message& message : messages) {
+    if (!ok) break;
+    const int32_t level = message.level;
+    const uint64_t position[3] = {message.position.line,
+                                  message.position.column,
+                                  message.position.index};
+    const uint32_t text_size = static_cast<uint32_t>(message.text.size());
+    ok = Write(file.get(), &level, sizeof(level)) &&
+         Write(file.get(), position, sizeof(position)) &&
+         Write(file.get(), &text_size, sizeof(text_size)) &&
+         Write(file.get(), message.text.data(), text_size);
+  }
+  ok = fclose(file.release()) == 0 && ok;
+
+  if (!ok || rename(temp_path.c_str(), path.c_str()) != 0) {
+    remove(temp_path.c_str());
+  }
+}
+
+}  // namespace libspirv
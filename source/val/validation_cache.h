@@ -0,0 +1,75 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef LIBSPIRV_VAL_VALIDATION_CACHE_H_
+#define LIBSPIRV_VAL_VALIDATION_CACHE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "spirv-tools/libspirv.h"
+#include "spirv_validator_options.h"
+
+namespace libspirv {
+
+// A persistent cache of validation results. Each result is stored in a file
+// of the cache directory named after the key of the validated module. The
+// file also holds the configuration and the words of the module, which are
+// compared on lookup, so that modules whose keys collide never share a result.
+class ValidationCache {
+ public:
+  // A message reported while validating a module.
+  struct Message {
+    spv_message_level_t level;
+    spv_position_t position;
+    std::string text;
+  };
+
+  // Creates a cache of the results of validating modules for |target_env|
+  // with |options|, which holds the cache directory.
+  ValidationCache(spv_target_env target_env,
+                  const spv_validator_options_t& options);
+
+  // Looks up the result of validating the module in |words|. On a hit returns
+  // true and stores the result in |result| and the messages reported by the
+  // validation in |messages|.
+  bool Lookup(const uint32_t* words, size_t num_words, spv_result_t* result,
+              std::vector<Message>* messages) const;
+
+  // Stores the result of validating the module in |words|, and the messages
+  // reported by the validation. Failing to write to the cache is not an
+  // error.
+  void Store(const uint32_t* words, size_t num_words, spv_result_t result,
+             const std::vector<Message>& messages) const;
+
+  // Returns the key under which the result of validating the module in
+  // |words| is stored, as 32 hexadecimal digits.
+  std::string Key(const uint32_t* words, size_t num_words) const;
+
+ private:
+  // Returns the path of the cache file of the module in |words|.
+  std::string EntryPath(const uint32_t* words, size_t num_words) const;
+
+  std::string directory_;
+  // The target environment, the options and the library version, which
+  // decide the result of validation besides the module.
+  std::vector<uint32_t> config_;
+  // The hash of config_, which seeds the hash of each module.
+  uint64_t seed_[2];
+};
+
+}  // namespace libspirv
+
+#endif  // LIBSPIRV_VAL_VALIDATION_CACHE_H_
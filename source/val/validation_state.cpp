@@ -17,6 +17,7 @@
 #include <cassert>
 
 #include "opcode.h"
+#include "spirv_validator_options.h"
 #include "val/basic_block.h"
 #include "val/construct.h"
 #include "val/function.h"
@@ -142,6 +143,9 @@ ValidationState_t::ValidationState_t(const spv_const_context ctx,
     : context_(ctx),
       options_(opt),
       instruction_counter_(0),
+      first_error_(SPV_SUCCESS),
+      num_errors_(0),
+      suppress_diagnostics_(false),
       unresolved_forward_ids_{},
       operand_names_{},
       current_layout_section_(kLayoutCapabilities),
@@ -150,6 +154,7 @@ ValidationState_t::ValidationState_t(const spv_const_context ctx,
       module_extensions_(),
       ordered_instructions_(),
       all_definitions_(),
+      id_bound_(0),
       global_vars_(),
       local_vars_(),
       struct_nesting_depth_(),
@@ -251,10 +256,20 @@ bool ValidationState_t::IsOpcodeInCurrentLayoutSection(SpvOp op) {
 
 DiagnosticStream ValidationState_t::diag(spv_result_t error_code) const {
   return libspirv::DiagnosticStream(
-      {0, 0, static_cast<size_t>(instruction_counter_)}, context_->consumer,
+      {0, 0, static_cast<size_t>(instruction_counter_)},
+      suppress_diagnostics_
+          ? nullptr
+          : (diagnostic_consumer_ ? diagnostic_consumer_ : context_->consumer),
       error_code);
 }
 
+bool ValidationState_t::RegisterError(spv_result_t error) const {
+  assert(error != SPV_SUCCESS);
+  if (first_error_ == SPV_SUCCESS) first_error_ = error;
+  ++num_errors_;
+  return num_errors_ < options_->max_errors;
+}
+
 deque<Function>& ValidationState_t::functions() { return module_functions_; }
 
 Function& ValidationState_t::current_function() {
@@ -403,16 +418,29 @@ spv_result_t ValidationState_t::RegisterFunctionEnd() {
 void ValidationState_t::RegisterInstruction(
     const spv_parsed_instruction_t& inst) {
   if (in_function_body()) {
-    ordered_instructions_.emplace_back(&inst, &current_function(),
+    ordered_instructions_.emplace_back(&inst, &instruction_arena_,
+                                       &current_function(),
                                        current_function().current_block());
   } else {
-    ordered_instructions_.emplace_back(&inst, nullptr, nullptr);
+    ordered_instructions_.emplace_back(&inst, &instruction_arena_, nullptr,
+                                       nullptr);
   }
   uint32_t id = ordered_instructions_.back().id();
   if (id) {
     all_definitions_.insert(make_pair(id, &ordered_instructions_.back()));
   }
 
+  if (id && id < id_bound_ &&
+      spvOpcodeGeneratesType(static_cast<SpvOp>(inst.opcode))) {
+    const TypeInfo info = ComputeTypeInfo(ordered_instructions_.back());
+    if (id < kMaxDenseTypeId) {
+      if (id >= type_infos_.size()) type_infos_.resize(id + 1);
+      type_infos_[id] = info;
+    } else {
+      sparse_type_infos_[id] = info;
+    }
+  }
+
   // If the instruction is using an OpTypeSampledImage as an operand, it should
   // be recorded. The validator will ensure that all usages of an
   // OpTypeSampledImage and its definition are in the same basic block.
@@ -449,7 +477,8 @@ void ValidationState_t::setIdBound(const uint32_t bound) { id_bound_ = bound; }
 
 bool ValidationState_t::RegisterUniqueTypeDeclaration(
     const spv_parsed_instruction_t& inst) {
-  std::vector<uint32_t> key;
+  std::vector<uint32_t>& key = type_declaration_key_;
+  key.clear();
   key.push_back(static_cast<uint32_t>(inst.opcode));
   for (int index = 0; index < inst.num_operands; ++index) {
     const spv_parsed_operand_t& operand = inst.operands[index];
@@ -463,7 +492,7 @@ bool ValidationState_t::RegisterUniqueTypeDeclaration(
     key.insert(key.end(), inst.words + words_begin, inst.words + words_end);
   }
 
-  return unique_type_declarations_.insert(std::move(key)).second;
+  return unique_type_declarations_.Insert(key);
 }
 
 uint32_t ValidationState_t::GetTypeId(uint32_t id) const {
@@ -476,209 +505,172 @@ SpvOp ValidationState_t::GetIdOpcode(uint32_t id) const {
   return inst ? inst->opcode() : SpvOpNop;
 }
 
-uint32_t ValidationState_t::GetComponentType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  switch (inst->opcode()) {
+ValidationState_t::TypeInfo ValidationState_t::ComputeTypeInfo(
+    const Instruction& inst) const {
+  TypeInfo info;
+  info.opcode = inst.opcode();
+  switch (inst.opcode()) {
     case SpvOpTypeFloat:
     case SpvOpTypeInt:
     case SpvOpTypeBool:
-      return id;
+      info.component_type = inst.id();
+      info.component_opcode = inst.opcode();
+      info.bit_width = inst.opcode() == SpvOpTypeBool ? 1 : inst.word(2);
+      info.signedness = inst.opcode() == SpvOpTypeInt ? inst.word(3) : 0;
+      info.dimension = 1;
+      break;
 
     case SpvOpTypeVector:
-      return inst->word(2);
+    case SpvOpTypeMatrix: {
+      const TypeInfo element_info = GetTypeInfo(inst.word(2));
+      info.component_type = inst.opcode() == SpvOpTypeVector
+                                ? inst.word(2)
+                                : element_info.component_type;
+      info.component_opcode = element_info.component_opcode;
+      info.bit_width = element_info.bit_width;
+      info.signedness = element_info.signedness;
+      info.dimension = inst.word(3);
+      info.element_type = inst.word(2);
+      break;
+    }
 
-    case SpvOpTypeMatrix:
-      return GetComponentType(inst->word(2));
+    case SpvOpTypeArray:
+    case SpvOpTypeRuntimeArray:
+    case SpvOpTypeSampledImage:
+      info.element_type = inst.word(2);
+      break;
+
+    case SpvOpTypePointer:
+      info.storage_class = inst.word(2);
+      info.element_type = inst.word(3);
+      break;
 
     default:
       break;
   }
+  return info;
+}
 
-  if (inst->type_id()) return GetComponentType(inst->type_id());
-
-  assert(0);
-  return 0;
+const ValidationState_t::TypeInfo* ValidationState_t::FindTypeInfo(
+    uint32_t id) const {
+  if (id < kMaxDenseTypeId) {
+    if (id < type_infos_.size() && type_infos_[id].opcode != SpvOpNop) {
+      return &type_infos_[id];
+    }
+    return nullptr;
+  }
+  const auto it = sparse_type_infos_.find(id);
+  return it == sparse_type_infos_.end() ? nullptr : &it->second;
 }
 
-uint32_t ValidationState_t::GetDimension(uint32_t id) const {
+ValidationState_t::TypeInfo ValidationState_t::GetTypeInfo(uint32_t id) const {
+  if (const TypeInfo* info = FindTypeInfo(id)) return *info;
   const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  switch (inst->opcode()) {
-    case SpvOpTypeFloat:
-    case SpvOpTypeInt:
-    case SpvOpTypeBool:
-      return 1;
-
-    case SpvOpTypeVector:
-    case SpvOpTypeMatrix:
-      return inst->word(3);
+  if (!inst || !spvOpcodeGeneratesType(inst->opcode())) return TypeInfo();
+  return ComputeTypeInfo(*inst);
+}
 
-    default:
-      break;
-  }
+ValidationState_t::TypeInfo ValidationState_t::GetTypeInfoOfTypeOrObject(
+    uint32_t id) const {
+  if (const TypeInfo* info = FindTypeInfo(id)) return *info;
+  const Instruction* inst = FindDef(id);
+  if (!inst) return TypeInfo();
+  if (spvOpcodeGeneratesType(inst->opcode())) return ComputeTypeInfo(*inst);
+  return GetTypeInfo(inst->type_id());
+}
 
-  if (inst->type_id()) return GetDimension(inst->type_id());
+uint32_t ValidationState_t::GetComponentType(uint32_t id) const {
+  const TypeInfo info = GetTypeInfoOfTypeOrObject(id);
+  assert(info.component_type);
+  return info.component_type;
+}
 
-  assert(0);
-  return 0;
+uint32_t ValidationState_t::GetDimension(uint32_t id) const {
+  const TypeInfo info = GetTypeInfoOfTypeOrObject(id);
+  assert(info.dimension);
+  return info.dimension;
 }
 
 uint32_t ValidationState_t::GetBitWidth(uint32_t id) const {
-  const uint32_t component_type_id = GetComponentType(id);
-  const Instruction* inst = FindDef(component_type_id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeFloat || inst->opcode() == SpvOpTypeInt)
-    return inst->word(2);
-
-  if (inst->opcode() == SpvOpTypeBool) return 1;
-
-  assert(0);
-  return 0;
+  const TypeInfo info = GetTypeInfoOfTypeOrObject(id);
+  assert(info.bit_width);
+  return info.bit_width;
 }
 
 bool ValidationState_t::IsFloatScalarType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  return inst->opcode() == SpvOpTypeFloat;
+  return GetTypeInfo(id).opcode == SpvOpTypeFloat;
 }
 
 bool ValidationState_t::IsFloatVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsFloatScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeVector &&
+         info.component_opcode == SpvOpTypeFloat;
 }
 
 bool ValidationState_t::IsFloatScalarOrVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeFloat) {
-    return true;
-  }
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsFloatScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return (info.opcode == SpvOpTypeFloat || info.opcode == SpvOpTypeVector) &&
+         info.component_opcode == SpvOpTypeFloat;
 }
 
 bool ValidationState_t::IsIntScalarType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  return inst->opcode() == SpvOpTypeInt;
+  return GetTypeInfo(id).opcode == SpvOpTypeInt;
 }
 
 bool ValidationState_t::IsIntVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsIntScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeVector &&
+         info.component_opcode == SpvOpTypeInt;
 }
 
 bool ValidationState_t::IsIntScalarOrVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeInt) {
-    return true;
-  }
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsIntScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return (info.opcode == SpvOpTypeInt || info.opcode == SpvOpTypeVector) &&
+         info.component_opcode == SpvOpTypeInt;
 }
 
 bool ValidationState_t::IsUnsignedIntScalarType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  return inst->opcode() == SpvOpTypeInt && inst->word(3) == 0;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeInt && info.signedness == 0;
 }
 
 bool ValidationState_t::IsUnsignedIntVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsUnsignedIntScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeVector &&
+         info.component_opcode == SpvOpTypeInt && info.signedness == 0;
 }
 
 bool ValidationState_t::IsSignedIntScalarType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  return inst->opcode() == SpvOpTypeInt && inst->word(3) == 1;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeInt && info.signedness == 1;
 }
 
 bool ValidationState_t::IsSignedIntVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsSignedIntScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeVector &&
+         info.component_opcode == SpvOpTypeInt && info.signedness == 1;
 }
 
 bool ValidationState_t::IsBoolScalarType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  return inst->opcode() == SpvOpTypeBool;
+  return GetTypeInfo(id).opcode == SpvOpTypeBool;
 }
 
 bool ValidationState_t::IsBoolVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsBoolScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeVector &&
+         info.component_opcode == SpvOpTypeBool;
 }
 
 bool ValidationState_t::IsBoolScalarOrVectorType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeBool) {
-    return true;
-  }
-
-  if (inst->opcode() == SpvOpTypeVector) {
-    return IsBoolScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return (info.opcode == SpvOpTypeBool || info.opcode == SpvOpTypeVector) &&
+         info.component_opcode == SpvOpTypeBool;
 }
 
 bool ValidationState_t::IsFloatMatrixType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-
-  if (inst->opcode() == SpvOpTypeMatrix) {
-    return IsFloatScalarType(GetComponentType(id));
-  }
-
-  return false;
+  const TypeInfo info = GetTypeInfo(id);
+  return info.opcode == SpvOpTypeMatrix &&
+         info.component_opcode == SpvOpTypeFloat;
 }
 
 bool ValidationState_t::GetMatrixTypeInfo(uint32_t id, uint32_t* num_rows,
@@ -687,23 +679,20 @@ bool ValidationState_t::GetMatrixTypeInfo(uint32_t id, uint32_t* num_rows,
                                           uint32_t* component_type) const {
   if (!id) return false;
 
-  const Instruction* mat_inst = FindDef(id);
-  assert(mat_inst);
-  if (mat_inst->opcode() != SpvOpTypeMatrix) return false;
-
-  const uint32_t vec_type = mat_inst->word(2);
-  const Instruction* vec_inst = FindDef(vec_type);
-  assert(vec_inst);
+  const TypeInfo mat_info = GetTypeInfo(id);
+  assert(mat_info.opcode != SpvOpNop);
+  if (mat_info.opcode != SpvOpTypeMatrix) return false;
 
-  if (vec_inst->opcode() != SpvOpTypeVector) {
+  const TypeInfo vec_info = GetTypeInfo(mat_info.element_type);
+  if (vec_info.opcode != SpvOpTypeVector) {
     assert(0);
     return false;
   }
 
-  *num_cols = mat_inst->word(3);
-  *num_rows = vec_inst->word(3);
-  *column_type = mat_inst->word(2);
-  *component_type = vec_inst->word(2);
+  *num_cols = mat_info.dimension;
+  *num_rows = vec_info.dimension;
+  *column_type = mat_info.element_type;
+  *component_type = vec_info.element_type;
 
   return true;
 }
@@ -726,21 +715,19 @@ bool ValidationState_t::GetStructMemberTypes(
 }
 
 bool ValidationState_t::IsPointerType(uint32_t id) const {
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  return inst->opcode() == SpvOpTypePointer;
+  return GetTypeInfo(id).opcode == SpvOpTypePointer;
 }
 
 bool ValidationState_t::GetPointerTypeInfo(uint32_t id, uint32_t* data_type,
                                            uint32_t* storage_class) const {
   if (!id) return false;
 
-  const Instruction* inst = FindDef(id);
-  assert(inst);
-  if (inst->opcode() != SpvOpTypePointer) return false;
+  const TypeInfo info = GetTypeInfo(id);
+  assert(info.opcode != SpvOpNop);
+  if (info.opcode != SpvOpTypePointer) return false;
 
-  *storage_class = inst->word(2);
-  *data_type = inst->word(3);
+  *storage_class = info.storage_class;
+  *data_type = info.element_type;
   return true;
 }
 
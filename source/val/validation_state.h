@@ -21,6 +21,7 @@
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "assembly_grammar.h"
@@ -30,6 +31,7 @@
 #include "latest_version_spirv_header.h"
 #include "spirv-tools/libspirv.h"
 #include "spirv_definition.h"
+#include "util/word_sequence_set.h"
 #include "val/function.h"
 #include "val/instruction.h"
 
@@ -137,6 +139,35 @@ class ValidationState_t {
 
   libspirv::DiagnosticStream diag(spv_result_t error_code) const;
 
+  /// Records an error found by the validator. Returns true if validation
+  /// should go on looking for more errors, as allowed by the max_errors
+  /// option.
+  bool RegisterError(spv_result_t error) const;
+
+  /// Returns the first error found by the validator, or SPV_SUCCESS.
+  spv_result_t first_error() const { return first_error_; }
+
+  /// Returns the number of errors found by the validator.
+  uint32_t num_errors() const { return num_errors_; }
+
+  /// Records that the instruction defining the given <id> is invalid.
+  void RegisterFailedId(uint32_t id) { failed_ids_.insert(id); }
+
+  /// Returns true if the instruction defining the given <id> is invalid.
+  bool IsFailedId(uint32_t id) const { return failed_ids_.count(id) != 0; }
+
+  /// Sets whether diag() reports its diagnostics. They are suppressed for
+  /// errors which are likely caused by an earlier one.
+  void set_suppress_diagnostics(bool suppress) {
+    suppress_diagnostics_ = suppress;
+  }
+
+  /// Sets the consumer which receives the diagnostics of diag() instead of the
+  /// consumer of the context. An empty consumer restores the default.
+  void set_diagnostic_consumer(spvtools::MessageConsumer consumer) {
+    diagnostic_consumer_ = std::move(consumer);
+  }
+
   /// Returns the function states
   std::deque<Function>& functions();
 
@@ -151,6 +182,24 @@ class ValidationState_t {
   /// function end instruction
   bool in_function_body() const;
 
+  /// Marks the function with the given id as unchanged since an earlier
+  /// successful validation, so that its function-level checks are skipped.
+  void SkipFunctionChecks(uint32_t function_id) {
+    skipped_functions_.insert(function_id);
+  }
+
+  /// Returns true if the function-level checks of the function with the given
+  /// id are skipped.
+  bool function_checks_skipped(uint32_t function_id) const {
+    return skipped_functions_.count(function_id) != 0;
+  }
+
+  /// Records that the module has been validated successfully.
+  void set_module_valid() { module_valid_ = true; }
+
+  /// Returns true if the module was validated successfully.
+  bool module_valid() const { return module_valid_; }
+
   /// Returns true if called after a label instruction but before a branch
   /// instruction
   bool in_block() const;
@@ -429,6 +478,45 @@ class ValidationState_t {
  private:
   ValidationState_t(const ValidationState_t&);
 
+  // The properties of a type which the validator queries most often. They are
+  // computed once, when the type is registered.
+  struct TypeInfo {
+    // The opcode of the type, or OpNop if the id is not a type.
+    SpvOp opcode = SpvOpNop;
+    // For scalar, vector and matrix types, the scalar component type, its
+    // opcode, bit width and the signedness word of integer components, which
+    // is 0 for unsigned and 1 for signed integers.
+    uint32_t component_type = 0;
+    SpvOp component_opcode = SpvOpNop;
+    uint32_t bit_width = 0;
+    uint32_t signedness = 0;
+    // 1 for scalar types, the number of components of vector types or the
+    // number of columns of matrix types.
+    uint32_t dimension = 0;
+    // The component type of vector types, the column type of matrix types,
+    // the element type of array types, the pointee type of pointer types and
+    // the image type of sampled image types.
+    uint32_t element_type = 0;
+    // The storage class of pointer types.
+    uint32_t storage_class = 0;
+  };
+
+  // Computes the properties of the type declared by |inst|, whose operand
+  // types are already registered.
+  TypeInfo ComputeTypeInfo(const Instruction& inst) const;
+
+  // Returns the stored properties of the type |id|, or nullptr if they are
+  // not stored.
+  const TypeInfo* FindTypeInfo(uint32_t id) const;
+
+  // Returns the properties of the type |id|. Their opcode is OpNop if |id| is
+  // not a type.
+  TypeInfo GetTypeInfo(uint32_t id) const;
+
+  // Returns the properties of the type |id|, or of the type of the object
+  // |id|.
+  TypeInfo GetTypeInfoOfTypeOrObject(uint32_t id) const;
+
   const spv_const_context context_;
 
   /// Stores the Validator command line options. Must be a valid options object.
@@ -437,6 +525,20 @@ class ValidationState_t {
   /// Tracks the number of instructions evaluated by the validator
   int instruction_counter_;
 
+  /// The first error found by the validator, and the number of errors found
+  mutable spv_result_t first_error_;
+  mutable uint32_t num_errors_;
+
+  /// IDs defined by instructions which failed validation
+  std::unordered_set<uint32_t> failed_ids_;
+
+  /// True if diag() does not report its diagnostics
+  bool suppress_diagnostics_;
+
+  /// If set, receives the diagnostics of diag() instead of the consumer of
+  /// the context
+  spvtools::MessageConsumer diagnostic_consumer_;
+
   /// IDs which have been forward declared but have not been defined
   std::unordered_set<uint32_t> unresolved_forward_ids_;
 
@@ -464,6 +566,9 @@ class ValidationState_t {
   /// Extensions declared in the module
   libspirv::ExtensionSet module_extensions_;
 
+  /// Stores the words and operands of all the instructions of the module
+  InstructionArena instruction_arena_;
+
   /// List of all instructions in the order they appear in the binary
   /// Pointers to objects in this container are guaranteed to be stable and
   /// valid until the end of lifetime of the validation state.
@@ -472,6 +577,17 @@ class ValidationState_t {
   /// Instructions that can be referenced by Ids
   std::unordered_map<uint32_t, Instruction*> all_definitions_;
 
+  /// Type ids are dense in valid modules, and the properties of types with
+  /// ids below this are stored in a vector indexed by id. The properties of
+  /// larger ids, which the ID bound in the header allows but valid modules
+  /// rarely use, are stored in a map so that the vector stays small.
+  static const uint32_t kMaxDenseTypeId = 1 << 22;
+
+  /// The properties of the types declared so far. Types with an id outside of
+  /// the ID bound are not stored.
+  std::vector<TypeInfo> type_infos_;
+  std::unordered_map<uint32_t, TypeInfo> sparse_type_infos_;
+
   /// IDs that are entry points, ie, arguments to OpEntryPoint.
   std::vector<uint32_t> entry_points_;
 
@@ -501,9 +617,16 @@ class ValidationState_t {
 
   /// Stores type declarations which need to be unique (i.e. non-aggregates),
   /// in the form [opcode, operand words], result_id is not stored.
-  /// Using ordered set to avoid the need for a vector hash function.
-  /// The size of this container is expected not to exceed double-digits.
-  std::set<std::vector<uint32_t>> unique_type_declarations_;
+  spvtools::utils::WordSequenceSet unique_type_declarations_;
+
+  /// Scratch space for building the keys of unique_type_declarations_.
+  std::vector<uint32_t> type_declaration_key_;
+
+  /// Ids of the functions whose function-level checks are skipped.
+  std::unordered_set<uint32_t> skipped_functions_;
+
+  /// True if the module was validated successfully.
+  bool module_valid_ = false;
 
   AssemblyGrammar grammar_;
 
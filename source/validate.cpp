@@ -36,8 +36,10 @@
 #include "spirv_constant.h"
 #include "spirv_endian.h"
 #include "spirv_validator_options.h"
+#include "table.h"
 #include "val/construct.h"
 #include "val/function.h"
+#include "val/validation_cache.h"
 #include "val/validation_state.h"
 
 using std::function;
@@ -48,13 +50,7 @@ using std::transform;
 using std::vector;
 using std::placeholders::_1;
 
-using libspirv::CfgPass;
-using libspirv::DataRulesPass;
 using libspirv::Extension;
-using libspirv::IdPass;
-using libspirv::InstructionPass;
-using libspirv::LiteralsPass;
-using libspirv::ModuleLayoutPass;
 using libspirv::ValidationState_t;
 
 spv_result_t spvValidateIDs(const spv_instruction_t* pInsts,
@@ -67,6 +63,77 @@ spv_result_t spvValidateIDs(const spv_instruction_t* pInsts,
   return SPV_SUCCESS;
 }
 
+namespace libspirv {
+
+InstructionRuleTable::InstructionRuleTable() : rule_lists_(1) {}
+
+void InstructionRuleTable::AddRule(InstructionRule rule,
+                                   std::initializer_list<SpvOp> opcodes) {
+  for (SpvOp opcode : opcodes) AddRuleForOpcode(rule, opcode);
+}
+
+void InstructionRuleTable::AddRule(InstructionRule rule,
+                                   std::function<bool(SpvOp)> applies) {
+  spv_opcode_table opcode_table = nullptr;
+  spvOpcodeTableGet(&opcode_table, SPV_ENV_UNIVERSAL_1_3);
+  for (uint32_t i = 0; i < opcode_table->count; ++i) {
+    const SpvOp opcode = opcode_table->entries[i].opcode;
+    if (applies(opcode)) AddRuleForOpcode(rule, opcode);
+  }
+}
+
+void InstructionRuleTable::AddRuleForAllOpcodes(InstructionRule rule) {
+  for (auto& rule_list : rule_lists_) rule_list.push_back(rule);
+}
+
+void InstructionRuleTable::AddRuleForOpcode(InstructionRule rule,
+                                            uint32_t opcode) {
+  if (opcode >= rule_list_index_.size()) {
+    rule_list_index_.resize(opcode + 1, 0);
+  }
+  uint32_t& index = rule_list_index_[opcode];
+  if (index == 0) {
+    // Start from the rules every opcode gets so far.
+    index = static_cast<uint32_t>(rule_lists_.size());
+    rule_lists_.push_back(rule_lists_[0]);
+  }
+  auto& rule_list = rule_lists_[index];
+  if (std::find(rule_list.begin(), rule_list.end(), rule) == rule_list.end()) {
+    rule_list.push_back(rule);
+  }
+}
+
+const InstructionRuleTable& GetInstructionRuleTable() {
+  // The order matches the order in which the checks used to run, which
+  // decides the error reported for instructions breaking several rules.
+  static const InstructionRuleTable* table = []() {
+    auto* rules = new InstructionRuleTable;
+    RegisterCapabilityRules(rules);
+    RegisterDataRules(rules);
+    rules->AddRuleForAllOpcodes(IdPass);
+    rules->AddRuleForAllOpcodes(ModuleLayoutPass);
+    rules->AddRuleForAllOpcodes(CfgPass);
+    rules->AddRuleForAllOpcodes(InstructionPass);
+    RegisterTypeUniqueRules(rules);
+    RegisterArithmeticsRules(rules);
+    RegisterCompositesRules(rules);
+    RegisterConversionRules(rules);
+    RegisterDerivativesRules(rules);
+    RegisterLogicalsRules(rules);
+    RegisterBitwiseRules(rules);
+    RegisterExtInstRules(rules);
+    RegisterImageRules(rules);
+    RegisterAtomicsRules(rules);
+    RegisterBarriersRules(rules);
+    RegisterPrimitivesRules(rules);
+    rules->AddRuleForAllOpcodes(LiteralsPass);
+    return rules;
+  }();
+  return *table;
+}
+
+}  // namespace libspirv
+
 namespace {
 
 // TODO(umar): Validate header
@@ -150,6 +217,13 @@ spv_result_t ProcessExtensions(void* user_data,
   return SPV_REQUESTED_TERMINATION;
 }
 
+// Returns true if |rule| records the ids, functions and blocks of the module
+// in the validation state. Later instructions are checked against that state.
+bool RecordsModuleStructure(libspirv::InstructionRule rule) {
+  return rule == libspirv::IdPass || rule == libspirv::ModuleLayoutPass ||
+         rule == libspirv::CfgPass;
+}
+
 spv_result_t ProcessInstruction(void* user_data,
                                 const spv_parsed_instruction_t* inst) {
   ValidationState_t& _ = *(reinterpret_cast<ValidationState_t*>(user_data));
@@ -168,27 +242,60 @@ spv_result_t ProcessInstruction(void* user_data,
   }
 
   DebugInstructionPass(_, inst);
-  if (auto error = CapabilityPass(_, inst)) return error;
-  if (auto error = DataRulesPass(_, inst)) return error;
-  if (auto error = IdPass(_, inst)) return error;
-  if (auto error = ModuleLayoutPass(_, inst)) return error;
-  if (auto error = CfgPass(_, inst)) return error;
-  if (auto error = InstructionPass(_, inst)) return error;
-  if (auto error = TypeUniquePass(_, inst)) return error;
-  if (auto error = ArithmeticsPass(_, inst)) return error;
-  if (auto error = CompositesPass(_, inst)) return error;
-  if (auto error = ConversionPass(_, inst)) return error;
-  if (auto error = DerivativesPass(_, inst)) return error;
-  if (auto error = LogicalsPass(_, inst)) return error;
-  if (auto error = BitwisePass(_, inst)) return error;
-  if (auto error = ExtInstPass(_, inst)) return error;
-  if (auto error = ImagePass(_, inst)) return error;
-  if (auto error = AtomicsPass(_, inst)) return error;
-  if (auto error = BarriersPass(_, inst)) return error;
-  if (auto error = PrimitivesPass(_, inst)) return error;
-  if (auto error = LiteralsPass(_, inst)) return error;
 
-  return SPV_SUCCESS;
+  // Once an error was found, errors in instructions using an <id> defined by
+  // an invalid instruction are most likely caused by the earlier error, and
+  // are not reported.
+  bool uses_failed_id = false;
+  if (_.num_errors() > 0) {
+    for (uint16_t i = 0; i < inst->num_operands; ++i) {
+      const spv_parsed_operand_t& operand = inst->operands[i];
+      if (spvIsIdType(operand.type) &&
+          _.IsFailedId(inst->words[operand.offset])) {
+        uses_failed_id = true;
+        break;
+      }
+    }
+  }
+
+  // Once a rule fails, the rules recording the structure of the module still
+  // run, so that the next instructions are not reported as misplaced or out
+  // of a block. Their errors are not reported, as only the first error of an
+  // instruction is, but a layout or CFG error still stops validation.
+  _.set_suppress_diagnostics(uses_failed_id);
+  spv_result_t error = SPV_SUCCESS;
+  bool structure_broken = false;
+  for (auto rule : libspirv::GetInstructionRuleTable().rules(inst->opcode)) {
+    if (error == SPV_SUCCESS) {
+      error = rule(_, inst);
+      if (error == SPV_ERROR_INVALID_LAYOUT || error == SPV_ERROR_INVALID_CFG)
+        break;
+      if (error != SPV_SUCCESS) _.set_suppress_diagnostics(true);
+    } else if (RecordsModuleStructure(rule)) {
+      const spv_result_t structure_error = rule(_, inst);
+      if (structure_error == SPV_ERROR_INVALID_LAYOUT ||
+          structure_error == SPV_ERROR_INVALID_CFG) {
+        structure_broken = true;
+        break;
+      }
+    }
+  }
+  _.set_suppress_diagnostics(false);
+  if (error == SPV_SUCCESS) return SPV_SUCCESS;
+
+  // Errors in the layout of the module or in its control flow leave the
+  // validation state inconsistent, so they always stop validation.
+  if (structure_broken || error == SPV_ERROR_INVALID_LAYOUT ||
+      error == SPV_ERROR_INVALID_CFG) {
+    if (!uses_failed_id) _.RegisterError(error);
+    return error;
+  }
+
+  // Only the first error of an instruction is reported. Validation of the
+  // module goes on with the next instruction while more errors are allowed.
+  if (inst->result_id) _.RegisterFailedId(inst->result_id);
+  if (uses_failed_id) return SPV_SUCCESS;
+  return _.RegisterError(error) ? SPV_SUCCESS : error;
 }
 
 void printDot(const ValidationState_t& _, const libspirv::BasicBlock& other) {
@@ -224,6 +331,105 @@ void PrintBlocks(ValidationState_t& _, libspirv::Function func) {
 #define UNUSED(func) func
 #endif
 
+// The word ranges of a function in a module binary.
+struct FunctionWords {
+  uint32_t id;
+  // The first word of its OpFunction instruction.
+  size_t begin;
+  // The word after its last OpFunctionParameter instruction.
+  size_t declaration_end;
+  // The word after its OpFunctionEnd instruction.
+  size_t end;
+};
+
+// Splits the module binary in |words| into the words before its first
+// function, which end at |globals_end|, and the words of each function.
+// Returns false if the binary is not in host order or is malformed.
+bool SplitModuleWords(const uint32_t* words, size_t num_words,
+                      size_t* globals_end,
+                      vector<FunctionWords>* functions) {
+  if (num_words < SPV_INDEX_INSTRUCTION || words[0] != SpvMagicNumber) {
+    return false;
+  }
+  *globals_end = num_words;
+  FunctionWords* function = nullptr;
+  for (size_t index = SPV_INDEX_INSTRUCTION; index < num_words;) {
+    const uint32_t word_count = words[index] >> 16;
+    const SpvOp opcode = static_cast<SpvOp>(words[index] & 0xffff);
+    if (word_count == 0 || index + word_count > num_words) return false;
+    if (opcode == SpvOpFunction) {
+      if (word_count < 3 || function) return false;
+      if (functions->empty()) *globals_end = index;
+      functions->push_back({words[index + 2], index, index + word_count, 0});
+      function = &functions->back();
+    } else if (function && opcode == SpvOpFunctionParameter &&
+               function->declaration_end == index) {
+      function->declaration_end = index + word_count;
+    } else if (function && opcode == SpvOpFunctionEnd) {
+      function->end = index + word_count;
+      function = nullptr;
+    }
+    index += word_count;
+  }
+  return function == nullptr;
+}
+
+// Returns the ids of the functions which are the same in the module binaries
+// |old_words| and |new_words|, provided the modules only differ in the bodies
+// of their functions. Returns no ids otherwise.
+vector<uint32_t> FindUnchangedFunctions(const uint32_t* old_words,
+                                        size_t num_old_words,
+                                        const uint32_t* new_words,
+                                        size_t num_new_words) {
+  size_t old_globals_end = 0;
+  size_t new_globals_end = 0;
+  vector<FunctionWords> old_functions;
+  vector<FunctionWords> new_functions;
+  if (!SplitModuleWords(old_words, num_old_words, &old_globals_end,
+                        &old_functions) ||
+      !SplitModuleWords(new_words, num_new_words, &new_globals_end,
+                        &new_functions)) {
+    return {};
+  }
+
+  const auto same_words = [old_words, new_words](size_t old_begin,
+                                                 size_t old_end,
+                                                 size_t new_begin,
+                                                 size_t new_end) {
+    return old_end - old_begin == new_end - new_begin &&
+           std::equal(old_words + old_begin, old_words + old_end,
+                      new_words + new_begin);
+  };
+
+  // The version decides which rules apply. The id bound does not matter, as
+  // any use of an id out of bounds is in a changed function.
+  if (old_words[1] != new_words[1] ||
+      !same_words(SPV_INDEX_INSTRUCTION, old_globals_end,
+                  SPV_INDEX_INSTRUCTION, new_globals_end) ||
+      old_functions.size() != new_functions.size()) {
+    return {};
+  }
+  for (size_t i = 0; i < old_functions.size(); ++i) {
+    const FunctionWords& old_function = old_functions[i];
+    const FunctionWords& new_function = new_functions[i];
+    if (!same_words(old_function.begin, old_function.declaration_end,
+                    new_function.begin, new_function.declaration_end)) {
+      return {};
+    }
+  }
+
+  vector<uint32_t> unchanged;
+  for (size_t i = 0; i < old_functions.size(); ++i) {
+    const FunctionWords& old_function = old_functions[i];
+    const FunctionWords& new_function = new_functions[i];
+    if (same_words(old_function.begin, old_function.end, new_function.begin,
+                   new_function.end)) {
+      unchanged.push_back(new_function.id);
+    }
+  }
+  return unchanged;
+}
+
 UNUSED(void PrintDotGraph(ValidationState_t& _, libspirv::Function func)) {
   if (func.first_block()) {
     string func_name(_.getIdOrName(func.id()));
@@ -263,8 +469,12 @@ spv_result_t ValidateBinaryUsingContextAndValidationState(
   // NOTE: Parse the module and perform inline validation checks. These
   // checks do not require the the knowledge of the whole module.
   if (auto error = spvBinaryParse(&context, vstate, words, num_words, setHeader,
-                                  ProcessInstruction, pDiagnostic))
-    return error;
+                                  ProcessInstruction, pDiagnostic)) {
+    return vstate->num_errors() > 0 ? vstate->first_error() : error;
+  }
+
+  // The checks below need a module whose instructions are valid.
+  if (vstate->num_errors() > 0) return vstate->first_error();
 
   if (vstate->in_function_body())
     return vstate->diag(SPV_ERROR_INVALID_LAYOUT)
@@ -286,16 +496,28 @@ spv_result_t ValidateBinaryUsingContextAndValidationState(
            << id_str.substr(0, id_str.size() - 1);
   }
 
+  // Returns true if validation must stop after a check which returned
+  // |error|, either because it succeeded or because no more errors are
+  // allowed.
+  auto stop_at = [vstate](spv_result_t error) {
+    return error != SPV_SUCCESS && !vstate->RegisterError(error);
+  };
+
   // Validate the preconditions involving adjacent instructions. e.g. SpvOpPhi
   // must only be preceeded by SpvOpLabel, SpvOpPhi, or SpvOpLine.
-  if (auto error = ValidateAdjacency(*vstate)) return error;
+  if (stop_at(ValidateAdjacency(*vstate))) return vstate->first_error();
 
   // CFG checks are performed after the binary has been parsed
   // and the CFGPass has collected information about the control flow
-  if (auto error = PerformCfgChecks(*vstate)) return error;
-  if (auto error = UpdateIdUse(*vstate)) return error;
-  if (auto error = CheckIdDefinitionDominateUse(*vstate)) return error;
-  if (auto error = ValidateDecorations(*vstate)) return error;
+  const spv_result_t cfg_error = PerformCfgChecks(*vstate);
+  if (stop_at(cfg_error)) return vstate->first_error();
+  if (stop_at(UpdateIdUse(*vstate))) return vstate->first_error();
+  // Dominance is only known once the CFG checks succeeded.
+  if (cfg_error == SPV_SUCCESS &&
+      stop_at(CheckIdDefinitionDominateUse(*vstate))) {
+    return vstate->first_error();
+  }
+  if (stop_at(ValidateDecorations(*vstate))) return vstate->first_error();
 
   // Entry point validation. Based on 2.16.1 (Universal Validation Rules) of the
   // SPIRV spec:
@@ -305,16 +527,20 @@ spv_result_t ValidateBinaryUsingContextAndValidationState(
   // OpFunctionCall instruction.
   if (vstate->entry_points().empty() &&
       !vstate->HasCapability(SpvCapabilityLinkage)) {
-    return vstate->diag(SPV_ERROR_INVALID_BINARY)
-           << "No OpEntryPoint instruction was found. This is only allowed if "
-              "the Linkage capability is being used.";
+    if (stop_at(vstate->diag(SPV_ERROR_INVALID_BINARY)
+                << "No OpEntryPoint instruction was found. This is only "
+                   "allowed if the Linkage capability is being used.")) {
+      return vstate->first_error();
+    }
   }
   for (const auto& entry_point : vstate->entry_points()) {
     if (vstate->IsFunctionCallTarget(entry_point)) {
-      return vstate->diag(SPV_ERROR_INVALID_BINARY)
-             << "A function (" << entry_point
-             << ") may not be targeted by both an OpEntryPoint instruction and "
-                "an OpFunctionCall instruction.";
+      if (stop_at(vstate->diag(SPV_ERROR_INVALID_BINARY)
+                  << "A function (" << entry_point
+                  << ") may not be targeted by both an OpEntryPoint "
+                     "instruction and an OpFunctionCall instruction.")) {
+        return vstate->first_error();
+      }
     }
   }
 
@@ -336,13 +562,49 @@ spv_result_t ValidateBinaryUsingContextAndValidationState(
   }
 
   position.index = SPV_INDEX_INSTRUCTION;
-  if (auto error = spvValidateIDs(instructions.data(), instructions.size(),
-                                  *vstate, &position))
-    return error;
+  // Registers its own errors.
+  if (spvValidateIDs(instructions.data(), instructions.size(), *vstate,
+                     &position)) {
+    return vstate->first_error();
+  }
 
-  if (auto error = ValidateBuiltIns(*vstate)) return error;
+  stop_at(ValidateBuiltIns(*vstate));
+  return vstate->first_error();
+}
 
-  return SPV_SUCCESS;
+// Makes |context| store the messages it reports in |*diagnostic|, one per
+// line, at the position of the first one.
+void UseDiagnosticToCollectMessages(spv_context context,
+                                    spv_diagnostic* diagnostic) {
+  assert(diagnostic && *diagnostic == nullptr);
+
+  auto collect_messages = [diagnostic](spv_message_level_t, const char*,
+                                       const spv_position_t& position,
+                                       const char* message) {
+    auto p = position;
+    string text = message;
+    if (*diagnostic) {
+      p = (*diagnostic)->position;
+      text = string((*diagnostic)->error) + "\n" + text;
+      spvDiagnosticDestroy(*diagnostic);
+    }
+    *diagnostic = spvDiagnosticCreate(&p, text.c_str());
+  };
+  libspirv::SetContextMessageConsumer(context, std::move(collect_messages));
+}
+
+// Makes |context| report the messages of validating with |options| in
+// |*diagnostic|, if |diagnostic| is not null.
+void UseDiagnosticForValidation(spv_context context,
+                                spv_const_validator_options options,
+                                spv_diagnostic* diagnostic) {
+  if (!diagnostic) return;
+  *diagnostic = nullptr;
+  if (options->max_errors > 1) {
+    UseDiagnosticToCollectMessages(context, diagnostic);
+  } else {
+    libspirv::UseDiagnosticAsMessageConsumer(context, diagnostic);
+  }
 }
 }  // anonymous namespace
 
@@ -380,16 +642,46 @@ spv_result_t spvValidateWithOptions(const spv_const_context context,
                                     const spv_const_binary binary,
                                     spv_diagnostic* pDiagnostic) {
   spv_context_t hijack_context = *context;
-  if (pDiagnostic) {
-    *pDiagnostic = nullptr;
-    libspirv::UseDiagnosticAsMessageConsumer(&hijack_context, pDiagnostic);
+  UseDiagnosticForValidation(&hijack_context, options, pDiagnostic);
+
+  if (options->cache_directory.empty()) {
+    // Create the ValidationState using the context.
+    ValidationState_t vstate(&hijack_context, options);
+
+    return ValidateBinaryUsingContextAndValidationState(
+        hijack_context, binary->code, binary->wordCount, pDiagnostic, &vstate);
+  }
+
+  // Report a cached result the way the validation reported it.
+  const libspirv::ValidationCache cache(context->target_env, *options);
+  spv_result_t result = SPV_SUCCESS;
+  vector<libspirv::ValidationCache::Message> messages;
+  if (cache.Lookup(binary->code, binary->wordCount, &result, &messages)) {
+    if (hijack_context.consumer) {
+      for (const auto& message : messages) {
+        hijack_context.consumer(message.level, "input", message.position,
+                                message.text.c_str());
+      }
+    }
+    return result;
   }
 
+  // Record the messages of the validation while passing them on.
+  const spvtools::MessageConsumer consumer = hijack_context.consumer;
+  hijack_context.consumer = [&messages, &consumer](
+      spv_message_level_t level, const char* source,
+      const spv_position_t& position, const char* message) {
+    messages.push_back({level, position, message});
+    if (consumer) consumer(level, source, position, message);
+  };
+
   // Create the ValidationState using the context.
   ValidationState_t vstate(&hijack_context, options);
 
-  return ValidateBinaryUsingContextAndValidationState(
+  result = ValidateBinaryUsingContextAndValidationState(
       hijack_context, binary->code, binary->wordCount, pDiagnostic, &vstate);
+  cache.Store(binary->code, binary->wordCount, result, messages);
+  return result;
 }
 
 namespace spvtools {
@@ -399,15 +691,39 @@ spv_result_t ValidateBinaryAndKeepValidationState(
     const uint32_t* words, const size_t num_words, spv_diagnostic* pDiagnostic,
     std::unique_ptr<ValidationState_t>* vstate) {
   spv_context_t hijack_context = *context;
-  if (pDiagnostic) {
-    *pDiagnostic = nullptr;
-    libspirv::UseDiagnosticAsMessageConsumer(&hijack_context, pDiagnostic);
+  UseDiagnosticForValidation(&hijack_context, options, pDiagnostic);
+
+  vstate->reset(new ValidationState_t(&hijack_context, options));
+
+  const spv_result_t result = ValidateBinaryUsingContextAndValidationState(
+      hijack_context, words, num_words, pDiagnostic, vstate->get());
+  if (result == SPV_SUCCESS) (*vstate)->set_module_valid();
+  return result;
+}
+
+spv_result_t RevalidateBinaryAndKeepValidationState(
+    const spv_const_context context, spv_const_validator_options options,
+    const uint32_t* old_words, const size_t num_old_words,
+    const uint32_t* words, const size_t num_words, spv_diagnostic* pDiagnostic,
+    std::unique_ptr<ValidationState_t>* vstate) {
+  vector<uint32_t> unchanged_functions;
+  if (*vstate && (*vstate)->module_valid()) {
+    unchanged_functions =
+        FindUnchangedFunctions(old_words, num_old_words, words, num_words);
   }
 
+  spv_context_t hijack_context = *context;
+  UseDiagnosticForValidation(&hijack_context, options, pDiagnostic);
+
   vstate->reset(new ValidationState_t(&hijack_context, options));
+  for (uint32_t function_id : unchanged_functions) {
+    (*vstate)->SkipFunctionChecks(function_id);
+  }
 
-  return ValidateBinaryUsingContextAndValidationState(
+  const spv_result_t result = ValidateBinaryUsingContextAndValidationState(
       hijack_context, words, num_words, pDiagnostic, vstate->get());
+  if (result == SPV_SUCCESS) (*vstate)->set_module_valid();
+  return result;
 }
 
 spv_result_t ValidateInstructionAndUpdateValidationState(
@@ -16,6 +16,7 @@
 #define LIBSPIRV_VALIDATE_H_
 
 #include <functional>
+#include <initializer_list>
 #include <utility>
 #include <vector>
 
@@ -34,6 +35,47 @@ class BasicBlock;
 using get_blocks_func =
     std::function<const std::vector<BasicBlock*>*(const BasicBlock*)>;
 
+/// A validation rule which checks a single instruction.
+using InstructionRule = spv_result_t (*)(ValidationState_t& _,
+                                         const spv_parsed_instruction_t* inst);
+
+/// Maps each opcode to the instruction rules which need to see instructions
+/// with that opcode, so that validating an instruction only runs the checks
+/// relevant to it. The rules of an opcode run in the order they were added.
+class InstructionRuleTable {
+ public:
+  InstructionRuleTable();
+
+  /// Adds |rule| for each of the |opcodes|.
+  void AddRule(InstructionRule rule, std::initializer_list<SpvOp> opcodes);
+
+  /// Adds |rule| for each opcode of the grammar for which |applies| is true.
+  void AddRule(InstructionRule rule, std::function<bool(SpvOp)> applies);
+
+  /// Adds |rule| for every opcode, including those unknown to the grammar.
+  void AddRuleForAllOpcodes(InstructionRule rule);
+
+  /// Returns the rules to run for instructions with the given |opcode|.
+  const std::vector<InstructionRule>& rules(uint32_t opcode) const {
+    return opcode < rule_list_index_.size()
+               ? rule_lists_[rule_list_index_[opcode]]
+               : rule_lists_[0];
+  }
+
+ private:
+  /// Adds |rule| for a single |opcode|.
+  void AddRuleForOpcode(InstructionRule rule, uint32_t opcode);
+
+  /// Distinct lists of rules. The first list holds the rules added for all
+  /// opcodes, and is used for the opcodes without rules of their own.
+  std::vector<std::vector<InstructionRule>> rule_lists_;
+  /// Index into |rule_lists_| of the rules of each opcode.
+  std::vector<uint32_t> rule_list_index_;
+};
+
+/// Returns the table of the instruction rules run by the validator.
+const InstructionRuleTable& GetInstructionRuleTable();
+
 /// @brief Performs the Control Flow Graph checks
 ///
 /// @param[in] _ the validation state of the module
@@ -110,6 +152,9 @@ spv_result_t IdPass(ValidationState_t& _, const spv_parsed_instruction_t* inst);
 spv_result_t DataRulesPass(ValidationState_t& _,
                            const spv_parsed_instruction_t* inst);
 
+/// Adds DataRulesPass to |table| for the opcodes it validates.
+void RegisterDataRules(InstructionRuleTable* table);
+
 /// Performs instruction validation.
 spv_result_t InstructionPass(ValidationState_t& _,
                              const spv_parsed_instruction_t* inst);
@@ -126,42 +171,72 @@ spv_result_t ValidateBuiltIns(const ValidationState_t& _);
 spv_result_t TypeUniquePass(ValidationState_t& _,
                             const spv_parsed_instruction_t* inst);
 
+/// Adds TypeUniquePass to |table| for the opcodes it validates.
+void RegisterTypeUniqueRules(InstructionRuleTable* table);
+
 /// Validates correctness of arithmetic instructions.
 spv_result_t ArithmeticsPass(ValidationState_t& _,
                              const spv_parsed_instruction_t* inst);
 
+/// Adds ArithmeticsPass to |table| for the opcodes it validates.
+void RegisterArithmeticsRules(InstructionRuleTable* table);
+
 /// Validates correctness of composite instructions.
 spv_result_t CompositesPass(ValidationState_t& _,
                             const spv_parsed_instruction_t* inst);
 
+/// Adds CompositesPass to |table| for the opcodes it validates.
+void RegisterCompositesRules(InstructionRuleTable* table);
+
 /// Validates correctness of conversion instructions.
 spv_result_t ConversionPass(ValidationState_t& _,
                             const spv_parsed_instruction_t* inst);
 
+/// Adds ConversionPass to |table| for the opcodes it validates.
+void RegisterConversionRules(InstructionRuleTable* table);
+
 /// Validates correctness of derivative instructions.
 spv_result_t DerivativesPass(ValidationState_t& _,
                              const spv_parsed_instruction_t* inst);
 
+/// Adds DerivativesPass to |table| for the opcodes it validates.
+void RegisterDerivativesRules(InstructionRuleTable* table);
+
 /// Validates correctness of logical instructions.
 spv_result_t LogicalsPass(ValidationState_t& _,
                           const spv_parsed_instruction_t* inst);
 
+/// Adds LogicalsPass to |table| for the opcodes it validates.
+void RegisterLogicalsRules(InstructionRuleTable* table);
+
 /// Validates correctness of bitwise instructions.
 spv_result_t BitwisePass(ValidationState_t& _,
                          const spv_parsed_instruction_t* inst);
 
+/// Adds BitwisePass to |table| for the opcodes it validates.
+void RegisterBitwiseRules(InstructionRuleTable* table);
+
 /// Validates correctness of image instructions.
 spv_result_t ImagePass(ValidationState_t& _,
                        const spv_parsed_instruction_t* inst);
 
+/// Adds ImagePass to |table| for the opcodes it validates.
+void RegisterImageRules(InstructionRuleTable* table);
+
 /// Validates correctness of atomic instructions.
 spv_result_t AtomicsPass(ValidationState_t& _,
                          const spv_parsed_instruction_t* inst);
 
+/// Adds AtomicsPass to |table| for the opcodes it validates.
+void RegisterAtomicsRules(InstructionRuleTable* table);
+
 /// Validates correctness of barrier instructions.
 spv_result_t BarriersPass(ValidationState_t& _,
                           const spv_parsed_instruction_t* inst);
 
+/// Adds BarriersPass to |table| for the opcodes it validates.
+void RegisterBarriersRules(InstructionRuleTable* table);
+
 /// Validates correctness of literal numbers.
 spv_result_t LiteralsPass(ValidationState_t& _,
                           const spv_parsed_instruction_t* inst);
@@ -170,15 +245,24 @@ spv_result_t LiteralsPass(ValidationState_t& _,
 spv_result_t ExtInstPass(ValidationState_t& _,
                          const spv_parsed_instruction_t* inst);
 
+/// Adds ExtInstPass to |table| for the opcodes it validates.
+void RegisterExtInstRules(InstructionRuleTable* table);
+
 // Validates that capability declarations use operands allowed in the current
 // context.
 spv_result_t CapabilityPass(ValidationState_t& _,
                             const spv_parsed_instruction_t* inst);
 
+/// Adds CapabilityPass to |table| for the opcodes it validates.
+void RegisterCapabilityRules(InstructionRuleTable* table);
+
 /// Validates correctness of primitive instructions.
 spv_result_t PrimitivesPass(ValidationState_t& _,
                             const spv_parsed_instruction_t* inst);
 
+/// Adds PrimitivesPass to |table| for the opcodes it validates.
+void RegisterPrimitivesRules(InstructionRuleTable* table);
+
 }  // namespace libspirv
 
 /// @brief Validate the ID usage of the instruction stream
@@ -188,7 +272,11 @@ spv_result_t PrimitivesPass(ValidationState_t& _,
 /// @param[in] usedefs use-def info from module parsing
 /// @param[in,out] position current position in the stream
 ///
-/// @return result code
+/// Each invalid instruction is registered as an error of @p usedefs, and
+/// validation goes on while more errors are allowed.
+///
+/// @return SPV_ERROR_INVALID_ID once no more errors are allowed, or
+/// SPV_SUCCESS
 spv_result_t spvValidateInstructionIDs(const spv_instruction_t* pInsts,
                                        const uint64_t instCount,
                                        const libspirv::ValidationState_t& state,
@@ -218,6 +306,20 @@ spv_result_t ValidateBinaryAndKeepValidationState(
     const uint32_t* words, const size_t num_words, spv_diagnostic* pDiagnostic,
     std::unique_ptr<libspirv::ValidationState_t>* vstate);
 
+// Performs validation for an edited version of the module whose validation
+// state is pointed to by vstate, and replaces that state by the state of the
+// edited module. |old_words| must be the binary of the earlier version, kept
+// by the caller; the validation state does not copy it. If the earlier
+// version was valid, and the edit is confined to function bodies, the CFG,
+// dominance and id checks of the functions the edit left untouched are not
+// repeated. The context and options must be the same as for the earlier
+// validation.
+spv_result_t RevalidateBinaryAndKeepValidationState(
+    const spv_const_context context, spv_const_validator_options options,
+    const uint32_t* old_words, const size_t num_old_words,
+    const uint32_t* words, const size_t num_words, spv_diagnostic* pDiagnostic,
+    std::unique_ptr<libspirv::ValidationState_t>* vstate);
+
 // Performs validation for a single instruction and updates given validation
 // state.
 spv_result_t ValidateInstructionAndUpdateValidationState(
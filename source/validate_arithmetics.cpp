@@ -468,4 +468,16 @@ spv_result_t ArithmeticsPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterArithmeticsRules(InstructionRuleTable* table) {
+  table->AddRule(ArithmeticsPass,
+                 {SpvOpFAdd, SpvOpFSub, SpvOpFMul, SpvOpFDiv, SpvOpFRem,
+                  SpvOpFMod, SpvOpFNegate, SpvOpUDiv, SpvOpUMod, SpvOpISub,
+                  SpvOpIAdd, SpvOpIMul, SpvOpSDiv, SpvOpSMod, SpvOpSRem,
+                  SpvOpSNegate, SpvOpDot, SpvOpVectorTimesScalar,
+                  SpvOpMatrixTimesScalar, SpvOpVectorTimesMatrix,
+                  SpvOpMatrixTimesVector, SpvOpMatrixTimesMatrix,
+                  SpvOpOuterProduct, SpvOpIAddCarry, SpvOpISubBorrow,
+                  SpvOpUMulExtended, SpvOpSMulExtended});
+}
+
 }  // namespace libspirv
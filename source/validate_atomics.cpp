@@ -318,4 +318,15 @@ spv_result_t AtomicsPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterAtomicsRules(InstructionRuleTable* table) {
+  table->AddRule(AtomicsPass,
+                 {SpvOpAtomicLoad, SpvOpAtomicStore, SpvOpAtomicExchange,
+                  SpvOpAtomicCompareExchange, SpvOpAtomicCompareExchangeWeak,
+                  SpvOpAtomicIIncrement, SpvOpAtomicIDecrement, SpvOpAtomicIAdd,
+                  SpvOpAtomicISub, SpvOpAtomicSMin, SpvOpAtomicUMin,
+                  SpvOpAtomicSMax, SpvOpAtomicUMax, SpvOpAtomicAnd,
+                  SpvOpAtomicOr, SpvOpAtomicXor, SpvOpAtomicFlagTestAndSet,
+                  SpvOpAtomicFlagClear});
+}
+
 }  // namespace libspirv
@@ -269,4 +269,10 @@ spv_result_t BarriersPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterBarriersRules(InstructionRuleTable* table) {
+  table->AddRule(BarriersPass,
+                 {SpvOpControlBarrier, SpvOpMemoryBarrier,
+                  SpvOpNamedBarrierInitialize, SpvOpMemoryNamedBarrier});
+}
+
 }  // namespace libspirv
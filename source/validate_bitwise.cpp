@@ -236,4 +236,13 @@ spv_result_t BitwisePass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterBitwiseRules(InstructionRuleTable* table) {
+  table->AddRule(BitwisePass,
+                 {SpvOpShiftRightLogical, SpvOpShiftRightArithmetic,
+                  SpvOpShiftLeftLogical, SpvOpBitwiseOr, SpvOpBitwiseXor,
+                  SpvOpBitwiseAnd, SpvOpNot, SpvOpBitFieldInsert,
+                  SpvOpBitFieldSExtract, SpvOpBitFieldUExtract, SpvOpBitReverse,
+                  SpvOpBitCount});
+}
+
 }  // namespace libspirv
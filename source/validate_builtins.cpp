@@ -16,9 +16,9 @@
 
 #include "validate.h"
 
+#include <algorithm>
 #include <functional>
 #include <list>
-#include <map>
 #include <set>
 #include <sstream>
 #include <stack>
@@ -345,37 +345,32 @@ class BuiltInsValidator {
   void Update(const Instruction& inst);
 
   // Traverses call tree and computes function_to_entry_points_,
-  // entry_point_to_execution_model_ and entry_point_to_execution_mode_.
+  // entry_point_execution_models_ and entry_point_to_execution_mode_.
   void ComputeFunctionToEntryPointMapping();
 
   const ValidationState_t& _;
 
   // Mapping id -> list of rules which validate instruction referencing the
-  // id. Rules can create new rules and add them to this container.
-  // Using std::map, and not std::unordered_map to avoid iterator invalidation
-  // during rehashing.
-  std::map<uint32_t, std::list<std::function<spv_result_t(const Instruction&)>>>
+  // id. Rules can create new rules and add them to this container. Rehashing
+  // does not invalidate references to the lists.
+  std::unordered_map<
+      uint32_t, std::list<std::function<spv_result_t(const Instruction&)>>>
       id_to_at_reference_checks_;
 
   // Id of the function we are currently inside. 0 if not inside a function.
   uint32_t function_id_ = 0;
 
-  // Entry points which can (indirectly) call the current function.
-  // The pointer either points to a vector inside to function_to_entry_points_
-  // or to no_entry_points_. The pointer is guaranteed to never be null.
-  const std::vector<uint32_t> no_entry_points;
-  const std::vector<uint32_t>* entry_points_ = &no_entry_points;
-
   // Execution models with which the current function can be called.
   std::set<SpvExecutionModel> execution_models_;
 
-  // Mapping function -> array of entry points inside this
-  // module which can (indirectly) call the function.
-  std::unordered_map<uint32_t, std::vector<uint32_t>> function_to_entry_points_;
+  // Mapping function -> set of entry points inside this module which can
+  // (indirectly) call the function. The set is a bitset indexed like
+  // entry_point_execution_models_.
+  std::unordered_map<uint32_t, std::vector<uint64_t>> function_to_entry_points_;
 
-  // Mapping entry point -> execution model.
-  std::unordered_map<uint32_t, SpvExecutionModel>
-      entry_point_to_execution_model_;
+  // Execution model of each entry point, in the order of the OpEntryPoint
+  // instructions.
+  std::vector<SpvExecutionModel> entry_point_execution_models_;
 
   // Mapping entry point -> execution mode.
   std::unordered_map<uint32_t, SpvExecutionMode> entry_point_to_execution_mode_;
@@ -389,13 +384,12 @@ void BuiltInsValidator::Update(const Instruction& inst) {
     function_id_ = inst.id();
     execution_models_.clear();
     const auto it = function_to_entry_points_.find(function_id_);
-    if (it == function_to_entry_points_.end()) {
-      entry_points_ = &no_entry_points;
-    } else {
-      entry_points_ = &it->second;
-      for (const uint32_t entry_point : *entry_points_) {
-        execution_models_.insert(
-            entry_point_to_execution_model_.at(entry_point));
+    if (it != function_to_entry_points_.end()) {
+      const std::vector<uint64_t>& entry_points = it->second;
+      for (size_t i = 0; i < entry_point_execution_models_.size(); ++i) {
+        if (entry_points[i / 64] & (uint64_t(1) << (i % 64))) {
+          execution_models_.insert(entry_point_execution_models_[i]);
+        }
       }
     }
   }
@@ -404,18 +398,18 @@ void BuiltInsValidator::Update(const Instruction& inst) {
     // Exiting a function.
     assert(function_id_ != 0);
     function_id_ = 0;
-    entry_points_ = &no_entry_points;
     execution_models_.clear();
   }
 }
 
 void BuiltInsValidator::ComputeFunctionToEntryPointMapping() {
+  std::vector<uint32_t> entry_points;
   for (const Instruction& inst : _.ordered_instructions()) {
     const SpvOp opcode = inst.opcode();
     if (opcode == SpvOpFunction) {
       // We are looking for opcodes which can only be found at the top of
       // the module.
-      return;
+      break;
     }
 
     if (opcode == SpvOpExecutionMode) {
@@ -424,24 +418,71 @@ void BuiltInsValidator::ComputeFunctionToEntryPointMapping() {
     }
 
     if (opcode == SpvOpEntryPoint) {
-      const uint32_t entry_point = inst.word(2);
-      entry_point_to_execution_model_[entry_point] =
-          SpvExecutionModel(inst.word(1));
-
-      std::stack<uint32_t> call_stack;
-      std::set<uint32_t> visited;
-      call_stack.push(entry_point);
-      while (!call_stack.empty()) {
-        const uint32_t called_func_id = call_stack.top();
-        call_stack.pop();
-        if (!visited.insert(called_func_id).second) continue;
-
-        function_to_entry_points_[called_func_id].push_back(entry_point);
-
-        const Function* called_func = _.function(called_func_id);
-        assert(called_func);
-        for (uint32_t new_call : called_func->function_call_targets()) {
-          call_stack.push(new_call);
+      entry_points.push_back(inst.word(2));
+      entry_point_execution_models_.push_back(SpvExecutionModel(inst.word(1)));
+    }
+  }
+  if (entry_points.empty()) return;
+
+  // Order the functions reachable from the entry points so that callers come
+  // before the functions they call: the reverse of a depth-first postorder of
+  // the call graph.
+  std::vector<uint32_t> postorder;
+  std::set<uint32_t> visited;
+  // Pairs of a function and the next of its call targets to visit.
+  std::stack<std::pair<const Function*, std::set<uint32_t>::const_iterator>>
+      dfs_stack;
+  for (const uint32_t entry_point : entry_points) {
+    if (!visited.insert(entry_point).second) continue;
+    const Function* entry_func = _.function(entry_point);
+    assert(entry_func);
+    dfs_stack.emplace(entry_func, entry_func->function_call_targets().begin());
+    while (!dfs_stack.empty()) {
+      const Function* func = dfs_stack.top().first;
+      auto& next_call = dfs_stack.top().second;
+      if (next_call == func->function_call_targets().end()) {
+        postorder.push_back(func->id());
+        dfs_stack.pop();
+        continue;
+      }
+      const uint32_t called_func_id = *next_call++;
+      if (!visited.insert(called_func_id).second) continue;
+      const Function* called_func = _.function(called_func_id);
+      assert(called_func);
+      dfs_stack.emplace(called_func,
+                        called_func->function_call_targets().begin());
+    }
+  }
+
+  // Each entry point reaches itself, and the functions called by the
+  // functions it reaches.
+  const size_t num_words = (entry_points.size() + 63) / 64;
+  for (const uint32_t func_id : postorder) {
+    function_to_entry_points_[func_id].assign(num_words, 0);
+  }
+  for (size_t i = 0; i < entry_points.size(); ++i) {
+    function_to_entry_points_[entry_points[i]][i / 64] |= uint64_t(1)
+                                                          << (i % 64);
+  }
+
+  // A single pass in topological order reaches every function, unless the
+  // call graph has cycles, which are invalid but not yet reported here. Keep
+  // going until nothing changes to handle them as well.
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (auto it = postorder.rbegin(); it != postorder.rend(); ++it) {
+      const std::vector<uint64_t>& caller = function_to_entry_points_[*it];
+      for (const uint32_t called_func_id :
+           _.function(*it)->function_call_targets()) {
+        std::vector<uint64_t>& callee =
+            function_to_entry_points_[called_func_id];
+        for (size_t word = 0; word < num_words; ++word) {
+          const uint64_t merged = callee[word] | caller[word];
+          if (merged != callee[word]) {
+            callee[word] = merged;
+            changed = true;
+          }
         }
       }
     }
@@ -2410,10 +2451,13 @@ spv_result_t BuiltInsValidator::Run() {
 
   // Second pass: validate every id reference in the module using
   // rules in id_to_at_reference_checks_.
+
+  // Ids referenced by the current instruction which have been checked.
+  std::vector<uint32_t> already_checked;
   for (const Instruction& inst : _.ordered_instructions()) {
     Update(inst);
 
-    std::set<uint32_t> already_checked;
+    already_checked.clear();
 
     for (const auto& operand : inst.operands()) {
       if (!spvIsIdType(operand.type)) {
@@ -2427,20 +2471,26 @@ spv_result_t BuiltInsValidator::Run() {
         continue;
       }
 
-      if (!already_checked.insert(id).second) {
+      const auto it = id_to_at_reference_checks_.find(id);
+      if (it == id_to_at_reference_checks_.end()) {
+        // No checks are associated with the id.
+        continue;
+      }
+
+      if (std::find(already_checked.begin(), already_checked.end(), id) !=
+          already_checked.end()) {
         // The instruction has already referenced this id.
         continue;
       }
+      already_checked.push_back(id);
 
       // Instruction references the id. Run all checks associated with the id on
       // the instruction. id_to_at_reference_checks_ can be modified in the
-      // process, iterators are safe because it's a tree-based map.
-      const auto it = id_to_at_reference_checks_.find(id);
-      if (it != id_to_at_reference_checks_.end()) {
-        for (const auto& check : it->second) {
-          if (spv_result_t error = check(inst)) {
-            return error;
-          }
+      // process, which keeps the list of checks of the id in place.
+      const auto& checks = it->second;
+      for (const auto& check : checks) {
+        if (spv_result_t error = check(inst)) {
+          return error;
         }
       }
     }
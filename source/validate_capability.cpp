@@ -259,4 +259,8 @@ spv_result_t CapabilityPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterCapabilityRules(InstructionRuleTable* table) {
+  table->AddRule(CapabilityPass, {SpvOpCapability});
+}
+
 }  // namespace libspirv
@@ -20,7 +20,9 @@
 #include <functional>
 #include <iostream>
 #include <map>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -28,6 +30,7 @@
 #include <vector>
 
 #include "spirv_validator_options.h"
+#include "util/parallel.h"
 #include "val/basic_block.h"
 #include "val/construct.h"
 #include "val/function.h"
@@ -92,6 +95,48 @@ spv_result_t MergeBlockAssert(ValidationState_t& _, uint32_t merge_block) {
   return SPV_SUCCESS;
 }
 
+/// Numbers the nodes of the dominator tree given by its |edges|, pairs of a
+/// block and its immediate dominator, in depth first pre and post order. The
+/// root of its tree and its numbers are passed to |set_numbers| for each
+/// block, after which a block A dominates a block B exactly when both have the
+/// same root and the interval of B nests in that of A.
+void NumberDominatorTree(
+    const vector<pair<BasicBlock*, BasicBlock*>>& edges,
+    function<void(const BasicBlock*, BasicBlock*, uint32_t, uint32_t)>
+        set_numbers) {
+  unordered_map<const BasicBlock*, vector<BasicBlock*>> children;
+  vector<BasicBlock*> roots;
+  for (const auto& edge : edges) {
+    if (edge.first == edge.second) {
+      roots.push_back(edge.first);
+    } else {
+      children[edge.second].push_back(edge.first);
+    }
+  }
+
+  uint32_t preorder = 0;
+  uint32_t postorder = 0;
+  unordered_map<const BasicBlock*, uint32_t> preorder_numbers;
+  // Each entry holds a block and the index of its next child to visit.
+  vector<pair<BasicBlock*, size_t>> stack;
+  for (BasicBlock* root : roots) {
+    preorder_numbers[root] = preorder++;
+    stack.emplace_back(root, 0);
+    while (!stack.empty()) {
+      BasicBlock* block = stack.back().first;
+      const vector<BasicBlock*>& block_children = children[block];
+      if (stack.back().second < block_children.size()) {
+        BasicBlock* child = block_children[stack.back().second++];
+        preorder_numbers[child] = preorder++;
+        stack.emplace_back(child, 0);
+      } else {
+        set_numbers(root, block, preorder_numbers[block], postorder++);
+        stack.pop_back();
+      }
+    }
+  }
+}
+
 /// Update the continue construct's exit blocks once the backedge blocks are
 /// identified in the CFG.
 void UpdateContinueConstructExitBlocks(
@@ -256,100 +301,177 @@ spv_result_t StructuredControlFlowChecks(
   return SPV_SUCCESS;
 }
 
-spv_result_t PerformCfgChecks(ValidationState_t& _) {
-  for (auto& function : _.functions()) {
-    // Check all referenced blocks are defined within a function
-    if (function.undefined_block_count() != 0) {
-      string undef_blocks("{");
-      for (auto undefined_block : function.undefined_blocks()) {
-        undef_blocks += _.getIdName(undefined_block) + " ";
-      }
-      return _.diag(SPV_ERROR_INVALID_CFG)
-             << "Block(s) " << undef_blocks << "\b}"
-             << " are referenced but not defined in function "
-             << _.getIdName(function.id());
-    }
+namespace {
 
-    // Set each block's immediate dominator and immediate postdominator,
-    // and find all back-edges.
-    //
-    // We want to analyze all the blocks in the function, even in degenerate
-    // control flow cases including unreachable blocks.  So use the augmented
-    // CFG to ensure we cover all the blocks.
-    vector<const BasicBlock*> postorder;
-    vector<const BasicBlock*> postdom_postorder;
-    vector<pair<uint32_t, uint32_t>> back_edges;
-    auto ignore_block = [](cbb_ptr) {};
-    auto ignore_edge = [](cbb_ptr, cbb_ptr) {};
-    if (!function.ordered_blocks().empty()) {
-      /// calculate dominators
-      spvtools::CFA<libspirv::BasicBlock>::DepthFirstTraversal(
-          function.first_block(), function.AugmentedCFGSuccessorsFunction(),
-          ignore_block, [&](cbb_ptr b) { postorder.push_back(b); },
-          ignore_edge);
-      auto edges = spvtools::CFA<libspirv::BasicBlock>::CalculateDominators(
-          postorder, function.AugmentedCFGPredecessorsFunction());
-      for (auto edge : edges) {
-        edge.first->SetImmediateDominator(edge.second);
-      }
+// Performs the CFG checks of a single function. Only |function| is modified,
+// so the checks of several functions may run in parallel, as long as the
+// diagnostics of each are routed to separate consumers.
+spv_result_t CheckFunctionCfg(ValidationState_t& _, Function& function) {
+  function.ComputeAugmentedCFG();
+
+  // Check all referenced blocks are defined within a function
+  if (function.undefined_block_count() != 0) {
+    string undef_blocks("{");
+    for (auto undefined_block : function.undefined_blocks()) {
+      undef_blocks += _.getIdName(undefined_block) + " ";
+    }
+    return _.diag(SPV_ERROR_INVALID_CFG)
+           << "Block(s) " << undef_blocks << "\b}"
+           << " are referenced but not defined in function "
+           << _.getIdName(function.id());
+  }
 
-      /// calculate post dominators
-      spvtools::CFA<libspirv::BasicBlock>::DepthFirstTraversal(
-          function.pseudo_exit_block(),
-          function.AugmentedCFGPredecessorsFunction(), ignore_block,
-          [&](cbb_ptr b) { postdom_postorder.push_back(b); }, ignore_edge);
-      auto postdom_edges =
-          spvtools::CFA<libspirv::BasicBlock>::CalculateDominators(
-              postdom_postorder, function.AugmentedCFGSuccessorsFunction());
-      for (auto edge : postdom_edges) {
-        edge.first->SetImmediatePostDominator(edge.second);
-      }
-      /// calculate back edges.
-      spvtools::CFA<libspirv::BasicBlock>::DepthFirstTraversal(
-          function.pseudo_entry_block(),
-          function
-              .AugmentedCFGSuccessorsFunctionIncludingHeaderToContinueEdge(),
-          ignore_block, ignore_block, [&](cbb_ptr from, cbb_ptr to) {
-            back_edges.emplace_back(from->id(), to->id());
-          });
+  // Set each block's immediate dominator and immediate postdominator,
+  // and find all back-edges.
+  //
+  // We want to analyze all the blocks in the function, even in degenerate
+  // control flow cases including unreachable blocks.  So use the augmented
+  // CFG to ensure we cover all the blocks.
+  vector<const BasicBlock*> postorder;
+  vector<const BasicBlock*> postdom_postorder;
+  vector<pair<uint32_t, uint32_t>> back_edges;
+  auto ignore_block = [](cbb_ptr) {};
+  auto ignore_edge = [](cbb_ptr, cbb_ptr) {};
+  if (!function.ordered_blocks().empty()) {
+    /// calculate dominators
+    spvtools::CFA<libspirv::BasicBlock>::DepthFirstTraversal(
+        function.first_block(), function.AugmentedCFGSuccessorsFunction(),
+        ignore_block, [&](cbb_ptr b) { postorder.push_back(b); },
+        ignore_edge);
+    auto edges = spvtools::CFA<libspirv::BasicBlock>::CalculateDominators(
+        postorder, function.AugmentedCFGPredecessorsFunction());
+    for (auto edge : edges) {
+      edge.first->SetImmediateDominator(edge.second);
     }
-    UpdateContinueConstructExitBlocks(function, back_edges);
-
-    auto& blocks = function.ordered_blocks();
-    if (!blocks.empty()) {
-      // Check if the order of blocks in the binary appear before the blocks
-      // they dominate
-      for (auto block = begin(blocks) + 1; block != end(blocks); ++block) {
-        if (auto idom = (*block)->immediate_dominator()) {
-          if (idom != function.pseudo_entry_block() &&
-              block == std::find(begin(blocks), block, idom)) {
-            return _.diag(SPV_ERROR_INVALID_CFG)
-                   << "Block " << _.getIdName((*block)->id())
-                   << " appears in the binary before its dominator "
-                   << _.getIdName(idom->id());
-          }
+    NumberDominatorTree(edges, [](const BasicBlock* root, BasicBlock* block,
+                                  uint32_t pre, uint32_t post) {
+      block->SetDominatorTreeNumbers(root, pre, post);
+    });
+
+    /// calculate post dominators
+    spvtools::CFA<libspirv::BasicBlock>::DepthFirstTraversal(
+        function.pseudo_exit_block(),
+        function.AugmentedCFGPredecessorsFunction(), ignore_block,
+        [&](cbb_ptr b) { postdom_postorder.push_back(b); }, ignore_edge);
+    auto postdom_edges =
+        spvtools::CFA<libspirv::BasicBlock>::CalculateDominators(
+            postdom_postorder, function.AugmentedCFGSuccessorsFunction());
+    for (auto edge : postdom_edges) {
+      edge.first->SetImmediatePostDominator(edge.second);
+    }
+    NumberDominatorTree(postdom_edges,
+                        [](const BasicBlock* root, BasicBlock* block,
+                           uint32_t pre, uint32_t post) {
+                          block->SetPostDominatorTreeNumbers(root, pre, post);
+                        });
+    /// calculate back edges.
+    spvtools::CFA<libspirv::BasicBlock>::DepthFirstTraversal(
+        function.pseudo_entry_block(),
+        function
+            .AugmentedCFGSuccessorsFunctionIncludingHeaderToContinueEdge(),
+        ignore_block, ignore_block, [&](cbb_ptr from, cbb_ptr to) {
+          back_edges.emplace_back(from->id(), to->id());
+        });
+  }
+  UpdateContinueConstructExitBlocks(function, back_edges);
+
+  auto& blocks = function.ordered_blocks();
+  if (!blocks.empty()) {
+    // Check if the order of blocks in the binary appear before the blocks
+    // they dominate
+    for (auto block = begin(blocks) + 1; block != end(blocks); ++block) {
+      if (auto idom = (*block)->immediate_dominator()) {
+        if (idom != function.pseudo_entry_block() &&
+            block == std::find(begin(blocks), block, idom)) {
+          return _.diag(SPV_ERROR_INVALID_CFG)
+                 << "Block " << _.getIdName((*block)->id())
+                 << " appears in the binary before its dominator "
+                 << _.getIdName(idom->id());
         }
       }
-      // If we have structed control flow, check that no block has a control
-      // flow nesting depth larger than the limit.
-      if (_.HasCapability(SpvCapabilityShader)) {
-        const int control_flow_nesting_depth_limit =
-            _.options()->universal_limits_.max_control_flow_nesting_depth;
-        for (auto block = begin(blocks); block != end(blocks); ++block) {
-          if (function.GetBlockDepth(*block) >
-              control_flow_nesting_depth_limit) {
-            return _.diag(SPV_ERROR_INVALID_CFG)
-                   << "Maximum Control Flow nesting depth exceeded.";
-          }
+    }
+    // If we have structed control flow, check that no block has a control
+    // flow nesting depth larger than the limit.
+    if (_.HasCapability(SpvCapabilityShader)) {
+      const int control_flow_nesting_depth_limit =
+          _.options()->universal_limits_.max_control_flow_nesting_depth;
+      for (auto block = begin(blocks); block != end(blocks); ++block) {
+        if (function.GetBlockDepth(*block) >
+            control_flow_nesting_depth_limit) {
+          return _.diag(SPV_ERROR_INVALID_CFG)
+                 << "Maximum Control Flow nesting depth exceeded.";
         }
       }
     }
+  }
 
-    /// Structured control flow checks are only required for shader capabilities
-    if (_.HasCapability(SpvCapabilityShader)) {
-      if (auto error = StructuredControlFlowChecks(_, function, back_edges))
-        return error;
+  /// Structured control flow checks are only required for shader capabilities
+  if (_.HasCapability(SpvCapabilityShader)) {
+    if (auto error = StructuredControlFlowChecks(_, function, back_edges))
+      return error;
+  }
+  return SPV_SUCCESS;
+}
+
+}  // anonymous namespace
+
+spv_result_t PerformCfgChecks(ValidationState_t& _) {
+  std::vector<Function*> functions;
+  for (auto& function : _.functions()) {
+    if (!_.function_checks_skipped(function.id())) {
+      functions.push_back(&function);
+    }
+  }
+
+  const uint32_t num_threads =
+      spvutils::ResolveNumThreads(_.options()->num_threads);
+  if (num_threads <= 1 || functions.size() <= 1) {
+    for (auto function : functions) {
+      if (auto error = CheckFunctionCfg(_, *function)) return error;
+    }
+    return SPV_SUCCESS;
+  }
+
+  // Check the functions in parallel. The diagnostics of each function are
+  // held back, and only those of the first failing function, in module
+  // order, are reported. That is what the sequential checks report.
+  struct Message {
+    spv_message_level_t level;
+    spv_position_t position;
+    std::string text;
+  };
+  std::vector<std::vector<Message>> messages(functions.size());
+  std::vector<spv_result_t> results(functions.size(), SPV_SUCCESS);
+  std::mutex mutex;
+  std::unordered_map<std::thread::id, std::vector<Message>*> thread_messages;
+  _.set_diagnostic_consumer([&mutex, &thread_messages](
+      spv_message_level_t level, const char*,
+      const spv_position_t& position, const char* text) {
+    std::vector<Message>* destination = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      destination = thread_messages[std::this_thread::get_id()];
+    }
+    destination->push_back({level, position, text});
+  });
+  spvutils::ParallelFor(functions.size(), num_threads, [&](size_t i) {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      thread_messages[std::this_thread::get_id()] = &messages[i];
+    }
+    results[i] = CheckFunctionCfg(_, *functions[i]);
+  });
+  _.set_diagnostic_consumer(nullptr);
+
+  for (size_t i = 0; i < functions.size(); ++i) {
+    if (results[i] == SPV_SUCCESS) continue;
+    if (const auto& consumer = _.context()->consumer) {
+      for (const auto& message : messages[i]) {
+        consumer(message.level, "input", message.position,
+                 message.text.c_str());
+      }
     }
+    return results[i];
   }
   return SPV_SUCCESS;
 }
@@ -403,10 +525,11 @@ spv_result_t CfgPass(ValidationState_t& _,
       _.current_function().RegisterBlockEnd({cases}, opcode);
     } break;
     case SpvOpReturn: {
+      // The return type is undefined if the OpFunction failed validation, and
+      // that error was already reported.
       const uint32_t return_type = _.current_function().GetResultTypeId();
       const Instruction* return_type_inst = _.FindDef(return_type);
-      assert(return_type_inst);
-      if (return_type_inst->opcode() != SpvOpTypeVoid)
+      if (return_type_inst && return_type_inst->opcode() != SpvOpTypeVoid)
         return _.diag(SPV_ERROR_INVALID_CFG)
                << "OpReturn can only be called from a function with void "
                << "return type.";
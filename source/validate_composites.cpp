@@ -478,4 +478,12 @@ spv_result_t CompositesPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterCompositesRules(InstructionRuleTable* table) {
+  table->AddRule(CompositesPass,
+                 {SpvOpVectorExtractDynamic, SpvOpVectorInsertDynamic,
+                  SpvOpVectorShuffle, SpvOpCompositeConstruct,
+                  SpvOpCompositeExtract, SpvOpCompositeInsert, SpvOpCopyObject,
+                  SpvOpTranspose});
+}
+
 }  // namespace libspirv
@@ -411,4 +411,14 @@ spv_result_t ConversionPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterConversionRules(InstructionRuleTable* table) {
+  table->AddRule(ConversionPass,
+                 {SpvOpConvertFToU, SpvOpConvertFToS, SpvOpConvertSToF,
+                  SpvOpConvertUToF, SpvOpUConvert, SpvOpSConvert, SpvOpFConvert,
+                  SpvOpQuantizeToF16, SpvOpConvertPtrToU, SpvOpSatConvertSToU,
+                  SpvOpSatConvertUToS, SpvOpConvertUToPtr,
+                  SpvOpPtrCastToGeneric, SpvOpGenericCastToPtr,
+                  SpvOpGenericCastToPtrExplicit, SpvOpBitcast});
+}
+
 }  // namespace libspirv
@@ -270,4 +270,12 @@ spv_result_t DataRulesPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterDataRules(InstructionRuleTable* table) {
+  table->AddRule(DataRulesPass,
+                 {SpvOpTypeVector, SpvOpTypeFloat, SpvOpTypeInt,
+                  SpvOpTypeMatrix, SpvOpSpecConstant, SpvOpSpecConstantFalse,
+                  SpvOpSpecConstantTrue, SpvOpTypeForwardPointer,
+                  SpvOpTypeStruct});
+}
+
 }  // namespace libspirv
@@ -66,4 +66,11 @@ spv_result_t DerivativesPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterDerivativesRules(InstructionRuleTable* table) {
+  table->AddRule(DerivativesPass,
+                 {SpvOpDPdx, SpvOpDPdy, SpvOpFwidth, SpvOpDPdxFine,
+                  SpvOpDPdyFine, SpvOpFwidthFine, SpvOpDPdxCoarse,
+                  SpvOpDPdyCoarse, SpvOpFwidthCoarse});
+}
+
 }  // namespace libspirv
@@ -1973,4 +1973,8 @@ spv_result_t ExtInstPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterExtInstRules(InstructionRuleTable* table) {
+  table->AddRule(ExtInstPass, {SpvOpExtInst});
+}
+
 }  // namespace libspirv
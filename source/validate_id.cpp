@@ -394,8 +394,8 @@ bool idUsage::isValid<SpvOpTypeSampler>(const spv_instruction_t*,
 // constant-defining instruction (either OpConstant or
 // OpSpecConstant). typeWords are the words of the constant's-type-defining
 // OpTypeInt.
-bool aboveZero(const vector<uint32_t>& constWords,
-               const vector<uint32_t>& typeWords) {
+bool aboveZero(spvtools::utils::Span<uint32_t> constWords,
+               spvtools::utils::Span<uint32_t> typeWords) {
   const uint32_t width = typeWords[2];
   const bool is_signed = typeWords[3] > 0;
   const uint32_t loWord = constWords[3];
@@ -823,7 +823,7 @@ bool idUsage::isValid<SpvOpConstantSampler>(const spv_instruction_t* inst,
 // True if instruction defines a type that can have a null value, as defined by
 // the SPIR-V spec.  Tracks composite-type components through module to check
 // nullability transitively.
-bool IsTypeNullable(const vector<uint32_t>& instruction,
+bool IsTypeNullable(spvtools::utils::Span<uint32_t> instruction,
                     const ValidationState_t& module) {
   uint16_t opcode;
   uint16_t word_count;
@@ -2623,12 +2623,16 @@ spv_result_t CheckIdDefinitionDominateUse(const ValidationState_t& _) {
   for (const auto& definition : _.all_definitions()) {
     // Check only those definitions defined in a function
     if (const Function* func = definition.second->function()) {
+      // Uses within a function whose checks are skipped were checked by an
+      // earlier validation.
+      const bool skipped = _.function_checks_skipped(func->id());
       if (const BasicBlock* block = definition.second->block()) {
         if (!block->reachable()) continue;
         // If the Id is defined within a block then make sure all references to
         // that Id appear in a blocks that are dominated by the defining block
         for (auto& use_index_pair : definition.second->uses()) {
           const Instruction* use = use_index_pair.first;
+          if (skipped && use->function() == func) continue;
           if (const BasicBlock* use_block = use->block()) {
             if (use_block->reachable() == false) continue;
             if (use->opcode() == SpvOpPhi) {
@@ -2648,6 +2652,7 @@ spv_result_t CheckIdDefinitionDominateUse(const ValidationState_t& _) {
         // appear within the same function
         for (auto use : definition.second->uses()) {
           const Instruction* inst = use.first;
+          if (skipped && inst->function() == func) continue;
           if (inst->function() && inst->function() != func) {
             return _.diag(SPV_ERROR_INVALID_ID)
                    << "ID " << _.getIdName(definition.first)
@@ -2667,6 +2672,7 @@ spv_result_t CheckIdDefinitionDominateUse(const ValidationState_t& _) {
   // blocks
   for (const Instruction* phi : phi_instructions) {
     if (phi->block()->reachable() == false) continue;
+    if (_.function_checks_skipped(phi->function()->id())) continue;
     for (size_t i = 3; i < phi->operands().size(); i += 2) {
       const Instruction* variable = _.FindDef(phi->word(i));
       const BasicBlock* parent =
@@ -2758,9 +2764,18 @@ spv_result_t spvValidateInstructionIDs(const spv_instruction_t* pInsts,
   idUsage idUsage(state.context(), pInsts, instCount, state.memory_model(),
                   state.addressing_model(), state, state.entry_points(),
                   position, state.context()->consumer);
+  bool in_skipped_function = false;
   for (uint64_t instIndex = 0; instIndex < instCount; ++instIndex) {
-    if (!idUsage.isValid(&pInsts[instIndex])) return SPV_ERROR_INVALID_ID;
-    position->index += pInsts[instIndex].words.size();
+    const spv_instruction_t& inst = pInsts[instIndex];
+    if (inst.opcode == SpvOpFunction) {
+      in_skipped_function = state.function_checks_skipped(inst.words[2]);
+    }
+    if (!in_skipped_function && !idUsage.isValid(&inst) &&
+        !state.RegisterError(SPV_ERROR_INVALID_ID)) {
+      return SPV_ERROR_INVALID_ID;
+    }
+    if (inst.opcode == SpvOpFunctionEnd) in_skipped_function = false;
+    position->index += inst.words.size();
   }
   return SPV_SUCCESS;
 }
@@ -1667,4 +1667,31 @@ spv_result_t ImagePass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterImageRules(InstructionRuleTable* table) {
+  table->AddRule(ImagePass,
+                 {SpvOpTypeImage, SpvOpTypeSampledImage, SpvOpSampledImage,
+                  SpvOpImageSampleImplicitLod, SpvOpImageSampleExplicitLod,
+                  SpvOpImageSampleProjImplicitLod,
+                  SpvOpImageSampleProjExplicitLod,
+                  SpvOpImageSparseSampleImplicitLod,
+                  SpvOpImageSparseSampleExplicitLod,
+                  SpvOpImageSampleDrefImplicitLod,
+                  SpvOpImageSampleDrefExplicitLod,
+                  SpvOpImageSampleProjDrefImplicitLod,
+                  SpvOpImageSampleProjDrefExplicitLod,
+                  SpvOpImageSparseSampleDrefImplicitLod,
+                  SpvOpImageSparseSampleDrefExplicitLod, SpvOpImageFetch,
+                  SpvOpImageSparseFetch, SpvOpImageGather, SpvOpImageDrefGather,
+                  SpvOpImageSparseGather, SpvOpImageSparseDrefGather,
+                  SpvOpImageRead, SpvOpImageSparseRead, SpvOpImageWrite,
+                  SpvOpImage, SpvOpImageQueryFormat, SpvOpImageQueryOrder,
+                  SpvOpImageQuerySizeLod, SpvOpImageQuerySize,
+                  SpvOpImageQueryLod, SpvOpImageQueryLevels,
+                  SpvOpImageQuerySamples, SpvOpImageSparseSampleProjImplicitLod,
+                  SpvOpImageSparseSampleProjExplicitLod,
+                  SpvOpImageSparseSampleProjDrefImplicitLod,
+                  SpvOpImageSparseSampleProjDrefExplicitLod,
+                  SpvOpImageSparseTexelsResident});
+}
+
 }  // namespace libspirv
@@ -281,4 +281,21 @@ spv_result_t LogicalsPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterLogicalsRules(InstructionRuleTable* table) {
+  table->AddRule(LogicalsPass,
+                 {SpvOpAny, SpvOpAll, SpvOpIsNan, SpvOpIsInf, SpvOpIsFinite,
+                  SpvOpIsNormal, SpvOpSignBitSet, SpvOpFOrdEqual,
+                  SpvOpFUnordEqual, SpvOpFOrdNotEqual, SpvOpFUnordNotEqual,
+                  SpvOpFOrdLessThan, SpvOpFUnordLessThan, SpvOpFOrdGreaterThan,
+                  SpvOpFUnordGreaterThan, SpvOpFOrdLessThanEqual,
+                  SpvOpFUnordLessThanEqual, SpvOpFOrdGreaterThanEqual,
+                  SpvOpFUnordGreaterThanEqual, SpvOpLessOrGreater, SpvOpOrdered,
+                  SpvOpUnordered, SpvOpLogicalEqual, SpvOpLogicalNotEqual,
+                  SpvOpLogicalOr, SpvOpLogicalAnd, SpvOpLogicalNot, SpvOpSelect,
+                  SpvOpIEqual, SpvOpINotEqual, SpvOpUGreaterThan,
+                  SpvOpUGreaterThanEqual, SpvOpULessThan, SpvOpULessThanEqual,
+                  SpvOpSGreaterThan, SpvOpSGreaterThanEqual, SpvOpSLessThan,
+                  SpvOpSLessThanEqual});
+}
+
 }  // namespace libspirv
@@ -70,4 +70,10 @@ spv_result_t PrimitivesPass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterPrimitivesRules(InstructionRuleTable* table) {
+  table->AddRule(PrimitivesPass,
+                 {SpvOpEmitVertex, SpvOpEndPrimitive, SpvOpEmitStreamVertex,
+                  SpvOpEndStreamPrimitive});
+}
+
 }  // namespace libspirv
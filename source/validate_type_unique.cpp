@@ -59,4 +59,10 @@ spv_result_t TypeUniquePass(ValidationState_t& _,
   return SPV_SUCCESS;
 }
 
+void RegisterTypeUniqueRules(InstructionRuleTable* table) {
+  table->AddRule(TypeUniquePass, [](SpvOp opcode) {
+    return spvOpcodeGeneratesType(opcode) != 0;
+  });
+}
+
 }  // namespace libspirv
@@ -12,6 +12,8 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <memory>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -21,6 +23,7 @@
 
 namespace {
 
+using spvutils::BitReaderChunked;
 using spvutils::BitReaderInterface;
 using spvutils::BitReaderWord64;
 using spvutils::BitsetToStream;
@@ -1280,6 +1283,94 @@ TEST(VariableWidthWriteRead, SingleWriteReadS16) {
   }
 }
 
+// Returns a source which supplies |data| at most |max_bytes_per_call| bytes at
+// a time.
+BitReaderChunked::ByteSource MakeByteSource(const std::vector<uint8_t>& data,
+                                            size_t max_bytes_per_call) {
+  std::shared_ptr<size_t> num_read(new size_t(0));
+  return [data, max_bytes_per_call, num_read](uint8_t* out, size_t max_size) {
+    const size_t size = std::min(std::min(max_size, max_bytes_per_call),
+                                 data.size() - *num_read);
+    std::copy(data.begin() + *num_read, data.begin() + *num_read + size, out);
+    *num_read += size;
+    return size;
+  };
+}
+
+TEST(BitReaderChunked, ReadsLikeBitReaderWord64) {
+  std::vector<uint8_t> data(200);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 37 + 11);
+  }
+  BitReaderWord64 reference(data);
+  BitReaderChunked reader(MakeByteSource(data, 3), 16);
+
+  size_t num_bits = 1;
+  while (reader.GetNumReadBits() + num_bits <= data.size() * 8) {
+    uint64_t expected = 0;
+    uint64_t bits = 0;
+    ASSERT_EQ(num_bits, reference.ReadBits(&expected, num_bits));
+    ASSERT_EQ(num_bits, reader.ReadBits(&bits, num_bits));
+    ASSERT_EQ(expected, bits);
+    EXPECT_EQ(reference.GetNumReadBits(), reader.GetNumReadBits());
+    num_bits = num_bits * 7 % 64 + 1;
+  }
+}
+
+TEST(BitReaderChunked, ReadsToTheEnd) {
+  BitReaderChunked reader(MakeByteSource({0xFF, 0x01}, 1), 16);
+  uint64_t bits = 0;
+  EXPECT_EQ(8u, reader.ReadBits(&bits, 8));
+  EXPECT_EQ(0xFFu, bits);
+  EXPECT_FALSE(reader.OnlyZeroesLeft());
+  EXPECT_EQ(1u, reader.ReadBits(&bits, 1));
+  EXPECT_EQ(1u, bits);
+  EXPECT_TRUE(reader.OnlyZeroesLeft());
+  EXPECT_FALSE(reader.ReachedEnd());
+  EXPECT_EQ(7u, reader.ReadBits(&bits, 64));
+  EXPECT_EQ(0u, bits);
+  EXPECT_TRUE(reader.ReachedEnd());
+  EXPECT_EQ(0u, reader.ReadBits(&bits, 1));
+}
+
+TEST(BitReaderChunked, PeekAndConsume) {
+  std::vector<uint8_t> data(100);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = static_cast<uint8_t>(i * 53 + 7);
+  }
+  BitReaderWord64 reference(data);
+  BitReaderChunked reader(MakeByteSource(data, 5), 16);
+
+  size_t num_bits = 1;
+  while (reader.GetNumReadBits() + num_bits <= data.size() * 8) {
+    uint64_t expected = 0;
+    ASSERT_EQ(num_bits, reference.ReadBits(&expected, num_bits));
+    // Peek more bits than are consumed, as a table-driven decoder would.
+    const size_t num_peeked = std::min<size_t>(num_bits + 9, 56);
+    const uint64_t peeked = reader.PeekBits(num_peeked);
+    ASSERT_EQ(expected, GetLowerBits(peeked, num_bits));
+    ASSERT_TRUE(reader.ConsumeBits(num_bits));
+    EXPECT_EQ(reference.GetNumReadBits(), reader.GetNumReadBits());
+    num_bits = num_bits * 5 % 56 + 1;
+  }
+
+  // Bits past the end read as zero, and cannot be consumed.
+  const size_t num_left = data.size() * 8 - reader.GetNumReadBits();
+  uint64_t expected = 0;
+  ASSERT_EQ(num_left, reference.ReadBits(&expected, num_left));
+  EXPECT_EQ(expected, reader.PeekBits(56));
+  EXPECT_FALSE(reader.ConsumeBits(num_left + 1));
+  EXPECT_TRUE(reader.ConsumeBits(num_left));
+  EXPECT_TRUE(reader.ReachedEnd());
+}
+
+TEST(BitReaderChunked, ReadStreamEmpty) {
+  BitReaderChunked reader(MakeByteSource({}, 1));
+  EXPECT_TRUE(reader.OnlyZeroesLeft());
+  EXPECT_TRUE(reader.ReachedEnd());
+  EXPECT_EQ("", reader.ReadStream(10));
+}
+
 TEST(VariableWidthWriteRead, SingleWriteReadU8) {
   for (int i = 0; i < 256; ++i) {
     const uint8_t val = static_cast<uint8_t>(i);
@@ -14,14 +14,23 @@
 
 // Tests for unique type declaration rules validator.
 
+#include <algorithm>
+#include <cstring>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <sstream>
 #include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "source/comp/markv.h"
+#include "source/spirv_stats.h"
 #include "test_fixture.h"
 #include "tools/comp/markv_model_factory.h"
+#include "tools/comp/markv_model_trainer.h"
 #include "unit_spirv.h"
 
 namespace {
@@ -85,13 +94,41 @@ void Disassemble(const std::vector<uint32_t>& words, std::string* out_text,
   spvTextDestroy(text);
 }
 
+// Returns the words of the instructions of |binary|, with every id replaced by
+// the index of its first appearance.
+std::vector<std::vector<uint32_t>> NormalizeIds(
+    const std::vector<uint32_t>& binary) {
+  struct Normalized {
+    std::unordered_map<uint32_t, uint32_t> ids;
+    std::vector<std::vector<uint32_t>> instructions;
+  } normalized;
+  ScopedContext ctx(SPV_ENV_UNIVERSAL_1_2);
+  const auto parse_instruction = [](void* user_data,
+                                    const spv_parsed_instruction_t* inst) {
+    Normalized* normalized = static_cast<Normalized*>(user_data);
+    std::vector<uint32_t> words(inst->words, inst->words + inst->num_words);
+    for (uint16_t i = 0; i < inst->num_operands; ++i) {
+      const spv_parsed_operand_t& operand = inst->operands[i];
+      if (!spvIsIdType(operand.type)) continue;
+      uint32_t& word = words[operand.offset];
+      word = normalized->ids
+                 .emplace(word, static_cast<uint32_t>(normalized->ids.size()))
+                 .first->second;
+    }
+    normalized->instructions.push_back(std::move(words));
+    return SPV_SUCCESS;
+  };
+  EXPECT_EQ(SPV_SUCCESS,
+            spvBinaryParse(ctx.context, &normalized, binary.data(),
+                           binary.size(), nullptr, parse_instruction, nullptr));
+  return normalized.instructions;
+}
+
 // Encodes/decodes |original|, assembles/dissasembles |original|, then compares
 // the results of the two operations.
-void TestEncodeDecode(MarkvModelType model_type,
+void TestEncodeDecode(const spvtools::MarkvModel& model,
                       const std::string& original_text) {
   ScopedContext ctx(SPV_ENV_UNIVERSAL_1_2);
-  std::unique_ptr<spvtools::MarkvModel> model =
-      spvtools::CreateMarkvModel(model_type);
   spvtools::MarkvCodecOptions options;
 
   std::vector<uint32_t> expected_binary;
@@ -113,7 +150,7 @@ void TestEncodeDecode(MarkvModelType model_type,
 
   std::vector<uint8_t> markv;
   ASSERT_EQ(SPV_SUCCESS, spvtools::SpirvToMarkv(
-                             ctx.context, binary_to_encode, options, *model,
+                             ctx.context, binary_to_encode, options, model,
                              DiagnosticsMessageHandler, output_to_string_stream,
                              spvtools::MarkvDebugConsumer(), &markv));
   ASSERT_FALSE(markv.empty());
@@ -121,13 +158,66 @@ void TestEncodeDecode(MarkvModelType model_type,
   std::vector<uint32_t> decoded_binary;
   ASSERT_EQ(SPV_SUCCESS,
             spvtools::MarkvToSpirv(
-                ctx.context, markv, options, *model, DiagnosticsMessageHandler,
+                ctx.context, markv, options, model, DiagnosticsMessageHandler,
                 spvtools::MarkvLogConsumer(), spvtools::MarkvDebugConsumer(),
                 &decoded_binary));
   ASSERT_FALSE(decoded_binary.empty());
 
   EXPECT_EQ(expected_binary, decoded_binary) << encoder_comments.str();
 
+  // The streaming decoder produces the same words from input supplied a few
+  // bytes at a time.
+  size_t num_read_bytes = 0;
+  const auto markv_source = [&markv, &num_read_bytes](uint8_t* data,
+                                                      size_t max_size) {
+    const size_t size =
+        std::min({max_size, size_t(3), markv.size() - num_read_bytes});
+    std::copy(markv.begin() + num_read_bytes,
+              markv.begin() + num_read_bytes + size, data);
+    num_read_bytes += size;
+    return size;
+  };
+  std::vector<uint32_t> streamed_binary;
+  const auto spirv_consumer = [&streamed_binary](const uint32_t* words,
+                                                 size_t num_words) {
+    streamed_binary.insert(streamed_binary.end(), words, words + num_words);
+    return true;
+  };
+  ASSERT_EQ(SPV_SUCCESS,
+            spvtools::MarkvStreamToSpirv(
+                ctx.context, markv_source, options, model,
+                DiagnosticsMessageHandler, spvtools::MarkvLogConsumer(),
+                spvtools::MarkvDebugConsumer(), spirv_consumer));
+  EXPECT_EQ(decoded_binary, streamed_binary);
+
+  // A container with a single block decodes to the same words.
+  spvtools::MarkvContainerOptions container_options;
+  std::vector<uint8_t> container;
+  std::vector<uint32_t> container_binary;
+  ASSERT_EQ(SPV_SUCCESS, spvtools::SpirvToMarkvContainer(
+                             ctx.context, binary_to_encode, options,
+                             container_options, model,
+                             DiagnosticsMessageHandler, &container));
+  ASSERT_EQ(SPV_SUCCESS, spvtools::MarkvContainerToSpirv(
+                             ctx.context, container, options,
+                             container_options, model,
+                             DiagnosticsMessageHandler, &container_binary));
+  EXPECT_EQ(decoded_binary, container_binary);
+
+  // With a block per function, functions are numbered by block.
+  container_options.min_block_num_words = 0;
+  container_options.num_threads = 4;
+  ASSERT_EQ(SPV_SUCCESS, spvtools::SpirvToMarkvContainer(
+                             ctx.context, binary_to_encode, options,
+                             container_options, model,
+                             DiagnosticsMessageHandler, &container));
+  ASSERT_EQ(SPV_SUCCESS, spvtools::MarkvContainerToSpirv(
+                             ctx.context, container, options,
+                             container_options, model,
+                             DiagnosticsMessageHandler, &container_binary));
+  EXPECT_EQ(decoded_binary[3], container_binary[3]);
+  EXPECT_EQ(NormalizeIds(decoded_binary), NormalizeIds(container_binary));
+
   std::string decoded_text;
   Disassemble(decoded_binary, &decoded_text);
   ASSERT_FALSE(decoded_text.empty());
@@ -135,6 +225,13 @@ void TestEncodeDecode(MarkvModelType model_type,
   EXPECT_EQ(expected_text, decoded_text) << encoder_comments.str();
 }
 
+void TestEncodeDecode(MarkvModelType model_type,
+                      const std::string& original_text) {
+  std::unique_ptr<spvtools::MarkvModel> model =
+      spvtools::CreateMarkvModel(model_type);
+  TestEncodeDecode(*model, original_text);
+}
+
 void TestEncodeDecodeShaderMainBody(MarkvModelType model_type,
                                     const std::string& body) {
   const std::string prefix =
@@ -818,6 +915,529 @@ OpFunctionEnd
 )");
 }
 
+TEST(MarkvModelFile, BuiltInModelsSerializeAndLoad) {
+  for (MarkvModelType model_type :
+       {spvtools::kMarkvModelShaderLite, spvtools::kMarkvModelShaderMid,
+        spvtools::kMarkvModelShaderMax}) {
+    std::unique_ptr<spvtools::MarkvModel> model =
+        spvtools::CreateMarkvModel(model_type);
+    std::vector<uint32_t> words;
+    model->Serialize(&words);
+
+    std::unique_ptr<spvtools::MarkvModel> loaded_model =
+        spvtools::MarkvModel::Deserialize(words.data(), words.size());
+    ASSERT_NE(nullptr, loaded_model);
+    EXPECT_EQ(model->model_type(), loaded_model->model_type());
+    EXPECT_EQ(model->model_version(), loaded_model->model_version());
+
+    std::vector<uint32_t> loaded_words;
+    loaded_model->Serialize(&loaded_words);
+    EXPECT_EQ(words, loaded_words);
+  }
+}
+
+TEST(MarkvModelFile, RejectsInvalidWords) {
+  std::unique_ptr<spvtools::MarkvModel> model =
+      spvtools::CreateMarkvModel(spvtools::kMarkvModelShaderMax);
+  std::vector<uint32_t> words;
+  model->Serialize(&words);
+
+  EXPECT_EQ(nullptr, spvtools::MarkvModel::Deserialize(words.data(), 0));
+  EXPECT_EQ(nullptr, spvtools::MarkvModel::Deserialize(words.data(),
+                                                       words.size() / 2));
+  EXPECT_EQ(nullptr, spvtools::MarkvModel::Deserialize(words.data(),
+                                                       words.size() - 1));
+
+  std::vector<uint32_t> trailing = words;
+  trailing.push_back(0);
+  EXPECT_EQ(nullptr, spvtools::MarkvModel::Deserialize(trailing.data(),
+                                                       trailing.size()));
+
+  std::vector<uint32_t> wrong_magic = words;
+  wrong_magic[0] = SpvMagicNumber;
+  EXPECT_EQ(nullptr, spvtools::MarkvModel::Deserialize(wrong_magic.data(),
+                                                       wrong_magic.size()));
+
+  // The codec of opcode_and_num_operands starts right after the descriptors,
+  // with its kind. Built-in codecs are trees.
+  std::vector<uint32_t> bad_root = words;
+  const size_t num_operand_types = words[11];
+  const size_t num_descriptors = words[12 + num_operand_types];
+  const size_t codec_index = 12 + num_operand_types + 1 + num_descriptors + 1;
+  ASSERT_EQ(1u, bad_root[codec_index - 1]);
+  ASSERT_EQ(0u, bad_root[codec_index]);
+  const size_t root_index = codec_index + 1;
+  bad_root[root_index] = bad_root[root_index + 1];
+  EXPECT_EQ(nullptr, spvtools::MarkvModel::Deserialize(bad_root.data(),
+                                                       bad_root.size()));
+}
+
+TEST(MarkvModelFile, TrainedModelEncodesAndDecodes) {
+  const std::string corpus[] = {
+      R"(
+OpCapability Shader
+OpCapability Linkage
+OpMemoryModel Logical GLSL450
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%v4f32 = OpTypeVector %f32 4
+%ptr = OpTypePointer Function %v4f32
+%one = OpConstant %f32 1
+%ones = OpConstantComposite %v4f32 %one %one %one %one
+%main = OpFunction %void None %fn
+%entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %ones
+%val = OpLoad %v4f32 %var
+%sum = OpFAdd %v4f32 %val %ones
+%prod = OpFMul %v4f32 %sum %val
+OpStore %var %prod
+OpReturn
+OpFunctionEnd
+)",
+      R"(
+OpCapability Shader
+OpCapability Linkage
+OpMemoryModel Logical GLSL450
+OpName %main "main"
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%u32 = OpTypeInt 32 0
+%ptr = OpTypePointer Function %u32
+%two = OpConstant %u32 2
+%main = OpFunction %void None %fn
+%entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %two
+%val = OpLoad %u32 %var
+%prod = OpIMul %u32 %val %two
+OpStore %var %prod
+OpReturn
+OpFunctionEnd
+)"};
+
+  ScopedContext ctx(SPV_ENV_UNIVERSAL_1_2);
+  SetContextMessageConsumer(ctx.context, DiagnosticsMessageHandler);
+  libspirv::SpirvStats stats;
+  for (const std::string& text : corpus) {
+    std::vector<uint32_t> words;
+    Compile(text, &words);
+    ASSERT_EQ(SPV_SUCCESS, libspirv::AggregateStats(*ctx.context, words.data(),
+                                                    words.size(), nullptr,
+                                                    &stats));
+  }
+
+  const spvtools::MarkvModelTrained trained_model(stats);
+  EXPECT_EQ(uint32_t(spvtools::kMarkvModelTrained),
+            trained_model.model_type());
+  EXPECT_NE(nullptr, trained_model.GetOpcodeAndNumOperandsMarkovHuffmanCodec(
+                         SpvOpLoad));
+  ASSERT_NE(nullptr,
+            trained_model.GetNonIdWordHuffmanCodec(SpvOpTypeInt, 1));
+  EXPECT_TRUE(
+      trained_model.GetNonIdWordHuffmanCodec(SpvOpTypeInt, 1)->is_canonical());
+
+  std::vector<uint32_t> words;
+  trained_model.Serialize(&words);
+  std::unique_ptr<spvtools::MarkvModel> loaded_model =
+      spvtools::MarkvModel::Deserialize(words.data(), words.size());
+  ASSERT_NE(nullptr, loaded_model);
+  EXPECT_EQ(trained_model.model_version(), loaded_model->model_version());
+  std::vector<uint32_t> loaded_words;
+  loaded_model->Serialize(&loaded_words);
+  EXPECT_EQ(words, loaded_words);
+
+  for (const std::string& text : corpus) {
+    TestEncodeDecode(*loaded_model, text);
+  }
+}
+
+// Modules with the same preamble and a shared helper function, and a module
+// with a different preamble.
+const char* const kPackModules[] = {
+    R"(
+OpCapability Shader
+OpCapability Linkage
+OpMemoryModel Logical GLSL450
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%ptr = OpTypePointer Function %f32
+%one = OpConstant %f32 1
+%helper = OpFunction %void None %fn
+%helper_entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %one
+OpReturn
+OpFunctionEnd
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%call = OpFunctionCall %void %helper
+OpReturn
+OpFunctionEnd
+)",
+    R"(
+OpCapability Shader
+OpCapability Linkage
+OpMemoryModel Logical GLSL450
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%ptr = OpTypePointer Function %f32
+%one = OpConstant %f32 1
+%helper = OpFunction %void None %fn
+%helper_entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %one
+OpReturn
+OpFunctionEnd
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%main_var = OpVariable %ptr Function
+%call = OpFunctionCall %void %helper
+%val = OpLoad %f32 %main_var
+%sum = OpFAdd %f32 %val %one
+OpStore %main_var %sum
+OpReturn
+OpFunctionEnd
+)",
+    R"(
+OpCapability Shader
+OpCapability Linkage
+OpMemoryModel Logical GLSL450
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%u32 = OpTypeInt 32 0
+%ptr = OpTypePointer Function %u32
+%two = OpConstant %u32 2
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %two
+OpReturn
+OpFunctionEnd
+)"};
+
+// Returns the number of segments of the MARK-V |pack|, which is the fifth
+// word of its header.
+uint32_t GetNumPackSegments(const std::vector<uint8_t>& pack) {
+  uint32_t num_segments = 0;
+  EXPECT_LE(5 * sizeof(uint32_t), pack.size());
+  if (pack.size() >= 5 * sizeof(uint32_t))
+    std::memcpy(&num_segments, pack.data() + 4 * sizeof(uint32_t),
+                sizeof(num_segments));
+  return num_segments;
+}
+
+// Packs the modules assembled from |texts|, checks that every module decodes
+// to its own instructions, and returns the number of segments of the pack.
+// The size of the pack is written to |pack_size| if it is not null.
+uint32_t PackAndUnpack(const std::vector<const char*>& texts,
+                       size_t* pack_size = nullptr) {
+  ScopedContext ctx(SPV_ENV_UNIVERSAL_1_2);
+  spvtools::MarkvCodecOptions options;
+  spvtools::MarkvContainerOptions container_options;
+  container_options.num_threads = 2;
+  std::unique_ptr<spvtools::MarkvModel> model =
+      spvtools::CreateMarkvModel(spvtools::kMarkvModelShaderMid);
+
+  std::vector<std::vector<uint32_t>> modules;
+  for (const char* text : texts) {
+    modules.emplace_back();
+    Compile(text, &modules.back());
+    EXPECT_FALSE(modules.back().empty());
+  }
+
+  std::vector<uint8_t> pack;
+  EXPECT_EQ(SPV_SUCCESS, spvtools::SpirvToMarkvPack(
+                             ctx.context, modules, options, container_options,
+                             *model, DiagnosticsMessageHandler, &pack));
+
+  uint32_t num_modules = 0;
+  EXPECT_EQ(SPV_SUCCESS, spvtools::GetMarkvPackNumModules(
+                             ctx.context, pack.data(), pack.size(), *model,
+                             DiagnosticsMessageHandler, &num_modules));
+  EXPECT_EQ(modules.size(), num_modules);
+
+  // Modules decode in any order, to their instructions with other ids.
+  for (uint32_t index = num_modules; index-- > 0;) {
+    std::vector<uint32_t> decoded_binary;
+    EXPECT_EQ(SPV_SUCCESS,
+              spvtools::MarkvPackToSpirv(ctx.context, pack.data(), pack.size(),
+                                         index, options, container_options,
+                                         *model, DiagnosticsMessageHandler,
+                                         &decoded_binary));
+    EXPECT_EQ(NormalizeIds(modules[index]), NormalizeIds(decoded_binary))
+        << index;
+  }
+
+  std::vector<uint32_t> decoded_binary;
+  EXPECT_NE(SPV_SUCCESS,
+            spvtools::MarkvPackToSpirv(ctx.context, pack.data(), pack.size(),
+                                       num_modules, options, container_options,
+                                       *model, nullptr, &decoded_binary));
+  if (pack_size) *pack_size = pack.size();
+  return GetNumPackSegments(pack);
+}
+
+TEST(MarkvPack, ModulesShareSegmentsAndDecodeByIndex) {
+  uint32_t num_separate_segments = 0;
+  for (const char* text : kPackModules) {
+    num_separate_segments += PackAndUnpack({text});
+  }
+  // The second module shares the global section, the helper function and the
+  // empty residual instructions of the first one, and the third module
+  // shares the empty residual instructions.
+  EXPECT_EQ(num_separate_segments - 4,
+            PackAndUnpack(std::vector<const char*>(std::begin(kPackModules),
+                                                   std::end(kPackModules))));
+}
+
+// Modules with other entry points and names than the first one, and a module
+// with a longer global section whose main function differs.
+const char* const kPackEntryPointModules[] = {
+    R"(
+OpCapability Shader
+OpMemoryModel Logical GLSL450
+OpEntryPoint Fragment %main "main_a" %out
+OpExecutionMode %main OriginUpperLeft
+OpName %helper "helper"
+OpName %main "main_a"
+OpDecorate %out Location 0
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%ptr = OpTypePointer Function %f32
+%out_ptr = OpTypePointer Output %f32
+%out = OpVariable %out_ptr Output
+%one = OpConstant %f32 1
+%helper = OpFunction %void None %fn
+%helper_entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %one
+OpReturn
+OpFunctionEnd
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%call = OpFunctionCall %void %helper
+OpStore %out %one
+OpReturn
+OpFunctionEnd
+)",
+    R"(
+OpCapability Shader
+OpMemoryModel Logical GLSL450
+OpEntryPoint Fragment %main "main_b" %out
+OpExecutionMode %main OriginUpperLeft
+OpName %helper "helper_b"
+OpName %main "main_b"
+OpDecorate %out Location 0
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%ptr = OpTypePointer Function %f32
+%out_ptr = OpTypePointer Output %f32
+%out = OpVariable %out_ptr Output
+%one = OpConstant %f32 1
+%helper = OpFunction %void None %fn
+%helper_entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %one
+OpReturn
+OpFunctionEnd
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%call = OpFunctionCall %void %helper
+OpStore %out %one
+OpReturn
+OpFunctionEnd
+)",
+    R"(
+OpCapability Shader
+OpMemoryModel Logical GLSL450
+OpEntryPoint Fragment %main "main_c" %out
+OpExecutionMode %main OriginUpperLeft
+OpName %helper "helper"
+OpName %main "main_c"
+OpDecorate %out Location 1
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%ptr = OpTypePointer Function %f32
+%out_ptr = OpTypePointer Output %f32
+%out = OpVariable %out_ptr Output
+%one = OpConstant %f32 1
+%two = OpConstant %f32 2
+%helper = OpFunction %void None %fn
+%helper_entry = OpLabel
+%var = OpVariable %ptr Function
+OpStore %var %one
+OpReturn
+OpFunctionEnd
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%call = OpFunctionCall %void %helper
+OpStore %out %two
+OpReturn
+OpFunctionEnd
+)"};
+
+TEST(MarkvPack, ModulesWithOtherEntryPointsAndNamesShareSegments) {
+  const char* const a = kPackEntryPointModules[0];
+  const char* const b = kPackEntryPointModules[1];
+  const char* const c = kPackEntryPointModules[2];
+  // The global section, the helper function, the main function, the table
+  // of the functions and the residual instructions.
+  const uint32_t num_segments = PackAndUnpack({a});
+  EXPECT_EQ(num_segments, PackAndUnpack({b}));
+  // Only the entry points, names and decorations of the second module are
+  // stored apart.
+  EXPECT_EQ(num_segments + 1, PackAndUnpack({a, b}));
+  // The helper function is shared although the global sections differ.
+  EXPECT_EQ(2 * num_segments - 1, PackAndUnpack({a, c}));
+  EXPECT_EQ(2 * num_segments, PackAndUnpack({a, b, c}));
+}
+
+// Returns the text of a variant of a fragment shader, like the many variants
+// shader compilers write of a shader: the helper functions and most types and
+// constants are the same in every variant, while the output location and the
+// constant the result is scaled by differ.
+std::string GetShaderVariant(int variant) {
+  const int kNumHelpers = 6;
+  std::ostringstream text;
+  text << R"(OpCapability Shader
+%glsl = OpExtInstImport "GLSL.std.450"
+OpMemoryModel Logical GLSL450
+OpEntryPoint Fragment %main "main" %uv %color
+OpExecutionMode %main OriginUpperLeft
+OpName %main "main"
+OpName %uv "uv"
+OpName %color "color"
+)";
+  for (int i = 0; i < kNumHelpers; ++i) {
+    text << "OpName %helper" << i << " \"helper" << i << "\"\n";
+  }
+  text << "OpDecorate %uv Location 0\n"
+       << "OpDecorate %color Location " << variant % 2 << "\n"
+       << R"(%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f32 = OpTypeFloat 32
+%v4 = OpTypeVector %f32 4
+%fn_v4 = OpTypeFunction %v4 %v4
+%in_ptr = OpTypePointer Input %v4
+%out_ptr = OpTypePointer Output %v4
+%uv = OpVariable %in_ptr Input
+%color = OpVariable %out_ptr Output
+%half = OpConstant %f32 0.5
+%two = OpConstant %f32 2
+%halves = OpConstantComposite %v4 %half %half %half %half
+%twos = OpConstantComposite %v4 %two %two %two %two
+%scale = OpConstant %f32 )"
+       << variant + 3 << "\n";
+
+  // Every helper calls the one before it, and then computes a longer chain
+  // of arithmetic than it.
+  for (int i = 0; i < kNumHelpers; ++i) {
+    text << "%helper" << i << " = OpFunction %v4 None %fn_v4\n"
+         << "%h" << i << "_0 = OpFunctionParameter %v4\n"
+         << "%helper" << i << "_entry = OpLabel\n";
+    int k = 0;
+    if (i > 0) {
+      text << "%h" << i << "_1 = OpFunctionCall %v4 %helper" << i - 1
+           << " %h" << i << "_0\n";
+      k = 1;
+    }
+    for (int j = 0; j < 10 + 2 * i; ++j, ++k) {
+      const char* const op =
+          j % 3 == 0 ? "OpFMul" : j % 3 == 1 ? "OpFAdd" : "OpFSub";
+      text << "%h" << i << "_" << k + 1 << " = " << op << " %v4 %h" << i
+           << "_" << k << (j % 2 ? " %twos\n" : " %halves\n");
+    }
+    text << "%h" << i << "_" << k + 1 << " = OpExtInst %v4 %glsl Fract %h"
+         << i << "_" << k << "\n"
+         << "OpReturnValue %h" << i << "_" << k + 1 << "\n"
+         << "OpFunctionEnd\n";
+  }
+
+  text << R"(%main = OpFunction %void None %fn
+%main_entry = OpLabel
+%in = OpLoad %v4 %uv
+%result = OpFunctionCall %v4 %helper)"
+       << kNumHelpers - 1 << R"( %in
+%scaled = OpVectorTimesScalar %v4 %result %scale
+OpStore %color %scaled
+OpReturn
+OpFunctionEnd
+)";
+  return text.str();
+}
+
+TEST(MarkvPack, IsSmallerThanModulesEncodedApart) {
+  ScopedContext ctx(SPV_ENV_UNIVERSAL_1_2);
+  spvtools::MarkvCodecOptions options;
+  std::unique_ptr<spvtools::MarkvModel> model =
+      spvtools::CreateMarkvModel(spvtools::kMarkvModelShaderMid);
+
+  std::vector<std::string> texts;
+  size_t separate_size = 0;
+  for (int variant = 0; variant < 8; ++variant) {
+    texts.push_back(GetShaderVariant(variant));
+    std::vector<uint32_t> binary;
+    Compile(texts.back(), &binary);
+    std::vector<uint8_t> markv;
+    ASSERT_EQ(SPV_SUCCESS,
+              spvtools::SpirvToMarkv(ctx.context, binary, options, *model,
+                                     DiagnosticsMessageHandler,
+                                     spvtools::MarkvLogConsumer(),
+                                     spvtools::MarkvDebugConsumer(), &markv));
+    separate_size += markv.size();
+  }
+
+  std::vector<const char*> text_pointers;
+  for (const std::string& text : texts) text_pointers.push_back(text.c_str());
+  size_t pack_size = 0;
+  PackAndUnpack(text_pointers, &pack_size);
+  EXPECT_LT(pack_size, separate_size);
+}
+
+TEST(MarkvPack, RejectsTruncatedPackAndOtherModels) {
+  ScopedContext ctx(SPV_ENV_UNIVERSAL_1_2);
+  spvtools::MarkvCodecOptions options;
+  spvtools::MarkvContainerOptions container_options;
+  std::unique_ptr<spvtools::MarkvModel> model =
+      spvtools::CreateMarkvModel(spvtools::kMarkvModelShaderLite);
+
+  std::vector<std::vector<uint32_t>> modules;
+  for (const char* text : kPackModules) {
+    modules.emplace_back();
+    Compile(text, &modules.back());
+  }
+  std::vector<uint8_t> pack;
+  ASSERT_EQ(SPV_SUCCESS, spvtools::SpirvToMarkvPack(
+                             ctx.context, modules, options, container_options,
+                             *model, DiagnosticsMessageHandler, &pack));
+
+  // The segments of the last module are at the end of the pack.
+  const uint32_t last_index = static_cast<uint32_t>(modules.size() - 1);
+  std::vector<uint32_t> decoded_binary;
+  for (size_t size = 0; size < pack.size(); ++size) {
+    EXPECT_NE(SPV_SUCCESS,
+              spvtools::MarkvPackToSpirv(ctx.context, pack.data(), size,
+                                         last_index, options,
+                                         container_options, *model, nullptr,
+                                         &decoded_binary))
+        << size;
+  }
+
+  std::unique_ptr<spvtools::MarkvModel> other_model =
+      spvtools::CreateMarkvModel(spvtools::kMarkvModelShaderMax);
+  uint32_t num_modules = 0;
+  EXPECT_NE(SPV_SUCCESS, spvtools::GetMarkvPackNumModules(
+                             ctx.context, pack.data(), pack.size(),
+                             *other_model, nullptr, &num_modules));
+}
+
 INSTANTIATE_TEST_CASE_P(AllMarkvModels, MarkvTest,
                         ::testing::ValuesIn(std::vector<MarkvModelType>{
                             spvtools::kMarkvModelShaderLite,
@@ -18,6 +18,8 @@
 #include <sstream>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "util/bit_stream.h"
@@ -26,6 +28,7 @@
 namespace {
 
 using spvutils::BitsToStream;
+using spvutils::GetLengthLimitedCodeLengths;
 using spvutils::HuffmanCodec;
 
 const std::map<std::string, uint32_t>& GetTestSet() {
@@ -312,4 +315,119 @@ TEST(Huffman, CreateFromTextU64) {
   EXPECT_EQ("00", BitsToStream(bits, num_bits));
 }
 
+TEST(Huffman, LengthLimitedCodeLengths) {
+  const std::vector<uint32_t> weights = {1, 1, 2, 4, 8, 16};
+  EXPECT_EQ(std::vector<uint32_t>({5, 5, 4, 3, 2, 1}),
+            GetLengthLimitedCodeLengths(weights, 64));
+  EXPECT_EQ(std::vector<uint32_t>({4, 4, 4, 4, 2, 1}),
+            GetLengthLimitedCodeLengths(weights, 4));
+  EXPECT_EQ(std::vector<uint32_t>({3, 3, 3, 3, 2, 2}),
+            GetLengthLimitedCodeLengths(weights, 3));
+  // Six symbols do not fit in codes of 2 bits.
+  EXPECT_EQ(std::vector<uint32_t>({3, 3, 3, 3, 2, 2}),
+            GetLengthLimitedCodeLengths(weights, 2));
+  EXPECT_EQ(std::vector<uint32_t>({0}), GetLengthLimitedCodeLengths({7}, 4));
+  EXPECT_TRUE(GetLengthLimitedCodeLengths({}, 4).empty());
+}
+
+TEST(Huffman, CanonicalCodesFromHistogram) {
+  HuffmanCodec<std::string> huffman(GetTestSet(), 4);
+  EXPECT_TRUE(huffman.is_canonical());
+
+  const std::vector<std::pair<std::string, uint32_t>> code_lengths =
+      huffman.GetCodeLengths();
+  ASSERT_EQ(GetTestSet().size(), code_lengths.size());
+  EXPECT_EQ(std::make_pair(std::string("e"), 3u), code_lengths[0]);
+  EXPECT_EQ(std::make_pair(std::string("x"), 4u), code_lengths.back());
+
+  uint64_t bits = 0;
+  size_t num_bits = 0;
+  EXPECT_TRUE(huffman.Encode("e", &bits, &num_bits));
+  EXPECT_EQ("000", BitsToStream(bits, num_bits));
+  EXPECT_TRUE(huffman.Encode("a", &bits, &num_bits));
+  EXPECT_EQ("0010", BitsToStream(bits, num_bits));
+  EXPECT_TRUE(huffman.Encode("x", &bits, &num_bits));
+  EXPECT_EQ("1111", BitsToStream(bits, num_bits));
+
+  TestBitReader bit_reader("0011");
+  auto read_bit = [&bit_reader](bool* bit) { return bit_reader.ReadBit(bit); };
+  std::string decoded;
+  ASSERT_TRUE(huffman.DecodeFromStream(read_bit, &decoded));
+  EXPECT_EQ("f", decoded);
+}
+
+TEST(Huffman, CanonicalCodesFromLengths) {
+  const std::vector<std::pair<uint64_t, uint32_t>> code_lengths = {
+      {30, 2}, {10, 1}, {20, 2}};
+  ASSERT_TRUE(HuffmanCodec<uint64_t>::AreValidCodeLengths(code_lengths));
+  HuffmanCodec<uint64_t> huffman(code_lengths);
+  EXPECT_TRUE(huffman.is_canonical());
+
+  const std::vector<std::pair<uint64_t, uint32_t>> expected_code_lengths = {
+      {10, 1}, {20, 2}, {30, 2}};
+  EXPECT_EQ(expected_code_lengths, huffman.GetCodeLengths());
+
+  uint64_t bits = 0;
+  size_t num_bits = 0;
+  EXPECT_TRUE(huffman.Encode(10, &bits, &num_bits));
+  EXPECT_EQ("0", BitsToStream(bits, num_bits));
+  EXPECT_TRUE(huffman.Encode(20, &bits, &num_bits));
+  EXPECT_EQ("10", BitsToStream(bits, num_bits));
+  EXPECT_TRUE(huffman.Encode(30, &bits, &num_bits));
+  EXPECT_EQ("11", BitsToStream(bits, num_bits));
+
+  // A codec rebuilt from the lengths of a canonical codec is the same codec.
+  HuffmanCodec<std::string> original(GetTestSet(), 5);
+  HuffmanCodec<std::string> rebuilt(original.GetCodeLengths());
+  EXPECT_EQ(original.GetEncodingTable(), rebuilt.GetEncodingTable());
+
+  // Codecs built from a histogram without a length limit are not canonical.
+  EXPECT_FALSE(HuffmanCodec<std::string>(GetTestSet()).is_canonical());
+}
+
+TEST(Huffman, InvalidCodeLengths) {
+  using CodeLengths = std::vector<std::pair<uint64_t, uint32_t>>;
+  EXPECT_TRUE(HuffmanCodec<uint64_t>::AreValidCodeLengths({{1, 0}}));
+  EXPECT_FALSE(HuffmanCodec<uint64_t>::AreValidCodeLengths(CodeLengths()));
+  EXPECT_FALSE(HuffmanCodec<uint64_t>::AreValidCodeLengths({{1, 1}}));
+  // Incomplete, and more codes than fit.
+  EXPECT_FALSE(HuffmanCodec<uint64_t>::AreValidCodeLengths({{1, 1}, {2, 2}}));
+  EXPECT_FALSE(
+      HuffmanCodec<uint64_t>::AreValidCodeLengths({{1, 1}, {2, 1}, {3, 1}}));
+  // Repeated values.
+  EXPECT_FALSE(HuffmanCodec<uint64_t>::AreValidCodeLengths({{1, 1}, {1, 1}}));
+  EXPECT_FALSE(HuffmanCodec<uint64_t>::AreValidCodeLengths(
+      {{1, 1}, {2, 2}, {1, 2}}));
+  // Too long.
+  CodeLengths too_long;
+  for (uint32_t i = 1; i <= 65; ++i) too_long.emplace_back(i, i);
+  too_long.emplace_back(0, 65);
+  EXPECT_FALSE(HuffmanCodec<uint64_t>::AreValidCodeLengths(too_long));
+}
+
+TEST(Huffman, EncodeSmallAndLargeIntegers) {
+  std::map<uint32_t, uint32_t> hist;
+  for (uint32_t i = 0; i < 100; ++i) {
+    if (i != 50) hist[i] = i + 1;
+  }
+  const auto test_codec = [](const HuffmanCodec<uint32_t>& huffman) {
+    for (const auto& kv : huffman.GetEncodingTable()) {
+      uint64_t bits = 0;
+      size_t num_bits = 0;
+      ASSERT_TRUE(huffman.Encode(kv.first, &bits, &num_bits));
+      EXPECT_EQ(kv.second.first, bits);
+      EXPECT_EQ(kv.second.second, num_bits);
+    }
+    uint64_t bits = 0;
+    size_t num_bits = 0;
+    EXPECT_FALSE(huffman.Encode(50, &bits, &num_bits));
+    EXPECT_FALSE(huffman.Encode(1000, &bits, &num_bits));
+  };
+
+  // Codecs of small values encode through a dense table, others do not.
+  test_codec(HuffmanCodec<uint32_t>(hist));
+  hist[100000] = 3;
+  test_codec(HuffmanCodec<uint32_t>(hist));
+}
+
 }  // anonymous namespace
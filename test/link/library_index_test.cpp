@@ -0,0 +1,146 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "gmock/gmock.h"
+#include "linker_fixture.h"
+
+namespace {
+
+using ::testing::HasSubstr;
+using ::testing::Not;
+
+class LibraryIndex : public spvtest::LinkerTest {
+ public:
+  LibraryIndex() {
+    SetDisassembleOptions(SPV_BINARY_TO_TEXT_OPTION_NO_HEADER);
+  }
+
+  // Exports "f" and "g", "g" calling "h", and has an entry point "main".
+  const std::string library_ = R"(
+OpCapability Linkage
+OpCapability Shader
+OpMemoryModel Logical GLSL450
+OpEntryPoint Vertex %main "main"
+OpName %f "f"
+OpName %g "g"
+OpName %h "h"
+OpDecorate %f LinkageAttributes "f" Export
+OpDecorate %g LinkageAttributes "g" Export
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%f = OpFunction %void None %fn
+%f_entry = OpLabel
+OpReturn
+OpFunctionEnd
+%h = OpFunction %void None %fn
+%h_entry = OpLabel
+OpReturn
+OpFunctionEnd
+%g = OpFunction %void None %fn
+%g_entry = OpLabel
+%call = OpFunctionCall %void %h
+OpReturn
+OpFunctionEnd
+%main = OpFunction %void None %fn
+%main_entry = OpLabel
+OpReturn
+OpFunctionEnd
+)";
+
+  // Imports "g".
+  const std::string program_ = R"(
+OpCapability Linkage
+OpCapability Shader
+OpMemoryModel Logical GLSL450
+OpDecorate %g LinkageAttributes "g" Import
+%void = OpTypeVoid
+%fn = OpTypeFunction %void
+%g = OpFunction %void None %fn
+OpFunctionEnd
+)";
+};
+
+TEST_F(LibraryIndex, OnlyReachableFunctionsAreLinked) {
+  spvtest::Binary library;
+  spvtest::Binary program;
+  ASSERT_EQ(SPV_SUCCESS, Assemble(library_, &library));
+  ASSERT_EQ(SPV_SUCCESS, Assemble(program_, &program));
+
+  std::vector<uint32_t> index;
+  ASSERT_EQ(SPV_SUCCESS, spvtools::CreateLibraryIndex(
+                             context(), library.data(), library.size(), &index))
+      << GetErrorMessage();
+
+  spvtest::Binary linked_binary;
+  ASSERT_EQ(SPV_SUCCESS,
+            spvtools::LinkWithLibrary(context(), {program}, library.data(),
+                                      library.size(), index.data(),
+                                      index.size(), &linked_binary))
+      << GetErrorMessage();
+
+  std::string res_body;
+  EXPECT_EQ(SPV_SUCCESS, Disassemble(linked_binary, &res_body))
+      << GetErrorMessage();
+  EXPECT_THAT(res_body, HasSubstr("\"g\""));
+  EXPECT_THAT(res_body, HasSubstr("\"h\""));
+  EXPECT_THAT(res_body, HasSubstr("\"main\""));
+  EXPECT_THAT(res_body, Not(HasSubstr("\"f\"")));
+}
+
+TEST_F(LibraryIndex, OnlyEntryPointsAreKeptWithoutImports) {
+  spvtest::Binary library;
+  ASSERT_EQ(SPV_SUCCESS, Assemble(library_, &library));
+
+  std::vector<uint32_t> index;
+  ASSERT_EQ(SPV_SUCCESS, spvtools::CreateLibraryIndex(
+                             context(), library.data(), library.size(), &index))
+      << GetErrorMessage();
+
+  spvtest::Binary linked_binary;
+  ASSERT_EQ(SPV_SUCCESS,
+            spvtools::LinkWithLibrary(context(), {}, library.data(),
+                                      library.size(), index.data(),
+                                      index.size(), &linked_binary))
+      << GetErrorMessage();
+  std::string res_body;
+  EXPECT_EQ(SPV_SUCCESS, Disassemble(linked_binary, &res_body))
+      << GetErrorMessage();
+  EXPECT_THAT(res_body, HasSubstr("\"main\""));
+  EXPECT_THAT(res_body, Not(HasSubstr("\"g\"")));
+  EXPECT_THAT(res_body, Not(HasSubstr("\"h\"")));
+}
+
+TEST_F(LibraryIndex, MismatchedIndexIsRejected) {
+  spvtest::Binary library;
+  spvtest::Binary program;
+  ASSERT_EQ(SPV_SUCCESS, Assemble(library_, &library));
+  ASSERT_EQ(SPV_SUCCESS, Assemble(program_, &program));
+
+  std::vector<uint32_t> index;
+  ASSERT_EQ(SPV_SUCCESS, spvtools::CreateLibraryIndex(
+                             context(), library.data(), library.size(), &index))
+      << GetErrorMessage();
+  index.pop_back();
+
+  spvtest::Binary linked_binary;
+  EXPECT_EQ(SPV_ERROR_INVALID_BINARY,
+            spvtools::LinkWithLibrary(context(), {program}, library.data(),
+                                      library.size(), index.data(),
+                                      index.size(), &linked_binary));
+  EXPECT_THAT(GetErrorMessage(),
+              HasSubstr("The library index is malformed or does not match "
+                        "the library."));
+}
+
+}  // namespace
@@ -79,6 +79,14 @@ class LinkerTest : public ::testing::Test {
     return spvtools::Link(context_, binaries, linked_binary, options);
   }
 
+  // Assembles |body| into |binary|. SPV_ERROR_INVALID_TEXT is returned if the
+  // assembling failed.
+  spv_result_t Assemble(const std::string& body, spvtest::Binary* binary) {
+    return tools_.Assemble(body, binary, assemble_options_)
+               ? SPV_SUCCESS
+               : SPV_ERROR_INVALID_TEXT;
+  }
+
   // Links the given SPIR-V binaries together; SPV_ERROR_INVALID_POINTER is
   // returned if |linked_binary| is a null pointer.
   spv_result_t Link(
@@ -107,6 +115,9 @@ class LinkerTest : public ::testing::Test {
     disassemble_options_ = disassemble_options;
   }
 
+  // Returns the context used for linking.
+  const spvtools::Context& context() const { return context_; }
+
   // Returns the accumulated error messages for the test.
   std::string GetErrorMessage() const { return error_message_; }
 
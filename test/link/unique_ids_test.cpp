@@ -19,7 +19,8 @@ namespace {
 
 using UniqueIds = spvtest::LinkerTest;
 
-TEST_F(UniqueIds, UniquelyMerged) {
+// Returns two modules that define the same ids.
+std::vector<std::string> GetBodies() {
   std::vector<std::string> bodies(2);
   bodies[0] =
       // clang-format off
@@ -126,12 +127,30 @@ TEST_F(UniqueIds, UniquelyMerged) {
                "OpReturnValue %30\n"
                "OpFunctionEnd\n";
   // clang-format on
+  return bodies;
+}
 
+TEST_F(UniqueIds, UniquelyMerged) {
   spvtest::Binary linked_binary;
   spvtools::LinkerOptions options;
   options.SetVerifyIds(true);
-  spv_result_t res = AssembleAndLink(bodies, &linked_binary, options);
+  spv_result_t res = AssembleAndLink(GetBodies(), &linked_binary, options);
   EXPECT_EQ(SPV_SUCCESS, res);
 }
 
+TEST_F(UniqueIds, UniquelyMergedWithSeveralThreads) {
+  spvtest::Binary serial_binary;
+  spvtools::LinkerOptions options;
+  options.SetVerifyIds(true);
+  ASSERT_EQ(SPV_SUCCESS,
+            AssembleAndLink(GetBodies(), &serial_binary, options));
+
+  // The linked module does not depend on the number of threads used.
+  options.SetNumThreads(4u);
+  spvtest::Binary parallel_binary;
+  EXPECT_EQ(SPV_SUCCESS,
+            AssembleAndLink(GetBodies(), &parallel_binary, options));
+  EXPECT_EQ(serial_binary, parallel_binary);
+}
+
 }  // anonymous namespace
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <iostream>
 #include <set>
+#include <vector>
 
 #include "gmock/gmock.h"
 #include "util/move_to_front.h"
@@ -938,4 +939,100 @@ TEST(MultiMoveToFront, TwoSequences) {
   EXPECT_EQ(1u, rank);
 }
 
+TEST(MultiMoveToFront, RemoveAllFromAll) {
+  MultiMoveToFront<uint32_t> multi_mtf;
+  for (uint32_t value = 1; value <= 100; ++value) {
+    multi_mtf.Insert(1, value);
+    if (value % 2) multi_mtf.Insert(2, value);
+  }
+
+  const std::vector<uint32_t> removed = {3, 4, 5, 6, 7, 100, 1000};
+  multi_mtf.RemoveAllFromAll(removed);
+  EXPECT_EQ(94u, multi_mtf.GetSize(1));
+  EXPECT_EQ(47u, multi_mtf.GetSize(2));
+  EXPECT_FALSE(multi_mtf.HasValue(1, 5));
+  EXPECT_FALSE(multi_mtf.HasValue(2, 5));
+
+  uint32_t rank = 0;
+  EXPECT_TRUE(multi_mtf.RankFromValue(1, 99, &rank));
+  EXPECT_EQ(1u, rank);
+  EXPECT_TRUE(multi_mtf.RankFromValue(1, 8, &rank));
+  EXPECT_EQ(92u, rank);
+  EXPECT_TRUE(multi_mtf.RankFromValue(2, 1, &rank));
+  EXPECT_EQ(47u, rank);
+}
+
+// Checks that every sequence of a MultiMoveToFront ranks its values the same
+// way as a MoveToFront which receives the same operations.
+TEST(MultiMoveToFront, MatchesMoveToFront) {
+  const uint64_t kNumSequences = 5;
+  MultiMoveToFront<uint32_t> multi_mtf;
+  std::vector<MoveToFront<uint32_t>> mtfs(kNumSequences);
+  std::vector<std::set<uint32_t>> contents(kNumSequences);
+
+  uint32_t state = 12345;
+  const auto random = [&state](uint32_t bound) {
+    state = state * 1103515245 + 12345;
+    return (state >> 8) % bound;
+  };
+
+  for (int i = 0; i < 20000; ++i) {
+    const uint64_t mtf = random(kNumSequences);
+    const uint32_t value = random(200);
+    uint32_t rank = 0;
+    uint32_t expected_rank = 0;
+    uint32_t found = 0;
+    uint32_t expected_found = 0;
+    switch (random(7)) {
+      case 0:
+      case 1:
+        EXPECT_EQ(mtfs[mtf].Insert(value), multi_mtf.Insert(mtf, value));
+        contents[mtf].insert(value);
+        break;
+      case 2:
+        EXPECT_EQ(mtfs[mtf].RankFromValue(value, &expected_rank),
+                  multi_mtf.RankFromValue(mtf, value, &rank));
+        EXPECT_EQ(expected_rank, rank);
+        break;
+      case 3:
+        rank = 1 + random(mtfs[mtf].GetSize() + 1);
+        EXPECT_EQ(mtfs[mtf].ValueFromRank(rank, &expected_found),
+                  multi_mtf.ValueFromRank(mtf, rank, &found));
+        EXPECT_EQ(expected_found, found);
+        break;
+      case 4:
+        for (uint64_t j = 0; j < kNumSequences; ++j) mtfs[j].Promote(value);
+        multi_mtf.Promote(value);
+        break;
+      case 5:
+        EXPECT_EQ(mtfs[mtf].Remove(value), multi_mtf.Remove(mtf, value));
+        contents[mtf].erase(value);
+        break;
+      case 6: {
+        std::vector<uint32_t> values;
+        for (uint32_t j = random(10); j; --j) values.push_back(random(200));
+        for (uint32_t removed : values) {
+          for (uint64_t j = 0; j < kNumSequences; ++j) {
+            mtfs[j].Remove(removed);
+            contents[j].erase(removed);
+          }
+        }
+        multi_mtf.RemoveAllFromAll(values);
+        break;
+      }
+    }
+    ASSERT_EQ(mtfs[mtf].GetSize(), multi_mtf.GetSize(mtf));
+  }
+
+  for (uint64_t mtf = 0; mtf < kNumSequences; ++mtf) {
+    for (uint32_t value : contents[mtf]) {
+      uint32_t rank = 0;
+      uint32_t expected_rank = 0;
+      ASSERT_TRUE(mtfs[mtf].RankFromValue(value, &expected_rank));
+      ASSERT_TRUE(multi_mtf.RankFromValue(mtf, value, &rank));
+      EXPECT_EQ(expected_rank, rank);
+    }
+  }
+}
+
 }  // anonymous namespace
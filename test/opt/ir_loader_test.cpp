@@ -315,7 +315,8 @@ TEST(IrBuilder, KeepModuleProcessedInRightPlace) {
 }
 
 // Checks the given |error_message| is reported when trying to build a module
-// from the given |assembly|.
+// from the given |assembly|, whether function bodies are loaded up front or
+// lazily.
 void DoErrorMessageCheck(const std::string& assembly,
                          const std::string& error_message) {
   auto consumer = [error_message](spv_message_level_t level, const char* source,
@@ -325,9 +326,14 @@ void DoErrorMessageCheck(const std::string& assembly,
   };
 
   SpirvTools t(SPV_ENV_UNIVERSAL_1_1);
-  std::unique_ptr<ir::IRContext> context =
-      BuildModule(SPV_ENV_UNIVERSAL_1_1, std::move(consumer), assembly);
-  EXPECT_EQ(nullptr, context);
+  std::vector<uint32_t> binary;
+  ASSERT_TRUE(t.Assemble(assembly, &binary));
+  for (bool lazy_function_bodies : {false, true}) {
+    std::unique_ptr<ir::IRContext> context =
+        BuildModule(SPV_ENV_UNIVERSAL_1_1, consumer, binary.data(),
+                    binary.size(), lazy_function_bodies);
+    EXPECT_EQ(nullptr, context) << lazy_function_bodies;
+  }
 }
 
 TEST(IrBuilder, FunctionInsideFunction) {
@@ -446,4 +452,76 @@ TEST(IrBuilder, UniqueIds) {
   });
 }
 
+TEST(IrBuilder, LazyFunctionBodies) {
+  const std::string text =
+      // clang-format off
+               "OpCapability Shader\n"
+          "%1 = OpString \"file\"\n"
+               "OpMemoryModel Logical GLSL450\n"
+               "OpEntryPoint Vertex %main \"main\"\n"
+               "OpName %main \"main\"\n"
+               "OpName %f_ \"f(\"\n"
+               "OpName %lv \"lv\"\n"
+       "%void = OpTypeVoid\n"
+          "%7 = OpTypeFunction %void\n"
+      "%float = OpTypeFloat 32\n"
+ "%_ptr_Function_float = OpTypePointer Function %float\n"
+   "%float_10 = OpConstant %float 10\n"
+               "OpLine %1 1 1\n"
+       "%main = OpFunction %void None %7\n"
+         "%11 = OpLabel\n"
+               "OpLine %1 2 2\n"
+         "%12 = OpFunctionCall %void %f_\n"
+               "OpReturn\n"
+               "OpFunctionEnd\n"
+         "%f_ = OpFunction %void None %7\n"
+         "%13 = OpLabel\n"
+         "%lv = OpVariable %_ptr_Function_float Function\n"
+               "OpStore %lv %float_10\n"
+               "OpReturn\n"
+               "OpFunctionEnd\n";
+  // clang-format on
+
+  SpirvTools t(SPV_ENV_UNIVERSAL_1_1);
+  std::vector<uint32_t> binary;
+  ASSERT_TRUE(t.Assemble(text, &binary));
+  std::unique_ptr<ir::IRContext> context =
+      BuildModule(SPV_ENV_UNIVERSAL_1_1, nullptr, binary.data(), binary.size(),
+                  /* lazy_function_bodies = */ true);
+  ASSERT_NE(nullptr, context);
+  for (const auto& function : *context->module())
+    EXPECT_TRUE(function.HasUnloadedBody());
+
+  // Unloaded bodies are written back as they were read.
+  std::vector<uint32_t> unloaded_binary;
+  context->module()->ToBinary(&unloaded_binary, /* skip_nop = */ false);
+  EXPECT_EQ(binary, unloaded_binary);
+
+  // The id bound is computed without loading bodies. The largest id, the one
+  // of %13, is only mentioned in the body of %f_.
+  EXPECT_EQ(binary[3], context->module()->ComputeIdBound());
+  for (const auto& function : *context->module())
+    EXPECT_TRUE(function.HasUnloadedBody());
+
+  // Accessing the blocks of a function only loads that function.
+  ir::Function& main = *context->module()->begin();
+  ir::BasicBlock& entry = *main.begin();
+  EXPECT_FALSE(main.HasUnloadedBody());
+  EXPECT_EQ(&main, entry.GetParent());
+  EXPECT_EQ(11u, entry.id());
+  EXPECT_TRUE((++context->module()->begin())->HasUnloadedBody());
+
+  std::vector<uint32_t> loaded_binary;
+  context->module()->ToBinary(&loaded_binary, /* skip_nop = */ false);
+  EXPECT_EQ(binary, loaded_binary);
+  EXPECT_EQ(binary[3], context->module()->ComputeIdBound());
+
+  std::unordered_set<uint32_t> ids;
+  context->module()->ForEachInst([&ids](const ir::Instruction* inst) {
+    EXPECT_TRUE(ids.insert(inst->unique_id()).second);
+  });
+  for (const auto& function : *context->module())
+    EXPECT_FALSE(function.HasUnloadedBody());
+}
+
 }  // anonymous namespace
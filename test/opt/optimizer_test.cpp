@@ -21,6 +21,8 @@
 
 namespace {
 
+using spvtools::CreateDeadBranchElimPass;
+using spvtools::CreateEliminateDeadConstantPass;
 using spvtools::CreateNullPass;
 using spvtools::CreateStripDebugInfoPass;
 using spvtools::Optimizer;
@@ -106,4 +108,31 @@ TEST(Optimizer, CanRunTransformingPassWithAliasedVectors) {
   EXPECT_THAT(disassembly, Eq("%void = OpTypeVoid\n"));
 }
 
+TEST(Optimizer, FailsOnMalformedFunctionBody) {
+  SpirvTools tools(SPV_ENV_UNIVERSAL_1_0);
+  std::vector<uint32_t> binary;
+  // The body of %main is only loaded when a pass accesses it, but it is
+  // checked before any pass runs. Dead branch elimination starts from the
+  // first block of each function.
+  tools.Assemble(
+      "OpCapability Shader\n"
+      "OpMemoryModel Logical GLSL450\n"
+      "%void = OpTypeVoid\n"
+      "%void_fn = OpTypeFunction %void\n"
+      "%main = OpFunction %void None %void_fn\n"
+      "%entry = OpLabel\n"
+      "%nested = OpLabel\n"
+      "OpReturn\n"
+      "OpFunctionEnd\n",
+      &binary);
+  ASSERT_FALSE(binary.empty());
+
+  Optimizer opt(SPV_ENV_UNIVERSAL_1_0);
+  opt.RegisterPass(CreateDeadBranchElimPass())
+      .RegisterPass(CreateEliminateDeadConstantPass());
+  std::vector<uint32_t> binary_out;
+  EXPECT_FALSE(opt.Run(binary.data(), binary.size(), &binary_out));
+  EXPECT_TRUE(binary_out.empty());
+}
+
 }  // namespace
@@ -225,6 +225,7 @@ class PassTest : public TestT {
 
   MessageConsumer consumer() { return consumer_; }
   ir::IRContext* context() { return context_.get(); }
+  opt::PassManager* manager() { return manager_.get(); }
 
   void SetMessageConsumer(MessageConsumer msg_consumer) {
     consumer_ = msg_consumer;
@@ -15,6 +15,9 @@
 #include "gmock/gmock.h"
 
 #include <initializer_list>
+#include <sstream>
+#include <string>
+#include <vector>
 
 #include "module_utils.h"
 #include "opt/make_unique.h"
@@ -183,4 +186,118 @@ TEST(PassManager, RecomputeIdBoundAutomatically) {
   EXPECT_THAT(GetIdBound(*context.module()), Eq(201u));
 }
 
+// A pass that appends an OpNop instruction to the debug1 section on each of its
+// first |num_changes| runs, and does nothing afterwards. |*num_runs| counts the
+// number of times the pass was run.
+class CountdownPass : public opt::Pass {
+ public:
+  CountdownPass(uint32_t num_changes, uint32_t* num_runs)
+      : num_changes_(num_changes), num_runs_(num_runs) {}
+
+  const char* name() const override { return "Countdown"; }
+  Status Process(ir::IRContext* irContext) override {
+    ++*num_runs_;
+    if (num_changes_ == 0) return Status::SuccessWithoutChange;
+    --num_changes_;
+    irContext->AddDebug1Inst(MakeUnique<ir::Instruction>(irContext));
+    return Status::SuccessWithChange;
+  }
+
+ private:
+  uint32_t num_changes_;
+  uint32_t* num_runs_;
+};
+
+// A pass that never changes the module and counts how often it is run.
+class CountingNullPass : public opt::NullPass {
+ public:
+  explicit CountingNullPass(uint32_t* num_runs) : num_runs_(num_runs) {}
+
+  const char* name() const override { return "CountingNull"; }
+  Status Process(ir::IRContext* irContext) override {
+    ++*num_runs_;
+    return opt::NullPass::Process(irContext);
+  }
+
+ private:
+  uint32_t* num_runs_;
+};
+
+TEST_F(PassManagerTest, FixedPointGroupRunsUntilNoChange) {
+  const std::string text = "OpMemoryModel Logical GLSL450\nOpSource ESSL 310\n";
+
+  uint32_t countdown_runs = 0;
+  uint32_t null_runs = 0;
+  manager()->BeginFixedPointGroup();
+  AddPass<CountdownPass>(3, &countdown_runs);
+  AddPass<CountingNullPass>(&null_runs);
+  manager()->EndFixedPointGroup();
+  RunAndCheck(text.c_str(), (text + "OpNop\nOpNop\nOpNop\n").c_str());
+
+  // Three rounds make changes, and the fourth round confirms the fixed point.
+  EXPECT_EQ(4u, countdown_runs);
+  // The null pass is skipped in the last round because the module did not
+  // change since it last ran.
+  EXPECT_EQ(3u, null_runs);
+}
+
+TEST_F(PassManagerTest, FixedPointGroupRespectsMaxIterations) {
+  const std::string text = "OpMemoryModel Logical GLSL450\nOpSource ESSL 310\n";
+
+  uint32_t countdown_runs = 0;
+  manager()->BeginFixedPointGroup(2);
+  AddPass<CountdownPass>(5, &countdown_runs);
+  manager()->EndFixedPointGroup();
+  AddPass<AppendOpNopPass>();
+  RunAndCheck(text.c_str(), (text + "OpNop\nOpNop\nOpNop\n").c_str());
+  EXPECT_EQ(2u, countdown_runs);
+}
+
+TEST(PassManager, ChangeReport) {
+  uint32_t countdown_runs = 0;
+  uint32_t null_runs = 0;
+  std::ostringstream report;
+  opt::PassManager manager;
+  manager.SetChangeReport(&report);
+  manager.BeginFixedPointGroup();
+  manager.AddPass(MakeUnique<CountdownPass>(1, &countdown_runs));
+  manager.AddPass(MakeUnique<CountingNullPass>(&null_runs));
+  manager.EndFixedPointGroup();
+
+  std::unique_ptr<ir::Module> module(new ir::Module());
+  ir::IRContext context(SPV_ENV_UNIVERSAL_1_2, std::move(module),
+                        manager.consumer());
+  EXPECT_EQ(opt::Pass::Status::SuccessWithChange, manager.Run(&context));
+  EXPECT_EQ(2u, countdown_runs);
+  EXPECT_EQ(1u, null_runs);
+  EXPECT_EQ(
+      "Pass: runs, changed, skipped, change rate\n"
+      "Countdown: 2, 1, 0, 50%\n"
+      "CountingNull: 1, 0, 1, 0%\n"
+      "Total: 3, 1, 1, 33.3333%\n",
+      report.str());
+}
+
+TEST(PassManager, EndFixedPointGroupWithoutGroupIsReported) {
+  uint32_t countdown_runs = 0;
+  std::vector<std::string> errors;
+  opt::PassManager manager;
+  manager.SetMessageConsumer(
+      [&errors](spv_message_level_t level, const char*,
+                const spv_position_t&, const char* message) {
+        if (level == SPV_MSG_ERROR) errors.push_back(message);
+      });
+  manager.AddPass(MakeUnique<CountdownPass>(3, &countdown_runs));
+  manager.EndFixedPointGroup();
+  ASSERT_EQ(1u, errors.size());
+  EXPECT_EQ("no fixed-point group to end", errors[0]);
+
+  // The pass is run once, outside of any group.
+  std::unique_ptr<ir::Module> module(new ir::Module());
+  ir::IRContext context(SPV_ENV_UNIVERSAL_1_2, std::move(module),
+                        manager.consumer());
+  EXPECT_EQ(opt::Pass::Status::SuccessWithChange, manager.Run(&context));
+  EXPECT_EQ(1u, countdown_runs);
+}
+
 }  // anonymous namespace
@@ -15,6 +15,7 @@
 // Tests for unique type declaration rules validator.
 
 #include <string>
+#include <vector>
 
 #include "source/spirv_stats.h"
 #include "test_fixture.h"
@@ -481,4 +482,144 @@ OpMemoryModel Logical GLSL450
   }
 }
 
+TEST(AggregateStats, IdDescriptorCollisions) {
+  // Descriptors don't depend on the order of the words, so the two composites
+  // get the same descriptor.
+  const std::string code = R"(
+OpCapability Shader
+OpCapability Linkage
+OpMemoryModel Logical GLSL450
+%f32 = OpTypeFloat 32
+%v2f32 = OpTypeVector %f32 2
+%1 = OpConstant %f32 1
+%2 = OpConstant %f32 2
+%12 = OpConstantComposite %v2f32 %1 %2
+%21 = OpConstantComposite %v2f32 %2 %1
+%12_again = OpConstantComposite %v2f32 %1 %2
+)";
+
+  SpirvStats stats;
+  CompileAndAggregateStats(code, &stats);
+  EXPECT_EQ(1u, stats.id_descriptor_collisions);
+
+  CompileAndAggregateStats(code, &stats);
+  EXPECT_EQ(2u, stats.id_descriptor_collisions);
+}
+
+TEST(MergeStats, SameAsAggregatingTogether) {
+  const std::string code1 = R"(
+OpCapability Shader
+OpCapability Linkage
+OpExtension "SPV_NV_viewport_array2"
+OpMemoryModel Logical GLSL450
+%u32 = OpTypeInt 32 0
+%u32_1 = OpConstant %u32 1
+)";
+
+  const std::string code2 = R"(
+OpCapability Addresses
+OpCapability Kernel
+OpCapability Int64
+OpCapability Linkage
+OpMemoryModel Physical32 OpenCL
+%u64 = OpTypeInt 64 0
+%u32 = OpTypeInt 32 0
+%f32 = OpTypeFloat 32
+%u32_1 = OpConstant %u32 1
+%u32_2 = OpConstant %u32 2
+)";
+
+  SpirvStats together;
+  together.opcode_markov_hist.resize(2);
+  CompileAndAggregateStats(code1, &together);
+  CompileAndAggregateStats(code2, &together);
+
+  SpirvStats stats1;
+  stats1.opcode_markov_hist.resize(2);
+  CompileAndAggregateStats(code1, &stats1);
+  SpirvStats stats2;
+  stats2.opcode_markov_hist.resize(2);
+  CompileAndAggregateStats(code2, &stats2);
+
+  // Merging into empty stats takes the number of Markov chain steps along.
+  SpirvStats merged;
+  MergeStats(stats1, &merged);
+  MergeStats(stats2, &merged);
+
+  EXPECT_EQ(together.version_hist, merged.version_hist);
+  EXPECT_EQ(together.generator_hist, merged.generator_hist);
+  EXPECT_EQ(together.capability_hist, merged.capability_hist);
+  EXPECT_EQ(together.extension_hist, merged.extension_hist);
+  EXPECT_EQ(together.opcode_hist, merged.opcode_hist);
+  EXPECT_EQ(together.opcode_and_num_operands_hist,
+            merged.opcode_and_num_operands_hist);
+  EXPECT_EQ(together.u32_constant_hist, merged.u32_constant_hist);
+  EXPECT_EQ(together.enum_hist, merged.enum_hist);
+  EXPECT_EQ(together.operand_slot_non_id_words_hist,
+            merged.operand_slot_non_id_words_hist);
+  EXPECT_EQ(together.id_descriptor_hist, merged.id_descriptor_hist);
+  EXPECT_EQ(together.operand_slot_id_descriptor_hist,
+            merged.operand_slot_id_descriptor_hist);
+  EXPECT_EQ(together.literal_strings_hist, merged.literal_strings_hist);
+  EXPECT_EQ(together.opcode_and_num_operands_markov_hist,
+            merged.opcode_and_num_operands_markov_hist);
+  EXPECT_EQ(together.opcode_markov_hist, merged.opcode_markov_hist);
+  EXPECT_EQ(2u, together.capability_hist.at(SpvCapabilityLinkage));
+}
+
+TEST(SerializeStats, AggregatesLikeMergeStats) {
+  const std::string code = R"(
+OpCapability Shader
+OpCapability Linkage
+OpCapability Int16
+OpCapability Float64
+OpExtension "SPV_NV_viewport_array2"
+OpMemoryModel Logical GLSL450
+%u32 = OpTypeInt 32 0
+%s16 = OpTypeInt 16 1
+%f64 = OpTypeFloat 64
+%u32_1 = OpConstant %u32 1
+%s16_m1 = OpConstant %s16 -1
+%f64_half = OpConstant %f64 0.5
+)";
+
+  SpirvStats stats;
+  stats.opcode_markov_hist.resize(2);
+  CompileAndAggregateStats(code, &stats);
+
+  std::vector<uint32_t> words;
+  SerializeStats(stats, &words);
+
+  SpirvStats deserialized;
+  ASSERT_TRUE(AggregateSerializedStats(words.data(), words.size(),
+                                       &deserialized));
+  EXPECT_EQ(stats.extension_hist, deserialized.extension_hist);
+  EXPECT_EQ(stats.opcode_hist, deserialized.opcode_hist);
+  EXPECT_EQ(stats.s16_constant_hist, deserialized.s16_constant_hist);
+  EXPECT_EQ(stats.f64_constant_hist, deserialized.f64_constant_hist);
+  EXPECT_EQ(stats.id_descriptor_labels, deserialized.id_descriptor_labels);
+  EXPECT_EQ(stats.literal_strings_hist, deserialized.literal_strings_hist);
+  EXPECT_EQ(stats.opcode_markov_hist, deserialized.opcode_markov_hist);
+
+  std::vector<uint32_t> deserialized_words;
+  SerializeStats(deserialized, &deserialized_words);
+  EXPECT_EQ(words.size(), deserialized_words.size());
+
+  SpirvStats merged = stats;
+  MergeStats(stats, &merged);
+  ASSERT_TRUE(
+      AggregateSerializedStats(words.data(), words.size(), &deserialized));
+  EXPECT_EQ(merged.opcode_hist, deserialized.opcode_hist);
+  EXPECT_EQ(merged.operand_slot_id_descriptor_hist,
+            deserialized.operand_slot_id_descriptor_hist);
+  EXPECT_EQ(merged.opcode_markov_hist, deserialized.opcode_markov_hist);
+
+  // Invalid words leave the stats alone.
+  EXPECT_FALSE(
+      AggregateSerializedStats(words.data(), words.size() - 1, &deserialized));
+  EXPECT_FALSE(AggregateSerializedStats(words.data() + 1, words.size() - 1,
+                                        &deserialized));
+  EXPECT_EQ(merged.opcode_hist, deserialized.opcode_hist);
+}
+
 }  // namespace
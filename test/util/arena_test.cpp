@@ -0,0 +1,68 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "util/arena.h"
+#include "util/span.h"
+
+namespace {
+
+using spvtools::utils::Arena;
+using spvtools::utils::Span;
+
+TEST(ArenaTest, CopiesAreIndependentOfTheSource) {
+  Arena<uint32_t> arena;
+  std::vector<uint32_t> words = {1, 2, 3};
+  const Span<uint32_t> copy = arena.Copy(words.data(), words.size());
+  words[0] = 7;
+  ASSERT_EQ(3u, copy.size());
+  EXPECT_EQ(1u, copy[0]);
+  EXPECT_EQ(3u, copy.back());
+  EXPECT_EQ((std::vector<uint32_t>{1, 2, 3}), copy.ToVector());
+}
+
+TEST(ArenaTest, CopiesNeverMove) {
+  Arena<uint32_t> arena(16);
+  std::vector<Span<uint32_t>> copies;
+  for (uint32_t i = 0; i < 100; ++i) {
+    // Mix arrays which fit in a chunk with arrays which get their own chunk.
+    const std::vector<uint32_t> words(i % 7 == 0 ? 10 : 3, i);
+    copies.push_back(arena.Copy(words.data(), words.size()));
+  }
+  for (uint32_t i = 0; i < 100; ++i) {
+    ASSERT_EQ(i % 7 == 0 ? 10u : 3u, copies[i].size());
+    for (uint32_t word : copies[i]) EXPECT_EQ(i, word);
+  }
+}
+
+TEST(ArenaTest, SmallArraysShareChunks) {
+  Arena<uint32_t> arena(64);
+  const uint32_t word = 5;
+  for (int i = 0; i < 64; ++i) arena.Copy(&word, 1);
+  EXPECT_EQ(64u, arena.capacity());
+  arena.Copy(&word, 1);
+  EXPECT_EQ(128u, arena.capacity());
+}
+
+TEST(ArenaTest, EmptyCopy) {
+  Arena<uint32_t> arena;
+  const Span<uint32_t> copy = arena.Copy(nullptr, 0);
+  EXPECT_TRUE(copy.empty());
+  EXPECT_EQ(copy.begin(), copy.end());
+}
+
+}  // anonymous namespace
@@ -0,0 +1,109 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+
+#include <type_traits>
+#include <vector>
+
+#include "gmock/gmock.h"
+
+#include "util/small_vector.h"
+
+namespace {
+
+using spvtools::utils::SmallVector;
+using ::testing::ElementsAre;
+using SmallVectorTest = ::testing::Test;
+
+TEST(SmallVectorTest, StaysInlineUpToSmallSize) {
+  SmallVector<uint32_t, 2> vec;
+  EXPECT_TRUE(vec.empty());
+  vec.push_back(1);
+  vec.push_back(2);
+  EXPECT_THAT(vec, ElementsAre(1, 2));
+  const uint32_t* inline_data = vec.data();
+  EXPECT_TRUE(inline_data >= reinterpret_cast<const uint32_t*>(&vec) &&
+              inline_data < reinterpret_cast<const uint32_t*>(&vec + 1));
+
+  vec.push_back(3);
+  EXPECT_THAT(vec, ElementsAre(1, 2, 3));
+  EXPECT_NE(inline_data, vec.data());
+}
+
+TEST(SmallVectorTest, ConstructAndCompareWithStdVector) {
+  const std::vector<uint32_t> small = {1, 2};
+  const std::vector<uint32_t> large = {1, 2, 3, 4};
+  SmallVector<uint32_t, 2> from_small(small);
+  SmallVector<uint32_t, 2> from_large(large);
+  EXPECT_TRUE(from_small == small);
+  EXPECT_TRUE(large == from_large);
+  EXPECT_TRUE(from_small != large);
+  EXPECT_FALSE(from_small == from_large);
+
+  std::vector<uint32_t> large_copy = large;
+  SmallVector<uint32_t, 2> moved(std::move(large_copy));
+  EXPECT_TRUE(moved == from_large);
+}
+
+TEST(SmallVectorTest, CopyAndMove) {
+  SmallVector<uint32_t, 2> small = {7};
+  SmallVector<uint32_t, 2> large = {1, 2, 3};
+
+  SmallVector<uint32_t, 2> copy(large);
+  EXPECT_THAT(copy, ElementsAre(1, 2, 3));
+  copy = small;
+  EXPECT_THAT(copy, ElementsAre(7));
+
+  SmallVector<uint32_t, 2> moved(std::move(large));
+  EXPECT_THAT(moved, ElementsAre(1, 2, 3));
+  EXPECT_TRUE(large.empty());
+  moved = std::move(small);
+  EXPECT_THAT(moved, ElementsAre(7));
+  EXPECT_TRUE(small.empty());
+
+  // std::vector only moves its elements when it grows if they cannot throw.
+  EXPECT_TRUE((std::is_nothrow_move_constructible<
+               SmallVector<uint32_t, 2>>::value));
+  EXPECT_TRUE(
+      (std::is_nothrow_move_assignable<SmallVector<uint32_t, 2>>::value));
+}
+
+TEST(SmallVectorTest, Insert) {
+  SmallVector<uint32_t, 4> vec = {1, 4};
+  const uint32_t middle[] = {2, 3};
+  auto it = vec.insert(vec.begin() + 1, middle, middle + 2);
+  EXPECT_EQ(2u, *it);
+  EXPECT_THAT(vec, ElementsAre(1, 2, 3, 4));
+
+  // Grows past the inline storage.
+  it = vec.insert(vec.end(), vec.front());
+  EXPECT_EQ(4u, it - vec.begin());
+  EXPECT_THAT(vec, ElementsAre(1, 2, 3, 4, 1));
+}
+
+TEST(SmallVectorTest, ResizeAndClear) {
+  SmallVector<uint32_t, 2> vec;
+  vec.resize(1, 5);
+  EXPECT_THAT(vec, ElementsAre(5));
+  vec.resize(3, 6);
+  EXPECT_THAT(vec, ElementsAre(5, 6, 6));
+  vec.pop_back();
+  EXPECT_THAT(vec, ElementsAre(5, 6));
+  vec.clear();
+  EXPECT_TRUE(vec.empty());
+  vec.emplace_back(8u);
+  EXPECT_THAT(vec, ElementsAre(8));
+}
+
+}  // namespace
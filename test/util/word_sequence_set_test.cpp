@@ -0,0 +1,55 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "util/word_sequence_set.h"
+
+namespace {
+
+using spvtools::utils::WordSequenceSet;
+
+TEST(WordSequenceSetTest, InsertReportsDuplicates) {
+  WordSequenceSet set;
+  EXPECT_TRUE(set.empty());
+  EXPECT_TRUE(set.Insert({21, 32, 1}));
+  EXPECT_TRUE(set.Insert({21, 32, 0}));
+  EXPECT_FALSE(set.Insert({21, 32, 1}));
+  EXPECT_EQ(2u, set.size());
+}
+
+TEST(WordSequenceSetTest, PrefixesAreDistinct) {
+  WordSequenceSet set;
+  EXPECT_TRUE(set.Insert(std::vector<uint32_t>{}));
+  EXPECT_TRUE(set.Insert({7}));
+  EXPECT_TRUE(set.Insert({7, 7}));
+  EXPECT_FALSE(set.Insert(std::vector<uint32_t>{}));
+  EXPECT_FALSE(set.Insert({7}));
+  EXPECT_EQ(3u, set.size());
+}
+
+TEST(WordSequenceSetTest, KeepsSequencesWhenGrowing) {
+  WordSequenceSet set;
+  for (uint32_t i = 0; i < 1000; ++i) {
+    EXPECT_TRUE(set.Insert({23, i, i * 3}));
+  }
+  for (uint32_t i = 0; i < 1000; ++i) {
+    EXPECT_FALSE(set.Insert({23, i, i * 3}));
+  }
+  EXPECT_EQ(1000u, set.size());
+}
+
+}  // namespace
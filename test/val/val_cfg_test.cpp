@@ -1399,6 +1399,49 @@ TEST_F(ValidateCFG, OpReturnInNonVoidFunc) {
           "OpReturn can only be called from a function with void return type"));
 }
 
+// Returns a module with one valid function followed by |num_bad_functions|
+// functions whose second block appears in the binary before its dominator.
+std::string GetModuleWithBadFunctions(int num_bad_functions) {
+  std::string spirv = R"(
+               OpCapability Shader
+               OpCapability Linkage
+               OpMemoryModel Logical GLSL450
+       %void = OpTypeVoid
+     %void_f = OpTypeFunction %void
+       %good = OpFunction %void None %void_f
+ %good_entry = OpLabel
+               OpReturn
+               OpFunctionEnd
+)";
+  for (int i = 0; i < num_bad_functions; ++i) {
+    const std::string f = "%f" + std::to_string(i);
+    spirv += f + " = OpFunction %void None %void_f\n" + f +
+             "_entry = OpLabel\nOpBranch " + f + "_dom\n" + f +
+             "_late = OpLabel\nOpReturn\n" + f + "_dom = OpLabel\nOpBranch " +
+             f + "_late\nOpFunctionEnd\n";
+  }
+  return spirv;
+}
+
+TEST_F(ValidateCFG, ParallelChecksReportFirstBadFunction) {
+  CompileSuccessfully(GetModuleWithBadFunctions(1));
+  ASSERT_EQ(SPV_ERROR_INVALID_CFG, ValidateInstructions());
+  const std::string sequential_diagnostic = getDiagnosticString();
+  EXPECT_THAT(sequential_diagnostic,
+              HasSubstr("appears in the binary before its dominator"));
+
+  CompileSuccessfully(GetModuleWithBadFunctions(8));
+  spvValidatorOptionsSetNumThreads(getValidatorOptions(), 4);
+  ASSERT_EQ(SPV_ERROR_INVALID_CFG, ValidateInstructions());
+  EXPECT_EQ(sequential_diagnostic, getDiagnosticString());
+}
+
+TEST_F(ValidateCFG, ParallelChecksAcceptValidFunctions) {
+  CompileSuccessfully(GetModuleWithBadFunctions(0));
+  spvValidatorOptionsSetNumThreads(getValidatorOptions(), 0);
+  EXPECT_EQ(SPV_SUCCESS, ValidateInstructions());
+}
+
 /// TODO(umar): Switch instructions
 /// TODO(umar): Nested CFG constructs
 }  // namespace
@@ -52,6 +52,13 @@ class ValidateBase : public ::testing::Test,
   spv_result_t ValidateAndRetrieveValidationState(
       spv_target_env env = SPV_ENV_UNIVERSAL_1_0);
 
+  // Performs validation reusing the validation state in the vstate_ member,
+  // which must come from validating |old_binary|, an earlier version of the
+  // module. Returns the status and stores the new validation state into
+  // vstate_.
+  spv_result_t RevalidateAndRetrieveValidationState(
+      spv_binary old_binary, spv_target_env env = SPV_ENV_UNIVERSAL_1_0);
+
   std::string getDiagnosticString();
   spv_position_t getErrorPosition();
   spv_validator_options getValidatorOptions();
@@ -118,6 +125,15 @@ spv_result_t ValidateBase<T>::ValidateAndRetrieveValidationState(
       get_const_binary()->wordCount, &diagnostic_, &vstate_);
 }
 
+template <typename T>
+spv_result_t ValidateBase<T>::RevalidateAndRetrieveValidationState(
+    spv_binary old_binary, spv_target_env env) {
+  return spvtools::RevalidateBinaryAndKeepValidationState(
+      ScopedContext(env).context, options_, old_binary->code,
+      old_binary->wordCount, get_const_binary()->code,
+      get_const_binary()->wordCount, &diagnostic_, &vstate_);
+}
+
 template <typename T>
 std::string ValidateBase<T>::getDiagnosticString() {
   return diagnostic_ == nullptr ? std::string()
@@ -1392,6 +1392,32 @@ TEST_F(ValidateSSA, UseFunctionParameterFromOtherFunctionBad) {
                    "outside of it's defining function .\\[func\\]"));
 }
 
+TEST_F(ValidateSSA, UseInEntryOfOtherFunctionBad) {
+  // The dominator trees of both functions are numbered from 0, so the entry
+  // blocks of the two functions have the same numbers.
+  string str = kHeader + "OpName %def \"def\"\n" +
+               "OpName %entry \"entry\"\n" +
+               "OpName %entry2 \"entry2\"\n" + kBasicTypes +
+               R"(
+%func   = OpFunction %voidt None %vfunct
+%entry  = OpLabel
+%def    = OpCopyObject %uintt %one
+          OpReturn
+          OpFunctionEnd
+%func2  = OpFunction %voidt None %vfunct
+%entry2 = OpLabel
+%use    = OpCopyObject %uintt %def
+          OpReturn
+          OpFunctionEnd
+)";
+
+  CompileSuccessfully(str);
+  ASSERT_EQ(SPV_ERROR_INVALID_ID, ValidateInstructions());
+  EXPECT_THAT(getDiagnosticString(),
+              MatchesRegex("ID .\\[def\\] defined in block .\\[entry\\] does "
+                           "not dominate its use in block .\\[entry2\\]"));
+}
+
 TEST_F(ValidateSSA, TypeForwardPointerForwardReference) {
   // See https://github.com/KhronosGroup/SPIRV-Tools/issues/429
   //
@@ -15,6 +15,7 @@
 
 // Unit tests for ValidationState_t.
 
+#include <algorithm>
 #include <vector>
 
 #include "gtest/gtest.h"
@@ -32,6 +33,8 @@ namespace {
 using libspirv::CapabilitySet;
 using libspirv::Extension;
 using libspirv::ExtensionSet;
+using libspirv::InstructionRule;
+using libspirv::InstructionRuleTable;
 using libspirv::ValidationState_t;
 using std::vector;
 
@@ -133,4 +136,54 @@ TEST_F(ValidationState_HasAnyOfExtensions, MultiCapMask) {
   EXPECT_TRUE(state_.HasAnyOfExtensions(set1));
   EXPECT_FALSE(state_.HasAnyOfExtensions(set2));
 }
+
+// Tests of InstructionRuleTable.
+spv_result_t FirstRule(ValidationState_t&, const spv_parsed_instruction_t*) {
+  return SPV_SUCCESS;
+}
+spv_result_t SecondRule(ValidationState_t&, const spv_parsed_instruction_t*) {
+  return SPV_SUCCESS;
+}
+spv_result_t ThirdRule(ValidationState_t&, const spv_parsed_instruction_t*) {
+  return SPV_SUCCESS;
+}
+
+TEST(InstructionRuleTable, RulesRunInTheOrderTheyWereAdded) {
+  InstructionRuleTable table;
+  table.AddRule(FirstRule, {SpvOpIAdd});
+  table.AddRuleForAllOpcodes(SecondRule);
+  table.AddRule(ThirdRule, {SpvOpIAdd, SpvOpFAdd});
+
+  EXPECT_EQ(vector<InstructionRule>({FirstRule, SecondRule, ThirdRule}),
+            table.rules(SpvOpIAdd));
+  EXPECT_EQ(vector<InstructionRule>({SecondRule, ThirdRule}),
+            table.rules(SpvOpFAdd));
+  EXPECT_EQ(vector<InstructionRule>({SecondRule}), table.rules(SpvOpNop));
+}
+
+TEST(InstructionRuleTable, UnknownOpcodesGetRulesForAllOpcodes) {
+  InstructionRuleTable table;
+  table.AddRule(FirstRule, {SpvOpIAdd});
+  table.AddRuleForAllOpcodes(SecondRule);
+  EXPECT_EQ(vector<InstructionRule>({SecondRule}), table.rules(0xfffe));
+}
+
+TEST(InstructionRuleTable, RulesCanBeAddedByPredicate) {
+  InstructionRuleTable table;
+  table.AddRule(FirstRule, [](SpvOp opcode) { return opcode == SpvOpFAdd; });
+  EXPECT_EQ(vector<InstructionRule>({FirstRule}), table.rules(SpvOpFAdd));
+  EXPECT_TRUE(table.rules(SpvOpIAdd).empty());
+}
+
+TEST(InstructionRuleTable, ValidatorRulesOnlyRunForRelevantOpcodes) {
+  const auto& rules = libspirv::GetInstructionRuleTable().rules(SpvOpNop);
+  EXPECT_NE(rules.end(),
+            std::find(rules.begin(), rules.end(), libspirv::IdPass));
+  EXPECT_EQ(rules.end(),
+            std::find(rules.begin(), rules.end(), libspirv::ArithmeticsPass));
+  const auto& iadd_rules = libspirv::GetInstructionRuleTable().rules(SpvOpIAdd);
+  EXPECT_NE(iadd_rules.end(), std::find(iadd_rules.begin(), iadd_rules.end(),
+                                        libspirv::ArithmeticsPass));
+}
+
 }  // namespace
@@ -0,0 +1,239 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// Tests for the keys and entries of the validation result cache.
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "spirv_validator_options.h"
+#include "val/validation_cache.h"
+
+namespace {
+
+using libspirv::ValidationCache;
+using Messages = std::vector<ValidationCache::Message>;
+
+const std::vector<uint32_t> kModule = {0x07230203, 0x00010000, 0, 1, 0,
+                                       0x00020011, 1};
+
+TEST(ValidationCacheKey, IsStable) {
+  spv_validator_options_t options;
+  const ValidationCache cache(SPV_ENV_UNIVERSAL_1_0, options);
+  const std::string key = cache.Key(kModule.data(), kModule.size());
+  EXPECT_EQ(32u, key.size());
+  EXPECT_EQ(key, cache.Key(kModule.data(), kModule.size()));
+  EXPECT_EQ(key, ValidationCache(SPV_ENV_UNIVERSAL_1_0, options)
+                     .Key(kModule.data(), kModule.size()));
+}
+
+TEST(ValidationCacheKey, DependsOnEveryWord) {
+  spv_validator_options_t options;
+  const ValidationCache cache(SPV_ENV_UNIVERSAL_1_0, options);
+  const std::string key = cache.Key(kModule.data(), kModule.size());
+  for (size_t i = 0; i < kModule.size(); ++i) {
+    std::vector<uint32_t> module = kModule;
+    module[i] ^= 0x100;
+    EXPECT_NE(key, cache.Key(module.data(), module.size())) << i;
+  }
+  EXPECT_NE(key, cache.Key(kModule.data(), kModule.size() - 1));
+}
+
+TEST(ValidationCacheKey, DependsOnTargetEnvAndOptions) {
+  spv_validator_options_t options;
+  const std::string key = ValidationCache(SPV_ENV_UNIVERSAL_1_0, options)
+                              .Key(kModule.data(), kModule.size());
+  EXPECT_NE(key, ValidationCache(SPV_ENV_VULKAN_1_0, options)
+                     .Key(kModule.data(), kModule.size()));
+
+  spv_validator_options_t relaxed_options;
+  relaxed_options.relax_struct_store = true;
+  EXPECT_NE(key, ValidationCache(SPV_ENV_UNIVERSAL_1_0, relaxed_options)
+                     .Key(kModule.data(), kModule.size()));
+
+  spv_validator_options_t limited_options;
+  limited_options.universal_limits_.max_struct_depth = 10;
+  EXPECT_NE(key, ValidationCache(SPV_ENV_UNIVERSAL_1_0, limited_options)
+                     .Key(kModule.data(), kModule.size()));
+}
+
+// Reads the bytes of the file at |path|.
+std::vector<char> ReadFile(const std::string& path) {
+  std::vector<char> bytes;
+  if (FILE* file = fopen(path.c_str(), "rb")) {
+    char buffer[256];
+    size_t size = 0;
+    while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+      bytes.insert(bytes.end(), buffer, buffer + size);
+    }
+    fclose(file);
+  }
+  return bytes;
+}
+
+// Replaces the file at |path| with |bytes|.
+void WriteFile(const std::string& path, const std::vector<char>& bytes) {
+  if (FILE* file = fopen(path.c_str(), "wb")) {
+    fwrite(bytes.data(), 1, bytes.size(), file);
+    fclose(file);
+  }
+}
+
+// Replaces the 4 bytes at |offset| of |bytes| with |value|.
+std::vector<char> WithWord(std::vector<char> bytes, size_t offset,
+                           uint32_t value) {
+  memcpy(&bytes[offset], &value, sizeof(value));
+  return bytes;
+}
+
+// Returns a cache of results for |options| in the temporary directory.
+ValidationCache TempCache(spv_validator_options_t* options) {
+  options->cache_directory = ::testing::TempDir();
+  return ValidationCache(SPV_ENV_UNIVERSAL_1_0, *options);
+}
+
+TEST(ValidationCacheEntry, CorruptEntriesAreMisses) {
+  spv_validator_options_t options;
+  const ValidationCache cache = TempCache(&options);
+  const std::string path = options.cache_directory + "/" +
+                           cache.Key(kModule.data(), kModule.size()) +
+                           ".spvval";
+  ValidationCache::Message message;
+  message.level = SPV_MSG_ERROR;
+  message.position = {1, 2, 3};
+  message.text = "bad";
+  cache.Store(kModule.data(), kModule.size(), SPV_ERROR_INVALID_ID,
+              Messages(1, message));
+
+  spv_result_t result = SPV_SUCCESS;
+  Messages messages;
+  ASSERT_TRUE(cache.Lookup(kModule.data(), kModule.size(), &result, &messages));
+  EXPECT_EQ(SPV_ERROR_INVALID_ID, result);
+  ASSERT_EQ(1u, messages.size());
+  EXPECT_EQ("bad", messages[0].text);
+
+  // The entry holds the magic number, the configuration and the module, each
+  // preceded by its size, the result, the number of messages, then the level,
+  // position and text size of each message. The size of the configuration
+  // depends on the library version, so offsets are taken from the end.
+  const std::vector<char> entry = ReadFile(path);
+  const size_t message_size = 4 + 24 + 4 + 3;
+  ASSERT_LT(4u + 8 + 8 + 4 * kModule.size() + 4 + 4 + message_size,
+            entry.size());
+  const size_t num_messages_offset = entry.size() - message_size - 4;
+  const size_t module_offset =
+      num_messages_offset - 4 - 4 * kModule.size();
+  const size_t text_size_offset = entry.size() - 3 - 4;
+  const std::vector<std::vector<char>> corrupt_entries = {
+      WithWord(entry, num_messages_offset, 0xFFFFFFFF),
+      WithWord(entry, num_messages_offset, 2),
+      WithWord(entry, text_size_offset, 0xFFFFFFF0),
+      WithWord(entry, text_size_offset, 4),
+      WithWord(entry, module_offset, kModule[0] ^ 0x100),
+      WithWord(entry, module_offset + 4 * (kModule.size() - 1),
+               kModule.back() ^ 0x100),
+      std::vector<char>(entry.begin(), entry.end() - 1)};
+  for (const auto& corrupt_entry : corrupt_entries) {
+    WriteFile(path, corrupt_entry);
+    EXPECT_FALSE(
+        cache.Lookup(kModule.data(), kModule.size(), &result, &messages));
+  }
+  std::remove(path.c_str());
+}
+
+TEST(ValidationCacheEntry, EntryOfOtherModuleIsMiss) {
+  // Simulates two modules whose keys collide, by storing the entry of one
+  // module under the key of the other.
+  spv_validator_options_t options;
+  const ValidationCache cache = TempCache(&options);
+  std::vector<uint32_t> other_module = kModule;
+  other_module.back() = 2;
+  cache.Store(other_module.data(), other_module.size(), SPV_ERROR_INVALID_ID,
+              Messages());
+  const std::string other_path = options.cache_directory + "/" +
+                                 cache.Key(other_module.data(),
+                                           other_module.size()) +
+                                 ".spvval";
+  const std::string path = options.cache_directory + "/" +
+                           cache.Key(kModule.data(), kModule.size()) +
+                           ".spvval";
+  WriteFile(path, ReadFile(other_path));
+
+  spv_result_t result = SPV_SUCCESS;
+  Messages messages;
+  EXPECT_TRUE(cache.Lookup(other_module.data(), other_module.size(), &result,
+                           &messages));
+  EXPECT_FALSE(
+      cache.Lookup(kModule.data(), kModule.size(), &result, &messages));
+  std::remove(path.c_str());
+  std::remove(other_path.c_str());
+}
+
+TEST(ValidationCacheEntry, ValidationReportsHitsAndStoresMisses) {
+  spv_context context = spvContextCreate(SPV_ENV_UNIVERSAL_1_0);
+  spv_validator_options options = spvValidatorOptionsCreate();
+  spvValidatorOptionsSetCacheDirectory(options,
+                                       ::testing::TempDir().c_str());
+  const ValidationCache cache(SPV_ENV_UNIVERSAL_1_0, *options);
+
+  const std::string text =
+      "OpCapability Shader\n"
+      "OpCapability Linkage\n"
+      "OpMemoryModel Logical GLSL450\n";
+  spv_binary binary = nullptr;
+  ASSERT_EQ(SPV_SUCCESS, spvTextToBinary(context, text.c_str(), text.size(),
+                                         &binary, nullptr));
+  const std::string path = options->cache_directory + "/" +
+                           cache.Key(binary->code, binary->wordCount) +
+                           ".spvval";
+  std::remove(path.c_str());
+
+  // A miss validates the module and stores its result.
+  spv_diagnostic diagnostic = nullptr;
+  spv_const_binary_t const_binary = {binary->code, binary->wordCount};
+  EXPECT_EQ(SPV_SUCCESS, spvValidateWithOptions(context, options,
+                                                &const_binary, &diagnostic));
+  EXPECT_EQ(nullptr, diagnostic);
+  spv_result_t result = SPV_ERROR_INTERNAL;
+  Messages messages;
+  EXPECT_TRUE(
+      cache.Lookup(binary->code, binary->wordCount, &result, &messages));
+  EXPECT_EQ(SPV_SUCCESS, result);
+  EXPECT_TRUE(messages.empty());
+
+  // A hit reports the stored result and messages without validating.
+  ValidationCache::Message message;
+  message.level = SPV_MSG_ERROR;
+  message.position = {0, 0, 5};
+  message.text = "cached";
+  cache.Store(binary->code, binary->wordCount, SPV_ERROR_INVALID_ID,
+              Messages(1, message));
+  EXPECT_EQ(SPV_ERROR_INVALID_ID,
+            spvValidateWithOptions(context, options, &const_binary,
+                                   &diagnostic));
+  ASSERT_NE(nullptr, diagnostic);
+  EXPECT_STREQ("cached", diagnostic->error);
+  EXPECT_EQ(5u, diagnostic->position.index);
+
+  std::remove(path.c_str());
+  spvDiagnosticDestroy(diagnostic);
+  spvBinaryDestroy(binary);
+  spvValidatorOptionsDestroy(options);
+  spvContextDestroy(context);
+}
+
+}  // namespace
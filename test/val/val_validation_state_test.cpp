@@ -25,6 +25,7 @@ namespace {
 
 using std::string;
 using ::testing::HasSubstr;
+using ::testing::Not;
 
 using ValidationStateTest = spvtest::ValidateBase<bool>;
 
@@ -152,4 +153,271 @@ TEST_F(ValidationStateTest, CheckAccessChainIndexesLimitOption) {
   EXPECT_EQ(100u, options_->universal_limits_.max_access_chain_indexes);
 }
 
+const char kTwoFunctions[] = R"(
+    %bool = OpTypeBool
+    %true = OpConstantTrue %bool
+    %void = OpTypeVoid
+  %void_f = OpTypeFunction %void
+       %f = OpFunction %void None %void_f
+ %f_entry = OpLabel
+            OpReturn
+            OpFunctionEnd
+       %g = OpFunction %void None %void_f
+ %g_entry = OpLabel
+            OpReturn
+            OpFunctionEnd
+)";
+
+// Returns kTwoFunctions with the body of %g replaced by |g_body|.
+string EditFunctionG(const string& g_body) {
+  string spirv = string(header) + kTwoFunctions;
+  const string old_body = "%g_entry = OpLabel\n            OpReturn\n";
+  return spirv.replace(spirv.find(old_body), old_body.size(), g_body);
+}
+
+TEST_F(ValidationStateTest, RevalidationSkipsUnchangedFunctions) {
+  CompileSuccessfully(string(header) + kTwoFunctions);
+  ASSERT_EQ(SPV_SUCCESS, ValidateAndRetrieveValidationState());
+  const uint32_t f_id = vstate_->functions()[0].id();
+  const uint32_t g_id = vstate_->functions()[1].id();
+
+  const spv_binary old_binary = binary_;
+  binary_ = nullptr;
+  CompileSuccessfully(EditFunctionG(R"(
+ %g_entry = OpLabel
+            OpBranch %g_exit
+  %g_exit = OpLabel
+            OpReturn
+)"));
+  EXPECT_EQ(SPV_SUCCESS, RevalidateAndRetrieveValidationState(old_binary));
+  EXPECT_TRUE(vstate_->function_checks_skipped(f_id));
+  EXPECT_FALSE(vstate_->function_checks_skipped(g_id));
+  spvBinaryDestroy(old_binary);
+}
+
+TEST_F(ValidationStateTest, RevalidationChecksChangedFunctions) {
+  CompileSuccessfully(string(header) + kTwoFunctions);
+  ASSERT_EQ(SPV_SUCCESS, ValidateAndRetrieveValidationState());
+
+  const spv_binary old_binary = binary_;
+  binary_ = nullptr;
+  CompileSuccessfully(EditFunctionG(R"(
+ %g_entry = OpLabel
+            OpSelectionMerge %merge None
+            OpBranchConditional %true %then %merge
+    %then = OpLabel
+       %x = OpCopyObject %bool %true
+            OpBranch %merge
+   %merge = OpLabel
+       %y = OpCopyObject %bool %x
+            OpReturn
+)"));
+  EXPECT_EQ(SPV_ERROR_INVALID_ID,
+            RevalidateAndRetrieveValidationState(old_binary));
+  EXPECT_THAT(getDiagnosticString(), HasSubstr("does not dominate its use"));
+  spvBinaryDestroy(old_binary);
+}
+
+TEST_F(ValidationStateTest, RevalidationAfterGlobalEditChecksAllFunctions) {
+  CompileSuccessfully(string(header) + kTwoFunctions);
+  ASSERT_EQ(SPV_SUCCESS, ValidateAndRetrieveValidationState());
+
+  const spv_binary old_binary = binary_;
+  binary_ = nullptr;
+  CompileSuccessfully(string(header) + "%int = OpTypeInt 32 0" +
+                      kTwoFunctions);
+  EXPECT_EQ(SPV_SUCCESS, RevalidateAndRetrieveValidationState(old_binary));
+  for (const auto& function : vstate_->functions()) {
+    EXPECT_FALSE(vstate_->function_checks_skipped(function.id()));
+  }
+  spvBinaryDestroy(old_binary);
+}
+
+// Tests the properties of types reported by ValidationState.
+TEST_F(ValidationStateTest, TypeProperties) {
+  string spirv = string(header) + R"(
+     %int = OpTypeInt 32 1
+    %uint = OpTypeInt 32 0
+   %float = OpTypeFloat 32
+    %vec3 = OpTypeVector %float 3
+    %mat4 = OpTypeMatrix %vec3 4
+   %ivec2 = OpTypeVector %int 2
+%_ptr_mat = OpTypePointer Private %mat4
+     %one = OpConstant %float 1
+  )";
+  CompileSuccessfully(spirv);
+  ASSERT_EQ(SPV_SUCCESS, ValidateAndRetrieveValidationState());
+
+  const uint32_t int_id = 1, uint_id = 2, float_id = 3, vec3_id = 4,
+                 mat4_id = 5, ivec2_id = 6, ptr_id = 7, one_id = 8;
+  EXPECT_TRUE(vstate_->IsSignedIntScalarType(int_id));
+  EXPECT_TRUE(vstate_->IsUnsignedIntScalarType(uint_id));
+  EXPECT_FALSE(vstate_->IsSignedIntScalarType(uint_id));
+  EXPECT_TRUE(vstate_->IsFloatVectorType(vec3_id));
+  EXPECT_EQ(3u, vstate_->GetDimension(vec3_id));
+  EXPECT_TRUE(vstate_->IsFloatMatrixType(mat4_id));
+  EXPECT_FALSE(vstate_->IsFloatVectorType(mat4_id));
+  EXPECT_EQ(float_id, vstate_->GetComponentType(mat4_id));
+  EXPECT_EQ(32u, vstate_->GetBitWidth(mat4_id));
+  EXPECT_TRUE(vstate_->IsSignedIntVectorType(ivec2_id));
+  EXPECT_FALSE(vstate_->IsUnsignedIntVectorType(ivec2_id));
+  EXPECT_FALSE(vstate_->IsPointerType(mat4_id));
+
+  uint32_t num_rows = 0, num_cols = 0, column_type = 0, component_type = 0;
+  EXPECT_TRUE(vstate_->GetMatrixTypeInfo(mat4_id, &num_rows, &num_cols,
+                                         &column_type, &component_type));
+  EXPECT_EQ(3u, num_rows);
+  EXPECT_EQ(4u, num_cols);
+  EXPECT_EQ(vec3_id, column_type);
+  EXPECT_EQ(float_id, component_type);
+
+  uint32_t data_type = 0, storage_class = 0;
+  EXPECT_TRUE(vstate_->GetPointerTypeInfo(ptr_id, &data_type, &storage_class));
+  EXPECT_EQ(mat4_id, data_type);
+  EXPECT_EQ(uint32_t(SpvStorageClassPrivate), storage_class);
+
+  // Objects report the properties of their type.
+  EXPECT_EQ(float_id, vstate_->GetComponentType(one_id));
+  EXPECT_EQ(1u, vstate_->GetDimension(one_id));
+  EXPECT_EQ(32u, vstate_->GetBitWidth(one_id));
+}
+
+// Tests that a type id near a huge ID bound does not size the type table.
+TEST_F(ValidationStateTest, TypePropertiesOfLargeIds) {
+  string spirv = string(header) + R"(
+ %uint = OpTypeInt 32 0
+%uvec2 = OpTypeVector %uint 2
+  )";
+  CompileSuccessfully(spirv);
+  // The result id of OpTypeVector follows the 5 header words, the 7 words of
+  // the capabilities and memory model, and the 4 words of OpTypeInt.
+  const uint32_t uvec2_id = 0xFFFFFFFE;
+  OverwriteAssembledBinary(3, 0xFFFFFFFF);
+  OverwriteAssembledBinary(17, uvec2_id);
+  ASSERT_EQ(SPV_SUCCESS, ValidateAndRetrieveValidationState());
+  EXPECT_TRUE(vstate_->IsUnsignedIntVectorType(uvec2_id));
+  EXPECT_EQ(2u, vstate_->GetDimension(uvec2_id));
+}
+
+// Tests that integer types are neither signed nor unsigned when their
+// signedness is neither 0 nor 1.
+TEST_F(ValidationStateTest, TypePropertiesOfInvalidSignedness) {
+  string spirv = string(header) + R"(
+  %odd = OpTypeInt 32 2
+ %vec2 = OpTypeVector %odd 2
+  )";
+  CompileSuccessfully(spirv);
+  ValidateAndRetrieveValidationState();
+  const uint32_t odd_id = 1, vec2_id = 2;
+  EXPECT_TRUE(vstate_->IsIntScalarType(odd_id));
+  EXPECT_FALSE(vstate_->IsUnsignedIntScalarType(odd_id));
+  EXPECT_FALSE(vstate_->IsSignedIntScalarType(odd_id));
+  EXPECT_FALSE(vstate_->IsUnsignedIntVectorType(vec2_id));
+  EXPECT_FALSE(vstate_->IsSignedIntVectorType(vec2_id));
+}
+
+const char kTwoBadAdds[] = R"(
+    %void = OpTypeVoid
+  %void_f = OpTypeFunction %void
+     %int = OpTypeInt 32 0
+   %float = OpTypeFloat 32
+     %one = OpConstant %int 1
+   %f_one = OpConstant %float 1
+    %func = OpFunction %void None %void_f
+   %entry = OpLabel
+       %x = OpIAdd %int %f_one %one
+       %y = OpIAdd %float %one %one
+       %z = OpIAdd %float %x %x
+            OpReturn
+            OpFunctionEnd
+)";
+
+TEST_F(ValidationStateTest, StopsAtFirstErrorByDefault) {
+  CompileSuccessfully(string(header) + kTwoBadAdds);
+  EXPECT_EQ(SPV_ERROR_INVALID_DATA, ValidateAndRetrieveValidationState());
+  EXPECT_EQ(1u, vstate_->num_errors());
+  EXPECT_THAT(getDiagnosticString(),
+              HasSubstr("Expected int scalar or vector type as operand"));
+}
+
+TEST_F(ValidationStateTest, ReportsSeveralErrors) {
+  spvValidatorOptionsSetMaxErrors(options_, 10);
+  CompileSuccessfully(string(header) + kTwoBadAdds);
+  EXPECT_EQ(SPV_ERROR_INVALID_DATA, ValidateInstructions());
+  const string diagnostic = getDiagnosticString();
+  EXPECT_THAT(diagnostic,
+              HasSubstr("Expected int scalar or vector type as operand"));
+  EXPECT_THAT(diagnostic,
+              HasSubstr("Expected int scalar or vector type as Result Type"));
+}
+
+TEST_F(ValidationStateTest, DoesNotReportErrorsCausedByEarlierOnes) {
+  spvValidatorOptionsSetMaxErrors(options_, 10);
+  CompileSuccessfully(string(header) + kTwoBadAdds);
+  EXPECT_EQ(SPV_ERROR_INVALID_DATA, ValidateAndRetrieveValidationState());
+  // The error of %z, which uses the invalid %x, is not counted.
+  EXPECT_EQ(2u, vstate_->num_errors());
+}
+
+TEST_F(ValidationStateTest, StopsAfterMaxErrors) {
+  spvValidatorOptionsSetMaxErrors(options_, 1);
+  CompileSuccessfully(string(header) + kTwoBadAdds);
+  EXPECT_EQ(SPV_ERROR_INVALID_DATA, ValidateInstructions());
+  EXPECT_THAT(getDiagnosticString(),
+              Not(HasSubstr("as Result Type")));
+}
+
+TEST_F(ValidationStateTest, FailedInstructionStillEndsItsBlock) {
+  spvValidatorOptionsSetMaxErrors(options_, 10);
+  CompileSuccessfully(string(header) + R"(
+     %int = OpTypeInt 32 0
+   %float = OpTypeFloat 32
+     %one = OpConstant %int 1
+   %int_f = OpTypeFunction %int
+    %func = OpFunction %int None %int_f
+   %entry = OpLabel
+       %x = OpIAdd %int %undef %one
+            OpReturnValue %x
+            OpFunctionEnd
+    %next = OpFunction %int None %int_f
+ %n_entry = OpLabel
+       %y = OpIAdd %float %one %one
+            OpReturnValue %one
+            OpFunctionEnd
+)");
+  EXPECT_EQ(SPV_ERROR_INVALID_ID, ValidateAndRetrieveValidationState());
+  // %x is not defined, so OpReturnValue fails too, but it still ends the
+  // block and OpFunctionEnd is valid. The error of %y is reported.
+  EXPECT_EQ(2u, vstate_->num_errors());
+  const string diagnostic = getDiagnosticString();
+  EXPECT_THAT(diagnostic, HasSubstr("has not been defined"));
+  EXPECT_THAT(diagnostic,
+              HasSubstr("Expected int scalar or vector type as Result Type"));
+  EXPECT_THAT(diagnostic, Not(HasSubstr("cannot be called in blocks")));
+}
+
+TEST_F(ValidationStateTest, FailedFunctionStillStartsItsBody) {
+  spvValidatorOptionsSetMaxErrors(options_, 10);
+  CompileSuccessfully(string(header) + R"(
+    %void = OpTypeVoid
+     %int = OpTypeInt 32 0
+   %float = OpTypeFloat 32
+     %one = OpConstant %int 1
+    %func = OpFunction %void None %missing_f
+   %entry = OpLabel
+       %y = OpIAdd %float %one %one
+            OpReturn
+            OpFunctionEnd
+)");
+  EXPECT_EQ(SPV_ERROR_INVALID_ID, ValidateAndRetrieveValidationState());
+  // The function is registered although OpFunction failed, so its label is
+  // in a function body and the error of %y is reported.
+  EXPECT_EQ(2u, vstate_->num_errors());
+  const string diagnostic = getDiagnosticString();
+  EXPECT_THAT(diagnostic, HasSubstr("has not been defined"));
+  EXPECT_THAT(diagnostic,
+              HasSubstr("Expected int scalar or vector type as Result Type"));
+  EXPECT_THAT(diagnostic, Not(HasSubstr("must be in a function body")));
+}
+
 }  // anonymous namespace
@@ -15,6 +15,7 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <functional>
 #include <iostream>
@@ -22,7 +23,9 @@
 #include <vector>
 
 #include "markv_model_factory.h"
+#include "markv_model_trainer.h"
 #include "source/comp/markv.h"
+#include "source/spirv_stats.h"
 #include "source/spirv_target_env.h"
 #include "source/table.h"
 #include "spirv-tools/optimizer.hpp"
@@ -37,6 +40,9 @@ enum Task {
   kEncode,
   kDecode,
   kTest,
+  kTrain,
+  kPack,
+  kUnpack,
 };
 
 struct ScopedContext {
@@ -50,10 +56,17 @@ void print_usage(char* argv0) {
       R"(%s - Encodes or decodes a SPIR-V binary to or from a MARK-V binary.
 
 USAGE: %s [e|d|t] [options] [<filename>]
+       %s train -o <model-filename> [<filenames>]
+       %s pack [options] -o <pack-filename> [<filenames>]
+       %s unpack [options] --index=<n> [<pack-filename>]
 
 The input binary is read from <filename>. If no file is specified,
 or if the filename is "-", then the binary is read from standard input.
 
+TIP: In order to train a model on all .spv files under a directory use
+find <directory> -name "*.spv" -print0 | xargs -0 -s 2000000 %s train -o <model-filename>
+Packs are built the same way, with 'pack' instead of 'train'.
+
 If no output is specified then the output is printed to stdout in a human
 readable format.
 
@@ -66,6 +79,11 @@ Tasks:
   d               Decode MARK-V to SPIR-V.
   t               Test the codec by first encoding the given SPIR-V file to
                   MARK-V, then decoding it back to SPIR-V and comparing results.
+  train           Train a compression model on the given SPIR-V files, and
+                  write it to a model file which --model-file accepts.
+  pack            Encode the given SPIR-V files to a MARK-V pack, which stores
+                  the global sections and functions they share once.
+  unpack          Decode the module with the given index from a MARK-V pack.
 
 Options:
   -h, --help      Print this help.
@@ -78,13 +96,18 @@ Options:
                   shader_mid - balanced
                   shader_max - best compression ratio
                   Default: shader_lite
+  --model-file=<filename>
+                  Load the compression model from a model file written by the
+                  'train' task, instead of using a built-in model.
+  --index=<n>     Index of the module to decode with the 'unpack' task, in
+                  the order of the files given to the 'pack' task.
 
   -o <filename>   Set the output filename.
                   Output goes to standard output if this option is
                   not specified, or if the filename is "-".
                   Not needed for 't' task (testing).
 )",
-      argv0, argv0);
+      argv0, argv0, argv0, argv0, argv0, argv0);
 }
 
 void DiagnosticsMessageHandler(spv_message_level_t level, const char*,
@@ -113,6 +136,11 @@ void DiagnosticsMessageHandler(spv_message_level_t level, const char*,
 int main(int argc, char** argv) {
   const char* input_filename = nullptr;
   const char* output_filename = nullptr;
+  const char* model_filename = nullptr;
+  std::vector<const char*> spirv_filenames;
+  bool has_module_index = false;
+  uint32_t module_index = 0;
+  spvtools::MarkvContainerOptions container_options;
 
   Task task = kNoTask;
 
@@ -128,6 +156,12 @@ int main(int argc, char** argv) {
     task = kDecode;
   } else if (0 == strcmp("t", task_char)) {
     task = kTest;
+  } else if (0 == strcmp("train", task_char)) {
+    task = kTrain;
+  } else if (0 == strcmp("pack", task_char)) {
+    task = kPack;
+  } else if (0 == strcmp("unpack", task_char)) {
+    task = kUnpack;
   }
 
   if (task == kNoTask) {
@@ -147,8 +181,7 @@ int main(int argc, char** argv) {
           print_usage(argv[0]);
           return 0;
         case 'o': {
-          if (!output_filename && argi + 1 < argc &&
-              (task == kEncode || task == kDecode)) {
+          if (!output_filename && argi + 1 < argc && task != kTest) {
             output_filename = argv[++argi];
           } else {
             print_usage(argv[0]);
@@ -178,6 +211,15 @@ int main(int argc, char** argv) {
             if (model_type != spvtools::kMarkvModelUnknown)
               fprintf(stderr, "error: More than one model specified\n");
             model_type = spvtools::kMarkvModelShaderMax;
+          } else if (0 == strncmp(argv[argi], "--model-file=", 13)) {
+            if (model_filename) {
+              fprintf(stderr, "error: More than one model file specified\n");
+              return 1;
+            }
+            model_filename = argv[argi] + 13;
+          } else if (0 == strncmp(argv[argi], "--index=", 8)) {
+            has_module_index = true;
+            module_index = static_cast<uint32_t>(atoi(argv[argi] + 8));
           } else {
             print_usage(argv[0]);
             return 1;
@@ -196,6 +238,8 @@ int main(int argc, char** argv) {
           print_usage(argv[0]);
           return 1;
       }
+    } else if (task == kTrain || task == kPack) {
+      spirv_filenames.push_back(argv[argi]);
     } else {
       if (!input_filename) {
         input_filename = argv[argi];
@@ -206,6 +250,11 @@ int main(int argc, char** argv) {
     }
   }
 
+  if (model_filename && model_type != spvtools::kMarkvModelUnknown) {
+    fprintf(stderr, "error: Both --model and --model-file specified\n");
+    return 1;
+  }
+
   if (model_type == spvtools::kMarkvModelUnknown)
     model_type = spvtools::kMarkvModelShaderLite;
 
@@ -216,8 +265,51 @@ int main(int argc, char** argv) {
 
   ScopedContext ctx(kSpvEnv);
 
-  std::unique_ptr<spvtools::MarkvModel> model =
-      spvtools::CreateMarkvModel(model_type);
+  if (task == kTrain) {
+    if (spirv_filenames.empty() || !output_filename) {
+      print_usage(argv[0]);
+      return 1;
+    }
+
+    libspirv::SetContextMessageConsumer(ctx.context,
+                                        DiagnosticsMessageHandler);
+    libspirv::SpirvStats stats;
+    for (const char* filename : spirv_filenames) {
+      std::vector<uint32_t> contents;
+      if (!ReadFile<uint32_t>(filename, "rb", &contents)) return 1;
+      if (SPV_SUCCESS != libspirv::AggregateStats(*ctx.context,
+                                                  contents.data(),
+                                                  contents.size(), nullptr,
+                                                  &stats)) {
+        std::cerr << "error: Failed to aggregate stats for " << filename
+                  << std::endl;
+        return 1;
+      }
+    }
+
+    const spvtools::MarkvModelTrained trained_model(stats);
+    std::vector<uint32_t> model_words;
+    trained_model.Serialize(&model_words);
+    if (!WriteFile<uint32_t>(output_filename, "wb", model_words.data(),
+                             model_words.size()))
+      return 1;
+    return 0;
+  }
+
+  std::unique_ptr<spvtools::MarkvModel> model;
+  if (model_filename) {
+    std::vector<uint32_t> model_words;
+    if (!ReadFile<uint32_t>(model_filename, "rb", &model_words)) return 1;
+    model = spvtools::MarkvModel::Deserialize(model_words.data(),
+                                              model_words.size());
+    if (!model) {
+      std::cerr << "error: " << model_filename
+                << " is not a valid MARK-V model file" << std::endl;
+      return 1;
+    }
+  } else {
+    model = spvtools::CreateMarkvModel(model_type);
+  }
 
   std::vector<uint32_t> spirv;
   std::vector<uint8_t> markv;
@@ -225,7 +317,47 @@ int main(int argc, char** argv) {
   spvtools::MarkvCodecOptions options;
   options.validate_spirv_binary = validate_spirv_binary;
 
-  if (task == kEncode) {
+  if (task == kPack) {
+    if (spirv_filenames.empty() || !output_filename) {
+      print_usage(argv[0]);
+      return 1;
+    }
+
+    std::vector<std::vector<uint32_t>> modules(spirv_filenames.size());
+    for (size_t index = 0; index < spirv_filenames.size(); ++index) {
+      if (!ReadFile<uint32_t>(spirv_filenames[index], "rb", &modules[index]))
+        return 1;
+    }
+
+    if (SPV_SUCCESS != spvtools::SpirvToMarkvPack(
+                           ctx.context, modules, options, container_options,
+                           *model, DiagnosticsMessageHandler, &markv)) {
+      std::cerr << "error: Failed to encode MARK-V pack" << std::endl;
+      return 1;
+    }
+
+    if (!WriteFile<uint8_t>(output_filename, "wb", markv.data(), markv.size()))
+      return 1;
+  } else if (task == kUnpack) {
+    if (!has_module_index) {
+      print_usage(argv[0]);
+      return 1;
+    }
+
+    if (!ReadFile<uint8_t>(input_filename, "rb", &markv)) return 1;
+
+    if (SPV_SUCCESS !=
+        spvtools::MarkvPackToSpirv(ctx.context, markv.data(), markv.size(),
+                                   module_index, options, container_options,
+                                   *model, DiagnosticsMessageHandler, &spirv)) {
+      std::cerr << "error: Failed to decode module " << module_index
+                << " of " << input_filename << " to SPIR-V " << std::endl;
+      return 1;
+    }
+
+    if (!WriteFile<uint32_t>(output_filename, "wb", spirv.data(), spirv.size()))
+      return 1;
+  } else if (task == kEncode) {
     if (!ReadFile<uint32_t>(input_filename, "rb", &spirv)) return 1;
     assert(!spirv.empty());
 
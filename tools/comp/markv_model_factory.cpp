@@ -33,6 +33,12 @@ std::unique_ptr<MarkvModel> CreateMarkvModel(MarkvModelType type) {
       model.reset(new MarkvModelShaderMax());
       break;
     }
+    case kMarkvModelTrained: {
+      assert(0 &&
+             "Trained models are loaded from model files, not created by "
+             "CreateMarkvModel");
+      return model;
+    }
     case kMarkvModelUnknown: {
       assert(0 && "kMarkvModelUnknown supplied to CreateMarkvModel");
       return model;
@@ -26,6 +26,8 @@ enum MarkvModelType {
   kMarkvModelShaderLite,
   kMarkvModelShaderMid,
   kMarkvModelShaderMax,
+  // Trained with spirv-markv train, see MarkvModelTrained.
+  kMarkvModelTrained,
 };
 
 std::unique_ptr<MarkvModel> CreateMarkvModel(MarkvModelType type);
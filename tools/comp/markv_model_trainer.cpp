@@ -0,0 +1,171 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "markv_model_trainer.h"
+
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "markv_model_factory.h"
+
+using libspirv::SpirvStats;
+using spvutils::HuffmanCodec;
+
+namespace spvtools {
+
+namespace {
+
+const uint64_t kMarkvNoneOfTheAbove = MarkvModel::GetMarkvNoneOfTheAbove();
+
+// Opcodes and values which make up less than this of their histogram are not
+// worth a codec entry of their own.
+const double kFrequentEnoughToAnalyze = 0.001;
+const double kWordFrequentEnoughToAnalyze = 0.003;
+const double kDescriptorFrequentEnoughToAnalyze = 0.003;
+
+// Longest code of the trained codecs. Rare values lose a few bits at most,
+// and the codecs are stored as code lengths only.
+const uint32_t kMaxCodeLength = 32;
+
+// Returns the histogram of a codec for the values of |hist| which |keep|
+// accepts, given the value and its frequency in |hist|. The other values are
+// merged into |none_of_the_above|.
+template <class Val, class Hist, class KeepFn>
+std::map<Val, uint32_t> GetCodecHist(const Hist& hist,
+                                     const Val& none_of_the_above,
+                                     KeepFn keep) {
+  uint32_t total = 0;
+  for (const auto& pair : hist) {
+    total += pair.second;
+  }
+
+  uint32_t left_out = 0;
+  std::map<Val, uint32_t> codec_hist;
+  for (const auto& pair : hist) {
+    if (!keep(pair.first, double(pair.second) / double(total))) {
+      left_out += pair.second;
+      continue;
+    }
+    codec_hist.emplace(pair.first, pair.second);
+  }
+
+  // Heuristic.
+  codec_hist.emplace(none_of_the_above,
+                     std::max(1, int(left_out + total * 0.01)));
+  return codec_hist;
+}
+
+// Returns a canonical codec for |hist|.
+template <class Val>
+std::unique_ptr<HuffmanCodec<Val>> CreateCodec(
+    const std::map<Val, uint32_t>& hist) {
+  return std::unique_ptr<HuffmanCodec<Val>>(
+      new HuffmanCodec<Val>(hist, kMaxCodeLength));
+}
+
+// Folds |words| into a 16-bit model version (FNV-1a).
+uint16_t GetVersionFromContents(const std::vector<uint32_t>& words) {
+  uint32_t hash = 2166136261u;
+  for (uint32_t word : words) {
+    hash = (hash ^ word) * 16777619u;
+  }
+  return static_cast<uint16_t>(hash ^ (hash >> 16));
+}
+
+}  // namespace
+
+MarkvModelTrained::MarkvModelTrained(const SpirvStats& stats) {
+  uint32_t num_opcodes = 0;
+  for (const auto& pair : stats.opcode_hist) {
+    num_opcodes += pair.second;
+  }
+  const auto opcode_freq = [&](uint32_t opcode) {
+    const auto it = stats.opcode_hist.find(opcode);
+    if (it == stats.opcode_hist.end()) return 0.0;
+    return double(it->second) / double(num_opcodes);
+  };
+
+  opcode_and_num_operands_huffman_codec_ = CreateCodec(
+      GetCodecHist(stats.opcode_and_num_operands_hist, kMarkvNoneOfTheAbove,
+                   [](uint64_t opcode_and_num_operands, double freq) {
+                     return (opcode_and_num_operands & 0xFFFF) !=
+                                SpvOpTypeStruct &&
+                            freq >= kFrequentEnoughToAnalyze;
+                   }));
+
+  for (const auto& kv : stats.opcode_and_num_operands_markov_hist) {
+    const uint32_t prev_opcode = kv.first;
+    if (opcode_freq(prev_opcode) < kFrequentEnoughToAnalyze) continue;
+    opcode_and_num_operands_markov_huffman_codecs_.emplace(
+        prev_opcode,
+        CreateCodec(GetCodecHist(
+            kv.second, kMarkvNoneOfTheAbove,
+            [&](uint64_t opcode_and_num_operands, double freq) {
+              const uint32_t opcode = opcode_and_num_operands & 0xFFFF;
+              return opcode != SpvOpTypeStruct &&
+                     (opcode_freq(opcode) >= kFrequentEnoughToAnalyze ||
+                      freq >= kFrequentEnoughToAnalyze);
+            })));
+  }
+
+  for (const auto& kv : stats.literal_strings_hist) {
+    const uint32_t opcode = kv.first;
+    if (opcode == SpvOpName || opcode == SpvOpMemberName) continue;
+    if (opcode_freq(opcode) < kFrequentEnoughToAnalyze) continue;
+    literal_string_huffman_codecs_.emplace(
+        opcode, CreateCodec(GetCodecHist(
+                    kv.second, std::string("kMarkvNoneOfTheAbove"),
+                    [](const std::string&, double freq) {
+                      return freq >= kFrequentEnoughToAnalyze;
+                    })));
+  }
+
+  for (const auto& kv : stats.operand_slot_non_id_words_hist) {
+    if (opcode_freq(kv.first.first) < kFrequentEnoughToAnalyze) continue;
+    non_id_word_huffman_codecs_.emplace(
+        kv.first, CreateCodec(GetCodecHist(
+                      kv.second, kMarkvNoneOfTheAbove,
+                      [](uint64_t, double freq) {
+                        return freq >= kWordFrequentEnoughToAnalyze;
+                      })));
+  }
+
+  for (const auto& kv : stats.operand_slot_id_descriptor_hist) {
+    if (opcode_freq(kv.first.first) < kDescriptorFrequentEnoughToAnalyze)
+      continue;
+    id_descriptor_huffman_codecs_.emplace(
+        kv.first, CreateCodec(GetCodecHist(
+                      kv.second, kMarkvNoneOfTheAbove,
+                      [this](uint64_t descriptor, double freq) {
+                        if (freq < kDescriptorFrequentEnoughToAnalyze)
+                          return false;
+                        descriptors_with_coding_scheme_.insert(
+                            static_cast<uint32_t>(descriptor));
+                        return true;
+                      })));
+  }
+
+  id_fallback_strategy_ = IdFallbackStrategy::kRuleBased;
+
+  SetModelType(kMarkvModelTrained);
+  std::vector<uint32_t> words;
+  Serialize(&words);
+  SetModelVersion(GetVersionFromContents(words));
+}
+
+}  // namespace spvtools
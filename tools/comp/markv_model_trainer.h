@@ -0,0 +1,36 @@
+// Copyright (c) 2018 Google LLC.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef SPIRV_TOOLS_MARKV_MODEL_TRAINER_H_
+#define SPIRV_TOOLS_MARKV_MODEL_TRAINER_H_
+
+#include "source/comp/markv_model.h"
+#include "source/spirv_stats.h"
+
+namespace spvtools {
+
+// MARK-V model trained on the statistics of a corpus of SPIR-V modules, as
+// collected by libspirv::AggregateStats. It has the same codecs as
+// MarkvModelShaderMax, made with the same heuristics which spirv-stats uses
+// to generate the code of the shader models. The model version is derived
+// from the contents of the model, so that modules are never decoded with a
+// model other than the one they were encoded with.
+class MarkvModelTrained : public MarkvModel {
+ public:
+  explicit MarkvModelTrained(const libspirv::SpirvStats& stats);
+};
+
+}  // namespace spvtools
+
+#endif  // SPIRV_TOOLS_MARKV_MODEL_TRAINER_H_
@@ -12,6 +12,7 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <cstdio>
 #include <cstring>
 #include <iostream>
 #include <vector>
@@ -38,6 +39,8 @@ Options:
   --create-library        Link the binaries into a library, keeping all exported symbols.
   --allow-partial-linkage Allow partial linkage by accepting imported symbols to be unresolved.
   --verify-ids            Verify that IDs in the resulting modules are truly unique.
+  --threads <n>           Use <n> threads to load the input binaries; 0 uses one
+                          thread per hardware thread. Defaults to 1.
   --version               Display linker version information
   --target-env            {vulkan1.0|spv1.0|spv1.1|spv1.2|opencl2.1|opencl2.2}
                           Use Vulkan1.0/SPIR-V1.0/SPIR-V1.1/SPIR-V1.2/OpenCL-2.1/OpenCL2.2 validation rules.
@@ -76,6 +79,17 @@ int main(int argc, char** argv) {
         options.SetVerifyIds(true);
       } else if (0 == strcmp(cur_arg, "--allow-partial-linkage")) {
         options.SetAllowPartialLinkage(true);
+      } else if (0 == strcmp(cur_arg, "--threads")) {
+        uint32_t num_threads = 0u;
+        if (argi + 1 < argc &&
+            1 == sscanf(argv[argi + 1], "%u", &num_threads)) {
+          options.SetNumThreads(num_threads);
+          ++argi;
+        } else {
+          fprintf(stderr, "error: Expected a thread count after --threads\n");
+          continue_processing = false;
+          return_code = 1;
+        }
       } else if (0 == strcmp(cur_arg, "--version")) {
         printf("%s\n", spvSoftwareVersionDetailsString());
         // TODO(dneto): Add OpenCL 2.2 at least.
@@ -93,6 +93,11 @@ Options (in lexicographical order):
                Cleanup the control flow graph. This will remove any unnecessary
                code from the CFG like unreachable code. Performed on entry
                point call tree functions and exported functions.
+  --change-report
+               Print, for each pass, how many times it ran, how many of those
+               runs changed the module, and how many runs were skipped because
+               the module had not changed since the pass last ran, to standard
+               error output.
   --compact-ids
                Remap result ids to a compact range starting from %%1 and without
                any gaps.
@@ -559,6 +564,8 @@ OptStatus ParseFlags(int argc, const char** argv, Optimizer* optimizer,
         optimizer->SetPrintAll(&std::cerr);
       } else if (0 == strcmp(cur_arg, "--time-report")) {
         optimizer->SetTimeReport(&std::cerr);
+      } else if (0 == strcmp(cur_arg, "--change-report")) {
+        optimizer->SetChangeReport(&std::cerr);
       } else if ('\0' == cur_arg[1]) {
         // Setting a filename of "-" to indicate stdin.
         if (!*in_file) {
@@ -12,14 +12,22 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <atomic>
 #include <cassert>
+#include <cctype>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "source/spirv_stats.h"
 #include "source/table.h"
+#include "source/util/parallel.h"
 #include "spirv-tools/libspirv.h"
 #include "stats_analyzer.h"
 #include "tools/io.h"
@@ -28,6 +36,9 @@ using libspirv::SpirvStats;
 
 namespace {
 
+// Guards the standard streams, which all threads report to.
+std::mutex output_mutex;
+
 struct ScopedContext {
   ScopedContext(spv_target_env env) : context(spvContextCreate(env)) {}
   ~ScopedContext() { spvContextDestroy(context); }
@@ -41,7 +52,7 @@ void PrintUsage(char* argv0) {
 USAGE: %s [options] [<filepaths>]
 
 TIP: In order to collect statistics from all .spv files under current dir use
-find . -name "*.spv" -print0 | xargs -0 -s 2000000 %s
+find . -name "*.spv" | %s --paths_from=-
 
 Options:
   -h, --help
@@ -50,6 +61,23 @@ Options:
   -v, --verbose
                    Print additional info to stderr.
 
+  --num_threads=<n>
+                   Process files on <n> threads. The default of 0 uses one
+                   thread per hardware thread.
+
+  --merge
+                   The input files are stats written by --write_stats, which
+                   are merged instead of being collected from SPIR-V binaries.
+
+  --write_stats=<filename>
+                   Write the collected or merged stats to <filename> in a
+                   binary format, which --merge accepts.
+
+  --paths_from=<filename>
+                   Also process the files listed in <filename>, one path per
+                   line. The list is read while the files are processed. If
+                   <filename> is "-", the list is read from standard input.
+
   --codegen_opcode_hist
                    Output generated C++ code for opcode histogram.
                    This flag disables non-C++ output.
@@ -85,6 +113,7 @@ Options:
 void DiagnosticsMessageHandler(spv_message_level_t level, const char*,
                                const spv_position_t& position,
                                const char* message) {
+  std::lock_guard<std::mutex> lock(output_mutex);
   switch (level) {
     case SPV_MSG_FATAL:
     case SPV_MSG_INTERNAL_ERROR:
@@ -103,6 +132,34 @@ void DiagnosticsMessageHandler(spv_message_level_t level, const char*,
   }
 }
 
+// Hands out the paths given on the command line, followed by the paths read
+// one per line from |list|, to any number of threads.
+class PathSource {
+ public:
+  PathSource(const std::vector<const char*>& paths, std::istream* list)
+      : paths_(paths), list_(list) {}
+
+  // Sets |path| to the next path to process. Returns false when there are
+  // none left.
+  bool Next(std::string* path) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (next_path_ < paths_.size()) {
+      *path = paths_[next_path_++];
+      return true;
+    }
+    while (list_ && std::getline(*list_, *path)) {
+      if (!path->empty()) return true;
+    }
+    return false;
+  }
+
+ private:
+  std::mutex mutex_;
+  const std::vector<const char*>& paths_;
+  size_t next_path_ = 0;
+  std::istream* list_;
+};
+
 }  // namespace
 
 int main(int argc, char** argv) {
@@ -119,7 +176,12 @@ int main(int argc, char** argv) {
   bool codegen_non_id_word_huffman_codecs = false;
   bool codegen_id_descriptor_huffman_codecs = false;
 
+  uint32_t num_threads = 0;
+  bool merge = false;
+  const char* write_stats_path = nullptr;
+
   std::vector<const char*> paths;
+  const char* paths_from = nullptr;
   const char* output_path = nullptr;
 
   for (int argi = 1; continue_processing && argi < argc; ++argi) {
@@ -155,6 +217,25 @@ int main(int argc, char** argv) {
       } else if (0 == strcmp(cur_arg, "--verbose") ||
                  0 == strcmp(cur_arg, "-v")) {
         verbose = true;
+      } else if (0 == strncmp(cur_arg, "--num_threads=", 14)) {
+        const char* value = cur_arg + 14;
+        char* end = nullptr;
+        const unsigned long parsed = strtoul(value, &end, 10);
+        if (!isdigit(static_cast<unsigned char>(*value)) || *end != '\0' ||
+            parsed > std::numeric_limits<uint32_t>::max()) {
+          std::cerr << "error: Invalid number of threads: " << value
+                    << std::endl;
+          continue_processing = false;
+          return_code = 1;
+        } else {
+          num_threads = static_cast<uint32_t>(parsed);
+        }
+      } else if (0 == strcmp(cur_arg, "--merge")) {
+        merge = true;
+      } else if (0 == strncmp(cur_arg, "--write_stats=", 14)) {
+        write_stats_path = cur_arg + 14;
+      } else if (0 == strncmp(cur_arg, "--paths_from=", 13)) {
+        paths_from = cur_arg + 13;
       } else if (0 == strcmp(cur_arg, "--output") ||
                  0 == strcmp(cur_arg, "-o")) {
         expect_output_path = true;
@@ -178,31 +259,91 @@ int main(int argc, char** argv) {
     return return_code;
   }
 
-  std::cerr << "Processing " << paths.size() << " files..." << std::endl;
+  std::ifstream paths_from_file;
+  std::istream* path_list = nullptr;
+  if (paths_from) {
+    if (0 == strcmp(paths_from, "-")) {
+      path_list = &std::cin;
+    } else {
+      paths_from_file.open(paths_from);
+      if (!paths_from_file.is_open()) {
+        std::cerr << "error: Failed to open " << paths_from << std::endl;
+        return 1;
+      }
+      path_list = &paths_from_file;
+    }
+    std::cerr << "Processing " << paths.size() << " files and the files "
+              << "listed in " << paths_from << "..." << std::endl;
+  } else {
+    std::cerr << "Processing " << paths.size() << " files..." << std::endl;
+  }
 
   ScopedContext ctx(SPV_ENV_UNIVERSAL_1_1);
   libspirv::SetContextMessageConsumer(ctx.context, DiagnosticsMessageHandler);
 
-  libspirv::SpirvStats stats;
-  stats.opcode_markov_hist.resize(1);
+  // Every thread aggregates the files it takes into a shard of its own, and
+  // the shards are merged once all files are processed.
+  PathSource path_source(paths, path_list);
+  const uint32_t num_shards = spvutils::ResolveNumThreads(num_threads);
+  std::vector<libspirv::SpirvStats> shards(num_shards);
+  std::atomic<size_t> num_processed(0);
+  std::atomic<bool> failed(false);
+  spvutils::ParallelFor(num_shards, num_shards, [&](size_t shard_index) {
+    libspirv::SpirvStats& shard = shards[shard_index];
+    shard.opcode_markov_hist.resize(1);
+
+    std::string path;
+    std::vector<uint32_t> contents;
+    while (!failed && path_source.Next(&path)) {
+      // Keeps the capacity of the buffer from the previous file.
+      contents.clear();
+      if (!ReadFile<uint32_t>(path.c_str(), "rb", &contents)) {
+        failed = true;
+        return;
+      }
+
+      if (merge) {
+        if (!libspirv::AggregateSerializedStats(contents.data(),
+                                                contents.size(), &shard)) {
+          std::lock_guard<std::mutex> lock(output_mutex);
+          std::cerr << "error: " << path << " does not contain valid stats"
+                    << std::endl;
+          failed = true;
+          return;
+        }
+      } else if (SPV_SUCCESS != libspirv::AggregateStats(*ctx.context,
+                                                         contents.data(),
+                                                         contents.size(),
+                                                         nullptr, &shard)) {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        std::cerr << "error: Failed to aggregate stats for " << path
+                  << std::endl;
+        failed = true;
+        return;
+      }
 
-  for (size_t index = 0; index < paths.size(); ++index) {
-    const size_t kMilestonePeriod = 1000;
-    if (verbose) {
-      if (index % kMilestonePeriod == kMilestonePeriod - 1)
+      const size_t kMilestonePeriod = 1000;
+      const size_t index = num_processed++;
+      if (verbose && index % kMilestonePeriod == kMilestonePeriod - 1) {
+        std::lock_guard<std::mutex> lock(output_mutex);
         std::cerr << "Processed " << index + 1 << " files..." << std::endl;
+      }
     }
+  });
+  if (failed) return 1;
 
-    const char* path = paths[index];
-    std::vector<uint32_t> contents;
-    if (!ReadFile<uint32_t>(path, "rb", &contents)) return 1;
+  libspirv::SpirvStats& stats = shards[0];
+  for (uint32_t shard_index = 1; shard_index < num_shards; ++shard_index) {
+    libspirv::MergeStats(shards[shard_index], &stats);
+    shards[shard_index] = libspirv::SpirvStats();
+  }
 
-    if (SPV_SUCCESS != libspirv::AggregateStats(*ctx.context, contents.data(),
-                                                contents.size(), nullptr,
-                                                &stats)) {
-      std::cerr << "error: Failed to aggregate stats for " << path << std::endl;
+  if (write_stats_path) {
+    std::vector<uint32_t> words;
+    libspirv::SerializeStats(stats, &words);
+    if (!WriteFile<uint32_t>(write_stats_path, "wb", words.data(),
+                             words.size()))
       return 1;
-    }
   }
 
   StatsAnalyzer analyzer(stats);
@@ -237,6 +378,10 @@ int main(int argc, char** argv) {
 
     out << std::endl;
     analyzer.WriteConstantLiterals(out);
+
+    out << std::endl;
+    out << "Id descriptor collisions: " << stats.id_descriptor_collisions
+        << std::endl;
   }
 
   if (codegen_opcode_hist) {
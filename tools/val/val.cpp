@@ -44,11 +44,18 @@ Options:
   --max-function-args              <maximum number arguments allowed per function>
   --max-control-flow-nesting-depth <maximum Control Flow nesting depth allowed>
   --max-access-chain-indexes       <maximum number of indexes allowed to use for Access Chain instructions>
+  --max-errors                     <maximum number of errors to report before stopping>
   --relax-logcial-pointer          Allow allocating an object of a pointer type and returning
                                    a pointer value from a function in logical addressing mode
   --relax-struct-store             Allow store from one struct type to a
                                    different type with compatible layout and
                                    members.
+  --num-threads                    <number of threads to use, 0 for one
+                                   per hardware thread>
+  --cache-dir                      <directory>
+                                   Cache validation results in the given
+                                   existing directory, and report cached
+                                   results for modules validated before.
   --version                        Display validator version information.
   --target-env                     {vulkan1.0|spv1.0|spv1.1|spv1.2}
                                    Use Vulkan1.0/SPIR-V1.0/SPIR-V1.1/SPIR-V1.2 validation rules.
@@ -66,7 +73,16 @@ int main(int argc, char** argv) {
   for (int argi = 1; continue_processing && argi < argc; ++argi) {
     const char* cur_arg = argv[argi];
     if ('-' == cur_arg[0]) {
-      if (0 == strncmp(cur_arg, "--max-", 6)) {
+      if (0 == strcmp(cur_arg, "--max-errors")) {
+        uint32_t max_errors = 0;
+        if (argi + 1 < argc && 1 == sscanf(argv[++argi], "%u", &max_errors)) {
+          options.SetMaxErrors(max_errors);
+        } else {
+          fprintf(stderr, "error: Missing argument to %s\n", cur_arg);
+          continue_processing = false;
+          return_code = 1;
+        }
+      } else if (0 == strncmp(cur_arg, "--max-", 6)) {
         if (argi + 1 < argc) {
           spv_validator_limit limit_type;
           if (spvParseUniversalLimitsOptions(cur_arg, &limit_type)) {
@@ -117,6 +133,23 @@ int main(int argc, char** argv) {
           continue_processing = false;
           return_code = 1;
         }
+      } else if (0 == strcmp(cur_arg, "--num-threads")) {
+        uint32_t num_threads = 0;
+        if (argi + 1 < argc && 1 == sscanf(argv[++argi], "%u", &num_threads)) {
+          options.SetNumThreads(num_threads);
+        } else {
+          fprintf(stderr, "error: Missing argument to %s\n", cur_arg);
+          continue_processing = false;
+          return_code = 1;
+        }
+      } else if (0 == strcmp(cur_arg, "--cache-dir")) {
+        if (argi + 1 < argc) {
+          options.SetCacheDirectory(argv[++argi]);
+        } else {
+          fprintf(stderr, "error: Missing argument to --cache-dir\n");
+          continue_processing = false;
+          return_code = 1;
+        }
       } else if (0 == strcmp(cur_arg, "--relax-logical-pointer")) {
         options.SetRelaxLogicalPointer(true);
       } else if (0 == strcmp(cur_arg, "--relax-struct-store")) {